@@ -416,6 +416,9 @@ bool OBSApp::InitGlobalConfigDefaults()
 				  "Normal");
 	config_set_default_bool(globalConfig, "General", "EnableAutoUpdates",
 				true);
+	config_set_default_int(globalConfig, "General", "RemuxJobs", 2);
+	config_set_default_bool(globalConfig, "General", "RemuxFaststart",
+				true);
 
 #if _WIN32
 	config_set_default_string(globalConfig, "Video", "Renderer",
@@ -1930,6 +1933,9 @@ static void SaveProfilerData(const ProfilerSnapshot &snap)
 		     static_cast<const char *>(path));
 }
 
+/* per thread, about ten seconds of the graphics thread at 60 fps */
+#define PROFILER_TRACE_EVENTS 16384
+
 static auto ProfilerFree = [](void *) {
 	profiler_stop();
 
@@ -1965,6 +1971,7 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 		static_cast<void *>(&ProfilerFree), ProfilerFree);
 
 	profiler_start();
+	profiler_trace_start(PROFILER_TRACE_EVENTS);
 	profile_register_root(run_program_init, 0);
 
 	ScopeProfiler prof{run_program_init};
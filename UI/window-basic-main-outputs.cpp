@@ -198,6 +198,13 @@ static bool CreateAACEncoder(OBSEncoder &res, string &id, int bitrate,
 	return false;
 }
 
+static void SetEncoderVideoQueue(config_t *config, obs_encoder_t *encoder)
+{
+	uint64_t depth = config_get_uint(config, "Video", "EncoderQueueDepth");
+	obs_encoder_set_video_queue(encoder, (size_t)depth,
+				    VIDEO_INPUT_DROP_OLDEST);
+}
+
 /* ------------------------------------------------------------------------ */
 
 inline BasicOutputHandler::BasicOutputHandler(OBSBasic *main_) : main(main_)
@@ -719,6 +726,7 @@ inline void SimpleOutput::SetupOutputs()
 {
 	SimpleOutput::Update();
 	obs_encoder_set_video(h264Streaming, obs_get_video());
+	SetEncoderVideoQueue(main->Config(), h264Streaming);
 	obs_encoder_set_audio(aacStreaming, obs_get_audio());
 	obs_encoder_set_audio(aacArchive, obs_get_audio());
 
@@ -728,6 +736,7 @@ inline void SimpleOutput::SetupOutputs()
 					     obs_get_audio());
 		} else {
 			obs_encoder_set_video(h264Recording, obs_get_video());
+			SetEncoderVideoQueue(main->Config(), h264Recording);
 			obs_encoder_set_audio(aacRecording, obs_get_audio());
 		}
 	}
@@ -1608,8 +1617,11 @@ inline void AdvancedOutput::UpdateAudioSettings()
 void AdvancedOutput::SetupOutputs()
 {
 	obs_encoder_set_video(h264Streaming, obs_get_video());
-	if (h264Recording)
+	SetEncoderVideoQueue(main->Config(), h264Streaming);
+	if (h264Recording) {
 		obs_encoder_set_video(h264Recording, obs_get_video());
+		SetEncoderVideoQueue(main->Config(), h264Recording);
+	}
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 		obs_encoder_set_audio(aacTrack[i], obs_get_audio());
 	obs_encoder_set_audio(streamAudioEnc, obs_get_audio());
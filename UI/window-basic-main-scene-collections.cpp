@@ -271,6 +271,7 @@ void OBSBasic::on_actionRenameSceneCollection_triggered()
 	oldFile.insert(0, path);
 	oldFile += ".json";
 	os_unlink(oldFile.c_str());
+	os_unlink((oldFile + ".bin").c_str());
 	oldFile += ".bak";
 	os_unlink(oldFile.c_str());
 
@@ -332,6 +333,7 @@ void OBSBasic::on_actionRemoveSceneCollection_triggered()
 	oldFile.insert(0, path);
 	oldFile += ".json";
 	os_unlink(oldFile.c_str());
+	os_unlink((oldFile + ".bin").c_str());
 	oldFile += ".bak";
 	os_unlink(oldFile.c_str());
 
@@ -18,6 +18,7 @@
 ******************************************************************************/
 
 #include <ctime>
+#include <sys/stat.h>
 #include <obs.hpp>
 #include <QGuiApplication>
 #include <QMessageBox>
@@ -679,8 +680,15 @@ void OBSBasic::Save(const char *file)
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
+	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak")) {
 		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	} else {
+		std::string binFile = std::string(file) + ".bin";
+		if (!obs_data_save_binary_safe(saveData, binFile.c_str(), "tmp",
+					       nullptr))
+			blog(LOG_WARNING, "Could not save scene data to %s",
+			     binFile.c_str());
+	}
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -909,11 +917,33 @@ void OBSBasic::LogScenes()
 	blog(LOG_INFO, "------------------------------------------------");
 }
 
+/* the binary copy is only used while it's at least as new as the json, so
+ * the json can still be edited or replaced by hand */
+static obs_data_t *LoadSceneCollectionData(const char *file)
+{
+	std::string binFile = std::string(file) + ".bin";
+	struct stat jsonStat, binStat;
+
+	if (os_stat(file, &jsonStat) == 0 &&
+	    os_stat(binFile.c_str(), &binStat) == 0 &&
+	    binStat.st_mtime >= jsonStat.st_mtime) {
+		obs_data_t *data =
+			obs_data_create_from_binary_file(binFile.c_str());
+		if (data)
+			return data;
+
+		blog(LOG_WARNING, "Failed to load %s, using the json instead",
+		     binFile.c_str());
+	}
+
+	return obs_data_create_from_json_file_safe(file, "bak");
+}
+
 void OBSBasic::Load(const char *file)
 {
 	disableSaving++;
 
-	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
+	obs_data_t *data = LoadSceneCollectionData(file);
 	if (!data) {
 		disableSaving--;
 		blog(LOG_INFO, "No scene file found, creating default scene");
@@ -999,7 +1029,7 @@ void OBSBasic::Load(const char *file)
 		UNUSED_PARAMETER(source);
 	};
 
-	obs_load_sources(sources, cb, files);
+	obs_load_sources_threaded(sources, cb, files);
 
 	if (transitions)
 		LoadTransitions(transitions);
@@ -1464,6 +1494,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "709");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 				  "Partial");
+	config_set_default_uint(basicConfig, "Video", "EncoderQueueDepth", 0);
+	config_set_default_bool(basicConfig, "Video", "ThreadedInputs", false);
 
 	config_set_default_string(basicConfig, "Audio", "MonitoringDeviceId",
 				  "default");
@@ -2514,6 +2546,19 @@ void OBSBasic::CreateHotkeys()
 		"OBSBasic.SelectedSourceScreenshot",
 		Str("Screenshot.SourceHotkey"), screenshotSource, this);
 	LoadHotkey(sourceScreenshotHotkey, "OBSBasic.SelectedSourceScreenshot");
+
+	auto profilerTrace = [](void *data, obs_hotkey_id, obs_hotkey_t *,
+				bool pressed) {
+		if (pressed)
+			QMetaObject::invokeMethod(static_cast<OBSBasic *>(data),
+						  "SaveProfilerTrace",
+						  Qt::QueuedConnection);
+	};
+
+	profilerTraceHotkey = obs_hotkey_register_frontend(
+		"OBSBasic.SaveProfilerTrace", Str("Basic.SaveProfilerTrace"),
+		profilerTrace, this);
+	LoadHotkey(profilerTraceHotkey, "OBSBasic.SaveProfilerTrace");
 }
 
 void OBSBasic::ClearHotkeys()
@@ -2531,6 +2576,7 @@ void OBSBasic::ClearHotkeys()
 	obs_hotkey_unregister(statsHotkey);
 	obs_hotkey_unregister(screenshotHotkey);
 	obs_hotkey_unregister(sourceScreenshotHotkey);
+	obs_hotkey_unregister(profilerTraceHotkey);
 }
 
 OBSBasic::~OBSBasic()
@@ -4060,6 +4106,10 @@ int OBSBasic::ResetVideo()
 	}
 
 	if (ret == OBS_VIDEO_SUCCESS) {
+		bool threadedInputs = config_get_bool(basicConfig, "Video",
+						      "ThreadedInputs");
+		video_output_set_threaded_inputs(obs_get_video(),
+						 threadedInputs);
 		OBSBasicStats::InitializeValues();
 		OBSProjector::UpdateMultiviewProjectors();
 	}
@@ -8474,6 +8524,22 @@ void OBSBasic::ResetStatsHotkey()
 	foreach(OBSBasicStats * s, list) s->Reset();
 }
 
+void OBSBasic::SaveProfilerTrace()
+{
+	string name = "obs-studio/profiler_data/Trace " +
+		      GenerateTimeDateFilename("json");
+
+	BPtr<char> path = GetConfigPathPtr(name.c_str());
+	if (!path)
+		return;
+
+	if (profiler_trace_dump_json(path))
+		blog(LOG_INFO, "Saved profiler trace to '%s'", path.Get());
+	else
+		blog(LOG_WARNING, "Could not save profiler trace to '%s'",
+		     path.Get());
+}
+
 void OBSBasic::on_customContextMenuRequested(const QPoint &pos)
 {
 	QWidget *widget = childAt(pos);
@@ -447,6 +447,7 @@ private:
 	obs_hotkey_id statsHotkey = 0;
 	obs_hotkey_id screenshotHotkey = 0;
 	obs_hotkey_id sourceScreenshotHotkey = 0;
+	obs_hotkey_id profilerTraceHotkey = 0;
 	int quickTransitionIdCounter = 1;
 	bool overridingTransition = false;
 
@@ -681,6 +682,7 @@ private slots:
 	void ScenesReordered();
 
 	void ResetStatsHotkey();
+	void SaveProfilerTrace();
 
 	void SetImageIcon(const QIcon &icon);
 	void SetColorIcon(const QIcon &icon);
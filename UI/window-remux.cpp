@@ -581,47 +581,31 @@ void RemuxQueueModel::endProcessing()
 			 index(queue.length(), RemuxEntryColumn::State));
 }
 
-bool RemuxQueueModel::beginNextEntry(QString &inputPath, QString &outputPath)
+bool RemuxQueueModel::getPendingEntries(QList<int> &rows,
+					QStringList &inputPaths,
+					QStringList &outputPaths) const
 {
-	bool anyStarted = false;
-
 	for (int row = 0; row < queue.length(); row++) {
-		RemuxQueueEntry &entry = queue[row];
+		const RemuxQueueEntry &entry = queue[row];
 		if (entry.state == RemuxEntryState::Pending) {
-			entry.state = RemuxEntryState::InProgress;
-
-			inputPath = entry.sourcePath;
-			outputPath = entry.targetPath;
-
-			QModelIndex index =
-				this->index(row, RemuxEntryColumn::State);
-			emit dataChanged(index, index);
-
-			anyStarted = true;
-			break;
+			rows.append(row);
+			inputPaths.append(entry.sourcePath);
+			outputPaths.append(entry.targetPath);
 		}
 	}
 
-	return anyStarted;
+	return !rows.empty();
 }
 
-void RemuxQueueModel::finishEntry(bool success)
+void RemuxQueueModel::setEntryState(int row, RemuxEntryState state)
 {
-	for (int row = 0; row < queue.length(); row++) {
-		RemuxQueueEntry &entry = queue[row];
-		if (entry.state == RemuxEntryState::InProgress) {
-			if (success)
-				entry.state = RemuxEntryState::Complete;
-			else
-				entry.state = RemuxEntryState::Error;
+	if (row < 0 || row >= queue.length())
+		return;
 
-			QModelIndex index =
-				this->index(row, RemuxEntryColumn::State);
-			emit dataChanged(index, index);
+	queue[row].state = state;
 
-			break;
-		}
-	}
+	QModelIndex index = this->index(row, RemuxEntryColumn::State);
+	emit dataChanged(index, index);
 }
 
 /**********************************************************
@@ -699,6 +683,10 @@ OBSRemux::OBSRemux(const char *path, QWidget *parent, bool autoRemux_)
 	connect(worker_, &RemuxWorker::updateProgress, this,
 		&OBSRemux::updateProgress);
 	connect(&remuxer, &QThread::finished, worker_, &QObject::deleteLater);
+	connect(worker_, &RemuxWorker::entryStarted, this,
+		&OBSRemux::entryStarted);
+	connect(worker_, &RemuxWorker::entryFinished, this,
+		&OBSRemux::entryFinished);
 	connect(worker_, &RemuxWorker::remuxFinished, this,
 		&OBSRemux::remuxFinished);
 	connect(this, &OBSRemux::remux, worker_, &RemuxWorker::remux);
@@ -857,45 +845,53 @@ void OBSRemux::beginRemux()
 		->setText(QTStr("Remux.Stop"));
 	setAcceptDrops(false);
 
-	remuxNextEntry();
+	remuxEntries();
 }
 
 void OBSRemux::AutoRemux(QString inFile, QString outFile)
 {
 	if (inFile != "" && outFile != "" && autoRemux) {
-		emit remux(inFile, outFile);
+		emit remux(QStringList(inFile), QStringList(outFile));
 		autoRemuxFile = inFile;
 	}
 }
 
-void OBSRemux::remuxNextEntry()
+void OBSRemux::remuxEntries()
 {
 	worker->lastProgress = 0.f;
 
-	QString inputPath, outputPath;
-	if (queueModel->beginNextEntry(inputPath, outputPath)) {
-		emit remux(inputPath, outputPath);
-	} else {
-		queueModel->autoRemux = autoRemux;
-		queueModel->endProcessing();
-
-		if (!autoRemux) {
-			OBSMessageBox::information(
-				this, QTStr("Remux.FinishedTitle"),
-				queueModel->checkForErrors()
-					? QTStr("Remux.FinishedError")
-					: QTStr("Remux.Finished"));
-		}
+	// All pending entries go to the worker at once, which runs several
+	// of them at the same time.
+	QStringList inputPaths, outputPaths;
+	remuxRows.clear();
 
-		ui->progressBar->setVisible(autoRemux);
-		ui->buttonBox->button(QDialogButtonBox::Ok)
-			->setText(QTStr("Remux.Remux"));
-		ui->buttonBox->button(QDialogButtonBox::RestoreDefaults)
-			->setEnabled(true);
-		ui->buttonBox->button(QDialogButtonBox::Reset)
-			->setEnabled(queueModel->canClearFinished());
-		setAcceptDrops(true);
+	if (queueModel->getPendingEntries(remuxRows, inputPaths, outputPaths))
+		emit remux(inputPaths, outputPaths);
+	else
+		endRemux();
+}
+
+void OBSRemux::endRemux()
+{
+	queueModel->autoRemux = autoRemux;
+	queueModel->endProcessing();
+
+	if (!autoRemux) {
+		OBSMessageBox::information(this, QTStr("Remux.FinishedTitle"),
+					   queueModel->checkForErrors()
+						   ? QTStr("Remux.FinishedError")
+						   : QTStr("Remux.Finished"));
 	}
+
+	ui->progressBar->setVisible(autoRemux);
+	ui->progressBar->setFormat("%p%");
+	ui->buttonBox->button(QDialogButtonBox::Ok)
+		->setText(QTStr("Remux.Remux"));
+	ui->buttonBox->button(QDialogButtonBox::RestoreDefaults)
+		->setEnabled(true);
+	ui->buttonBox->button(QDialogButtonBox::Reset)
+		->setEnabled(queueModel->canClearFinished());
+	setAcceptDrops(true);
 }
 
 void OBSRemux::closeEvent(QCloseEvent *event)
@@ -914,22 +910,40 @@ void OBSRemux::reject()
 	QDialog::reject();
 }
 
-void OBSRemux::updateProgress(float percent)
+void OBSRemux::updateProgress(float percent, double bytesPerSec)
 {
 	ui->progressBar->setValue(percent * 10);
+
+	if (bytesPerSec > 0.0)
+		ui->progressBar->setFormat(QTStr("Remux.Progress")
+						   .arg(bytesPerSec / 1048576.0,
+							0, 'f', 1));
 }
 
-void OBSRemux::remuxFinished(bool success)
+void OBSRemux::entryStarted(int index)
 {
-	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+	if (index < remuxRows.size())
+		queueModel->setEntryState(remuxRows[index],
+					  RemuxEntryState::InProgress);
+}
 
-	queueModel->finishEntry(success);
+void OBSRemux::entryFinished(int index, bool success)
+{
+	if (index < remuxRows.size())
+		queueModel->setEntryState(remuxRows[index],
+					  success ? RemuxEntryState::Complete
+						  : RemuxEntryState::Error);
+}
+
+void OBSRemux::remuxFinished(bool)
+{
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
 
 	if (autoRemux && autoRemuxFile != "") {
 		QTimer::singleShot(3000, this, SLOT(close()));
 	}
 
-	remuxNextEntry();
+	endRemux();
 }
 
 void OBSRemux::clearFinished()
@@ -947,25 +961,50 @@ void OBSRemux::clearAll()
                   background process.
 **********************************************************/
 
-void RemuxWorker::UpdateProgress(float percent)
+void RemuxWorker::UpdateProgress(float percent, double bytesPerSec)
 {
 	if (abs(lastProgress - percent) < 0.1f)
 		return;
 
-	emit updateProgress(percent);
+	emit updateProgress(percent, bytesPerSec);
 	lastProgress = percent;
 }
 
-void RemuxWorker::remux(const QString &source, const QString &target)
+void RemuxWorker::remux(const QStringList &sources,
+			const QStringList &targets)
 {
 	isWorking = true;
 
-	auto callback = [](void *data, float percent) {
+	config_t *config = GetGlobalConfig();
+	int64_t jobs = config_get_int(config, "General", "RemuxJobs");
+
+	media_remux_options options = {};
+	options.faststart =
+		config_get_bool(config, "General", "RemuxFaststart");
+
+	// The queue calls these from the threads that run the jobs.
+	media_remux_queue_callbacks callbacks = {};
+	callbacks.data = this;
+	callbacks.job_started = [](void *data, size_t idx) {
+		RemuxWorker *rw = static_cast<RemuxWorker *>(data);
+		emit rw->entryStarted((int)idx);
+	};
+	callbacks.job_finished = [](void *data, size_t idx, bool success) {
+		RemuxWorker *rw = static_cast<RemuxWorker *>(data);
+		emit rw->entryFinished((int)idx, success);
+	};
+	callbacks.progress = [](void *data,
+				const media_remux_queue_progress *progress) {
 		RemuxWorker *rw = static_cast<RemuxWorker *>(data);
 
 		QMutexLocker lock(&rw->updateMutex);
 
-		rw->UpdateProgress(percent);
+		float percent = 0.f;
+		if (progress->bytes)
+			percent = (float)((double)progress->bytes_done /
+					  (double)progress->bytes * 100.0);
+
+		rw->UpdateProgress(percent, progress->bytes_per_sec);
 
 		return rw->isWorking;
 	};
@@ -973,13 +1012,16 @@ void RemuxWorker::remux(const QString &source, const QString &target)
 	bool stopped = false;
 	bool success = false;
 
-	media_remux_job_t mr_job = nullptr;
-	if (media_remux_job_create(&mr_job, QT_TO_UTF8(source),
-				   QT_TO_UTF8(target))) {
+	media_remux_queue_t queue = media_remux_queue_create(
+		jobs > 0 ? (size_t)jobs : 1, &options);
+	if (queue) {
+		for (int i = 0; i < sources.size() && i < targets.size(); i++)
+			media_remux_queue_add(queue, QT_TO_UTF8(sources[i]),
+					      QT_TO_UTF8(targets[i]));
 
-		success = media_remux_job_process(mr_job, callback, this);
+		success = media_remux_queue_process(queue, &callbacks);
 
-		media_remux_job_destroy(mr_job);
+		media_remux_queue_destroy(queue);
 
 		stopped = !isWorking;
 	}
@@ -59,6 +59,8 @@ class OBSRemux : public QDialog {
 	bool autoRemux;
 	QString autoRemuxFile;
 
+	QList<int> remuxRows;
+
 public:
 	explicit OBSRemux(const char *recPath, QWidget *parent = nullptr,
 			  bool autoRemux = false);
@@ -72,13 +74,16 @@ protected:
 	virtual void dropEvent(QDropEvent *ev) override;
 	virtual void dragEnterEvent(QDragEnterEvent *ev) override;
 
-	void remuxNextEntry();
+	void remuxEntries();
+	void endRemux();
 
 private slots:
 	void rowCountChanged(const QModelIndex &parent, int first, int last);
 
 public slots:
-	void updateProgress(float percent);
+	void updateProgress(float percent, double bytesPerSec);
+	void entryStarted(int index);
+	void entryFinished(int index, bool success);
 	void remuxFinished(bool success);
 	void beginRemux();
 	bool stopRemux();
@@ -86,7 +91,7 @@ public slots:
 	void clearAll();
 
 signals:
-	void remux(const QString &source, const QString &target);
+	void remux(const QStringList &sources, const QStringList &targets);
 };
 
 class RemuxQueueModel : public QAbstractTableModel {
@@ -112,8 +117,9 @@ public:
 	bool checkForErrors() const;
 	void beginProcessing();
 	void endProcessing();
-	bool beginNextEntry(QString &inputPath, QString &outputPath);
-	void finishEntry(bool success);
+	bool getPendingEntries(QList<int> &rows, QStringList &inputPaths,
+			       QStringList &outputPaths) const;
+	void setEntryState(int row, RemuxEntryState state);
 	bool canClearFinished() const;
 	void clearFinished();
 	void clearAll();
@@ -144,16 +150,18 @@ class RemuxWorker : public QObject {
 	bool isWorking;
 
 	float lastProgress;
-	void UpdateProgress(float percent);
+	void UpdateProgress(float percent, double bytesPerSec);
 
 	explicit RemuxWorker() : isWorking(false) {}
 	virtual ~RemuxWorker(){};
 
 private slots:
-	void remux(const QString &source, const QString &target);
+	void remux(const QStringList &sources, const QStringList &targets);
 
 signals:
-	void updateProgress(float percent);
+	void updateProgress(float percent, double bytesPerSec);
+	void entryStarted(int index);
+	void entryFinished(int index, bool success);
 	void remuxFinished(bool success);
 
 	friend class OBSRemux;
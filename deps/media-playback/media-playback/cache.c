@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/bmem.h>
+
+#include "cache.h"
+
+#define CACHE_BLOCK_SIZE (8 * 1024 * 1024)
+#define CACHE_ALIGN 32
+
+void mp_cache_clear(struct mp_cache *c)
+{
+	for (size_t i = 0; i < c->blocks.num; i++)
+		bfree(c->blocks.array[i]);
+
+	da_free(c->blocks);
+	da_free(c->video);
+	da_free(c->audio);
+	c->block_size = 0;
+	c->block_used = 0;
+	c->size = 0;
+	c->next_video = 0;
+	c->next_audio = 0;
+}
+
+void mp_cache_free(struct mp_cache *c)
+{
+	mp_cache_clear(c);
+	c->state = MP_CACHE_DISABLED;
+}
+
+static inline size_t entries_size(const struct mp_cache *c)
+{
+	return c->video.capacity * sizeof(struct mp_cache_video) +
+	       c->audio.capacity * sizeof(struct mp_cache_audio);
+}
+
+static bool reserve(struct mp_cache *c, size_t size)
+{
+	size_t block_size;
+
+	size = (size + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1);
+
+	if (c->blocks.num && c->block_used + size <= c->block_size)
+		return true;
+
+	block_size = size > CACHE_BLOCK_SIZE ? size : CACHE_BLOCK_SIZE;
+
+	if (c->max_size &&
+	    c->size + block_size + entries_size(c) > c->max_size) {
+		mp_cache_clear(c);
+		c->state = MP_CACHE_DISABLED;
+		return false;
+	}
+
+	uint8_t *block = bmalloc(block_size);
+	da_push_back(c->blocks, &block);
+	c->size += block_size;
+	c->block_size = block_size;
+	c->block_used = 0;
+	return true;
+}
+
+static uint8_t *copy_data(struct mp_cache *c, const uint8_t *data, size_t size)
+{
+	uint8_t *block = c->blocks.array[c->blocks.num - 1];
+	uint8_t *ptr = block + c->block_used;
+
+	memcpy(ptr, data, size);
+	c->block_used += (size + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1);
+	return ptr;
+}
+
+static inline size_t aligned_total(const size_t *sizes, size_t count)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < count; i++)
+		total += (sizes[i] + CACHE_ALIGN - 1) &
+			 ~(size_t)(CACHE_ALIGN - 1);
+
+	return total;
+}
+
+bool mp_cache_add_video(struct mp_cache *c,
+			const struct obs_source_frame *frame,
+			const size_t plane_sizes[MAX_AV_PLANES], int64_t pts,
+			int64_t duration)
+{
+	struct mp_cache_video *entry;
+
+	/* planes share a block so a frame is never split */
+	if (!reserve(c, aligned_total(plane_sizes, MAX_AV_PLANES)))
+		return false;
+
+	entry = da_push_back_new(c->video);
+	entry->frame = *frame;
+	entry->pts = pts;
+	entry->duration = duration;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		entry->frame.data[i] =
+			plane_sizes[i] ? copy_data(c, frame->data[i],
+						   plane_sizes[i])
+				       : NULL;
+	}
+
+	return true;
+}
+
+bool mp_cache_add_audio(struct mp_cache *c,
+			const struct obs_source_audio *audio, int64_t pts,
+			int64_t duration)
+{
+	size_t planes = get_audio_planes(audio->format, audio->speakers);
+	size_t size = get_audio_size(audio->format, audio->speakers,
+				     audio->frames);
+	size_t sizes[MAX_AV_PLANES];
+	struct mp_cache_audio *entry;
+
+	for (size_t i = 0; i < planes; i++)
+		sizes[i] = size;
+
+	if (!reserve(c, aligned_total(sizes, planes)))
+		return false;
+
+	entry = da_push_back_new(c->audio);
+	entry->audio = *audio;
+	entry->pts = pts;
+	entry->duration = duration;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		entry->audio.data[i] =
+			i < planes ? copy_data(c, audio->data[i], size) : NULL;
+	}
+
+	return true;
+}
+
+void mp_cache_seek(struct mp_cache *c, int64_t pts)
+{
+	c->next_video = 0;
+	c->next_audio = 0;
+
+	/* starts at the frame shown at that time rather than the next one */
+	while (c->next_video + 1 < c->video.num &&
+	       c->video.array[c->next_video + 1].pts <= pts)
+		c->next_video++;
+	while (c->next_audio + 1 < c->audio.num &&
+	       c->audio.array[c->next_audio + 1].pts <= pts)
+		c->next_audio++;
+}
+
+uint64_t mp_cache_get_memory_usage(const struct mp_cache *c)
+{
+	return (uint64_t)(c->size + entries_size(c));
+}
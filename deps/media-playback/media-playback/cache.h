@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decoded frame cache
+ *
+ *   Holds every decoded frame of a media file so that looping it again doesn't
+ * need to decode anything.  Frame data is copied into large blocks instead of
+ * one allocation per frame.  Only used by the media thread.
+ */
+
+enum mp_cache_state {
+	MP_CACHE_DISABLED,
+	MP_CACHE_EMPTY,
+	MP_CACHE_FILLING,
+	MP_CACHE_COMPLETE,
+};
+
+struct mp_cache_video {
+	struct obs_source_frame frame;
+	int64_t pts;
+	int64_t duration;
+};
+
+struct mp_cache_audio {
+	struct obs_source_audio audio;
+	int64_t pts;
+	int64_t duration;
+};
+
+struct mp_cache {
+	enum mp_cache_state state;
+	size_t max_size;
+
+	DARRAY(uint8_t *) blocks;
+	size_t block_size;
+	size_t block_used;
+	size_t size;
+
+	DARRAY(struct mp_cache_video) video;
+	DARRAY(struct mp_cache_audio) audio;
+	size_t next_video;
+	size_t next_audio;
+};
+
+extern void mp_cache_free(struct mp_cache *c);
+
+/** Frees all frames, the state is left as it is */
+extern void mp_cache_clear(struct mp_cache *c);
+
+/*
+ * Adding a frame copies its data.  If the cache would grow over max_size it
+ * is cleared and disabled instead, and false is returned.
+ */
+
+/** plane_sizes are the sizes of the planes of the frame in bytes */
+extern bool mp_cache_add_video(struct mp_cache *c,
+			       const struct obs_source_frame *frame,
+			       const size_t plane_sizes[MAX_AV_PLANES],
+			       int64_t pts, int64_t duration);
+extern bool mp_cache_add_audio(struct mp_cache *c,
+			       const struct obs_source_audio *audio,
+			       int64_t pts, int64_t duration);
+
+/** Sets the next frames to play to the ones at the given position */
+extern void mp_cache_seek(struct mp_cache *c, int64_t pts);
+
+/** Memory used by the frames and their descriptions */
+extern uint64_t mp_cache_get_memory_usage(const struct mp_cache *c);
+
+#ifdef __cplusplus
+}
+#endif
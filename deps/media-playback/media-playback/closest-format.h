@@ -102,3 +102,26 @@ static enum AVPixelFormat closest_format(enum AVPixelFormat fmt)
 
 	return AV_PIX_FMT_BGRA;
 }
+
+static inline int get_sws_colorspace(enum AVColorSpace cs)
+{
+	switch (cs) {
+	case AVCOL_SPC_BT709:
+		return SWS_CS_ITU709;
+	case AVCOL_SPC_FCC:
+		return SWS_CS_FCC;
+	case AVCOL_SPC_SMPTE170M:
+		return SWS_CS_SMPTE170M;
+	case AVCOL_SPC_SMPTE240M:
+		return SWS_CS_SMPTE240M;
+	default:
+		break;
+	}
+
+	return SWS_CS_ITU601;
+}
+
+static inline int get_sws_range(enum AVColorRange r)
+{
+	return r == AVCOL_RANGE_JPEG ? 1 : 0;
+}
@@ -102,7 +102,7 @@ static int mp_open_codec(struct mp_decode *d, bool hw)
 	    c->codec_id != AV_CODEC_ID_TIFF &&
 	    c->codec_id != AV_CODEC_ID_JPEG2000 &&
 	    c->codec_id != AV_CODEC_ID_MPEG4 && c->codec_id != AV_CODEC_ID_WEBP)
-		c->thread_count = 0;
+		c->thread_count = d->m->decode_threads;
 
 	ret = avcodec_open2(c, d->codec, NULL);
 	if (ret < 0)
@@ -122,6 +122,12 @@ fail:
 bool mp_decode_init(mp_media_t *m, enum AVMediaType type, bool hw)
 {
 	struct mp_decode *d = type == AVMEDIA_TYPE_VIDEO ? &m->v : &m->a;
+	return mp_decode_open(d, m, type, hw);
+}
+
+bool mp_decode_open(struct mp_decode *d, mp_media_t *m, enum AVMediaType type,
+		    bool hw)
+{
 	enum AVCodecID id;
 	AVStream *stream;
 	int ret;
@@ -329,7 +335,7 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 
 bool mp_decode_next(struct mp_decode *d)
 {
-	bool eof = d->m->eof;
+	bool eof = d->m->eof || d->input_eof;
 	int got_frame;
 	int ret;
 
@@ -432,6 +438,7 @@ void mp_decode_flush(struct mp_decode *d)
 	avcodec_flush_buffers(d->decoder);
 	mp_decode_clear_packets(d);
 	d->eof = false;
+	d->input_eof = false;
 	d->frame_pts = 0;
 	d->frame_ready = false;
 }
@@ -68,6 +68,9 @@ struct mp_decode {
 	bool eof;
 	bool hw;
 
+	/* set instead of media->eof when packets are read on another thread */
+	bool input_eof;
+
 	AVPacket orig_pkt;
 	AVPacket pkt;
 	bool packet_pending;
@@ -76,6 +79,8 @@ struct mp_decode {
 
 extern bool mp_decode_init(struct mp_media *media, enum AVMediaType type,
 			   bool hw);
+extern bool mp_decode_open(struct mp_decode *decode, struct mp_media *media,
+			   enum AVMediaType type, bool hw);
 extern void mp_decode_free(struct mp_decode *decode);
 
 extern void mp_decode_clear_packets(struct mp_decode *decode);
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "index.h"
+
+#include <libavformat/avformat.h>
+
+#define INDEX_VERSION 1
+
+struct index_header {
+	char magic[4];
+	uint32_t version;
+	int64_t file_size;
+	int64_t file_time;
+	int32_t stream;
+	int32_t time_base_num;
+	int32_t time_base_den;
+	uint32_t path_len;
+	uint64_t frames;
+	uint64_t keyframes;
+};
+
+void mp_index_free(struct mp_index *index)
+{
+	da_free(index->frames);
+	da_free(index->keyframes);
+}
+
+static int cmp_pts(const void *a, const void *b)
+{
+	int64_t pts_a = *(const int64_t *)a;
+	int64_t pts_b = *(const int64_t *)b;
+	return pts_a < pts_b ? -1 : (pts_a > pts_b ? 1 : 0);
+}
+
+static int cmp_keyframes(const void *a, const void *b)
+{
+	const struct mp_index_keyframe *kf_a = a;
+	const struct mp_index_keyframe *kf_b = b;
+	return cmp_pts(&kf_a->pts, &kf_b->pts);
+}
+
+bool mp_index_build(struct mp_index *index, const char *path,
+		    const volatile bool *stop)
+{
+	AVFormatContext *fmt = NULL;
+	AVStream *stream;
+	AVPacket pkt;
+	bool success = false;
+	int idx;
+
+	if (avformat_open_input(&fmt, path, NULL, NULL) < 0)
+		return false;
+	if (avformat_find_stream_info(fmt, NULL) < 0)
+		goto fail;
+
+	idx = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (idx < 0)
+		goto fail;
+
+	/* lets the demuxer skip the data of the other streams */
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		if ((int)i != idx)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	stream = fmt->streams[idx];
+	index->stream = idx;
+	index->time_base_num = stream->time_base.num;
+	index->time_base_den = stream->time_base.den;
+
+	av_init_packet(&pkt);
+
+	while (!os_atomic_load_bool(stop)) {
+		int ret = av_read_frame(fmt, &pkt);
+		if (ret == AVERROR_EOF) {
+			success = true;
+			break;
+		} else if (ret < 0) {
+			break;
+		}
+
+		int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+
+		if (pkt.stream_index == idx && pts != AV_NOPTS_VALUE) {
+			da_push_back(index->frames, &pts);
+
+			if (pkt.flags & AV_PKT_FLAG_KEY) {
+				struct mp_index_keyframe *kf =
+					da_push_back_new(index->keyframes);
+				kf->pts = pts;
+				kf->pos = pkt.pos;
+			}
+		}
+
+		av_packet_unref(&pkt);
+	}
+
+	/* packets are in decode order */
+	if (success) {
+		qsort(index->frames.array, index->frames.num, sizeof(int64_t),
+		      cmp_pts);
+		qsort(index->keyframes.array, index->keyframes.num,
+		      sizeof(struct mp_index_keyframe), cmp_keyframes);
+		success = index->keyframes.num > 0;
+	}
+
+fail:
+	avformat_close_input(&fmt);
+	if (!success)
+		mp_index_free(index);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+char *mp_index_get_cache_file(const char *dir, const char *path)
+{
+	struct dstr file = {0};
+	uint64_t hash = 14695981039346656037ULL;
+
+	/* FNV-1a */
+	for (const char *ch = path; *ch; ch++) {
+		hash ^= (uint8_t)*ch;
+		hash *= 1099511628211ULL;
+	}
+
+	dstr_printf(&file, "%s/%016llx.idx", dir, (unsigned long long)hash);
+	return file.array;
+}
+
+static bool get_file_info(const char *path, int64_t *size, int64_t *time)
+{
+	struct stat st;
+
+	if (os_stat(path, &st) != 0)
+		return false;
+
+	*size = (int64_t)st.st_size;
+	*time = (int64_t)st.st_mtime;
+	return true;
+}
+
+static inline bool is_cache_file(const char *name)
+{
+	size_t len = strlen(name);
+	return len > 4 && strcmp(name + len - 4, ".idx") == 0;
+}
+
+size_t mp_index_purge_cache(const char *dir, int64_t max_age)
+{
+	struct dstr path = {0};
+	struct os_dirent *ent;
+	int64_t now = (int64_t)time(NULL);
+	size_t count = 0;
+
+	os_dir_t *d = os_opendir(dir);
+	if (!d)
+		return 0;
+
+	while ((ent = os_readdir(d)) != NULL) {
+		int64_t size, mtime;
+
+		if (ent->directory || !is_cache_file(ent->d_name))
+			continue;
+
+		dstr_printf(&path, "%s/%s", dir, ent->d_name);
+		if (!get_file_info(path.array, &size, &mtime))
+			continue;
+		if (now - mtime > max_age && os_unlink(path.array) == 0)
+			count++;
+	}
+
+	os_closedir(d);
+	dstr_free(&path);
+	return count;
+}
+
+bool mp_index_load(struct mp_index *index, const char *cache_file,
+		   const char *path)
+{
+	struct index_header header;
+	int64_t size, time;
+	size_t path_len = strlen(path);
+	char *saved_path = NULL;
+	bool success = false;
+	FILE *f;
+
+	if (!get_file_info(path, &size, &time))
+		return false;
+
+	f = os_fopen(cache_file, "rb");
+	if (!f)
+		return false;
+
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		goto fail;
+	if (memcmp(header.magic, "MPIX", 4) != 0 ||
+	    header.version != INDEX_VERSION || header.file_size != size ||
+	    header.file_time != time || header.path_len != path_len ||
+	    !header.keyframes || header.keyframes > header.frames ||
+	    header.frames > (uint64_t)size)
+		goto fail;
+
+	/* guards against hash collisions */
+	saved_path = bmalloc(path_len);
+	if (fread(saved_path, 1, path_len, f) != path_len ||
+	    memcmp(saved_path, path, path_len) != 0)
+		goto fail;
+
+	index->stream = header.stream;
+	index->time_base_num = header.time_base_num;
+	index->time_base_den = header.time_base_den;
+
+	da_resize(index->frames, (size_t)header.frames);
+	da_resize(index->keyframes, (size_t)header.keyframes);
+
+	if (fread(index->frames.array, sizeof(int64_t), index->frames.num,
+		  f) != index->frames.num)
+		goto fail;
+	if (fread(index->keyframes.array, sizeof(struct mp_index_keyframe),
+		  index->keyframes.num, f) != index->keyframes.num)
+		goto fail;
+
+	success = true;
+
+fail:
+	fclose(f);
+	bfree(saved_path);
+	if (!success)
+		mp_index_free(index);
+	return success;
+}
+
+bool mp_index_save(const struct mp_index *index, const char *cache_file,
+		   const char *path)
+{
+	struct index_header header = {0};
+	struct dstr temp = {0};
+	bool success;
+	FILE *f;
+
+	memcpy(header.magic, "MPIX", 4);
+	header.version = INDEX_VERSION;
+	header.stream = index->stream;
+	header.time_base_num = index->time_base_num;
+	header.time_base_den = index->time_base_den;
+	header.path_len = (uint32_t)strlen(path);
+	header.frames = index->frames.num;
+	header.keyframes = index->keyframes.num;
+
+	if (!get_file_info(path, &header.file_size, &header.file_time))
+		return false;
+
+	/* written to a temporary file first so that a partially written
+	 * index is never loaded by another source */
+	dstr_printf(&temp, "%s.tmp", cache_file);
+
+	f = os_fopen(temp.array, "wb");
+	if (!f) {
+		dstr_free(&temp);
+		return false;
+	}
+
+	success = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(path, 1, header.path_len, f) == header.path_len &&
+		  fwrite(index->frames.array, sizeof(int64_t),
+			 index->frames.num, f) == index->frames.num &&
+		  fwrite(index->keyframes.array,
+			 sizeof(struct mp_index_keyframe),
+			 index->keyframes.num, f) == index->keyframes.num;
+	fclose(f);
+
+	if (success)
+		success = os_safe_replace(cache_file, temp.array, NULL) == 0;
+	if (!success)
+		os_unlink(temp.array);
+
+	dstr_free(&temp);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+int64_t mp_index_find_frame(const struct mp_index *index, int64_t pts)
+{
+	size_t lo = 0;
+	size_t hi = index->frames.num;
+
+	if (!hi)
+		return pts;
+
+	/* first frame after pts */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->frames.array[mid] <= pts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return index->frames.array[lo ? lo - 1 : 0];
+}
+
+const struct mp_index_keyframe *
+mp_index_find_keyframe(const struct mp_index *index, int64_t pts)
+{
+	size_t lo = 0;
+	size_t hi = index->keyframes.num;
+
+	if (!hi)
+		return NULL;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->keyframes.array[mid].pts <= pts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return index->keyframes.array + (lo ? lo - 1 : 0);
+}
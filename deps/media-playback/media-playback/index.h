@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <util/darray.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Seek index
+ *
+ *   Timestamps of every frame and keyframe of the video stream of a file, read
+ * from its packets without decoding anything.  Timestamps are in the time
+ * base of the stream and sorted in presentation order.
+ */
+
+struct mp_index_keyframe {
+	int64_t pts;
+	int64_t pos;
+};
+
+struct mp_index {
+	int stream;
+	int time_base_num;
+	int time_base_den;
+
+	DARRAY(int64_t) frames;
+	DARRAY(struct mp_index_keyframe) keyframes;
+};
+
+extern void mp_index_free(struct mp_index *index);
+
+/** Reads the whole file, returns false if stopped or on failure */
+extern bool mp_index_build(struct mp_index *index, const char *path,
+			   const volatile bool *stop);
+
+/*
+ * The index of a file can be saved to a cache file.  Loading fails if the
+ * file changed since it was saved.
+ */
+
+/** Returns the cache file of a media file within dir, free with bfree */
+extern char *mp_index_get_cache_file(const char *dir, const char *path);
+extern bool mp_index_load(struct mp_index *index, const char *cache_file,
+			  const char *path);
+extern bool mp_index_save(const struct mp_index *index,
+			  const char *cache_file, const char *path);
+
+/** Deletes the cache files in dir that were saved more than max_age seconds
+ * ago, returns the number of files deleted */
+extern size_t mp_index_purge_cache(const char *dir, int64_t max_age);
+
+/** Returns the pts of the frame shown at pts, or the first frame */
+extern int64_t mp_index_find_frame(const struct mp_index *index, int64_t pts);
+
+/** Returns the last keyframe at or before pts, or the first keyframe */
+extern const struct mp_index_keyframe *
+mp_index_find_keyframe(const struct mp_index *index, int64_t pts);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,7 @@
 
 #include <libavdevice/avdevice.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 
 static int64_t base_sys_ts = 0;
 
@@ -181,29 +182,6 @@ static inline bool mp_decode_frame(struct mp_decode *d)
 	return d->frame_ready || mp_decode_next(d);
 }
 
-static inline int get_sws_colorspace(enum AVColorSpace cs)
-{
-	switch (cs) {
-	case AVCOL_SPC_BT709:
-		return SWS_CS_ITU709;
-	case AVCOL_SPC_FCC:
-		return SWS_CS_FCC;
-	case AVCOL_SPC_SMPTE170M:
-		return SWS_CS_SMPTE170M;
-	case AVCOL_SPC_SMPTE240M:
-		return SWS_CS_SMPTE240M;
-	default:
-		break;
-	}
-
-	return SWS_CS_ITU601;
-}
-
-static inline int get_sws_range(enum AVColorRange r)
-{
-	return r == AVCOL_RANGE_JPEG ? 1 : 0;
-}
-
 #define FIXED_1_0 (1 << 16)
 
 static bool mp_media_init_scaling(mp_media_t *m)
@@ -237,15 +215,152 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	return true;
 }
 
+static inline bool mp_media_cached(mp_media_t *m)
+{
+	return m->cache.state == MP_CACHE_COMPLETE;
+}
+
+static void mp_media_update_cache_memory(mp_media_t *m)
+{
+	uint64_t usage = mp_cache_get_memory_usage(&m->cache);
+
+	if (usage != m->cache_memory) {
+		pthread_mutex_lock(&m->mutex);
+		m->cache_memory = usage;
+		pthread_mutex_unlock(&m->mutex);
+	}
+}
+
+static void mp_media_cache_video(mp_media_t *m,
+				 const struct obs_source_frame *frame)
+{
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(m->scale_format);
+	int planes = av_pix_fmt_count_planes(m->scale_format);
+	size_t sizes[MAX_AV_PLANES] = {0};
+
+	for (int i = 0; i < planes && i < MAX_AV_PLANES; i++) {
+		int height = (int)frame->height;
+		if (i == 1 || i == 2)
+			height = AV_CEIL_RSHIFT(height, desc->log2_chroma_h);
+
+		sizes[i] = (size_t)frame->linesize[i] * height;
+	}
+
+	if (!mp_cache_add_video(&m->cache, frame, sizes, m->v.frame_pts,
+				m->v.next_pts - m->v.frame_pts))
+		blog(LOG_INFO, "MP: '%s' is too large to cache", m->path);
+
+	mp_media_update_cache_memory(m);
+}
+
+static void mp_media_cache_audio(mp_media_t *m,
+				 const struct obs_source_audio *audio)
+{
+	if (!mp_cache_add_audio(&m->cache, audio, m->a.frame_pts,
+				m->a.next_pts - m->a.frame_pts))
+		blog(LOG_INFO, "MP: '%s' is too large to cache", m->path);
+
+	mp_media_update_cache_memory(m);
+}
+
+/* the cached equivalent of decoding the next frame of each stream */
+static void mp_media_prepare_cached(mp_media_t *m)
+{
+	struct mp_cache *c = &m->cache;
+
+	if (m->has_video && !m->v.frame_ready &&
+	    c->next_video < c->video.num) {
+		struct mp_cache_video *entry = c->video.array + c->next_video++;
+
+		m->v.frame_pts = entry->pts;
+		m->v.next_pts = entry->pts + entry->duration;
+		m->v.frame_ready = true;
+	}
+
+	if (m->has_audio && !m->a.frame_ready &&
+	    c->next_audio < c->audio.num) {
+		struct mp_cache_audio *entry = c->audio.array + c->next_audio++;
+
+		m->a.frame_pts = entry->pts;
+		m->a.next_pts = entry->pts + entry->duration;
+		m->a.frame_ready = true;
+	}
+}
+
+/* drops decoded frames that end before the seek target */
+static inline void mp_media_skip_frames(mp_media_t *m)
+{
+	if (!m->skip_to_target)
+		return;
+
+	if (m->has_video && m->v.frame_ready &&
+	    m->v.next_pts <= m->seek_target_ns)
+		m->v.frame_ready = false;
+	if (m->has_audio && m->a.frame_ready &&
+	    m->a.next_pts <= m->seek_target_ns)
+		m->a.frame_ready = false;
+}
+
+static bool mp_media_next_pipeline_frame(mp_media_t *m, struct mp_decode *d)
+{
+	struct mp_pipeline_frame *pf;
+
+	if (!mp_pipeline_next_frame(m->pipeline, d->audio, &pf))
+		return false;
+
+	if (!pf) {
+		d->eof = true;
+		return true;
+	}
+
+	if (!d->audio) {
+		m->pipeline_frame = pf;
+		m->scale_format = pf->format;
+	}
+
+	d->frame = pf->frame;
+	d->frame_pts = pf->pts;
+	d->next_pts = pf->next_pts;
+	d->frame_ready = true;
+	return true;
+}
+
+/* frames are decoded and converted by the pipeline threads */
+static bool mp_media_prepare_pipelined(mp_media_t *m)
+{
+	while (!mp_media_ready_to_start(m)) {
+		if (m->has_video && !m->v.eof && !m->v.frame_ready &&
+		    !mp_media_next_pipeline_frame(m, &m->v))
+			return false;
+		if (m->has_audio && !m->a.eof && !m->a.frame_ready &&
+		    !mp_media_next_pipeline_frame(m, &m->a))
+			return false;
+
+		mp_media_skip_frames(m);
+	}
+
+	m->skip_to_target = false;
+	return true;
+}
+
 static bool mp_media_prepare_frames(mp_media_t *m)
 {
 	bool actively_seeking = m->seek_next_ts && m->pause;
 
+	if (mp_media_cached(m)) {
+		mp_media_prepare_cached(m);
+		return true;
+	}
+	if (m->pipeline)
+		return mp_media_prepare_pipelined(m);
+
 	while (!mp_media_ready_to_start(m)) {
 		if (!m->eof) {
 			int ret = mp_media_next_packet(m);
 			if (ret == AVERROR_EOF || ret == AVERROR_EXIT) {
-				if (!actively_seeking) {
+				/* a seek target near the end is only reached
+				 * once the decoders are drained */
+				if (!actively_seeking || m->skip_to_target) {
 					m->eof = true;
 				} else {
 					break;
@@ -259,8 +374,13 @@ static bool mp_media_prepare_frames(mp_media_t *m)
 			return false;
 		if (m->has_audio && !mp_decode_frame(&m->a))
 			return false;
+
+		mp_media_skip_frames(m);
 	}
 
+	if (mp_media_ready_to_start(m))
+		m->skip_to_target = false;
+
 	if (m->has_video && m->v.frame_ready && !m->swscale) {
 		m->scale_format = closest_format(m->v.frame->format);
 		if (m->scale_format != m->v.frame->format) {
@@ -319,6 +439,14 @@ static void mp_media_next_audio(mp_media_t *m)
 	if (!m->a_cb)
 		return;
 
+	if (mp_media_cached(m)) {
+		audio = m->cache.audio.array[m->cache.next_audio - 1].audio;
+		audio.timestamp = m->base_ts + d->frame_pts - m->start_ts +
+				  m->play_sys_ts - base_sys_ts;
+		m->a_cb(m->opaque, &audio);
+		return;
+	}
+
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		audio.data[i] = f->data[i];
 
@@ -333,9 +461,29 @@ static void mp_media_next_audio(mp_media_t *m)
 	if (audio.format == AUDIO_FORMAT_UNKNOWN)
 		return;
 
+	if (m->cache.state == MP_CACHE_FILLING)
+		mp_media_cache_audio(m, &audio);
+
 	m->a_cb(m->opaque, &audio);
 }
 
+static void mp_media_next_cached_video(mp_media_t *m, bool preload)
+{
+	struct mp_cache_video *entry =
+		m->cache.video.array + m->cache.next_video - 1;
+	struct obs_source_frame frame = entry->frame;
+
+	frame.timestamp = m->base_ts + entry->pts - m->start_ts +
+			  m->play_sys_ts - base_sys_ts;
+
+	if (!preload)
+		m->v_cb(m->opaque, &frame);
+	else if (m->seek_next_ts && m->v_seek_cb)
+		m->v_seek_cb(m->opaque, &frame);
+	else
+		m->v_preload_cb(m->opaque, &frame);
+}
+
 static void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	struct mp_decode *d = &m->v;
@@ -357,8 +505,22 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		return;
 	}
 
+	if (mp_media_cached(m)) {
+		mp_media_next_cached_video(m, preload);
+		return;
+	}
+
 	bool flip = false;
-	if (m->swscale) {
+	if (m->pipeline) {
+		struct mp_pipeline_frame *pf = m->pipeline_frame;
+
+		flip = pf->linesize[0] < 0 && pf->linesize[1] == 0;
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			frame->data[i] = pf->data[i];
+			frame->linesize[i] = abs(pf->linesize[i]);
+		}
+
+	} else if (m->swscale) {
 		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data,
 				    f->linesize, 0, f->height, m->scale_pic,
 				    m->scale_linesizes);
@@ -435,6 +597,9 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 			m->v_preload_cb(m->opaque, frame);
 		}
 	} else {
+		if (m->cache.state == MP_CACHE_FILLING)
+			mp_media_cache_video(m, frame);
+
 		m->v_cb(m->opaque, frame);
 	}
 }
@@ -461,12 +626,161 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
-static void seek_to(mp_media_t *m, int64_t pos)
+static void mp_media_seek_cached(mp_media_t *m, int64_t pos)
+{
+	int64_t pts = INT64_MIN;
+
+	/* cached timestamps are already scaled to the playback speed */
+	if (pos != AV_NOPTS_VALUE)
+		pts = av_rescale(pos, 1000 * 100, m->speed);
+
+	mp_cache_seek(&m->cache, pts);
+	m->v.frame_ready = false;
+	m->v.frame_pts = 0;
+	m->a.frame_ready = false;
+	m->a.frame_pts = 0;
+
+	if (m->has_video && m->seek_next_ts && m->pause && m->v_preload_cb) {
+		mp_media_prepare_cached(m);
+		mp_media_next_video(m, true);
+	}
+}
+
+static inline int64_t stream_ts_to_ns(mp_media_t *m, AVStream *stream,
+				      int64_t ts)
+{
+	int64_t ns = av_rescale_q(ts, stream->time_base,
+				  (AVRational){1, 1000000000});
+
+	if (m->speed != 100)
+		ns = av_rescale_q(ns, (AVRational){1, m->speed},
+				  (AVRational){1, 100});
+	return ns;
+}
+
+bool mp_media_index_ready(mp_media_t *m)
+{
+	bool ready;
+
+	pthread_mutex_lock(&m->mutex);
+	ready = m->index_ready;
+	pthread_mutex_unlock(&m->mutex);
+
+	return ready;
+}
+
+static inline void mp_media_pause_pipeline(mp_media_t *m)
+{
+	if (m->pipeline)
+		mp_pipeline_pause(m->pipeline);
+}
+
+static inline void mp_media_resume_pipeline(mp_media_t *m)
+{
+	if (m->pipeline)
+		mp_pipeline_resume(m->pipeline);
+}
+
+/* the pipeline must be paused */
+static void mp_media_flush(mp_media_t *m)
+{
+	if (m->pipeline) {
+		mp_pipeline_flush(m->pipeline);
+
+		m->v.eof = false;
+		m->v.frame_pts = 0;
+		m->v.frame_ready = false;
+		m->a.eof = false;
+		m->a.frame_pts = 0;
+		m->a.frame_ready = false;
+		return;
+	}
+
+	if (m->has_video)
+		mp_decode_flush(&m->v);
+	if (m->has_audio)
+		mp_decode_flush(&m->a);
+}
+
+/*
+ * Seeks to the keyframe of the frame shown at pos and decodes from there up
+ * to that frame, so at most one GOP is decoded.  If the frame is later in
+ * the GOP that is currently being decoded, decoding just continues instead.
+ */
+static bool seek_to_indexed(mp_media_t *m, int64_t pos)
+{
+	AVStream *stream = m->v.stream;
+	const struct mp_index_keyframe *kf;
+	int64_t frame_pts;
+	int64_t kf_ns;
+
+	if (!m->has_video || !mp_media_index_ready(m))
+		return false;
+	if (m->index.stream != stream->index ||
+	    m->index.time_base_num != stream->time_base.num ||
+	    m->index.time_base_den != stream->time_base.den)
+		return false;
+
+	frame_pts = av_rescale_q(pos, AV_TIME_BASE_Q, stream->time_base);
+	frame_pts = mp_index_find_frame(&m->index, frame_pts);
+	kf = mp_index_find_keyframe(&m->index, frame_pts);
+	if (!kf)
+		return false;
+
+	m->seek_target_ns = stream_ts_to_ns(m, stream, frame_pts);
+	kf_ns = stream_ts_to_ns(m, stream, kf->pts);
+
+	if (m->eof || m->v.eof || m->v.frame_pts <= kf_ns ||
+	    m->v.frame_pts >= m->seek_target_ns) {
+		mp_media_pause_pipeline(m);
+
+		int ret = av_seek_frame(m->fmt, stream->index, kf->pts,
+					AVSEEK_FLAG_BACKWARD);
+		if (ret < 0 && kf->pos >= 0)
+			ret = av_seek_frame(m->fmt, stream->index, kf->pos,
+					    AVSEEK_FLAG_BYTE);
+		if (ret >= 0)
+			mp_media_flush(m);
+
+		mp_media_resume_pipeline(m);
+		if (ret < 0)
+			return false;
+
+		m->eof = false;
+	}
+
+	m->skip_to_target = true;
+
+	if (m->seek_next_ts && m->pause && m->v_preload_cb &&
+	    mp_media_prepare_frames(m))
+		mp_media_next_video(m, true);
+	return true;
+}
+
+static void seek_to(mp_media_t *m, int64_t pos, bool exact)
 {
 	AVStream *stream = m->fmt->streams[0];
 	int64_t seek_pos = pos;
 	int seek_flags;
 
+	m->skip_to_target = false;
+
+	if (mp_media_cached(m)) {
+		mp_media_seek_cached(m, pos);
+		return;
+	}
+
+	/* only a full pass from the start can be cached */
+	if (m->cache.state == MP_CACHE_FILLING) {
+		mp_cache_clear(&m->cache);
+		m->cache.state = MP_CACHE_EMPTY;
+		mp_media_update_cache_memory(m);
+	}
+
+	exact = exact && m->is_local_file && pos != AV_NOPTS_VALUE;
+	if (exact && seek_to_indexed(m, pos))
+		return;
+
 	if (m->fmt->duration == AV_NOPTS_VALUE)
 		seek_flags = AVSEEK_FLAG_FRAME;
 	else
@@ -478,21 +792,27 @@ static void seek_to(mp_media_t *m, int64_t pos)
 				      : seek_pos;
 
 	if (m->is_local_file) {
+		mp_media_pause_pipeline(m);
+
 		int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
 		if (ret < 0) {
 			blog(LOG_WARNING, "MP: Failed to seek: %s",
 			     av_err2str(ret));
 		}
+
+		mp_media_flush(m);
+		mp_media_resume_pipeline(m);
+		m->eof = false;
 	}
 
-	if (m->has_video && m->is_local_file) {
-		mp_decode_flush(&m->v);
-		if (m->seek_next_ts && m->pause && m->v_preload_cb &&
-		    mp_media_prepare_frames(m))
-			mp_media_next_video(m, true);
+	if (exact) {
+		m->seek_target_ns = av_rescale(pos, 1000 * 100, m->speed);
+		m->skip_to_target = true;
 	}
-	if (m->has_audio && m->is_local_file)
-		mp_decode_flush(&m->a);
+
+	if (m->has_video && m->is_local_file && m->seek_next_ts && m->pause &&
+	    m->v_preload_cb && mp_media_prepare_frames(m))
+		mp_media_next_video(m, true);
 }
 
 static bool mp_media_reset(mp_media_t *m)
@@ -500,7 +820,10 @@ static bool mp_media_reset(mp_media_t *m)
 	bool stopping;
 	bool active;
 
-	seek_to(m, m->fmt->start_time);
+	seek_to(m, m->fmt->start_time, false);
+
+	if (m->cache.state == MP_CACHE_EMPTY)
+		m->cache.state = MP_CACHE_FILLING;
 
 	int64_t next_ts = mp_media_get_base_pts(m);
 	int64_t offset = next_ts - m->next_pts_ns;
@@ -569,6 +892,14 @@ static inline bool mp_media_eof(mp_media_t *m)
 	if (eof) {
 		bool looping;
 
+		if (m->cache.state == MP_CACHE_FILLING) {
+			m->cache.state = MP_CACHE_COMPLETE;
+			blog(LOG_INFO,
+			     "MP: Cached %zu frames of '%s' (%.1f MB)",
+			     m->cache.video.num, m->path,
+			     (double)m->cache_memory / (1024.0 * 1024.0));
+		}
+
 		pthread_mutex_lock(&m->mutex);
 		looping = m->looping;
 		if (!looping) {
@@ -645,8 +976,21 @@ static bool init_avformat(mp_media_t *m)
 	}
 
 	m->reconnecting = false;
-	m->has_video = mp_decode_init(m, AVMEDIA_TYPE_VIDEO, m->hw);
-	m->has_audio = mp_decode_init(m, AVMEDIA_TYPE_AUDIO, m->hw);
+
+	if (m->pipeline) {
+		m->has_video = mp_pipeline_init_stream(
+			m->pipeline, AVMEDIA_TYPE_VIDEO, m->hw);
+		m->has_audio = mp_pipeline_init_stream(
+			m->pipeline, AVMEDIA_TYPE_AUDIO, m->hw);
+	} else {
+		m->has_video = mp_decode_init(m, AVMEDIA_TYPE_VIDEO, m->hw);
+		m->has_audio = mp_decode_init(m, AVMEDIA_TYPE_AUDIO, m->hw);
+	}
+
+	if (m->cache.state == MP_CACHE_EMPTY && m->cache_max_duration &&
+	    (m->fmt->duration == AV_NOPTS_VALUE ||
+	     m->fmt->duration / 1000 > m->cache_max_duration))
+		m->cache.state = MP_CACHE_DISABLED;
 
 	if (!m->has_video && !m->has_audio) {
 		blog(LOG_WARNING,
@@ -656,6 +1000,9 @@ static bool init_avformat(mp_media_t *m)
 		return false;
 	}
 
+	if (m->pipeline && !mp_pipeline_start(m->pipeline))
+		return false;
+
 	return true;
 }
 
@@ -723,7 +1070,7 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 		if (seek) {
 			m->seek_next_ts = true;
-			seek_to(m, seek_pos);
+			seek_to(m, seek_pos, true);
 			continue;
 		}
 
@@ -767,6 +1114,50 @@ static void *mp_media_thread_start(void *opaque)
 	return NULL;
 }
 
+static void *mp_media_index_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+	struct mp_index index = {0};
+	char *cache_file = NULL;
+	bool success = false;
+	uint64_t start = os_gettime_ns();
+
+	os_set_thread_name("mp_media_index_thread");
+
+	if (m->index_dir) {
+		os_mkdirs(m->index_dir);
+		cache_file = mp_index_get_cache_file(m->index_dir, m->path);
+		success = mp_index_load(&index, cache_file, m->path);
+	}
+
+	if (!success) {
+		success = mp_index_build(&index, m->path, &m->index_stop);
+
+		if (success) {
+			blog(LOG_INFO,
+			     "MP: Indexed %zu frames of '%s' in %.1f ms",
+			     index.frames.num, m->path,
+			     (double)(os_gettime_ns() - start) / 1000000.0);
+
+			if (cache_file &&
+			    !mp_index_save(&index, cache_file, m->path))
+				blog(LOG_WARNING,
+				     "MP: Failed to save seek index to '%s'",
+				     cache_file);
+		}
+	}
+
+	if (success) {
+		pthread_mutex_lock(&m->mutex);
+		m->index = index;
+		m->index_ready = true;
+		pthread_mutex_unlock(&m->mutex);
+	}
+
+	bfree(cache_file);
+	return NULL;
+}
+
 static inline bool mp_media_init_internal(mp_media_t *m,
 					  const struct mp_media_info *info)
 {
@@ -782,6 +1173,16 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 	m->path = info->path ? bstrdup(info->path) : NULL;
 	m->format_name = info->format ? bstrdup(info->format) : NULL;
 	m->hw = info->hardware_decoding;
+	m->decode_threads = info->decode_threads;
+
+	if (info->pipelined)
+		m->pipeline = mp_pipeline_create(m);
+
+	if (info->cache_frames && info->is_local_file) {
+		m->cache.state = MP_CACHE_EMPTY;
+		m->cache.max_size = info->cache_max_size;
+		m->cache_max_duration = info->cache_max_duration;
+	}
 
 	if (pthread_create(&m->thread, NULL, mp_media_thread_start, m) != 0) {
 		blog(LOG_WARNING, "MP: Could not create media thread");
@@ -789,6 +1190,19 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 	}
 
 	m->thread_valid = true;
+
+	if (info->build_index && m->is_local_file && m->path &&
+	    os_file_exists(m->path)) {
+		m->index_dir = info->index_dir ? bstrdup(info->index_dir)
+					       : NULL;
+
+		if (pthread_create(&m->index_thread, NULL,
+				   mp_media_index_thread, m) == 0)
+			m->index_thread_valid = true;
+		else
+			blog(LOG_WARNING, "MP: Could not create index thread");
+	}
+
 	return true;
 }
 
@@ -840,6 +1254,10 @@ static void mp_kill_thread(mp_media_t *m)
 		pthread_mutex_unlock(&m->mutex);
 		os_sem_post(m->sem);
 
+		/* wakes the media thread if it waits for a frame */
+		if (m->pipeline)
+			mp_pipeline_stop(m->pipeline);
+
 		pthread_join(m->thread, NULL);
 	}
 }
@@ -851,8 +1269,17 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+
+	if (media->index_thread_valid) {
+		os_atomic_set_bool(&media->index_stop, true);
+		pthread_join(media->index_thread, NULL);
+	}
+
+	mp_index_free(&media->index);
+	mp_pipeline_destroy(media->pipeline);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
+	mp_cache_free(&media->cache);
 	avformat_close_input(&media->fmt);
 	pthread_mutex_destroy(&media->mutex);
 	os_sem_destroy(media->sem);
@@ -860,6 +1287,7 @@ void mp_media_free(mp_media_t *media)
 	av_freep(&media->scale_pic[0]);
 	bfree(media->path);
 	bfree(media->format_name);
+	bfree(media->index_dir);
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
 }
@@ -921,3 +1349,45 @@ void mp_media_seek_to(mp_media_t *m, int64_t pos)
 
 	os_sem_post(m->sem);
 }
+
+void mp_media_seek_to_frame(mp_media_t *m, int64_t frame)
+{
+	pthread_mutex_lock(&m->mutex);
+	if (m->active && m->index_ready && frame >= 0 &&
+	    (size_t)frame < m->index.frames.num) {
+		AVRational time_base = {m->index.time_base_num,
+					m->index.time_base_den};
+
+		/* rounded up so that it doesn't land on the previous frame */
+		m->seek = true;
+		m->seek_pos = av_rescale_q_rnd(m->index.frames.array[frame],
+					       time_base, AV_TIME_BASE_Q,
+					       AV_ROUND_UP);
+	}
+	pthread_mutex_unlock(&m->mutex);
+
+	os_sem_post(m->sem);
+}
+
+int64_t mp_media_get_frames(mp_media_t *m)
+{
+	int64_t frames = -1;
+
+	pthread_mutex_lock(&m->mutex);
+	if (m->index_ready)
+		frames = (int64_t)m->index.frames.num;
+	pthread_mutex_unlock(&m->mutex);
+
+	return frames;
+}
+
+uint64_t mp_media_get_memory_usage(mp_media_t *m)
+{
+	uint64_t usage;
+
+	pthread_mutex_lock(&m->mutex);
+	usage = m->cache_memory;
+	pthread_mutex_unlock(&m->mutex);
+
+	return usage;
+}
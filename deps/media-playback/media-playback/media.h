@@ -18,6 +18,9 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "cache.h"
+#include "index.h"
+#include "pipeline.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +67,7 @@ struct mp_media {
 
 	struct mp_decode v;
 	struct mp_decode a;
+	int decode_threads;
 	bool is_local_file;
 	bool reconnecting;
 	bool has_video;
@@ -101,6 +105,28 @@ struct mp_media {
 	bool seek;
 	bool seek_next_ts;
 	int64_t seek_pos;
+
+	/* frames before the seek target are decoded but not output */
+	bool skip_to_target;
+	int64_t seek_target_ns;
+
+	/* built by the index thread, read only once index_ready is set */
+	struct mp_index index;
+	bool index_ready;
+	bool index_thread_valid;
+	volatile bool index_stop;
+	pthread_t index_thread;
+	char *index_dir;
+
+	/* frames of the first pass are kept, later loops play from memory */
+	struct mp_cache cache;
+	int64_t cache_max_duration;
+	uint64_t cache_memory;
+
+	/* demuxes and decodes on other threads if not NULL, v and a then only
+	 * hold the frames being output */
+	struct mp_pipeline *pipeline;
+	struct mp_pipeline_frame *pipeline_frame;
 };
 
 typedef struct mp_media mp_media_t;
@@ -122,6 +148,22 @@ struct mp_media_info {
 	bool hardware_decoding;
 	bool is_local_file;
 	bool reconnecting;
+
+	/* only files shorter than cache_max_duration (in milliseconds) that
+	 * fit in cache_max_size bytes are cached */
+	bool cache_frames;
+	size_t cache_max_size;
+	int64_t cache_max_duration;
+
+	/* builds a seek index of local files in the background, which is
+	 * saved to index_dir if it isn't NULL */
+	bool build_index;
+	const char *index_dir;
+
+	/* demuxes, decodes and converts frames on separate threads, and
+	 * decodes with decode_threads threads per stream (0 is automatic) */
+	bool pipelined;
+	int decode_threads;
 };
 
 extern bool mp_media_init(mp_media_t *media, const struct mp_media_info *info);
@@ -132,6 +174,10 @@ extern void mp_media_stop(mp_media_t *media);
 extern void mp_media_play_pause(mp_media_t *media, bool pause);
 extern int64_t mp_get_current_time(mp_media_t *m);
 extern void mp_media_seek_to(mp_media_t *m, int64_t pos);
+extern void mp_media_seek_to_frame(mp_media_t *m, int64_t frame);
+extern bool mp_media_index_ready(mp_media_t *m);
+extern int64_t mp_media_get_frames(mp_media_t *m);
+extern uint64_t mp_media_get_memory_usage(mp_media_t *m);
 
 /* #define DETAILED_DEBUG_INFO */
 
@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <obs.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+
+#include "media.h"
+#include "pipeline.h"
+#include "closest-format.h"
+
+#include <libavutil/imgutils.h>
+
+/* queued packets per stream before the demuxer waits */
+#define MP_PIPELINE_PACKETS 64
+
+/* decoded frames per stream before the decoder waits, one more slot is
+ * needed for the frame the media thread is outputting */
+#define MP_PIPELINE_FRAMES 4
+#define FRAME_SLOTS (MP_PIPELINE_FRAMES + 1)
+
+static const char *demux_name = "mp_demux_thread";
+static const char *read_frame_name = "av_read_frame";
+static const char *video_name = "mp_video_decode_thread";
+static const char *audio_name = "mp_audio_decode_thread";
+static const char *decode_name = "mp_decode_next";
+static const char *convert_name = "sws_scale";
+
+struct mp_pipeline_stream {
+	struct mp_pipeline *p;
+	struct mp_decode d;
+	bool valid;
+
+	struct circlebuf packets;
+	bool input_eof;
+
+	struct mp_pipeline_frame frames[FRAME_SLOTS];
+	size_t head;
+	size_t count;
+	bool frames_eof;
+
+	/* the media thread waits for a frame of this stream */
+	bool waiting;
+
+	struct SwsContext *swscale;
+	enum AVColorSpace sws_space;
+	enum AVColorRange sws_range;
+
+	const char *name;
+	bool thread_valid;
+	pthread_t thread;
+};
+
+struct mp_pipeline {
+	mp_media_t *m;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	struct mp_pipeline_stream video;
+	struct mp_pipeline_stream audio;
+
+	/* threads working outside of the mutex */
+	int busy;
+
+	bool demux_eof;
+	bool pausing;
+	bool error;
+	bool stop;
+
+	bool demux_thread_valid;
+	pthread_t demux_thread;
+};
+
+static inline size_t queued_packets(const struct mp_pipeline_stream *s)
+{
+	return s->packets.size / sizeof(AVPacket);
+}
+
+static void clear_packets(struct mp_pipeline_stream *s)
+{
+	while (s->packets.size) {
+		AVPacket pkt;
+		circlebuf_pop_front(&s->packets, &pkt, sizeof(pkt));
+		av_packet_unref(&pkt);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline struct mp_pipeline_stream *
+get_packet_stream(struct mp_pipeline *p, AVPacket *pkt)
+{
+	if (p->audio.valid && pkt->stream_index == p->audio.d.stream->index)
+		return &p->audio;
+	if (p->video.valid && pkt->stream_index == p->video.d.stream->index)
+		return &p->video;
+
+	return NULL;
+}
+
+/* the queues only limit the demuxer while no stream runs out of packets */
+static bool demux_blocked(struct mp_pipeline *p)
+{
+	struct mp_pipeline_stream *streams[] = {&p->video, &p->audio};
+	bool full = false;
+
+	for (size_t i = 0; i < 2; i++) {
+		struct mp_pipeline_stream *s = streams[i];
+		size_t packets = queued_packets(s);
+
+		if (!s->valid)
+			continue;
+		if (s->waiting && !packets)
+			return false;
+		if (packets >= MP_PIPELINE_PACKETS)
+			full = true;
+	}
+
+	return full;
+}
+
+static void *demux_thread(void *data)
+{
+	struct mp_pipeline *p = data;
+
+	os_set_thread_name("mp_demux_thread");
+
+	pthread_mutex_lock(&p->mutex);
+
+	for (;;) {
+		struct mp_pipeline_stream *s = NULL;
+		AVPacket new_pkt;
+		AVPacket pkt;
+		int ret;
+
+		while (!p->stop && (p->pausing || p->error || p->demux_eof ||
+				    demux_blocked(p)))
+			pthread_cond_wait(&p->cond, &p->mutex);
+		if (p->stop)
+			break;
+
+		p->busy++;
+		pthread_mutex_unlock(&p->mutex);
+
+		profile_start(demux_name);
+
+		av_init_packet(&pkt);
+		new_pkt = pkt;
+
+		profile_start(read_frame_name);
+		ret = av_read_frame(p->m->fmt, &pkt);
+		profile_end(read_frame_name);
+
+		if (ret >= 0) {
+			s = get_packet_stream(p, &pkt);
+			if (s && pkt.size)
+				av_packet_ref(&new_pkt, &pkt);
+			else
+				s = NULL;
+
+			av_packet_unref(&pkt);
+		} else if (ret != AVERROR_EOF && ret != AVERROR_EXIT) {
+			blog(LOG_WARNING, "MP: av_read_frame failed: %s (%d)",
+			     av_err2str(ret), ret);
+		}
+
+		profile_end(demux_name);
+
+		pthread_mutex_lock(&p->mutex);
+		p->busy--;
+
+		if (ret == AVERROR_EOF || ret == AVERROR_EXIT) {
+			p->demux_eof = true;
+			p->video.input_eof = true;
+			p->audio.input_eof = true;
+		} else if (ret < 0) {
+			p->error = true;
+		} else if (s) {
+			circlebuf_push_back(&s->packets, &new_pkt,
+					    sizeof(new_pkt));
+		}
+
+		pthread_cond_broadcast(&p->cond);
+	}
+
+	pthread_mutex_unlock(&p->mutex);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define FIXED_1_0 (1 << 16)
+
+static bool init_scaling(struct mp_pipeline_stream *s, const AVFrame *f,
+			 enum AVPixelFormat format)
+{
+	struct SwsContext *swscale = sws_getCachedContext(
+		s->swscale, f->width, f->height, f->format, f->width,
+		f->height, format, SWS_POINT, NULL, NULL, NULL);
+
+	if (!swscale) {
+		s->swscale = NULL;
+		blog(LOG_WARNING, "MP: Failed to initialize scaler");
+		return false;
+	}
+
+	if (swscale != s->swscale || f->colorspace != s->sws_space ||
+	    f->color_range != s->sws_range) {
+		int space = get_sws_colorspace(f->colorspace);
+		int range = get_sws_range(f->color_range);
+		const int *coeff = sws_getCoefficients(space);
+
+		sws_setColorspaceDetails(swscale, coeff, range, coeff, range,
+					 0, FIXED_1_0, FIXED_1_0);
+
+		s->swscale = swscale;
+		s->sws_space = f->colorspace;
+		s->sws_range = f->color_range;
+	}
+
+	return true;
+}
+
+static bool init_scale_pic(struct mp_pipeline_frame *pf, const AVFrame *f,
+			   enum AVPixelFormat format)
+{
+	if (pf->scale_pic[0] && pf->scale_width == f->width &&
+	    pf->scale_height == f->height && pf->scale_format == format)
+		return true;
+
+	av_freep(&pf->scale_pic[0]);
+
+	int ret = av_image_alloc(pf->scale_pic, pf->scale_linesizes, f->width,
+				 f->height, format, 32);
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to create scale pic data");
+		return false;
+	}
+
+	pf->scale_width = f->width;
+	pf->scale_height = f->height;
+	pf->scale_format = format;
+	return true;
+}
+
+/* frames that fail to convert are kept with no format and not shown */
+static bool convert_frame(struct mp_pipeline_stream *s,
+			  struct mp_pipeline_frame *pf)
+{
+	AVFrame *f = pf->frame;
+	enum AVPixelFormat format = closest_format(f->format);
+
+	if (format == f->format) {
+		pf->format = format;
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			pf->data[i] = f->data[i];
+			pf->linesize[i] = f->linesize[i];
+		}
+		return true;
+	}
+
+	if (!init_scaling(s, f, format) || !init_scale_pic(pf, f, format))
+		return false;
+
+	int ret = sws_scale(s->swscale, (const uint8_t *const *)f->data,
+			    f->linesize, 0, f->height, pf->scale_pic,
+			    pf->scale_linesizes);
+
+	pf->format = ret < 0 ? AV_PIX_FMT_NONE : format;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		pf->data[i] = i < 4 ? pf->scale_pic[i] : NULL;
+		pf->linesize[i] = i < 4 ? pf->scale_linesizes[i] : 0;
+	}
+	return true;
+}
+
+static inline bool stream_has_work(struct mp_pipeline *p,
+				   struct mp_pipeline_stream *s)
+{
+	if (p->pausing || p->error || s->frames_eof)
+		return false;
+	if (s->count == MP_PIPELINE_FRAMES)
+		return false;
+
+	return s->d.packets.size || s->packets.size || s->input_eof;
+}
+
+static void *stream_thread(void *data)
+{
+	struct mp_pipeline_stream *s = data;
+	struct mp_pipeline *p = s->p;
+	struct mp_decode *d = &s->d;
+
+	os_set_thread_name(s->name);
+
+	pthread_mutex_lock(&p->mutex);
+
+	for (;;) {
+		struct mp_pipeline_frame *pf;
+		bool success;
+
+		while (!p->stop && !stream_has_work(p, s))
+			pthread_cond_wait(&p->cond, &p->mutex);
+		if (p->stop)
+			break;
+
+		/* packets are handed over one at a time so that the stream
+		 * queue keeps limiting the demuxer */
+		if (!d->packets.size && s->packets.size) {
+			AVPacket pkt;
+			circlebuf_pop_front(&s->packets, &pkt, sizeof(pkt));
+			mp_decode_push_packet(d, &pkt);
+			pthread_cond_broadcast(&p->cond);
+		}
+
+		d->input_eof = s->input_eof && !s->packets.size;
+		pf = s->frames + (s->head + s->count) % FRAME_SLOTS;
+
+		p->busy++;
+		pthread_mutex_unlock(&p->mutex);
+
+		profile_start(s->name);
+
+		profile_start(decode_name);
+		success = mp_decode_next(d);
+		profile_end(decode_name);
+
+		if (success && d->frame_ready) {
+			/* copies the data of decoders that reuse their
+			 * buffers instead of referencing it */
+			av_frame_unref(pf->frame);
+			success = av_frame_ref(pf->frame, d->frame) == 0;
+			av_frame_unref(d->frame);
+
+			pf->pts = d->frame_pts;
+			pf->next_pts = d->next_pts;
+		}
+
+		if (success && d->frame_ready && !d->audio) {
+			profile_start(convert_name);
+			success = convert_frame(s, pf);
+			profile_end(convert_name);
+		}
+
+		profile_end(s->name);
+
+		pthread_mutex_lock(&p->mutex);
+		p->busy--;
+
+		if (!success) {
+			p->error = true;
+		} else if (d->frame_ready) {
+			d->frame_ready = false;
+			s->count++;
+		} else if (d->eof) {
+			s->frames_eof = true;
+		}
+
+		pthread_cond_broadcast(&p->cond);
+	}
+
+	pthread_mutex_unlock(&p->mutex);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool init_stream_frames(struct mp_pipeline_stream *s)
+{
+	for (size_t i = 0; i < FRAME_SLOTS; i++) {
+		s->frames[i].frame = av_frame_alloc();
+		if (!s->frames[i].frame)
+			return false;
+	}
+
+	return true;
+}
+
+static void free_stream(struct mp_pipeline_stream *s)
+{
+	clear_packets(s);
+	circlebuf_free(&s->packets);
+
+	for (size_t i = 0; i < FRAME_SLOTS; i++) {
+		av_frame_free(&s->frames[i].frame);
+		av_freep(&s->frames[i].scale_pic[0]);
+	}
+
+	sws_freeContext(s->swscale);
+	mp_decode_free(&s->d);
+}
+
+struct mp_pipeline *mp_pipeline_create(mp_media_t *m)
+{
+	struct mp_pipeline *p = bzalloc(sizeof(*p));
+	p->m = m;
+	p->video.p = p;
+	p->video.name = video_name;
+	p->audio.p = p;
+	p->audio.name = audio_name;
+
+	if (pthread_mutex_init(&p->mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init pipeline mutex");
+		bfree(p);
+		return NULL;
+	}
+	if (pthread_cond_init(&p->cond, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init pipeline condition");
+		pthread_mutex_destroy(&p->mutex);
+		bfree(p);
+		return NULL;
+	}
+
+	if (!init_stream_frames(&p->video) || !init_stream_frames(&p->audio)) {
+		blog(LOG_WARNING, "MP: Failed to allocate pipeline frames");
+		mp_pipeline_destroy(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void mp_pipeline_destroy(struct mp_pipeline *p)
+{
+	if (!p)
+		return;
+
+	mp_pipeline_stop(p);
+	free_stream(&p->video);
+	free_stream(&p->audio);
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->mutex);
+	bfree(p);
+}
+
+bool mp_pipeline_init_stream(struct mp_pipeline *p, enum AVMediaType type,
+			     bool hw)
+{
+	bool audio = type == AVMEDIA_TYPE_AUDIO;
+	struct mp_pipeline_stream *s = audio ? &p->audio : &p->video;
+	struct mp_decode *d = audio ? &p->m->a : &p->m->v;
+
+	s->valid = mp_decode_open(&s->d, p->m, type, hw);
+
+	/* the decoder of the media only keeps the frame being output */
+	memset(d, 0, sizeof(*d));
+	d->m = p->m;
+	d->audio = audio;
+	if (s->valid)
+		d->stream = s->d.stream;
+
+	return s->valid;
+}
+
+static bool start_thread(pthread_t *thread, void *(*func)(void *),
+			 void *data)
+{
+	if (pthread_create(thread, NULL, func, data) != 0) {
+		blog(LOG_WARNING, "MP: Could not create pipeline thread");
+		return false;
+	}
+
+	return true;
+}
+
+bool mp_pipeline_start(struct mp_pipeline *p)
+{
+	p->demux_thread_valid =
+		start_thread(&p->demux_thread, demux_thread, p);
+	if (!p->demux_thread_valid)
+		return false;
+
+	if (p->video.valid) {
+		p->video.thread_valid = start_thread(
+			&p->video.thread, stream_thread, &p->video);
+		if (!p->video.thread_valid)
+			return false;
+	}
+	if (p->audio.valid) {
+		p->audio.thread_valid = start_thread(
+			&p->audio.thread, stream_thread, &p->audio);
+		if (!p->audio.thread_valid)
+			return false;
+	}
+
+	return true;
+}
+
+void mp_pipeline_stop(struct mp_pipeline *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	p->stop = true;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+
+	if (p->demux_thread_valid) {
+		pthread_join(p->demux_thread, NULL);
+		p->demux_thread_valid = false;
+	}
+	if (p->video.thread_valid) {
+		pthread_join(p->video.thread, NULL);
+		p->video.thread_valid = false;
+	}
+	if (p->audio.thread_valid) {
+		pthread_join(p->audio.thread, NULL);
+		p->audio.thread_valid = false;
+	}
+}
+
+void mp_pipeline_pause(struct mp_pipeline *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	p->pausing = true;
+	while (p->busy)
+		pthread_cond_wait(&p->cond, &p->mutex);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+void mp_pipeline_resume(struct mp_pipeline *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	p->pausing = false;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+static void flush_stream(struct mp_pipeline_stream *s)
+{
+	if (!s->valid)
+		return;
+
+	clear_packets(s);
+	mp_decode_flush(&s->d);
+	s->input_eof = false;
+	s->head = 0;
+	s->count = 0;
+	s->frames_eof = false;
+}
+
+void mp_pipeline_flush(struct mp_pipeline *p)
+{
+	pthread_mutex_lock(&p->mutex);
+	flush_stream(&p->video);
+	flush_stream(&p->audio);
+	p->demux_eof = false;
+	pthread_mutex_unlock(&p->mutex);
+}
+
+bool mp_pipeline_next_frame(struct mp_pipeline *p, bool audio,
+			    struct mp_pipeline_frame **frame)
+{
+	struct mp_pipeline_stream *s = audio ? &p->audio : &p->video;
+	bool success;
+
+	*frame = NULL;
+
+	pthread_mutex_lock(&p->mutex);
+
+	if (!s->count && !s->frames_eof) {
+		s->waiting = true;
+		pthread_cond_broadcast(&p->cond);
+
+		while (!p->stop && !p->error && !s->count && !s->frames_eof)
+			pthread_cond_wait(&p->cond, &p->mutex);
+
+		s->waiting = false;
+	}
+
+	success = !p->error;
+
+	if (success && !p->stop && s->count) {
+		*frame = s->frames + s->head;
+		s->head = (s->head + 1) % FRAME_SLOTS;
+		s->count--;
+		pthread_cond_broadcast(&p->cond);
+	}
+
+	pthread_mutex_unlock(&p->mutex);
+	return success;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <obs.h>
+#include "decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decode pipeline
+ *
+ *   Splits the work of the media thread over a demux thread and a decode
+ * thread per stream, connected by bounded queues.  The video decode thread
+ * also converts frames to a format libobs supports.  The media thread only
+ * takes finished frames out of the queues and outputs them on time.
+ *
+ *   The demuxer and decoders must only be used by the media thread while the
+ * pipeline is paused, for example to seek.
+ */
+
+struct mp_pipeline;
+
+struct mp_pipeline_frame {
+	AVFrame *frame;
+
+	/* the planes to output, converted if format isn't the frame format */
+	enum AVPixelFormat format;
+	uint8_t *data[MAX_AV_PLANES];
+	int linesize[MAX_AV_PLANES];
+
+	int64_t pts;
+	int64_t next_pts;
+
+	/* owned by the frame, kept to be reused */
+	uint8_t *scale_pic[4];
+	int scale_linesizes[4];
+	int scale_width;
+	int scale_height;
+	enum AVPixelFormat scale_format;
+};
+
+extern struct mp_pipeline *mp_pipeline_create(struct mp_media *m);
+extern void mp_pipeline_destroy(struct mp_pipeline *p);
+
+/** Opens the decoder of a stream, returns false if there is none */
+extern bool mp_pipeline_init_stream(struct mp_pipeline *p,
+				    enum AVMediaType type, bool hw);
+
+extern bool mp_pipeline_start(struct mp_pipeline *p);
+
+/** Stops and joins the threads, frames are no longer returned after this */
+extern void mp_pipeline_stop(struct mp_pipeline *p);
+
+/** Waits until no thread uses the demuxer or the decoders */
+extern void mp_pipeline_pause(struct mp_pipeline *p);
+extern void mp_pipeline_resume(struct mp_pipeline *p);
+
+/** Drops all queued packets and frames and flushes the decoders, the
+ * pipeline must be paused */
+extern void mp_pipeline_flush(struct mp_pipeline *p);
+
+/**
+ * Waits for the next frame of a stream.  The frame stays valid until the
+ * next call for that stream or until the pipeline is flushed.  *frame is
+ * NULL at the end of the stream or once the pipeline is stopped.
+ *
+ * @return false if reading the file failed
+ */
+extern bool mp_pipeline_next_frame(struct mp_pipeline *p, bool audio,
+				   struct mp_pipeline_frame **frame);
+
+#ifdef __cplusplus
+}
+#endif
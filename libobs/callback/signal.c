@@ -16,26 +16,99 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Signalling does not take any locks.  The callbacks of a signal are kept in
+ * an array that is never modified once it is published: connecting or
+ * disconnecting builds a new array and swaps it in.  Replaced arrays and
+ * disconnected callbacks are only freed once no signal is in progress, as a
+ * signal in progress may still be walking them.
+ *
+ * A signal in progress is counted in one of two reader slots, picked by the
+ * epoch when it starts.  Waiting for the signals in progress flips the epoch
+ * first, so new signals go to the other slot and the wait cannot be starved
+ * by a thread that keeps signalling.
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct callback_list {
+	size_t num;
+	struct signal_callback **array;
+};
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+	struct callback_list *volatile callbacks;
 	pthread_mutex_t mutex;
-	bool signalling;
 
-	struct signal_info *next;
+	volatile long epoch;
+	volatile long readers[2];
+	volatile bool has_removed;
+	volatile bool has_retired;
+	DARRAY(void *) retired;
+
+	struct signal_info *volatile next;
 };
 
+static inline struct callback_list *get_callbacks(struct signal_info *si)
+{
+	return os_atomic_load_ptr((void *const volatile *)&si->callbacks);
+}
+
+static struct callback_list *callback_list_create(size_t num)
+{
+	struct callback_list *list = bmalloc(
+		sizeof(struct callback_list) + num * sizeof(void *));
+
+	list->num = num;
+	list->array = (struct signal_callback **)(list + 1);
+	return list;
+}
+
+static inline void free_retired(struct signal_info *si)
+{
+	for (size_t i = 0; i < si->retired.num; i++)
+		bfree(si->retired.array[i]);
+	da_resize(si->retired, 0);
+}
+
+/* must be called with the signal mutex held */
+static void reclaim_retired(struct signal_info *si)
+{
+	/* a signal loads the callback array after it is counted, so once no
+	 * signal is counted, none can still hold a replaced array */
+	if (os_atomic_load_long(&si->readers[0]) == 0 &&
+	    os_atomic_load_long(&si->readers[1]) == 0) {
+		free_retired(si);
+		os_atomic_set_bool(&si->has_retired, false);
+	} else {
+		os_atomic_set_bool(&si->has_retired, true);
+	}
+}
+
+/* must be called with the signal mutex held */
+static inline void retire(struct signal_info *si, void *ptr)
+{
+	da_push_back(si->retired, &ptr);
+}
+
+/* must be called with the signal mutex held */
+static void set_callbacks(struct signal_info *si, struct callback_list *list)
+{
+	retire(si, os_atomic_set_ptr((void *volatile *)&si->callbacks, list));
+	reclaim_retired(si);
+}
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
 	pthread_mutexattr_t attr;
@@ -46,17 +119,16 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		return NULL;
 
-	si = bmalloc(sizeof(struct signal_info));
+	si = bzalloc(sizeof(struct signal_info));
 
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->callbacks = callback_list_create(0);
 
 	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
+		bfree(si->callbacks);
 		bfree(si);
 		return NULL;
 	}
@@ -67,21 +139,30 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		struct callback_list *list = get_callbacks(si);
+
+		for (size_t i = 0; i < list->num; i++)
+			bfree(list->array[i]);
+		bfree(list);
+
+		free_retired(si);
+		da_free(si->retired);
+
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
+static inline size_t signal_get_callback_idx(struct callback_list *list,
 					     signal_callback_t callback,
 					     void *data)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *sc = list->array[i];
 
-		if (sc->callback == callback && sc->data == data)
+		if (sc->callback == callback && sc->data == data &&
+		    !os_atomic_load_bool(&sc->remove))
 			return i;
 	}
 
@@ -96,27 +177,30 @@ struct global_callback_info {
 };
 
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_info *volatile first;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
 	DARRAY(struct global_callback_info) global_callbacks;
 	pthread_mutex_t global_callbacks_mutex;
+	volatile bool has_global_callbacks;
 };
 
+/* signals are only ever added, so they can be looked up without locking */
 static struct signal_info *getsignal(signal_handler_t *handler,
 				     const char *name,
 				     struct signal_info **p_last)
 {
 	struct signal_info *signal, *last = NULL;
 
-	signal = handler->first;
+	signal = os_atomic_load_ptr((void *const volatile *)&handler->first);
 	while (signal != NULL) {
 		if (strcmp(signal->func.name, name) == 0)
 			break;
 
 		last = signal;
-		signal = signal->next;
+		signal = os_atomic_load_ptr(
+			(void *const volatile *)&signal->next);
 	}
 
 	if (p_last)
@@ -197,9 +281,10 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	} else {
 		sig = signal_info_create(&func);
 		if (!last)
-			handler->first = sig;
+			os_atomic_set_ptr((void *volatile *)&handler->first,
+					  sig);
 		else
-			last->next = sig;
+			os_atomic_set_ptr((void *volatile *)&last->next, sig);
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -212,17 +297,14 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 					    signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_info *sig;
+	struct callback_list *old, *list;
+	struct signal_callback *cb;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal(handler, signal, NULL);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -238,9 +320,22 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	old = get_callbacks(sig);
+	if (keep_ref ||
+	    signal_get_callback_idx(old, callback, data) == DARRAY_INVALID) {
+		cb = bzalloc(sizeof(struct signal_callback));
+		cb->callback = callback;
+		cb->data = data;
+		cb->keep_ref = keep_ref;
+
+		list = callback_list_create(old->num + 1);
+		if (old->num)
+			memcpy(list->array, old->array,
+			       old->num * sizeof(void *));
+		list->array[old->num] = cb;
+
+		set_callbacks(sig, list);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -257,26 +352,102 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal,
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-						   const char *name)
+static inline struct signal_info *getsignal_checked(signal_handler_t *handler,
+						    const char *name)
 {
+	return handler ? getsignal(handler, name, NULL) : NULL;
+}
+
+/* builds a new callback array without the callbacks flagged for removal,
+ * must be called with the signal mutex held */
+static long remove_flagged_callbacks(struct signal_info *sig)
+{
+	struct callback_list *old = get_callbacks(sig);
+	struct callback_list *list = callback_list_create(old->num);
+	long remove_refs = 0;
+
+	list->num = 0;
+	os_atomic_set_bool(&sig->has_removed, false);
+
+	for (size_t i = 0; i < old->num; i++) {
+		struct signal_callback *cb = old->array[i];
+
+		if (!os_atomic_load_bool(&cb->remove)) {
+			list->array[list->num++] = cb;
+			continue;
+		}
+
+		if (cb->keep_ref)
+			remove_refs++;
+		retire(sig, cb);
+	}
+
+	set_callbacks(sig, list);
+	return remove_refs;
+}
+
+struct signal_frame {
 	struct signal_info *sig;
+	struct signal_callback *cb;
+	long slot;
+	struct signal_frame *prev;
+};
 
-	if (!handler)
-		return NULL;
+static THREAD_LOCAL struct signal_frame *current_signal_frame = NULL;
+static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
+/* signals of this thread that are counted in a reader slot */
+static inline long own_readers(struct signal_info *sig, long slot)
+{
+	long readers = 0;
+
+	for (struct signal_frame *frame = current_signal_frame; frame;
+	     frame = frame->prev) {
+		if (frame->sig == sig && frame->slot == slot)
+			readers++;
+	}
 
-	return sig;
+	return readers;
+}
+
+/* waits for every signal in progress on another thread to return */
+static void wait_for_signals(struct signal_info *sig)
+{
+	for (int i = 0; i < 2; i++) {
+		long slot = (os_atomic_inc_long(&sig->epoch) - 1) & 1;
+		long own = own_readers(sig, slot);
+
+		while (os_atomic_load_long(&sig->readers[slot]) > own)
+			os_sleep_ms(0);
+	}
+}
+
+static inline long begin_signal(struct signal_info *sig)
+{
+	long slot = os_atomic_load_long(&sig->epoch) & 1;
+
+	os_atomic_inc_long(&sig->readers[slot]);
+	return slot;
+}
+
+static void end_signal(struct signal_info *sig, long slot)
+{
+	os_atomic_dec_long(&sig->readers[slot]);
+
+	if (os_atomic_load_bool(&sig->has_retired)) {
+		pthread_mutex_lock(&sig->mutex);
+		reclaim_retired(sig);
+		pthread_mutex_unlock(&sig->mutex);
+	}
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 			       signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
+	struct signal_info *sig = getsignal_checked(handler, signal);
+	struct signal_callback *cb = NULL;
+	DARRAY(void *) retired = {0};
+	long remove_refs = 0;
 	size_t idx;
 
 	if (!sig)
@@ -284,71 +455,101 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
+	idx = signal_get_callback_idx(get_callbacks(sig), callback, data);
 	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
+		cb = get_callbacks(sig)->array[idx];
+
+		os_atomic_set_bool(&cb->remove, true);
+		remove_refs = remove_flagged_callbacks(sig);
+
+		/* everything retired so far is safe to free once the signals
+		 * in progress return */
+		da_move(retired, sig->retired);
+		os_atomic_set_bool(&sig->has_retired, false);
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
-		signal_handler_actually_destroy(handler);
+	if (!cb)
+		return;
+
+	/* signals that started before the callback was removed may still be
+	 * calling it, once they return it is not called again */
+	wait_for_signals(sig);
+
+	if (own_readers(sig, 0) + own_readers(sig, 1) == 0) {
+		for (size_t i = 0; i < retired.num; i++)
+			bfree(retired.array[i]);
+		da_free(retired);
+	} else {
+		/* disconnected from a callback of this signal, which is still
+		 * walking the old array */
+		pthread_mutex_lock(&sig->mutex);
+		da_push_back_da(sig->retired, retired);
+		os_atomic_set_bool(&sig->has_retired, true);
+		pthread_mutex_unlock(&sig->mutex);
+		da_free(retired);
 	}
-}
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
+	for (; remove_refs > 0; remove_refs--) {
+		if (os_atomic_dec_long(&handler->refs) == 0) {
+			signal_handler_actually_destroy(handler);
+			break;
+		}
+	}
+}
 
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
+	if (current_signal_frame) {
+		struct signal_frame *frame = current_signal_frame;
+
+		os_atomic_set_bool(&frame->cb->remove, true);
+		os_atomic_set_bool(&frame->sig->has_removed, true);
+	} else if (current_global_cb) {
 		current_global_cb->remove = true;
+	}
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			   calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_info *sig = getsignal_checked(handler, signal);
+	struct signal_frame frame;
+	struct callback_list *list;
 	long remove_refs = 0;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	frame.sig = sig;
+	frame.slot = begin_signal(sig);
+	frame.prev = current_signal_frame;
+
+	list = get_callbacks(sig);
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
+
+		if (!os_atomic_load_bool(&cb->remove)) {
+			frame.cb = cb;
+			current_signal_frame = &frame;
 			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
+			current_signal_frame = frame.prev;
 		}
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
-
-			da_erase(sig->callbacks, i - 1);
-		}
+	if (os_atomic_load_bool(&sig->has_removed)) {
+		pthread_mutex_lock(&sig->mutex);
+		remove_refs = remove_flagged_callbacks(sig);
+		pthread_mutex_unlock(&sig->mutex);
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	end_signal(sig, frame.slot);
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	if (os_atomic_load_bool(&handler->has_global_callbacks)) {
+		pthread_mutex_lock(&handler->global_callbacks_mutex);
 
-	if (handler->global_callbacks.num) {
 		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
 			struct global_callback_info *cb =
 				handler->global_callbacks.array + i;
@@ -369,14 +570,18 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			if (cb->remove && !cb->signaling)
 				da_erase(handler->global_callbacks, i - 1);
 		}
-	}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+		os_atomic_set_bool(&handler->has_global_callbacks,
+				   handler->global_callbacks.num != 0);
 
-	if (remove_refs) {
-		os_atomic_set_long(&handler->refs,
-				   os_atomic_load_long(&handler->refs) -
-					   remove_refs);
+		pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	}
+
+	for (; remove_refs > 0; remove_refs--) {
+		if (os_atomic_dec_long(&handler->refs) == 0) {
+			signal_handler_actually_destroy(handler);
+			break;
+		}
 	}
 }
 
@@ -396,6 +601,8 @@ void signal_handler_connect_global(signal_handler_t *handler,
 	if (idx == DARRAY_INVALID)
 		da_push_back(handler->global_callbacks, &cb_data);
 
+	os_atomic_set_bool(&handler->has_global_callbacks, true);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
@@ -422,5 +629,8 @@ void signal_handler_disconnect_global(signal_handler_t *handler,
 			da_erase(handler->global_callbacks, idx);
 	}
 
+	os_atomic_set_bool(&handler->has_global_callbacks,
+			   handler->global_callbacks.num != 0);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
@@ -0,0 +1,104 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+#define MIX_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX_TARGET
+#else
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+#else
+#define MIX_X86 0
+#include "../util/sse-intrin.h"
+#endif
+
+static void mix_floats_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 d0 = _mm_loadu_ps(dst + i);
+		__m128 d1 = _mm_loadu_ps(dst + i + 4);
+		__m128 s0 = _mm_loadu_ps(src + i);
+		__m128 s1 = _mm_loadu_ps(src + i + 4);
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(d0, s0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(d1, s1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+#if MIX_X86
+AVX_TARGET static void mix_floats_avx(float *dst, const float *src,
+				      size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256 d0 = _mm256_loadu_ps(dst + i);
+		__m256 d1 = _mm256_loadu_ps(dst + i + 8);
+		__m256 s0 = _mm256_loadu_ps(src + i);
+		__m256 s1 = _mm256_loadu_ps(src + i + 8);
+
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(d0, s0));
+		_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(d1, s1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+static bool cpu_has_avx(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+
+	/* AVX support and OS support for saving the YMM registers */
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+
+	return (_xgetbv(0) & 6) == 6;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+audio_mix_func_t audio_get_mix_func(void)
+{
+	static audio_mix_func_t mix_func = NULL;
+
+	if (!mix_func) {
+#if MIX_X86
+		mix_func = cpu_has_avx() ? mix_floats_avx : mix_floats_sse;
+#else
+		mix_func = mix_floats_sse;
+#endif
+	}
+
+	return mix_func;
+}
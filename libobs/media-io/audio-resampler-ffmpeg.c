@@ -17,12 +17,14 @@
 
 #include "../util/bmem.h"
 #include "audio-resampler.h"
+#include "audio-resampler-native.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
 struct audio_resampler {
+	struct native_resampler *native;
 	struct SwrContext *context;
 	bool opened;
 
@@ -39,6 +41,18 @@ struct audio_resampler {
 	uint32_t output_planes;
 };
 
+static bool use_native = true;
+
+void audio_resampler_set_native(bool native)
+{
+	use_native = native;
+}
+
+bool audio_resampler_is_native(const audio_resampler_t *rs)
+{
+	return rs && rs->native;
+}
+
 static inline enum AVSampleFormat convert_audio_format(enum audio_format format)
 {
 	switch (format) {
@@ -108,6 +122,11 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	rs->output_format = convert_audio_format(dst->format);
 	rs->output_planes = is_audio_planar(dst->format) ? rs->output_ch : 1;
 
+	if (use_native && native_resampler_supported(dst, src)) {
+		rs->native = native_resampler_create(dst, src);
+		return rs;
+	}
+
 	rs->context = swr_alloc_set_opts(NULL, rs->output_layout,
 					 rs->output_format,
 					 dst->samples_per_sec, rs->input_layout,
@@ -151,6 +170,7 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 void audio_resampler_destroy(audio_resampler_t *rs)
 {
 	if (rs) {
+		native_resampler_destroy(rs->native);
 		if (rs->context)
 			swr_free(&rs->context);
 		if (rs->output_buffer[0])
@@ -167,6 +187,12 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	if (!rs)
 		return false;
 
+	if (rs->native) {
+		native_resampler_resample(rs->native, output, out_frames,
+					  ts_offset, input, in_frames);
+		return true;
+	}
+
 	struct SwrContext *context = rs->context;
 	int ret;
 
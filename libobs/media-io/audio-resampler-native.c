@@ -0,0 +1,720 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/bmem.h"
+#include "../util/sse-intrin.h"
+#include "audio-resampler-native.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+/* the libswresample defaults, so that both give the same results */
+#define FILTER_SIZE 32
+#define FILTER_CUTOFF 0.97
+#define KAISER_BETA 9.0
+
+#define MAX_PHASES 1024
+#define MAX_DOWNSAMPLE 4
+
+/* the dot product reads up to three samples past the last tap */
+#define HISTORY_PADDING 4
+
+enum sample_type {
+	SAMPLE_S16,
+	SAMPLE_S32,
+	SAMPLE_FLOAT,
+};
+
+struct polyphase {
+	uint32_t phases;
+	uint32_t step;
+	uint32_t taps;
+	uint32_t taps_alloc;
+	uint32_t center;
+	float *filter;
+
+	/* input starting at the first tap of the next output sample */
+	float *history[MAX_AUDIO_CHANNELS];
+	size_t history_len;
+	size_t history_capacity;
+	uint32_t phase;
+	bool started;
+};
+
+struct native_resampler {
+	uint32_t in_rate;
+	uint32_t in_ch;
+	enum sample_type in_type;
+	bool in_planar;
+
+	uint32_t out_rate;
+	uint32_t out_ch;
+	enum sample_type out_type;
+	bool out_planar;
+
+	/* channels that are converted and resampled, mono is duplicated to
+	 * stereo at the very end */
+	uint32_t ch;
+	float downmix;
+
+	bool resample;
+	struct polyphase poly;
+
+	float *work[MAX_AUDIO_CHANNELS];
+	size_t work_capacity;
+	float *resampled[MAX_AUDIO_CHANNELS];
+	size_t resampled_capacity;
+	uint8_t *output[MAX_AUDIO_CHANNELS];
+	size_t output_capacity;
+	uint8_t *temp;
+	size_t temp_capacity;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void grow_planes(float **planes, uint32_t count, size_t *capacity,
+			size_t frames)
+{
+	if (frames <= *capacity)
+		return;
+
+	frames += frames / 2;
+	for (uint32_t i = 0; i < count; i++)
+		planes[i] = brealloc(planes[i], frames * sizeof(float));
+
+	*capacity = frames;
+}
+
+static void grow_bytes(uint8_t **planes, uint32_t count, size_t *capacity,
+		       size_t size)
+{
+	if (size <= *capacity)
+		return;
+
+	for (uint32_t i = 0; i < count; i++) {
+		bfree(planes[i]);
+		planes[i] = bmalloc(size);
+	}
+
+	*capacity = size;
+}
+
+static inline size_t sample_size(enum sample_type type)
+{
+	return type == SAMPLE_S16 ? sizeof(int16_t) : sizeof(int32_t);
+}
+
+/* ------------------------------------------------------------------------- */
+/* sample conversion, rounded and clipped the same way libswresample does */
+
+static void s16_to_float(float *dst, const int16_t *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / (1 << 15));
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	for (; i < count; i++)
+		dst[i] = src[i] * (1.0f / (1 << 15));
+}
+
+static void s32_to_float(float *dst, const int32_t *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / (1U << 31));
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+	}
+
+	for (; i < count; i++)
+		dst[i] = src[i] * (1.0f / (1U << 31));
+}
+
+static void float_to_s16(int16_t *dst, const float *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1 << 15);
+	const __m128 max = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-32768.0f);
+	size_t i = 0;
+
+	/* clamped first, out of range values don't convert to an integer */
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+		__m128i ia, ib;
+
+		a = _mm_max_ps(_mm_min_ps(a, max), min);
+		b = _mm_max_ps(_mm_min_ps(b, max), min);
+		ia = _mm_cvtps_epi32(a);
+		ib = _mm_cvtps_epi32(b);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(ia, ib));
+	}
+
+	for (; i < count; i++) {
+		long val = lrintf(src[i] * (1 << 15));
+
+		if (val > INT16_MAX)
+			val = INT16_MAX;
+		else if (val < INT16_MIN)
+			val = INT16_MIN;
+		dst[i] = (int16_t)val;
+	}
+}
+
+static void float_to_s32(int32_t *dst, const float *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1U << 31);
+	const __m128i max = _mm_set1_epi32(0x7FFFFFFF);
+	size_t i = 0;
+
+	/* values that don't fit convert to INT32_MIN, which is only right
+	 * for the negative ones */
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128i over = _mm_castps_si128(_mm_cmpge_ps(v, scale));
+		__m128i val = _mm_cvtps_epi32(v);
+
+		val = _mm_or_si128(_mm_andnot_si128(over, val),
+				   _mm_and_si128(over, max));
+		_mm_storeu_si128((__m128i *)(dst + i), val);
+	}
+
+	for (; i < count; i++) {
+		long long val = llrintf(src[i] * (1U << 31));
+
+		if (val > INT32_MAX)
+			val = INT32_MAX;
+		else if (val < INT32_MIN)
+			val = INT32_MIN;
+		dst[i] = (int32_t)val;
+	}
+}
+
+static void to_float(float *dst, const uint8_t *src, enum sample_type type,
+		     size_t count)
+{
+	if (type == SAMPLE_S16)
+		s16_to_float(dst, (const int16_t *)src, count);
+	else if (type == SAMPLE_S32)
+		s32_to_float(dst, (const int32_t *)src, count);
+	else
+		memcpy(dst, src, count * sizeof(float));
+}
+
+static void from_float(uint8_t *dst, const float *src, enum sample_type type,
+		       size_t count)
+{
+	if (type == SAMPLE_S16)
+		float_to_s16((int16_t *)dst, src, count);
+	else if (type == SAMPLE_S32)
+		float_to_s32((int32_t *)dst, src, count);
+	else
+		memcpy(dst, src, count * sizeof(float));
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void deinterleave(float **dst, const float *src, uint32_t channels,
+			 size_t frames)
+{
+	size_t i = 0;
+
+	if (channels == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(src + i * 2);
+			__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+
+			_mm_storeu_ps(dst[0] + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(dst[1] + i,
+				      _mm_shuffle_ps(a, b,
+						     _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (uint32_t c = 0; c < channels; c++)
+			dst[c][i] = src[i * channels + c];
+	}
+}
+
+static void interleave(float *dst, const float *const *src, uint32_t channels,
+		       size_t frames)
+{
+	size_t i = 0;
+
+	if (channels == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			__m128 l = _mm_loadu_ps(src[0] + i);
+			__m128 r = _mm_loadu_ps(src[1] + i);
+
+			_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (uint32_t c = 0; c < channels; c++)
+			dst[i * channels + c] = src[c][i];
+	}
+}
+
+static void mix_to_mono(float *dst, const float *l, const float *r,
+			float coeff, size_t frames)
+{
+	const __m128 c = _mm_set1_ps(coeff);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(l + i), c);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(r + i), c);
+		_mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+	}
+
+	for (; i < frames; i++)
+		dst[i] = l[i] * coeff + r[i] * coeff;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 64; k++) {
+		term *= (x * 0.5) / k;
+		sum += term * term;
+		if (term * term < sum * 1e-17)
+			break;
+	}
+
+	return sum;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* a Kaiser windowed sinc for every phase, built like libswresample does */
+static void poly_init(struct polyphase *p, uint32_t out_rate,
+		      uint32_t in_rate)
+{
+	uint32_t div = gcd(out_rate, in_rate);
+	double factor = (double)out_rate * FILTER_CUTOFF / in_rate;
+	double *tab;
+
+	if (factor > 1.0)
+		factor = 1.0;
+
+	p->phases = out_rate / div;
+	p->step = in_rate / div;
+	p->taps = (uint32_t)ceil(FILTER_SIZE / factor);
+	p->taps += p->taps & 1;
+	p->taps_alloc = (p->taps + 3) & ~3;
+	p->center = (p->taps - 1) / 2;
+	p->filter = bzalloc(sizeof(float) * p->phases * p->taps_alloc);
+
+	tab = bmalloc(sizeof(double) * p->taps);
+
+	for (uint32_t ph = 0; ph < p->phases; ph++) {
+		double norm = 0.0;
+
+		for (uint32_t i = 0; i < p->taps; i++) {
+			double x = M_PI * factor *
+				   ((double)((int)i - (int)p->center) -
+				    (double)ph / p->phases);
+			double y = x == 0.0 ? 1.0 : sin(x) / x;
+			double w = 2.0 * x / (factor * p->taps * M_PI);
+			double k = 1.0 - w * w;
+
+			y *= bessel_i0(KAISER_BETA * sqrt(k > 0.0 ? k : 0.0));
+			tab[i] = y;
+			norm += y;
+		}
+
+		for (uint32_t i = 0; i < p->taps; i++)
+			p->filter[ph * p->taps_alloc + i] =
+				(float)(tab[i] / norm);
+	}
+
+	bfree(tab);
+}
+
+static void poly_free(struct polyphase *p)
+{
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++)
+		bfree(p->history[i]);
+	bfree(p->filter);
+}
+
+/* count is a multiple of 4, filter is aligned */
+static inline float dot(const float *src, const float *filter, size_t count)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i),
+				      _mm_load_ps(filter + i));
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4),
+				      _mm_load_ps(filter + i + 4));
+
+		sum0 = _mm_add_ps(sum0, a);
+		sum1 = _mm_add_ps(sum1, b);
+	}
+	if (i < count)
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(src + i),
+						   _mm_load_ps(filter + i)));
+
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum1 = _mm_shuffle_ps(sum0, sum0, _MM_SHUFFLE(2, 3, 0, 1));
+	sum0 = _mm_add_ps(sum0, sum1);
+	sum1 = _mm_movehl_ps(sum1, sum0);
+	sum0 = _mm_add_ss(sum0, sum1);
+	return _mm_cvtss_f32(sum0);
+}
+
+/* input time from the next output sample to the end of the history */
+static uint64_t poly_get_delay(const struct polyphase *p, uint32_t rate)
+{
+	int64_t num = ((int64_t)p->history_len - p->center) * p->phases -
+		      p->phase;
+	int64_t den = (int64_t)rate * p->phases;
+
+	if (!p->started || num <= 0)
+		return 0;
+
+	return (uint64_t)((num * 1000000000LL + den / 2) / den);
+}
+
+static void poly_append(struct polyphase *p, const float **planes,
+			uint32_t channels, size_t frames)
+{
+	/* the first samples are mirrored to fill the taps before them */
+	size_t start = p->started ? 0 : p->center;
+	size_t len = p->history_len + start;
+
+	grow_planes(p->history, channels, &p->history_capacity,
+		    len + frames + HISTORY_PADDING);
+
+	for (uint32_t c = 0; c < channels; c++) {
+		float *h = p->history[c];
+
+		for (size_t i = 0; i < start; i++) {
+			size_t mirror = start - i;
+			h[i] = mirror < frames ? planes[c][mirror] : 0.0f;
+		}
+
+		memcpy(h + len, planes[c], frames * sizeof(float));
+		memset(h + len + frames, 0, HISTORY_PADDING * sizeof(float));
+	}
+
+	p->history_len = len + frames;
+	p->started = true;
+}
+
+static size_t poly_resample(struct native_resampler *nr, const float **planes,
+			    size_t frames)
+{
+	struct polyphase *p = &nr->poly;
+	size_t len, out_max;
+	size_t idx = 0;
+	size_t count = 0;
+	uint32_t phase = p->phase;
+
+	poly_append(p, planes, nr->ch, frames);
+	len = p->history_len;
+
+	out_max = len * p->phases / p->step + 1;
+	grow_planes(nr->resampled, nr->ch, &nr->resampled_capacity, out_max);
+
+	for (uint32_t c = 0; c < nr->ch; c++) {
+		const float *h = p->history[c];
+		float *dst = nr->resampled[c];
+
+		idx = 0;
+		count = 0;
+		phase = p->phase;
+
+		while (idx + p->taps <= len) {
+			const float *filter =
+				p->filter + (size_t)phase * p->taps_alloc;
+
+			dst[count++] = dot(h + idx, filter, p->taps_alloc);
+
+			phase += p->step;
+			idx += phase / p->phases;
+			phase %= p->phases;
+		}
+
+		planes[c] = dst;
+	}
+
+	for (uint32_t c = 0; c < nr->ch; c++)
+		memmove(p->history[c], p->history[c] + idx,
+			(len - idx) * sizeof(float));
+
+	p->history_len = len - idx;
+	p->phase = phase;
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool get_sample_type(enum audio_format format, enum sample_type *type)
+{
+	switch (format) {
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		*type = SAMPLE_S16;
+		return true;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		*type = SAMPLE_S32;
+		return true;
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		*type = SAMPLE_FLOAT;
+		return true;
+	case AUDIO_FORMAT_UNKNOWN:
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		break;
+	}
+
+	return false;
+}
+
+static bool rates_supported(uint32_t out_rate, uint32_t in_rate)
+{
+	uint32_t div;
+
+	if (!out_rate || !in_rate)
+		return false;
+	if (out_rate == in_rate)
+		return true;
+
+	div = gcd(out_rate, in_rate);
+	return out_rate / div <= MAX_PHASES && in_rate / div <= MAX_PHASES &&
+	       in_rate <= out_rate * MAX_DOWNSAMPLE;
+}
+
+bool native_resampler_supported(const struct resample_info *dst,
+				const struct resample_info *src)
+{
+	enum sample_type in_type, out_type;
+	bool same_layout = src->speakers == dst->speakers;
+	bool mono_stereo = (src->speakers == SPEAKERS_MONO &&
+			    dst->speakers == SPEAKERS_STEREO) ||
+			   (src->speakers == SPEAKERS_STEREO &&
+			    dst->speakers == SPEAKERS_MONO);
+
+	if (!get_sample_type(src->format, &in_type) ||
+	    !get_sample_type(dst->format, &out_type))
+		return false;
+
+	/* integer to integer conversions aren't done through float */
+	if (in_type != SAMPLE_FLOAT && out_type != SAMPLE_FLOAT)
+		return false;
+
+	if (src->speakers == SPEAKERS_UNKNOWN || (!same_layout && !mono_stereo))
+		return false;
+
+	return rates_supported(dst->samples_per_sec, src->samples_per_sec);
+}
+
+struct native_resampler *
+native_resampler_create(const struct resample_info *dst,
+			const struct resample_info *src)
+{
+	struct native_resampler *nr;
+
+	if (!native_resampler_supported(dst, src))
+		return NULL;
+
+	nr = bzalloc(sizeof(*nr));
+	nr->in_rate = src->samples_per_sec;
+	nr->in_ch = get_audio_channels(src->speakers);
+	nr->in_planar = is_audio_planar(src->format);
+	get_sample_type(src->format, &nr->in_type);
+
+	nr->out_rate = dst->samples_per_sec;
+	nr->out_ch = get_audio_channels(dst->speakers);
+	nr->out_planar = is_audio_planar(dst->format);
+	get_sample_type(dst->format, &nr->out_type);
+
+	nr->ch = nr->in_ch < nr->out_ch ? nr->in_ch : nr->out_ch;
+
+	/* libswresample keeps integer output from clipping */
+	nr->downmix = nr->out_type == SAMPLE_FLOAT ? (float)M_SQRT1_2 : 0.5f;
+
+	nr->resample = nr->in_rate != nr->out_rate;
+	if (nr->resample)
+		poly_init(&nr->poly, nr->out_rate, nr->in_rate);
+
+	return nr;
+}
+
+void native_resampler_destroy(struct native_resampler *nr)
+{
+	if (!nr)
+		return;
+
+	poly_free(&nr->poly);
+
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
+		bfree(nr->work[i]);
+		bfree(nr->resampled[i]);
+		bfree(nr->output[i]);
+	}
+
+	bfree(nr->temp);
+	bfree(nr);
+}
+
+/* converts the input to float planes, downmixed if needed */
+static void convert_input(struct native_resampler *nr, const float **planes,
+			  const uint8_t *const input[], size_t frames)
+{
+	uint32_t in_ch = nr->in_ch;
+
+	if (nr->in_planar || in_ch == 1) {
+		if (nr->in_type != SAMPLE_FLOAT)
+			grow_planes(nr->work, in_ch, &nr->work_capacity,
+				    frames);
+
+		for (uint32_t c = 0; c < in_ch; c++) {
+			if (nr->in_type == SAMPLE_FLOAT) {
+				planes[c] = (const float *)input[c];
+			} else {
+				to_float(nr->work[c], input[c], nr->in_type,
+					 frames);
+				planes[c] = nr->work[c];
+			}
+		}
+
+	} else {
+		const float *src = (const float *)input[0];
+
+		if (nr->in_type != SAMPLE_FLOAT) {
+			size_t size = frames * in_ch * sizeof(float);
+			grow_bytes(&nr->temp, 1, &nr->temp_capacity, size);
+			to_float((float *)nr->temp, input[0], nr->in_type,
+				 frames * in_ch);
+			src = (const float *)nr->temp;
+		}
+
+		grow_planes(nr->work, in_ch, &nr->work_capacity, frames);
+		deinterleave(nr->work, src, in_ch, frames);
+
+		for (uint32_t c = 0; c < in_ch; c++)
+			planes[c] = nr->work[c];
+	}
+
+	if (nr->in_ch == 2 && nr->out_ch == 1) {
+		grow_planes(nr->work, 1, &nr->work_capacity, frames);
+		mix_to_mono(nr->work[0], planes[0], planes[1], nr->downmix,
+			    frames);
+		planes[0] = nr->work[0];
+	}
+}
+
+static void write_output(struct native_resampler *nr, uint8_t *output[],
+			 const float **planes, size_t frames)
+{
+	const float *out[MAX_AUDIO_CHANNELS];
+	uint32_t out_ch = nr->out_ch;
+	size_t size = frames * sample_size(nr->out_type);
+
+	/* mono upmixed to stereo */
+	for (uint32_t c = 0; c < out_ch; c++)
+		out[c] = planes[nr->ch == 1 ? 0 : c];
+
+	if (nr->out_type == SAMPLE_FLOAT && (nr->out_planar || out_ch == 1)) {
+		for (uint32_t c = 0; c < out_ch; c++)
+			output[c] = (uint8_t *)out[c];
+
+	} else if (nr->out_planar || out_ch == 1) {
+		grow_bytes(nr->output, out_ch, &nr->output_capacity, size);
+
+		for (uint32_t c = 0; c < out_ch; c++) {
+			from_float(nr->output[c], out[c], nr->out_type, frames);
+			output[c] = nr->output[c];
+		}
+
+	} else if (nr->out_type == SAMPLE_FLOAT) {
+		grow_bytes(nr->output, 1, &nr->output_capacity, size * out_ch);
+		interleave((float *)nr->output[0], out, out_ch, frames);
+		output[0] = nr->output[0];
+
+	} else {
+		grow_bytes(&nr->temp, 1, &nr->temp_capacity,
+			   frames * out_ch * sizeof(float));
+		grow_bytes(nr->output, 1, &nr->output_capacity, size * out_ch);
+
+		interleave((float *)nr->temp, out, out_ch, frames);
+		from_float(nr->output[0], (const float *)nr->temp,
+			   nr->out_type, frames * out_ch);
+		output[0] = nr->output[0];
+	}
+}
+
+void native_resampler_resample(struct native_resampler *nr,
+			       uint8_t *output[], uint32_t *out_frames,
+			       uint64_t *ts_offset,
+			       const uint8_t *const input[], uint32_t in_frames)
+{
+	const float *planes[MAX_AUDIO_CHANNELS];
+	size_t frames = in_frames;
+
+	*ts_offset = nr->resample ? poly_get_delay(&nr->poly, nr->in_rate) : 0;
+
+	convert_input(nr, planes, input, frames);
+
+	if (nr->resample)
+		frames = poly_resample(nr, planes, frames);
+
+	write_output(nr, output, planes, frames);
+	*out_frames = (uint32_t)frames;
+}
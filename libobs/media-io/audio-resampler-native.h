@@ -0,0 +1,47 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "audio-resampler.h"
+
+/*
+ * Built-in resampler for the common cases
+ *
+ *   Converts between 16 bit, 32 bit and float samples, planar or interleaved,
+ * as long as one side is float.  Mono can be converted to stereo and back,
+ * and rates with a small integer ratio (like 44.1 kHz and 48 kHz) are
+ * converted with a polyphase filter.  The results match what libswresample
+ * produces with its default settings.
+ */
+
+struct native_resampler;
+
+extern bool native_resampler_supported(const struct resample_info *dst,
+				       const struct resample_info *src);
+
+extern struct native_resampler *
+native_resampler_create(const struct resample_info *dst,
+			const struct resample_info *src);
+extern void native_resampler_destroy(struct native_resampler *nr);
+
+/* output can point to the input if nothing needs to be converted */
+extern void native_resampler_resample(struct native_resampler *nr,
+				      uint8_t *output[], uint32_t *out_frames,
+				      uint64_t *ts_offset,
+				      const uint8_t *const input[],
+				      uint32_t in_frames);
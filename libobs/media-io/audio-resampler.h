@@ -44,6 +44,14 @@ EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
 				     const uint8_t *const input[],
 				     uint32_t in_frames);
 
+/**
+ * Enables or disables the built-in conversions for resamplers created after
+ * this call, so that they always go through libswresample.  Mostly useful to
+ * compare the two, enabled by default.
+ */
+EXPORT void audio_resampler_set_native(bool native);
+EXPORT bool audio_resampler_is_native(const audio_resampler_t *resampler);
+
 #ifdef __cplusplus
 }
 #endif
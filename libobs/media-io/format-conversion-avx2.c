@@ -0,0 +1,387 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "format-conversion-internal.h"
+
+#include <string.h>
+
+#if FORMAT_CONVERSION_X86
+
+/* kept out of format-conversion.c, <immintrin.h> does not mix with the simde
+ * aliases used there */
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+/*
+ * Packed pixels are U, Y, V, X from the lowest byte up.  The 256 bit
+ * shuffles work within each 128 bit half, so results are gathered with a
+ * dword permute afterwards.
+ */
+
+static inline uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+#define SHUFFLE_LANES(b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11, b12, \
+		      b13, b14, b15)                                         \
+	_mm256_setr_epi8(b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11,   \
+			 b12, b13, b14, b15, b0, b1, b2, b3, b4, b5, b6, b7, \
+			 b8, b9, b10, b11, b12, b13, b14, b15)
+
+/* 8 pixels of two lines: stores 8 luma values of each line, and returns the
+ * 2x2 averaged chroma as [U V 0 0] per 16 bit word, in dwords 0 and 2 of each
+ * 128 bit half */
+AVX2_TARGET static inline __m256i compress_8px(const uint8_t *img,
+					       uint32_t in_linesize,
+					       uint8_t *lum0, uint8_t *lum1)
+{
+	const __m256i lum_shuf = SHUFFLE_LANES(1, 5, 9, 13, -1, -1, -1, -1, -1,
+					       -1, -1, -1, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+
+	__m256i line1 = _mm256_loadu_si256((const __m256i *)img);
+	__m256i line2 =
+		_mm256_loadu_si256((const __m256i *)(img + in_linesize));
+	__m256i lum, sum;
+
+	lum = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(line1, lum_shuf),
+					  join);
+	_mm_storel_epi64((__m128i *)lum0, _mm256_castsi256_si128(lum));
+	lum = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(line2, lum_shuf),
+					  join);
+	_mm_storel_epi64((__m128i *)lum1, _mm256_castsi256_si128(lum));
+
+	sum = _mm256_add_epi16(_mm256_and_si256(line1, uv_mask),
+			       _mm256_and_si256(line2, uv_mask));
+	sum = _mm256_add_epi16(sum, _mm256_shuffle_epi32(sum, 0xB1));
+	return _mm256_srli_epi16(sum, 2);
+}
+
+AVX2_TARGET static void
+compress_uyvx_to_i420_avx2(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	/* [U0 U1 V0 V1] in dword 0 of each half */
+	const __m256i uv_shuf = SHUFFLE_LANES(0, 8, 2, 10, -1, -1, -1, -1, -1,
+					      -1, -1, -1, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	const __m128i split = _mm_setr_epi8(0, 1, 4, 5, 2, 3, 6, 7, -1, -1, -1,
+					    -1, -1, -1, -1, -1);
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line = input + y * in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *u = output[1] + (y >> 1) * out_linesize[1];
+		uint8_t *v = output[2] + (y >> 1) * out_linesize[2];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			__m256i uv = compress_8px(line + x * 4, in_linesize,
+						  lum0 + x, lum1 + x);
+			__m128i packed;
+			uint32_t vals[2];
+
+			uv = _mm256_permutevar8x32_epi32(
+				_mm256_shuffle_epi8(uv, uv_shuf), join);
+			packed = _mm_shuffle_epi8(_mm256_castsi256_si128(uv),
+						  split);
+
+			_mm_storel_epi64((__m128i *)vals, packed);
+			memcpy(u + (x >> 1), &vals[0], sizeof(uint32_t));
+			memcpy(v + (x >> 1), &vals[1], sizeof(uint32_t));
+		}
+
+		compress_uyvx_tail(line, line + in_linesize, x, width, lum0,
+				   lum1, u, v, 1);
+	}
+}
+
+AVX2_TARGET static void
+compress_uyvx_to_nv12_avx2(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	/* [U0 V0 U1 V1] in dword 0 of each half */
+	const __m256i uv_shuf = SHUFFLE_LANES(0, 2, 8, 10, -1, -1, -1, -1, -1,
+					      -1, -1, -1, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line = input + y * in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *chroma = output[1] + (y >> 1) * out_linesize[1];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			__m256i uv = compress_8px(line + x * 4, in_linesize,
+						  lum0 + x, lum1 + x);
+
+			uv = _mm256_permutevar8x32_epi32(
+				_mm256_shuffle_epi8(uv, uv_shuf), join);
+			_mm_storel_epi64((__m128i *)(chroma + x),
+					 _mm256_castsi256_si128(uv));
+		}
+
+		compress_uyvx_tail(line, line + in_linesize, x, width, lum0,
+				   lum1, chroma, chroma + 1, 2);
+	}
+}
+
+AVX2_TARGET static void
+convert_uyvx_to_i444_avx2(const uint8_t *input, uint32_t in_linesize,
+			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+	/* Y, U and V of each half in dwords 0, 1 and 2 */
+	const __m256i shuf = SHUFFLE_LANES(1, 5, 9, 13, 0, 4, 8, 12, 2, 6, 10,
+					   14, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint8_t *line = input + y * in_linesize;
+		uint32_t pos = y * out_linesize[0];
+		uint8_t *lum = output[0] + pos;
+		uint8_t *u = output[1] + pos;
+		uint8_t *v = output[2] + pos;
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			__m256i px = _mm256_loadu_si256(
+				(const __m256i *)(line + x * 4));
+			__m128i lo, hi;
+
+			px = _mm256_permutevar8x32_epi32(
+				_mm256_shuffle_epi8(px, shuf), join);
+			lo = _mm256_castsi256_si128(px);
+			hi = _mm256_extracti128_si256(px, 1);
+
+			_mm_storel_epi64((__m128i *)(lum + x), lo);
+			_mm_storel_epi64((__m128i *)(u + x),
+					 _mm_unpackhi_epi64(lo, lo));
+			_mm_storel_epi64((__m128i *)(v + x), hi);
+		}
+
+		convert_uyvx_to_i444_tail(line, x, width, lum, u, v);
+	}
+}
+
+/* 16 pixels of one line from 8 chroma values, each given as a 16 bit word
+ * that is used for two pixels */
+AVX2_TARGET static inline void store_16px(uint32_t *output, __m128i chroma,
+					  int chroma_shift, __m128i lum,
+					  int lum_shift)
+{
+	__m256i chroma_lo = _mm256_cvtepu16_epi32(
+		_mm_unpacklo_epi16(chroma, chroma));
+	__m256i chroma_hi = _mm256_cvtepu16_epi32(
+		_mm_unpackhi_epi16(chroma, chroma));
+	__m256i lum_lo = _mm256_cvtepu8_epi32(lum);
+	__m256i lum_hi = _mm256_cvtepu8_epi32(_mm_srli_si128(lum, 8));
+
+	chroma_lo = _mm256_slli_epi32(chroma_lo, chroma_shift);
+	chroma_hi = _mm256_slli_epi32(chroma_hi, chroma_shift);
+	lum_lo = _mm256_slli_epi32(lum_lo, lum_shift);
+	lum_hi = _mm256_slli_epi32(lum_hi, lum_shift);
+
+	_mm256_storeu_si256((__m256i *)output,
+			    _mm256_or_si256(chroma_lo, lum_lo));
+	_mm256_storeu_si256((__m256i *)(output + 8),
+			    _mm256_or_si256(chroma_hi, lum_hi));
+}
+
+AVX2_TARGET static void decompress_420_avx2(const uint8_t *const input[],
+					    const uint32_t in_linesize[],
+					    uint32_t start_y, uint32_t end_y,
+					    uint8_t *output,
+					    uint32_t out_linesize)
+{
+	uint32_t width_d2 = in_linesize[0] / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y / 2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0 = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1 = lum0 + in_linesize[0];
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i u = _mm_loadl_epi64(
+				(const __m128i *)(chroma0 + x));
+			__m128i v = _mm_loadl_epi64(
+				(const __m128i *)(chroma1 + x));
+			__m128i uv = _mm_unpacklo_epi8(v, u);
+			__m128i lum;
+
+			lum = _mm_loadu_si128((const __m128i *)(lum0 + x * 2));
+			store_16px(output0 + x * 2, uv, 0, lum, 16);
+			lum = _mm_loadu_si128((const __m128i *)(lum1 + x * 2));
+			store_16px(output1 + x * 2, uv, 0, lum, 16);
+		}
+
+		decompress_420_tail(lum0, lum1, chroma0, chroma1, x, width_d2,
+				    output0, output1);
+	}
+}
+
+AVX2_TARGET static void decompress_nv12_avx2(const uint8_t *const input[],
+					     const uint32_t in_linesize[],
+					     uint32_t start_y, uint32_t end_y,
+					     uint8_t *output,
+					     uint32_t out_linesize)
+{
+	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y / 2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m128i uv =
+				_mm_loadu_si128((const __m128i *)(chroma + x));
+			__m128i lum;
+
+			lum = _mm_loadu_si128((const __m128i *)(lum0 + x * 2));
+			store_16px(output0 + x * 2, uv, 8, lum, 0);
+			lum = _mm_loadu_si128((const __m128i *)(lum1 + x * 2));
+			store_16px(output1 + x * 2, uv, 8, lum, 0);
+		}
+
+		decompress_nv12_tail(lum0, lum1, chroma, x, width_d2, output0,
+				     output1);
+	}
+}
+
+AVX2_TARGET static void decompress_422_avx2(const uint8_t *input,
+					    uint32_t in_linesize,
+					    uint32_t start_y, uint32_t end_y,
+					    uint8_t *output,
+					    uint32_t out_linesize,
+					    bool leading_lum)
+{
+	/* the second pixel of each pair gets the other luma value */
+	const __m256i shuf = leading_lum
+				     ? SHUFFLE_LANES(2, 1, 2, 3, 6, 5, 6, 7, 10,
+						     9, 10, 11, 14, 13, 14, 15)
+				     : SHUFFLE_LANES(0, 3, 2, 3, 4, 7, 6, 7, 8,
+						     11, 10, 11, 12, 15, 14,
+						     15);
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t *output32;
+		uint32_t x;
+
+		input32 = (const uint32_t *)(input + y * in_linesize);
+		output32 = (uint32_t *)(output + y * out_linesize);
+
+		for (x = 0; x + 8 <= width_d2; x += 8) {
+			__m256i in = _mm256_loadu_si256(
+				(const __m256i *)(input32 + x));
+			__m256i second = _mm256_shuffle_epi8(in, shuf);
+			__m256i lo = _mm256_unpacklo_epi32(in, second);
+			__m256i hi = _mm256_unpackhi_epi32(in, second);
+
+			_mm256_storeu_si256(
+				(__m256i *)(output32 + x * 2),
+				_mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256(
+				(__m256i *)(output32 + x * 2 + 8),
+				_mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+
+		decompress_422_tail(input32, x, width_d2, output32,
+				    leading_lum);
+	}
+}
+
+const struct format_conversion_kernels format_conversion_avx2 = {
+	.compress_uyvx_to_i420 = compress_uyvx_to_i420_avx2,
+	.compress_uyvx_to_nv12 = compress_uyvx_to_nv12_avx2,
+	.convert_uyvx_to_i444 = convert_uyvx_to_i444_avx2,
+	.decompress_nv12 = decompress_nv12_avx2,
+	.decompress_420 = decompress_420_avx2,
+	.decompress_422 = decompress_422_avx2,
+};
+
+static bool check_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* AVX support and OS support for saving the YMM registers */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool format_conversion_cpu_has_avx2(void)
+{
+	static int has_avx2 = -1;
+
+	if (has_avx2 == -1)
+		has_avx2 = check_avx2() ? 1 : 0;
+
+	return has_avx2 == 1;
+}
+
+#endif
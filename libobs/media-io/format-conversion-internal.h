@@ -0,0 +1,171 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+#define FORMAT_CONVERSION_X86 1
+#else
+#define FORMAT_CONVERSION_X86 0
+#endif
+
+/*
+ * One set of conversion functions per instruction set.  These only ever
+ * convert the rows they are given, slicing the frame up is done by the
+ * exported functions in format-conversion.c.
+ */
+
+struct format_conversion_kernels {
+	void (*compress_uyvx_to_i420)(const uint8_t *input,
+				      uint32_t in_linesize, uint32_t start_y,
+				      uint32_t end_y, uint8_t *output[],
+				      const uint32_t out_linesize[]);
+	void (*compress_uyvx_to_nv12)(const uint8_t *input,
+				      uint32_t in_linesize, uint32_t start_y,
+				      uint32_t end_y, uint8_t *output[],
+				      const uint32_t out_linesize[]);
+	void (*convert_uyvx_to_i444)(const uint8_t *input, uint32_t in_linesize,
+				     uint32_t start_y, uint32_t end_y,
+				     uint8_t *output[],
+				     const uint32_t out_linesize[]);
+	void (*decompress_nv12)(const uint8_t *const input[],
+				const uint32_t in_linesize[], uint32_t start_y,
+				uint32_t end_y, uint8_t *output,
+				uint32_t out_linesize);
+	void (*decompress_420)(const uint8_t *const input[],
+			       const uint32_t in_linesize[], uint32_t start_y,
+			       uint32_t end_y, uint8_t *output,
+			       uint32_t out_linesize);
+	void (*decompress_422)(const uint8_t *input, uint32_t in_linesize,
+			       uint32_t start_y, uint32_t end_y,
+			       uint8_t *output, uint32_t out_linesize,
+			       bool leading_lum);
+};
+
+#if FORMAT_CONVERSION_X86
+extern const struct format_conversion_kernels format_conversion_avx2;
+
+extern bool format_conversion_cpu_has_avx2(void);
+#endif
+
+/* plain C, used for whatever the vector loops leave over at the end of a
+ * row.  x is in pixels and must be even. */
+
+static inline uint32_t format_conversion_avg4(uint32_t a, uint32_t b,
+					      uint32_t c, uint32_t d,
+					      uint32_t shift)
+{
+	return (((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) +
+		((c >> shift) & 0xFF) + ((d >> shift) & 0xFF)) >>
+	       2;
+}
+
+static inline void compress_uyvx_tail(const uint8_t *line1,
+				      const uint8_t *line2, uint32_t x,
+				      uint32_t width, uint8_t *lum0,
+				      uint8_t *lum1, uint8_t *u, uint8_t *v,
+				      uint32_t uv_stride)
+{
+	const uint32_t *in1 = (const uint32_t *)line1;
+	const uint32_t *in2 = (const uint32_t *)line2;
+
+	for (; x < width; x += 2) {
+		uint32_t p00 = in1[x], p01 = in1[x + 1];
+		uint32_t p10 = in2[x], p11 = in2[x + 1];
+		uint32_t chroma_pos = (x >> 1) * uv_stride;
+
+		lum0[x] = (uint8_t)(p00 >> 8);
+		lum0[x + 1] = (uint8_t)(p01 >> 8);
+		lum1[x] = (uint8_t)(p10 >> 8);
+		lum1[x + 1] = (uint8_t)(p11 >> 8);
+
+		u[chroma_pos] =
+			(uint8_t)format_conversion_avg4(p00, p01, p10, p11, 0);
+		v[chroma_pos] =
+			(uint8_t)format_conversion_avg4(p00, p01, p10, p11, 16);
+	}
+}
+
+static inline void convert_uyvx_to_i444_tail(const uint8_t *line, uint32_t x,
+					     uint32_t width, uint8_t *lum,
+					     uint8_t *u, uint8_t *v)
+{
+	const uint32_t *in = (const uint32_t *)line;
+
+	for (; x < width; x++) {
+		uint32_t p = in[x];
+
+		lum[x] = (uint8_t)(p >> 8);
+		u[x] = (uint8_t)p;
+		v[x] = (uint8_t)(p >> 16);
+	}
+}
+
+static inline void decompress_420_tail(const uint8_t *lum0,
+				       const uint8_t *lum1,
+				       const uint8_t *chroma0,
+				       const uint8_t *chroma1, uint32_t x,
+				       uint32_t width_d2, uint32_t *output0,
+				       uint32_t *output1)
+{
+	for (; x < width_d2; x++) {
+		uint32_t out = ((uint32_t)chroma0[x] << 8) | chroma1[x];
+
+		output0[x * 2] = ((uint32_t)lum0[x * 2] << 16) | out;
+		output0[x * 2 + 1] = ((uint32_t)lum0[x * 2 + 1] << 16) | out;
+		output1[x * 2] = ((uint32_t)lum1[x * 2] << 16) | out;
+		output1[x * 2 + 1] = ((uint32_t)lum1[x * 2 + 1] << 16) | out;
+	}
+}
+
+static inline void decompress_nv12_tail(const uint8_t *lum0,
+					const uint8_t *lum1,
+					const uint16_t *chroma, uint32_t x,
+					uint32_t width_d2, uint32_t *output0,
+					uint32_t *output1)
+{
+	for (; x < width_d2; x++) {
+		uint32_t out = (uint32_t)chroma[x] << 8;
+
+		output0[x * 2] = lum0[x * 2] | out;
+		output0[x * 2 + 1] = lum0[x * 2 + 1] | out;
+		output1[x * 2] = lum1[x * 2] | out;
+		output1[x * 2 + 1] = lum1[x * 2 + 1] | out;
+	}
+}
+
+static inline void decompress_422_tail(const uint32_t *input32, uint32_t x,
+				       uint32_t width_d2, uint32_t *output32,
+				       bool leading_lum)
+{
+	for (; x < width_d2; x++) {
+		uint32_t dw = input32[x];
+
+		output32[x * 2] = dw;
+		if (leading_lum) {
+			dw &= 0xFFFFFF00;
+			dw |= (uint8_t)(dw >> 16);
+		} else {
+			dw &= 0xFFFF00FF;
+			dw |= (dw >> 16) & 0xFF00;
+		}
+		output32[x * 2 + 1] = dw;
+	}
+}
@@ -16,8 +16,16 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "format-conversion-internal.h"
 
 #include "../util/sse-intrin.h"
+#include "../util/threading.h"
+#include "../util/platform.h"
+#include "../util/darray.h"
+#include "../util/bmem.h"
+#include "../util/base.h"
+
+#include <string.h>
 
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
@@ -90,9 +98,191 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+/* ------------------------------------------------------------------------- */
+/* plain C */
+
+static void compress_uyvx_to_i420_c(const uint8_t *input, uint32_t in_linesize,
+				    uint32_t start_y, uint32_t end_y,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint32_t chroma_y = y >> 1;
+
+		compress_uyvx_tail(line1, line1 + in_linesize, 0, width, lum0,
+				   lum0 + out_linesize[0],
+				   output[1] + chroma_y * out_linesize[1],
+				   output[2] + chroma_y * out_linesize[2], 1);
+	}
+}
+
+static void compress_uyvx_to_nv12_c(const uint8_t *input, uint32_t in_linesize,
+				    uint32_t start_y, uint32_t end_y,
+				    uint8_t *output[],
+				    const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		const uint8_t *line1 = input + y * in_linesize;
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *chroma = output[1] + (y >> 1) * out_linesize[1];
+
+		compress_uyvx_tail(line1, line1 + in_linesize, 0, width, lum0,
+				   lum0 + out_linesize[0], chroma, chroma + 1,
+				   2);
+	}
+}
+
+static void convert_uyvx_to_i444_c(const uint8_t *input, uint32_t in_linesize,
+				   uint32_t start_y, uint32_t end_y,
+				   uint8_t *output[],
+				   const uint32_t out_linesize[])
+{
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y++) {
+		uint32_t pos = y * out_linesize[0];
+
+		convert_uyvx_to_i444_tail(input + y * in_linesize, 0, width,
+					  output[0] + pos, output[1] + pos,
+					  output[2] + pos);
+	}
+}
+
+static void decompress_420_c(const uint8_t *const input[],
+			     const uint32_t in_linesize[], uint32_t start_y,
+			     uint32_t end_y, uint8_t *output,
+			     uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y / 2;
+	uint32_t width_d2 = in_linesize[0] / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		register const uint8_t *lum0, *lum1;
+		register uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x++) {
+			uint32_t out;
+			out = (*(chroma0++) << 8) | *(chroma1++);
+
+			*(output0++) = (*(lum0++) << 16) | out;
+			*(output0++) = (*(lum0++) << 16) | out;
+
+			*(output1++) = (*(lum1++) << 16) | out;
+			*(output1++) = (*(lum1++) << 16) | out;
+		}
+	}
+}
+
+static void decompress_nv12_c(const uint8_t *const input[],
+			      const uint32_t in_linesize[], uint32_t start_y,
+			      uint32_t end_y, uint8_t *output,
+			      uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y / 2;
+	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
+	uint32_t height_d2 = end_y / 2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		register const uint8_t *lum0, *lum1;
+		register uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t *)(output + y * 2 * out_linesize);
+		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
+
+		for (x = 0; x < width_d2; x++) {
+			uint32_t out = *(chroma++) << 8;
+
+			*(output0++) = *(lum0++) | out;
+			*(output0++) = *(lum0++) | out;
+
+			*(output1++) = *(lum1++) | out;
+			*(output1++) = *(lum1++) | out;
+		}
+	}
+}
+
+static void decompress_422_c(const uint8_t *input, uint32_t in_linesize,
+			     uint32_t start_y, uint32_t end_y, uint8_t *output,
+			     uint32_t out_linesize, bool leading_lum)
+{
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
+	uint32_t y;
+
+	register const uint32_t *input32;
+	register const uint32_t *input32_end;
+	register uint32_t *output32;
+
+	if (leading_lum) {
+		for (y = start_y; y < end_y; y++) {
+			input32 = (const uint32_t *)(input + y * in_linesize);
+			input32_end = input32 + width_d2;
+			output32 = (uint32_t *)(output + y * out_linesize);
+
+			while (input32 < input32_end) {
+				register uint32_t dw = *input32;
+
+				output32[0] = dw;
+				dw &= 0xFFFFFF00;
+				dw |= (uint8_t)(dw >> 16);
+				output32[1] = dw;
+
+				output32 += 2;
+				input32++;
+			}
+		}
+	} else {
+		for (y = start_y; y < end_y; y++) {
+			input32 = (const uint32_t *)(input + y * in_linesize);
+			input32_end = input32 + width_d2;
+			output32 = (uint32_t *)(output + y * out_linesize);
+
+			while (input32 < input32_end) {
+				register uint32_t dw = *input32;
+
+				output32[0] = dw;
+				dw &= 0xFFFF00FF;
+				dw |= (dw >> 16) & 0xFF00;
+				output32[1] = dw;
+
+				output32 += 2;
+				input32++;
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 */
+
+static void compress_uyvx_to_i420_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -127,9 +317,10 @@ void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static void compress_uyvx_to_nv12_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint8_t *output[],
+				       const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *chroma_plane = output[1];
@@ -162,9 +353,10 @@ void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
-			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			  const uint32_t out_linesize[])
+static void convert_uyvx_to_i444_sse2(const uint8_t *input,
+				      uint32_t in_linesize, uint32_t start_y,
+				      uint32_t end_y, uint8_t *output[],
+				      const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -200,53 +392,86 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize)
+static inline int load_32(const uint8_t *ptr)
+{
+	int val;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+
+static FORCE_INLINE void store_pixels(uint32_t *output, __m128i chroma_lo,
+				      __m128i chroma_hi, __m128i lum_lo,
+				      __m128i lum_hi)
+{
+	_mm_storeu_si128((__m128i *)output, _mm_or_si128(chroma_lo, lum_lo));
+	_mm_storeu_si128((__m128i *)(output + 4),
+			 _mm_or_si128(chroma_hi, lum_hi));
+}
+
+static void decompress_420_sse2(const uint8_t *const input[],
+				const uint32_t in_linesize[], uint32_t start_y,
+				uint32_t end_y, uint8_t *output,
+				uint32_t out_linesize)
 {
-	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = in_linesize[0] / 2;
 	uint32_t height_d2 = end_y / 2;
+	__m128i zero = _mm_setzero_si128();
 	uint32_t y;
 
-	for (y = start_y_d2; y < height_d2; y++) {
+	for (y = start_y / 2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0 = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1 = lum0 + in_linesize[0];
+		uint32_t *output0, *output1;
 		uint32_t x;
 
-		lum0 = input[0] + y * 2 * in_linesize[0];
-		lum1 = lum0 + in_linesize[0];
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | *(chroma1++);
+		/* 4 chroma samples, 8 pixels of both lines at a time */
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i u = _mm_cvtsi32_si128(load_32(chroma0 + x));
+			__m128i v = _mm_cvtsi32_si128(load_32(chroma1 + x));
+			__m128i uv = _mm_unpacklo_epi8(v, u);
+			__m128i uv_lo, uv_hi, lum;
 
-			*(output0++) = (*(lum0++) << 16) | out;
-			*(output0++) = (*(lum0++) << 16) | out;
+			uv = _mm_unpacklo_epi16(uv, uv);
+			uv_lo = _mm_unpacklo_epi16(uv, zero);
+			uv_hi = _mm_unpackhi_epi16(uv, zero);
 
-			*(output1++) = (*(lum1++) << 16) | out;
-			*(output1++) = (*(lum1++) << 16) | out;
+			lum = _mm_loadl_epi64((const __m128i *)(lum0 + x * 2));
+			lum = _mm_unpacklo_epi8(lum, zero);
+			store_pixels(output0 + x * 2, uv_lo, uv_hi,
+				     _mm_unpacklo_epi16(zero, lum),
+				     _mm_unpackhi_epi16(zero, lum));
+
+			lum = _mm_loadl_epi64((const __m128i *)(lum1 + x * 2));
+			lum = _mm_unpacklo_epi8(lum, zero);
+			store_pixels(output1 + x * 2, uv_lo, uv_hi,
+				     _mm_unpacklo_epi16(zero, lum),
+				     _mm_unpackhi_epi16(zero, lum));
 		}
+
+		decompress_420_tail(lum0, lum1, chroma0, chroma1, x, width_d2,
+				    output0, output1);
 	}
 }
 
-void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
-		     uint32_t start_y, uint32_t end_y, uint8_t *output,
-		     uint32_t out_linesize)
+static void decompress_nv12_sse2(const uint8_t *const input[],
+				 const uint32_t in_linesize[], uint32_t start_y,
+				 uint32_t end_y, uint8_t *output,
+				 uint32_t out_linesize)
 {
-	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
 	uint32_t height_d2 = end_y / 2;
+	__m128i zero = _mm_setzero_si128();
 	uint32_t y;
 
-	for (y = start_y_d2; y < height_d2; y++) {
+	for (y = start_y / 2; y < height_d2; y++) {
 		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 		uint32_t x;
 
 		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
@@ -255,64 +480,555 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i uv =
+				_mm_loadl_epi64((const __m128i *)(chroma + x));
+			__m128i uv_lo, uv_hi, lum;
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			uv = _mm_unpacklo_epi16(uv, uv);
+			uv_lo = _mm_slli_epi32(_mm_unpacklo_epi16(uv, zero), 8);
+			uv_hi = _mm_slli_epi32(_mm_unpackhi_epi16(uv, zero), 8);
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+			lum = _mm_loadl_epi64((const __m128i *)(lum0 + x * 2));
+			lum = _mm_unpacklo_epi8(lum, zero);
+			store_pixels(output0 + x * 2, uv_lo, uv_hi,
+				     _mm_unpacklo_epi16(lum, zero),
+				     _mm_unpackhi_epi16(lum, zero));
+
+			lum = _mm_loadl_epi64((const __m128i *)(lum1 + x * 2));
+			lum = _mm_unpacklo_epi8(lum, zero);
+			store_pixels(output1 + x * 2, uv_lo, uv_hi,
+				     _mm_unpacklo_epi16(lum, zero),
+				     _mm_unpackhi_epi16(lum, zero));
 		}
+
+		decompress_nv12_tail(lum0, lum1, chroma, x, width_d2, output0,
+				     output1);
 	}
 }
 
-void decompress_422(const uint8_t *input, uint32_t in_linesize,
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize, bool leading_lum)
+static void decompress_422_sse2(const uint8_t *input, uint32_t in_linesize,
+				uint32_t start_y, uint32_t end_y,
+				uint8_t *output, uint32_t out_linesize,
+				bool leading_lum)
 {
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
+	__m128i keep = _mm_set1_epi32(leading_lum ? (int)0xFFFFFF00
+						  : (int)0xFFFF00FF);
+	__m128i take = _mm_set1_epi32(leading_lum ? 0x000000FF : 0x0000FF00);
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t *output32;
-
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32 = (const uint32_t *)(input + y * in_linesize);
-			input32_end = input32 + width_d2;
-			output32 = (uint32_t *)(output + y * out_linesize);
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t *output32;
+		uint32_t x;
 
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
+		input32 = (const uint32_t *)(input + y * in_linesize);
+		output32 = (uint32_t *)(output + y * out_linesize);
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw >> 16);
-				output32[1] = dw;
+		/* the second pixel of each pair gets the other luma value */
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *)(input32 +
+								       x));
+			__m128i second = _mm_or_si128(
+				_mm_and_si128(in, keep),
+				_mm_and_si128(_mm_srli_epi32(in, 16), take));
 
-				output32 += 2;
-				input32++;
-			}
+			_mm_storeu_si128((__m128i *)(output32 + x * 2),
+					 _mm_unpacklo_epi32(in, second));
+			_mm_storeu_si128((__m128i *)(output32 + x * 2 + 4),
+					 _mm_unpackhi_epi32(in, second));
 		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32 = (const uint32_t *)(input + y * in_linesize);
-			input32_end = input32 + width_d2;
-			output32 = (uint32_t *)(output + y * out_linesize);
 
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
+		decompress_422_tail(input32, x, width_d2, output32,
+				    leading_lum);
+	}
+}
 
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw >> 16) & 0xFF00;
-				output32[1] = dw;
+/* ------------------------------------------------------------------------- */
 
-				output32 += 2;
-				input32++;
-			}
+static const struct format_conversion_kernels kernels_c = {
+	.compress_uyvx_to_i420 = compress_uyvx_to_i420_c,
+	.compress_uyvx_to_nv12 = compress_uyvx_to_nv12_c,
+	.convert_uyvx_to_i444 = convert_uyvx_to_i444_c,
+	.decompress_nv12 = decompress_nv12_c,
+	.decompress_420 = decompress_420_c,
+	.decompress_422 = decompress_422_c,
+};
+
+static const struct format_conversion_kernels kernels_sse2 = {
+	.compress_uyvx_to_i420 = compress_uyvx_to_i420_sse2,
+	.compress_uyvx_to_nv12 = compress_uyvx_to_nv12_sse2,
+	.convert_uyvx_to_i444 = convert_uyvx_to_i444_sse2,
+	.decompress_nv12 = decompress_nv12_sse2,
+	.decompress_420 = decompress_420_sse2,
+	.decompress_422 = decompress_422_sse2,
+};
+
+static volatile long simd_override = FORMAT_CONVERSION_SIMD_AUTO;
+
+bool format_conversion_simd_supported(enum format_conversion_simd simd)
+{
+	switch (simd) {
+	case FORMAT_CONVERSION_SIMD_AUTO:
+	case FORMAT_CONVERSION_SIMD_NONE:
+	case FORMAT_CONVERSION_SIMD_SSE2:
+		return true;
+	case FORMAT_CONVERSION_SIMD_AVX2:
+#if FORMAT_CONVERSION_X86
+		return format_conversion_cpu_has_avx2();
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+bool format_conversion_set_simd(enum format_conversion_simd simd)
+{
+	if (!format_conversion_simd_supported(simd))
+		return false;
+
+	os_atomic_set_long(&simd_override, (long)simd);
+	return true;
+}
+
+enum format_conversion_simd format_conversion_get_simd(void)
+{
+	long simd = os_atomic_load_long(&simd_override);
+
+	if (simd != FORMAT_CONVERSION_SIMD_AUTO)
+		return (enum format_conversion_simd)simd;
+
+	return format_conversion_simd_supported(FORMAT_CONVERSION_SIMD_AVX2)
+		       ? FORMAT_CONVERSION_SIMD_AVX2
+		       : FORMAT_CONVERSION_SIMD_SSE2;
+}
+
+const char *format_conversion_simd_name(enum format_conversion_simd simd)
+{
+	switch (simd) {
+	case FORMAT_CONVERSION_SIMD_AUTO:
+		return "auto";
+	case FORMAT_CONVERSION_SIMD_NONE:
+		return "none";
+	case FORMAT_CONVERSION_SIMD_SSE2:
+		return "SSE2";
+	case FORMAT_CONVERSION_SIMD_AVX2:
+		return "AVX2";
+	}
+
+	return "unknown";
+}
+
+static const struct format_conversion_kernels *get_kernels(void)
+{
+	switch (format_conversion_get_simd()) {
+	case FORMAT_CONVERSION_SIMD_NONE:
+		return &kernels_c;
+#if FORMAT_CONVERSION_X86
+	case FORMAT_CONVERSION_SIMD_AVX2:
+		return &format_conversion_avx2;
+#endif
+	default:
+		return &kernels_sse2;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* slice threads
+ *
+ * A frame is cut in to horizontal slices which are handed out to a small set
+ * of worker threads, the calling thread converts slices as well and returns
+ * once all of them are done.  Only one conversion uses the threads at a time,
+ * anything that comes in while they are busy is simply converted on the
+ * calling thread. */
+
+#define MAX_THREADS 16
+/* anything smaller is not worth waking up another thread for */
+#define MIN_SLICE_ROWS 64
+
+enum conversion_type {
+	CONVERT_UYVX_TO_I420,
+	CONVERT_UYVX_TO_NV12,
+	CONVERT_UYVX_TO_I444,
+	CONVERT_NV12_TO_UYVX,
+	CONVERT_420_TO_UYVX,
+	CONVERT_422_TO_UYVX,
+};
+
+struct conversion_job {
+	enum conversion_type type;
+	const struct format_conversion_kernels *kernels;
+
+	const uint8_t *input;
+	const uint8_t *const *inputs;
+	uint32_t in_linesize;
+	const uint32_t *in_linesizes;
+
+	uint8_t *output;
+	uint8_t **outputs;
+	uint32_t out_linesize;
+	const uint32_t *out_linesizes;
+
+	bool leading_lum;
+};
+
+/* held while a conversion is using the threads, and while they are started
+ * or stopped */
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+	pthread_mutex_t mutex;
+	os_sem_t *sem;
+	os_event_t *done;
+	DARRAY(pthread_t) threads;
+	uint32_t max_threads;
+	bool started;
+	bool disabled;
+	volatile bool stop;
+
+	/* current job, protected by mutex */
+	const struct conversion_job *job;
+	uint32_t end_y;
+	uint32_t next_y;
+	uint32_t slice_rows;
+	uint32_t slices_left;
+} pool = {0};
+
+static void convert_rows(const struct conversion_job *job, uint32_t start_y,
+			 uint32_t end_y)
+{
+	const struct format_conversion_kernels *k = job->kernels;
+
+	switch (job->type) {
+	case CONVERT_UYVX_TO_I420:
+		k->compress_uyvx_to_i420(job->input, job->in_linesize, start_y,
+					 end_y, job->outputs,
+					 job->out_linesizes);
+		break;
+	case CONVERT_UYVX_TO_NV12:
+		k->compress_uyvx_to_nv12(job->input, job->in_linesize, start_y,
+					 end_y, job->outputs,
+					 job->out_linesizes);
+		break;
+	case CONVERT_UYVX_TO_I444:
+		k->convert_uyvx_to_i444(job->input, job->in_linesize, start_y,
+					end_y, job->outputs,
+					job->out_linesizes);
+		break;
+	case CONVERT_NV12_TO_UYVX:
+		k->decompress_nv12(job->inputs, job->in_linesizes, start_y,
+				   end_y, job->output, job->out_linesize);
+		break;
+	case CONVERT_420_TO_UYVX:
+		k->decompress_420(job->inputs, job->in_linesizes, start_y,
+				  end_y, job->output, job->out_linesize);
+		break;
+	case CONVERT_422_TO_UYVX:
+		k->decompress_422(job->input, job->in_linesize, start_y, end_y,
+				  job->output, job->out_linesize,
+				  job->leading_lum);
+		break;
+	}
+}
+
+static void convert_slices(void)
+{
+	pthread_mutex_lock(&pool.mutex);
+
+	while (pool.next_y < pool.end_y) {
+		const struct conversion_job *job = pool.job;
+		uint32_t start_y = pool.next_y;
+		uint32_t end_y = min_uint32(start_y + pool.slice_rows,
+					    pool.end_y);
+
+		pool.next_y = end_y;
+		pthread_mutex_unlock(&pool.mutex);
+
+		convert_rows(job, start_y, end_y);
+
+		pthread_mutex_lock(&pool.mutex);
+		if (--pool.slices_left == 0)
+			os_event_signal(pool.done);
+	}
+
+	pthread_mutex_unlock(&pool.mutex);
+}
+
+static void *slice_thread(void *unused)
+{
+	os_set_thread_name("format-conversion: slice thread");
+
+	for (;;) {
+		if (os_sem_wait(pool.sem) != 0)
+			break;
+		if (os_atomic_load_bool(&pool.stop))
+			break;
+
+		convert_slices();
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static uint32_t get_thread_count(void)
+{
+	int cores;
+
+	if (pool.max_threads)
+		return pool.max_threads;
+
+	cores = os_get_logical_cores();
+	return cores > 0 ? min_uint32((uint32_t)cores, MAX_THREADS) : 1;
+}
+
+static void stop_threads(void)
+{
+	if (!pool.started)
+		return;
+
+	os_atomic_set_bool(&pool.stop, true);
+	for (size_t i = 0; i < pool.threads.num; i++)
+		os_sem_post(pool.sem);
+	for (size_t i = 0; i < pool.threads.num; i++)
+		pthread_join(pool.threads.array[i], NULL);
+
+	da_free(pool.threads);
+	os_event_destroy(pool.done);
+	os_sem_destroy(pool.sem);
+	pthread_mutex_destroy(&pool.mutex);
+
+	pool.done = NULL;
+	pool.sem = NULL;
+	pool.started = false;
+	os_atomic_set_bool(&pool.stop, false);
+}
+
+static bool start_threads(void)
+{
+	uint32_t count = get_thread_count();
+
+	/* the calling thread does its share of the work */
+	if (count <= 1)
+		goto fail;
+
+	pthread_mutex_init_value(&pool.mutex);
+	if (pthread_mutex_init(&pool.mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&pool.sem, 0) != 0) {
+		pthread_mutex_destroy(&pool.mutex);
+		goto fail;
+	}
+	if (os_event_init(&pool.done, OS_EVENT_TYPE_AUTO) != 0) {
+		os_sem_destroy(pool.sem);
+		pthread_mutex_destroy(&pool.mutex);
+		goto fail;
+	}
+
+	pool.started = true;
+
+	for (uint32_t i = 1; i < count; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, slice_thread, NULL) != 0) {
+			blog(LOG_WARNING, "format-conversion: Failed to "
+					  "create slice thread");
+			break;
 		}
+
+		da_push_back(pool.threads, &thread);
+	}
+
+	if (!pool.threads.num) {
+		stop_threads();
+		goto fail;
 	}
+
+	blog(LOG_INFO, "format-conversion: Using %u slice threads",
+	     (unsigned int)pool.threads.num + 1);
+	return true;
+
+fail:
+	pool.disabled = true;
+	return false;
+}
+
+static void convert(const struct conversion_job *job, uint32_t start_y,
+		    uint32_t end_y)
+{
+	uint32_t rows = end_y > start_y ? end_y - start_y : 0;
+	uint32_t slices;
+	uint32_t slice_rows;
+
+	if (rows < MIN_SLICE_ROWS * 2)
+		goto single_thread;
+	if (pthread_mutex_trylock(&job_mutex) != 0)
+		goto single_thread;
+
+	if (!pool.started && (pool.disabled || !start_threads())) {
+		pthread_mutex_unlock(&job_mutex);
+		goto single_thread;
+	}
+
+	slices = min_uint32((uint32_t)pool.threads.num + 1,
+			    rows / MIN_SLICE_ROWS);
+
+	/* the conversions work on pairs of lines */
+	slice_rows = (rows + slices - 1) / slices;
+	slice_rows = (slice_rows + 1) & ~1;
+	slices = (rows + slice_rows - 1) / slice_rows;
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.job = job;
+	pool.next_y = start_y;
+	pool.end_y = end_y;
+	pool.slice_rows = slice_rows;
+	pool.slices_left = slices;
+	pthread_mutex_unlock(&pool.mutex);
+
+	for (uint32_t i = 1; i < slices; i++)
+		os_sem_post(pool.sem);
+
+	convert_slices();
+	os_event_wait(pool.done);
+
+	pthread_mutex_unlock(&job_mutex);
+	return;
+
+single_thread:
+	convert_rows(job, start_y, end_y);
+}
+
+void format_conversion_set_threads(uint32_t threads)
+{
+	threads = min_uint32(threads, MAX_THREADS);
+
+	pthread_mutex_lock(&job_mutex);
+	if (threads != pool.max_threads) {
+		stop_threads();
+		pool.max_threads = threads;
+		pool.disabled = false;
+	}
+	pthread_mutex_unlock(&job_mutex);
+}
+
+uint32_t format_conversion_get_threads(void)
+{
+	uint32_t threads;
+
+	pthread_mutex_lock(&job_mutex);
+	threads = get_thread_count();
+	pthread_mutex_unlock(&job_mutex);
+
+	return threads;
+}
+
+void format_conversion_free(void)
+{
+	pthread_mutex_lock(&job_mutex);
+	stop_threads();
+	pool.disabled = false;
+	pthread_mutex_unlock(&job_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	struct conversion_job job = {
+		.type = CONVERT_UYVX_TO_I420,
+		.kernels = get_kernels(),
+		.input = input,
+		.in_linesize = in_linesize,
+		.outputs = output,
+		.out_linesizes = out_linesize,
+	};
+
+	convert(&job, start_y, end_y);
+}
+
+void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+	struct conversion_job job = {
+		.type = CONVERT_UYVX_TO_NV12,
+		.kernels = get_kernels(),
+		.input = input,
+		.in_linesize = in_linesize,
+		.outputs = output,
+		.out_linesizes = out_linesize,
+	};
+
+	convert(&job, start_y, end_y);
+}
+
+void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
+			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+	struct conversion_job job = {
+		.type = CONVERT_UYVX_TO_I444,
+		.kernels = get_kernels(),
+		.input = input,
+		.in_linesize = in_linesize,
+		.outputs = output,
+		.out_linesizes = out_linesize,
+	};
+
+	convert(&job, start_y, end_y);
+}
+
+void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
+		     uint32_t start_y, uint32_t end_y, uint8_t *output,
+		     uint32_t out_linesize)
+{
+	struct conversion_job job = {
+		.type = CONVERT_NV12_TO_UYVX,
+		.kernels = get_kernels(),
+		.inputs = input,
+		.in_linesizes = in_linesize,
+		.output = output,
+		.out_linesize = out_linesize,
+	};
+
+	convert(&job, start_y, end_y);
+}
+
+void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize)
+{
+	struct conversion_job job = {
+		.type = CONVERT_420_TO_UYVX,
+		.kernels = get_kernels(),
+		.inputs = input,
+		.in_linesizes = in_linesize,
+		.output = output,
+		.out_linesize = out_linesize,
+	};
+
+	convert(&job, start_y, end_y);
+}
+
+void decompress_422(const uint8_t *input, uint32_t in_linesize,
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize, bool leading_lum)
+{
+	struct conversion_job job = {
+		.type = CONVERT_422_TO_UYVX,
+		.kernels = get_kernels(),
+		.input = input,
+		.in_linesize = in_linesize,
+		.output = output,
+		.out_linesize = out_linesize,
+		.leading_lum = leading_lum,
+	};
+
+	convert(&job, start_y, end_y);
 }
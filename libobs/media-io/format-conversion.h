@@ -25,6 +25,9 @@ extern "C" {
 
 /*
  * Functions for converting to and from packed 444 YUV
+ *
+ *   Large conversions are split in to row slices and spread over a few
+ * threads, the functions return once the whole range has been converted.
  */
 
 EXPORT void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
@@ -56,6 +59,38 @@ EXPORT void decompress_422(const uint8_t *input, uint32_t in_linesize,
 			   uint32_t start_y, uint32_t end_y, uint8_t *output,
 			   uint32_t out_linesize, bool leading_lum);
 
+enum format_conversion_simd {
+	FORMAT_CONVERSION_SIMD_AUTO,
+	FORMAT_CONVERSION_SIMD_NONE,
+	FORMAT_CONVERSION_SIMD_SSE2,
+	FORMAT_CONVERSION_SIMD_AVX2,
+};
+
+EXPORT bool format_conversion_simd_supported(enum format_conversion_simd simd);
+
+/**
+ * Forces the conversions to use a specific instruction set, mostly useful for
+ * testing.  Returns false if the CPU does not support it.
+ */
+EXPORT bool format_conversion_set_simd(enum format_conversion_simd simd);
+
+/** Returns the instruction set that is currently being used */
+EXPORT enum format_conversion_simd format_conversion_get_simd(void);
+
+EXPORT const char *
+format_conversion_simd_name(enum format_conversion_simd simd);
+
+/**
+ * Sets the maximum number of threads a conversion is split across, the
+ * calling thread included.  0 picks a count based on the number of logical
+ * cores, 1 disables threading.
+ */
+EXPORT void format_conversion_set_threads(uint32_t threads);
+EXPORT uint32_t format_conversion_get_threads(void);
+
+/** Stops the conversion threads, they are restarted when needed */
+EXPORT void format_conversion_free(void);
+
 #ifdef __cplusplus
 }
 #endif
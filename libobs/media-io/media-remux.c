@@ -19,10 +19,16 @@
 
 #include "../util/base.h"
 #include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/dstr.h"
+#include "../util/job-pool.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #include <libavformat/avformat.h>
+#include <libavutil/opt.h>
 
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -32,11 +38,299 @@
 #define CODEC_FLAG_GLOBAL_H CODEC_FLAG_GLOBAL_HEADER
 #endif
 
+#define DEFAULT_READ_AHEAD (32 * 1024 * 1024)
+#define MIN_READ_AHEAD (1024 * 1024)
+#define READ_AHEAD_BLOCKS 4
+#define READ_BUFFER_SIZE (256 * 1024)
+#define WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+
+/* more than the mov muxer writes per sample even if every sample ends up
+ * in its own chunk (stsz, stts, ctts, stss, stsc and co64) */
+#define MOOV_BYTES_PER_SAMPLE 48
+#define MOOV_BYTES_PER_STREAM (16 * 1024)
+#define MOOV_BYTES_BASE (64 * 1024)
+
+#define QUEUE_REPORT_INTERVAL_NS 100000000ULL
+
+struct read_block {
+	uint8_t *data;
+	int64_t pos;
+	size_t size;
+};
+
+/* reads the input on a separate thread, a few blocks ahead of the demuxer */
+struct remux_reader {
+	FILE *file;
+	int64_t size;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+
+	struct read_block blocks[READ_AHEAD_BLOCKS];
+	size_t block_size;
+	size_t head;
+	size_t filled;
+
+	/* only used by the demuxer */
+	size_t offset;
+	int64_t pos;
+
+	/* where the thread reads next, any block in flight is dropped when
+	 * the generation changes */
+	int64_t read_pos;
+	uint64_t generation;
+	bool eof;
+	bool error;
+	bool stop;
+};
+
 struct media_remux_job {
 	int64_t in_size;
 	AVFormatContext *ifmt_ctx, *ofmt_ctx;
+
+	struct media_remux_options options;
+	struct remux_reader *reader;
+	AVIOContext *in_pb;
+	FILE *out_file;
+	AVIOContext *out_pb;
+
+	/* space reserved for the moov atom in front of the media data, and
+	 * the most it could take up with the packets written so far */
+	int64_t moov_size;
+	int64_t moov_bound;
+	bool moov_overflow;
 };
 
+/* ------------------------------------------------------------------------- */
+
+static void *reader_thread(void *data)
+{
+	struct remux_reader *r = data;
+	int64_t file_pos = 0;
+
+	os_set_thread_name("media_remux: read-ahead");
+
+	pthread_mutex_lock(&r->mutex);
+
+	for (;;) {
+		struct read_block *block;
+		uint64_t generation;
+		int64_t pos;
+		size_t size = 0;
+		bool failed = false;
+
+		while (!r->stop && (r->filled == READ_AHEAD_BLOCKS || r->eof ||
+				    r->error))
+			pthread_cond_wait(&r->cond, &r->mutex);
+		if (r->stop)
+			break;
+
+		block = &r->blocks[(r->head + r->filled) % READ_AHEAD_BLOCKS];
+		generation = r->generation;
+		pos = r->read_pos;
+		pthread_mutex_unlock(&r->mutex);
+
+		/* blocks past the filled ones are only touched here */
+		if (pos != file_pos)
+			failed = os_fseeki64(r->file, pos, SEEK_SET) != 0;
+
+		if (!failed) {
+			clearerr(r->file);
+			size = fread(block->data, 1, r->block_size, r->file);
+			failed = !size && ferror(r->file);
+			file_pos = pos + (int64_t)size;
+		} else {
+			file_pos = -1;
+		}
+
+		pthread_mutex_lock(&r->mutex);
+
+		if (generation != r->generation)
+			continue;
+
+		if (size) {
+			block->pos = pos;
+			block->size = size;
+			r->read_pos += (int64_t)size;
+			r->filled++;
+		} else if (failed) {
+			r->error = true;
+		} else {
+			r->eof = true;
+		}
+
+		pthread_cond_broadcast(&r->cond);
+	}
+
+	pthread_mutex_unlock(&r->mutex);
+	return NULL;
+}
+
+static int reader_read(void *opaque, uint8_t *buf, int buf_size)
+{
+	struct remux_reader *r = opaque;
+	struct read_block *block;
+	size_t size;
+
+	pthread_mutex_lock(&r->mutex);
+
+	while (!r->filled && !r->eof && !r->error)
+		pthread_cond_wait(&r->cond, &r->mutex);
+
+	if (!r->filled) {
+		int ret = r->error ? AVERROR(EIO) : AVERROR_EOF;
+		pthread_mutex_unlock(&r->mutex);
+		return ret;
+	}
+
+	block = &r->blocks[r->head];
+	pthread_mutex_unlock(&r->mutex);
+
+	/* a filled block doesn't change until it is handed back */
+	size = block->size - r->offset;
+	if (size > (size_t)buf_size)
+		size = (size_t)buf_size;
+
+	memcpy(buf, block->data + r->offset, size);
+	r->offset += size;
+	r->pos += (int64_t)size;
+
+	if (r->offset == block->size) {
+		pthread_mutex_lock(&r->mutex);
+		r->head = (r->head + 1) % READ_AHEAD_BLOCKS;
+		r->filled--;
+		r->offset = 0;
+		pthread_cond_broadcast(&r->cond);
+		pthread_mutex_unlock(&r->mutex);
+	}
+
+	return (int)size;
+}
+
+static int64_t reader_seek(void *opaque, int64_t offset, int whence)
+{
+	struct remux_reader *r = opaque;
+	bool buffered = false;
+	int64_t pos;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return r->size;
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = r->pos + offset;
+		break;
+	case SEEK_END:
+		pos = r->size + offset;
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+
+	if (pos < 0)
+		return AVERROR(EINVAL);
+
+	pthread_mutex_lock(&r->mutex);
+
+	/* seeking forward within what was already read drops blocks, anything
+	 * else starts reading again from the new position */
+	while (r->filled) {
+		struct read_block *block = &r->blocks[r->head];
+
+		if (pos < block->pos)
+			break;
+		if (pos < block->pos + (int64_t)block->size) {
+			r->offset = (size_t)(pos - block->pos);
+			buffered = true;
+			break;
+		}
+
+		r->head = (r->head + 1) % READ_AHEAD_BLOCKS;
+		r->filled--;
+		r->offset = 0;
+	}
+
+	if (!buffered && (r->filled || pos != r->read_pos)) {
+		r->generation++;
+		r->filled = 0;
+		r->offset = 0;
+		r->read_pos = pos;
+		r->eof = false;
+		r->error = false;
+	}
+
+	r->pos = pos;
+
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->mutex);
+	return pos;
+}
+
+static void reader_destroy(struct remux_reader *r)
+{
+	if (!r)
+		return;
+
+	pthread_mutex_lock(&r->mutex);
+	r->stop = true;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->mutex);
+
+	pthread_join(r->thread, NULL);
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->mutex);
+
+	for (size_t i = 0; i < READ_AHEAD_BLOCKS; i++)
+		bfree(r->blocks[i].data);
+
+	fclose(r->file);
+	bfree(r);
+}
+
+static struct remux_reader *reader_create(const char *filename,
+					  size_t read_ahead)
+{
+	struct remux_reader *r = bzalloc(sizeof(struct remux_reader));
+
+	r->file = os_fopen(filename, "rb");
+	if (!r->file)
+		goto fail_file;
+
+	/* blocks are read with a single fread each */
+	setvbuf(r->file, NULL, _IONBF, 0);
+
+	r->size = os_fgetsize(r->file);
+	r->block_size = read_ahead / READ_AHEAD_BLOCKS;
+	for (size_t i = 0; i < READ_AHEAD_BLOCKS; i++)
+		r->blocks[i].data = bmalloc(r->block_size);
+
+	if (pthread_mutex_init(&r->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_cond_init(&r->cond, NULL) != 0)
+		goto fail_cond;
+	if (pthread_create(&r->thread, NULL, reader_thread, r) != 0)
+		goto fail_thread;
+
+	return r;
+
+fail_thread:
+	pthread_cond_destroy(&r->cond);
+fail_cond:
+	pthread_mutex_destroy(&r->mutex);
+fail_mutex:
+	for (size_t i = 0; i < READ_AHEAD_BLOCKS; i++)
+		bfree(r->blocks[i].data);
+	fclose(r->file);
+fail_file:
+	bfree(r);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void init_size(media_remux_job_t job, const char *in_filename)
 {
 #ifdef _MSC_VER
@@ -49,9 +343,53 @@ static inline void init_size(media_remux_job_t job, const char *in_filename)
 	job->in_size = st.st_size;
 }
 
+static bool init_read_ahead(media_remux_job_t job, const char *in_filename)
+{
+	const char *ext = os_get_path_extension(in_filename);
+	size_t read_ahead = job->options.read_ahead;
+	uint8_t *buf;
+
+	/* playlists open their segments through their own I/O */
+	if (ext && astrcmpi(ext, ".m3u8") == 0)
+		return false;
+
+	if (!read_ahead)
+		read_ahead = DEFAULT_READ_AHEAD;
+	else if (read_ahead < MIN_READ_AHEAD)
+		read_ahead = MIN_READ_AHEAD;
+
+	job->reader = reader_create(in_filename, read_ahead);
+	if (!job->reader)
+		return false;
+
+	buf = av_malloc(READ_BUFFER_SIZE);
+	if (!buf)
+		return false;
+
+	job->in_pb = avio_alloc_context(buf, READ_BUFFER_SIZE, 0, job->reader,
+					reader_read, NULL, reader_seek);
+	if (!job->in_pb) {
+		av_free(buf);
+		return false;
+	}
+
+	job->ifmt_ctx = avformat_alloc_context();
+	if (!job->ifmt_ctx)
+		return false;
+
+	job->ifmt_ctx->pb = job->in_pb;
+	return true;
+}
+
 static inline bool init_input(media_remux_job_t job, const char *in_filename)
 {
-	int ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
+	int ret;
+
+	if (!init_read_ahead(job, in_filename))
+		blog(LOG_DEBUG, "media_remux: Reading '%s' without read-ahead",
+		     in_filename);
+
+	ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
 		     in_filename);
@@ -71,6 +409,54 @@ static inline bool init_input(media_remux_job_t job, const char *in_filename)
 	return true;
 }
 
+static int write_output(void *opaque, uint8_t *buf, int buf_size)
+{
+	FILE *file = opaque;
+	size_t size = (size_t)buf_size;
+
+	return fwrite(buf, 1, size, file) == size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t seek_output(void *opaque, int64_t offset, int whence)
+{
+	FILE *file = opaque;
+
+	if (whence == AVSEEK_SIZE)
+		return -1;
+
+	if (os_fseeki64(file, offset, whence & ~AVSEEK_FORCE) != 0)
+		return AVERROR(EIO);
+
+	return os_ftelli64(file);
+}
+
+static bool open_output_file(media_remux_job_t job, const char *out_filename)
+{
+	uint8_t *buf;
+
+	job->out_file = os_fopen(out_filename, "wb");
+	if (!job->out_file)
+		return false;
+
+	/* the I/O buffer is written with a single fwrite when it fills up */
+	setvbuf(job->out_file, NULL, _IONBF, 0);
+
+	buf = av_malloc(WRITE_BUFFER_SIZE);
+	if (!buf)
+		return false;
+
+	job->out_pb = avio_alloc_context(buf, WRITE_BUFFER_SIZE, 1,
+					 job->out_file, NULL, write_output,
+					 seek_output);
+	if (!job->out_pb) {
+		av_free(buf);
+		return false;
+	}
+
+	job->ofmt_ctx->pb = job->out_pb;
+	return true;
+}
+
 static inline bool init_output(media_remux_job_t job, const char *out_filename)
 {
 	int ret;
@@ -126,9 +512,7 @@ static inline bool init_output(media_remux_job_t job, const char *out_filename)
 #endif
 
 	if (!(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-		ret = avio_open(&job->ofmt_ctx->pb, out_filename,
-				AVIO_FLAG_WRITE);
-		if (ret < 0) {
+		if (!open_output_file(job, out_filename)) {
 			blog(LOG_ERROR,
 			     "media_remux: Failed to open output"
 			     " file '%s'",
@@ -142,6 +526,14 @@ static inline bool init_output(media_remux_job_t job, const char *out_filename)
 
 bool media_remux_job_create(media_remux_job_t *job, const char *in_filename,
 			    const char *out_filename)
+{
+	return media_remux_job_create_with_options(job, in_filename,
+						   out_filename, NULL);
+}
+
+bool media_remux_job_create_with_options(
+	media_remux_job_t *job, const char *in_filename,
+	const char *out_filename, const struct media_remux_options *options)
 {
 	if (!job)
 		return false;
@@ -157,6 +549,9 @@ bool media_remux_job_create(media_remux_job_t *job, const char *in_filename,
 	if (!*job)
 		return false;
 
+	if (options)
+		(*job)->options = *options;
+
 	init_size(*job, in_filename);
 
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
@@ -176,6 +571,86 @@ fail:
 	return false;
 }
 
+/* ------------------------------------------------------------------------- */
+
+/* rough packet count from the duration, with some room for variable frame
+ * rates, or -1 if there's no telling */
+static int64_t estimate_packets(AVFormatContext *ifmt_ctx, AVStream *stream)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+	const AVCodecParameters *par = stream->codecpar;
+#else
+	const AVCodecContext *par = stream->codec;
+#endif
+	double duration = 0.0;
+	double rate = 0.0;
+
+	if (stream->duration > 0)
+		duration = stream->duration * av_q2d(stream->time_base);
+	else if (ifmt_ctx->duration > 0)
+		duration = (double)ifmt_ctx->duration / AV_TIME_BASE;
+
+	if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+		rate = av_q2d(stream->avg_frame_rate);
+		if (av_q2d(stream->r_frame_rate) > rate)
+			rate = av_q2d(stream->r_frame_rate);
+	} else if (par->codec_type == AVMEDIA_TYPE_AUDIO &&
+		   par->frame_size > 0) {
+		rate = (double)par->sample_rate / par->frame_size;
+	}
+
+	if (duration <= 0.0 || rate <= 0.0)
+		return -1;
+
+	return (int64_t)((duration * 1.1 + 1.0) * rate);
+}
+
+/*
+ * The mov muxer can put the moov atom first by moving all of the media data
+ * once it is done, which reads and writes the whole file a second time.
+ * Reserving enough space for it up front avoids that, so that is done
+ * whenever the size can be estimated from the input.
+ */
+static void init_faststart(media_remux_job_t job, AVDictionary **opts)
+{
+	AVFormatContext *ifmt_ctx = job->ifmt_ctx;
+	int64_t bound = MOOV_BYTES_BASE;
+	int64_t moov_size = MOOV_BYTES_BASE;
+
+	if (!job->options.faststart || !job->ofmt_ctx->priv_data ||
+	    !av_opt_find(job->ofmt_ctx->priv_data, "moov_size", NULL, 0, 0))
+		return;
+
+	for (unsigned i = 0; i < ifmt_ctx->nb_streams; i++) {
+		AVStream *stream = ifmt_ctx->streams[i];
+		int64_t packets = estimate_packets(ifmt_ctx, stream);
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+		int extradata_size = stream->codecpar->extradata_size;
+#else
+		int extradata_size = stream->codec->extradata_size;
+#endif
+
+		if (packets < 0) {
+			moov_size = -1;
+			break;
+		}
+
+		bound += MOOV_BYTES_PER_STREAM + extradata_size;
+		moov_size += MOOV_BYTES_PER_STREAM + extradata_size +
+			     packets * MOOV_BYTES_PER_SAMPLE;
+	}
+
+	if (moov_size > 0 && moov_size <= INT_MAX) {
+		job->moov_size = moov_size;
+		job->moov_bound = bound;
+		av_dict_set_int(opts, "moov_size", moov_size, 0);
+	} else {
+		blog(LOG_INFO, "media_remux: Unknown number of packets, "
+			       "moving the moov atom in a second pass");
+		av_dict_set(opts, "movflags", "+faststart", 0);
+	}
+}
+
 static inline void process_packet(AVPacket *pkt, AVStream *in_stream,
 				  AVStream *out_stream)
 {
@@ -232,6 +707,19 @@ static inline int process_packets(media_remux_job_t job,
 
 			break;
 		}
+
+		/* writing the trailer now would overwrite the media data */
+		if (job->moov_size) {
+			job->moov_bound += MOOV_BYTES_PER_SAMPLE;
+			if (job->moov_bound > job->moov_size) {
+				blog(LOG_ERROR, "media_remux: More packets "
+						"than expected, not enough "
+						"space for the moov atom");
+				job->moov_overflow = true;
+				ret = AVERROR(ENOSPC);
+				break;
+			}
+		}
 	}
 
 	return ret;
@@ -240,13 +728,17 @@ static inline int process_packets(media_remux_job_t job,
 bool media_remux_job_process(media_remux_job_t job,
 			     media_remux_progress_callback callback, void *data)
 {
+	AVDictionary *opts = NULL;
 	int ret;
 	bool success = false;
 
 	if (!job)
 		return success;
 
-	ret = avformat_write_header(job->ofmt_ctx, NULL);
+	init_faststart(job, &opts);
+
+	ret = avformat_write_header(job->ofmt_ctx, &opts);
+	av_dict_free(&opts);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Error opening output file: %s",
 		     av_err2str(ret));
@@ -259,11 +751,13 @@ bool media_remux_job_process(media_remux_job_t job,
 	ret = process_packets(job, callback, data);
 	success = ret >= 0 || ret == AVERROR_EOF;
 
-	ret = av_write_trailer(job->ofmt_ctx);
-	if (ret < 0) {
-		blog(LOG_ERROR, "media_remux: av_write_trailer: %s",
-		     av_err2str(ret));
-		success = false;
+	if (!job->moov_overflow) {
+		ret = av_write_trailer(job->ofmt_ctx);
+		if (ret < 0) {
+			blog(LOG_ERROR, "media_remux: av_write_trailer: %s",
+			     av_err2str(ret));
+			success = false;
+		}
 	}
 
 	if (callback != NULL)
@@ -279,10 +773,242 @@ void media_remux_job_destroy(media_remux_job_t job)
 
 	avformat_close_input(&job->ifmt_ctx);
 
-	if (job->ofmt_ctx && !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE))
-		avio_close(job->ofmt_ctx->pb);
+	if (job->in_pb) {
+		av_freep(&job->in_pb->buffer);
+		avio_context_free(&job->in_pb);
+	}
+
+	reader_destroy(job->reader);
 
-	avformat_free_context(job->ofmt_ctx);
+	if (job->ofmt_ctx) {
+		job->ofmt_ctx->pb = NULL;
+		avformat_free_context(job->ofmt_ctx);
+	}
+
+	if (job->out_pb) {
+		avio_flush(job->out_pb);
+		av_freep(&job->out_pb->buffer);
+		avio_context_free(&job->out_pb);
+	}
+
+	if (job->out_file)
+		fclose(job->out_file);
 
 	bfree(job);
 }
+
+/* ------------------------------------------------------------------------- */
+
+struct remux_queue_entry {
+	char *in_filename;
+	char *out_filename;
+
+	uint64_t size;
+	uint64_t bytes_done;
+};
+
+struct media_remux_queue {
+	size_t jobs;
+	struct media_remux_options options;
+	DARRAY(struct remux_queue_entry) entries;
+
+	/* while processing */
+	const struct media_remux_queue_callbacks *callbacks;
+	pthread_mutex_t mutex;
+	struct media_remux_queue_progress progress;
+	uint64_t start_time;
+	uint64_t last_report;
+	volatile bool stop;
+	volatile long failed;
+};
+
+struct remux_queue_job {
+	struct media_remux_queue *queue;
+	struct remux_queue_entry *entry;
+};
+
+media_remux_queue_t
+media_remux_queue_create(size_t jobs,
+			 const struct media_remux_options *options)
+{
+	struct media_remux_queue *queue =
+		bzalloc(sizeof(struct media_remux_queue));
+
+	if (pthread_mutex_init(&queue->mutex, NULL) != 0) {
+		bfree(queue);
+		return NULL;
+	}
+
+	queue->jobs = jobs ? jobs : 1;
+	if (options)
+		queue->options = *options;
+
+	return queue;
+}
+
+void media_remux_queue_destroy(media_remux_queue_t queue)
+{
+	if (!queue)
+		return;
+
+	for (size_t i = 0; i < queue->entries.num; i++) {
+		bfree(queue->entries.array[i].in_filename);
+		bfree(queue->entries.array[i].out_filename);
+	}
+
+	da_free(queue->entries);
+	pthread_mutex_destroy(&queue->mutex);
+	bfree(queue);
+}
+
+size_t media_remux_queue_add(media_remux_queue_t queue,
+			     const char *in_filename, const char *out_filename)
+{
+	struct remux_queue_entry *entry;
+
+	if (!queue)
+		return 0;
+
+	entry = da_push_back_new(queue->entries);
+	entry->in_filename = bstrdup(in_filename);
+	entry->out_filename = bstrdup(out_filename);
+	return queue->entries.num - 1;
+}
+
+/* called with the mutex locked */
+static void queue_report(struct media_remux_queue *queue, bool force)
+{
+	const struct media_remux_queue_callbacks *cb = queue->callbacks;
+	uint64_t now = os_gettime_ns();
+	double elapsed;
+
+	if (!cb->progress)
+		return;
+	if (!force && now - queue->last_report < QUEUE_REPORT_INTERVAL_NS)
+		return;
+
+	elapsed = (double)(now - queue->start_time) / 1000000000.0;
+	queue->progress.bytes_per_sec =
+		elapsed > 0.0 ? (double)queue->progress.bytes_done / elapsed
+			      : 0.0;
+	queue->last_report = now;
+
+	if (!cb->progress(cb->data, &queue->progress))
+		os_atomic_set_bool(&queue->stop, true);
+}
+
+static void queue_add_bytes(struct media_remux_queue *queue,
+			    struct remux_queue_entry *entry, uint64_t bytes)
+{
+	if (bytes > entry->size)
+		bytes = entry->size;
+
+	/* packet positions can go back a little */
+	if (bytes > entry->bytes_done) {
+		queue->progress.bytes_done += bytes - entry->bytes_done;
+		entry->bytes_done = bytes;
+	}
+}
+
+static bool queue_job_progress(void *data, float percent)
+{
+	struct remux_queue_job *job = data;
+	struct media_remux_queue *queue = job->queue;
+	uint64_t bytes = 0;
+
+	if (percent > 0.0f)
+		bytes = (uint64_t)((double)job->entry->size * percent / 100.0);
+
+	pthread_mutex_lock(&queue->mutex);
+	queue_add_bytes(queue, job->entry, bytes);
+	queue_report(queue, false);
+	pthread_mutex_unlock(&queue->mutex);
+
+	return !os_atomic_load_bool(&queue->stop);
+}
+
+static void queue_run_job(void *param, size_t idx)
+{
+	struct media_remux_queue *queue = param;
+	const struct media_remux_queue_callbacks *cb = queue->callbacks;
+	struct remux_queue_job job_data = {queue, &queue->entries.array[idx]};
+	struct remux_queue_entry *entry = job_data.entry;
+	media_remux_job_t job;
+	bool success = false;
+
+	if (os_atomic_load_bool(&queue->stop)) {
+		os_atomic_inc_long(&queue->failed);
+		return;
+	}
+
+	if (cb->job_started)
+		cb->job_started(cb->data, idx);
+
+	if (media_remux_job_create_with_options(&job, entry->in_filename,
+						entry->out_filename,
+						&queue->options)) {
+		success = media_remux_job_process(job, queue_job_progress,
+						  &job_data);
+		media_remux_job_destroy(job);
+	}
+
+	if (os_atomic_load_bool(&queue->stop))
+		success = false;
+	if (!success)
+		os_atomic_inc_long(&queue->failed);
+
+	pthread_mutex_lock(&queue->mutex);
+	queue_add_bytes(queue, entry, entry->size);
+	queue->progress.jobs_finished++;
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (cb->job_finished)
+		cb->job_finished(cb->data, idx, success);
+
+	pthread_mutex_lock(&queue->mutex);
+	queue_report(queue, true);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+bool media_remux_queue_process(
+	media_remux_queue_t queue,
+	const struct media_remux_queue_callbacks *callbacks)
+{
+	static const struct media_remux_queue_callbacks no_callbacks = {0};
+	os_job_pool_t *pool = NULL;
+	size_t jobs;
+
+	if (!queue)
+		return false;
+
+	queue->callbacks = callbacks ? callbacks : &no_callbacks;
+	queue->stop = false;
+	queue->failed = 0;
+
+	memset(&queue->progress, 0, sizeof(queue->progress));
+	queue->progress.jobs = queue->entries.num;
+
+	for (size_t i = 0; i < queue->entries.num; i++) {
+		struct remux_queue_entry *entry = &queue->entries.array[i];
+		int64_t size = os_get_file_size(entry->in_filename);
+
+		entry->size = size > 0 ? (uint64_t)size : 0;
+		entry->bytes_done = 0;
+		queue->progress.bytes += entry->size;
+	}
+
+	queue->start_time = os_gettime_ns();
+	queue->last_report = queue->start_time;
+
+	/* the calling thread runs jobs as well */
+	jobs = queue->jobs < queue->entries.num ? queue->jobs
+						: queue->entries.num;
+	if (jobs > 1)
+		pool = os_job_pool_create("media_remux: queue", jobs - 1);
+
+	os_job_pool_run(pool, queue_run_job, queue, queue->entries.num);
+	os_job_pool_destroy(pool);
+
+	queue->callbacks = NULL;
+	return queue->failed == 0;
+}
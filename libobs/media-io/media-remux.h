@@ -24,6 +24,15 @@ typedef struct media_remux_job *media_remux_job_t;
 
 typedef bool(media_remux_progress_callback)(void *data, float percent);
 
+struct media_remux_options {
+	/* bytes of the input read ahead on a separate thread, 0 for the
+	 * default */
+	size_t read_ahead;
+
+	/* write the index of mp4/mov files before the media data */
+	bool faststart;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,11 +40,70 @@ extern "C" {
 EXPORT bool media_remux_job_create(media_remux_job_t *job,
 				   const char *in_filename,
 				   const char *out_filename);
+EXPORT bool
+media_remux_job_create_with_options(media_remux_job_t *job,
+				    const char *in_filename,
+				    const char *out_filename,
+				    const struct media_remux_options *options);
 EXPORT bool media_remux_job_process(media_remux_job_t job,
 				    media_remux_progress_callback callback,
 				    void *data);
 EXPORT void media_remux_job_destroy(media_remux_job_t job);
 
+/* ------------------------------------------------------------------------- */
+/* Remux queue
+ *
+ *   Runs a list of remux jobs, several of them at the same time.  Remuxing is
+ * mostly waiting for the disk, so a few jobs at once keep it busier than one
+ * job after another.
+ */
+
+struct media_remux_queue;
+typedef struct media_remux_queue *media_remux_queue_t;
+
+struct media_remux_queue_progress {
+	size_t jobs;
+	size_t jobs_finished;
+
+	/* input bytes of all jobs */
+	uint64_t bytes;
+	uint64_t bytes_done;
+	double bytes_per_sec;
+};
+
+struct media_remux_queue_callbacks {
+	void *data;
+
+	/* called from the thread that runs the job */
+	void (*job_started)(void *data, size_t idx);
+	void (*job_finished)(void *data, size_t idx, bool success);
+
+	/* called a few times per second, return false to stop all jobs */
+	bool (*progress)(void *data,
+			 const struct media_remux_queue_progress *progress);
+};
+
+EXPORT media_remux_queue_t
+media_remux_queue_create(size_t jobs,
+			 const struct media_remux_options *options);
+EXPORT void media_remux_queue_destroy(media_remux_queue_t queue);
+
+/** Adds a job and returns its index, not while the queue is processed */
+EXPORT size_t media_remux_queue_add(media_remux_queue_t queue,
+				    const char *in_filename,
+				    const char *out_filename);
+
+/**
+ * Runs every job in the queue and returns once all of them are done.  Jobs
+ * that haven't started when the queue is stopped are skipped without any
+ * callback.
+ *
+ * @return true if every job succeeded
+ */
+EXPORT bool
+media_remux_queue_process(media_remux_queue_t queue,
+			  const struct media_remux_queue_callbacks *callbacks);
+
 #ifdef __cplusplus
 }
 #endif
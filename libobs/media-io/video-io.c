@@ -22,6 +22,7 @@
 #include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf-spsc.h"
 #include "../util/util_uint64.h"
 
 #include "format-conversion.h"
@@ -33,6 +34,8 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_INPUT_QUEUE 2
+#define SPACE_WAIT_MS 10
 
 struct cached_frame_info {
 	struct video_data frame;
@@ -40,6 +43,11 @@ struct cached_frame_info {
 	int count;
 };
 
+struct queued_frame {
+	struct video_data frame;
+	uint64_t queued_time;
+};
+
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
@@ -48,13 +56,70 @@ struct video_input {
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
+
+	volatile long skipped_frames;
+	volatile long total_frames;
+
+	/* threaded inputs only, the video thread pushes and the input thread
+	 * pops, so the queue needs no lock */
+	bool threaded;
+	pthread_t thread;
+	os_sem_t *queue_semaphore;
+	volatile bool stop;
+	struct circlebuf_spsc queue;
+
+	/* with VIDEO_INPUT_DROP_OLDEST the queue has room for twice the depth,
+	 * and the input thread drops the oldest frames above the depth */
+	size_t queue_depth;
+	enum video_input_drop_policy policy;
+	os_event_t *space_event;
+
+	/* queued frames are copied in to buffers of the input's own, one for
+	 * every queue entry and used in the same order, so a slow input never
+	 * holds on to frames of the shared cache */
+	struct video_frame *buffers;
+	size_t num_buffers;
+	size_t next_buffer;
+	enum video_format buffer_format;
+	uint32_t buffer_height;
+
+	volatile long max_queued;
+	volatile long latency[VIDEO_INPUT_LATENCY_BUCKETS];
 };
 
+static inline void free_input_buffers(struct video_input *input)
+{
+	for (size_t i = 0; i < input->num_buffers; i++)
+		video_frame_free(&input->buffers[i]);
+	bfree(input->buffers);
+	input->buffers = NULL;
+	input->num_buffers = 0;
+}
+
+static inline void video_input_stop(struct video_input *input)
+{
+	if (!input->threaded)
+		return;
+
+	os_atomic_set_bool(&input->stop, true);
+	os_sem_post(input->queue_semaphore);
+	pthread_join(input->thread, NULL);
+
+	free_input_buffers(input);
+	os_sem_destroy(input->queue_semaphore);
+	os_event_destroy(input->space_event);
+	circlebuf_spsc_free(&input->queue);
+	input->threaded = false;
+}
+
 static inline void video_input_free(struct video_input *input)
 {
+	video_input_stop(input);
+
 	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
 		video_frame_free(&input->frame[i]);
 	video_scaler_destroy(input->scaler);
+	bfree(input);
 }
 
 struct video_output {
@@ -72,7 +137,8 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	bool threaded_inputs;
 
 	size_t available_frames;
 	size_t first_added;
@@ -116,6 +182,147 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+static inline size_t queued_frames(const struct video_input *input)
+{
+	return circlebuf_spsc_size(&input->queue) / sizeof(struct queued_frame);
+}
+
+static inline void skip_input_frame(struct video_input *input)
+{
+	os_atomic_inc_long(&input->skipped_frames);
+	os_atomic_inc_long(&input->total_frames);
+}
+
+static void drop_oldest_frames(struct video_input *input)
+{
+	struct queued_frame qf;
+
+	while (queued_frames(input) > input->queue_depth &&
+	       circlebuf_spsc_pop(&input->queue, &qf, sizeof(qf)))
+		skip_input_frame(input);
+}
+
+static inline void add_latency(struct video_input *input, uint64_t ns)
+{
+	uint64_t ms = ns / 1000000;
+	size_t idx = 0;
+
+	while (idx < VIDEO_INPUT_LATENCY_BUCKETS - 1 && ms >= (1ULL << idx))
+		idx++;
+
+	os_atomic_inc_long(&input->latency[idx]);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(input->queue_semaphore) == 0) {
+		struct queued_frame qf;
+
+		if (os_atomic_load_bool(&input->stop))
+			break;
+
+		if (input->policy == VIDEO_INPUT_DROP_OLDEST)
+			drop_oldest_frames(input);
+
+		if (!circlebuf_spsc_peek(&input->queue, &qf, sizeof(qf)))
+			continue;
+
+		if (scale_video_output(input, &qf.frame))
+			input->callback(input->param, &qf.frame);
+
+		os_atomic_inc_long(&input->total_frames);
+		add_latency(input, os_gettime_ns() - qf.queued_time);
+
+		/* the queue entry is only popped once the callback has
+		 * returned so that a busy input counts towards its limit */
+		circlebuf_spsc_pop(&input->queue, NULL, sizeof(qf));
+
+		if (input->space_event)
+			os_event_signal(input->space_event);
+	}
+
+	return NULL;
+}
+
+/* VIDEO_INPUT_BLOCK: hold up the video thread until the input has room.  the
+ * wait is split up so that stopping the video output is never held up */
+static bool wait_for_input_space(struct video_output *video,
+				 struct video_input *input)
+{
+	while (queued_frames(input) >= input->queue_depth) {
+		if (video->stop || os_atomic_load_bool(&input->stop))
+			return false;
+
+		os_event_timedwait(input->space_event, SPACE_WAIT_MS);
+	}
+
+	return true;
+}
+
+static inline bool input_has_space(struct video_output *video,
+				   struct video_input *input)
+{
+	if (input->policy == VIDEO_INPUT_BLOCK)
+		return wait_for_input_space(video, input);
+
+	/* for VIDEO_INPUT_DROP_OLDEST the input thread drops what is above
+	 * its depth once it takes the next frame, so just push until the
+	 * queue itself is full */
+	if (input->policy == VIDEO_INPUT_DROP_OLDEST)
+		return circlebuf_spsc_avail(&input->queue) >=
+		       sizeof(struct queued_frame);
+
+	return queued_frames(input) < input->queue_depth;
+}
+
+static inline void update_max_queued(struct video_input *input)
+{
+	long queued = (long)queued_frames(input);
+
+	if (queued > os_atomic_load_long(&input->max_queued))
+		os_atomic_set_long(&input->max_queued, queued);
+}
+
+static inline void queue_input_frame(struct video_output *video,
+				     struct video_input *input,
+				     const struct video_data *frame)
+{
+	struct queued_frame qf = {.queued_time = os_gettime_ns()};
+	struct video_frame *buffer;
+
+	/* the buffer of the next entry is only free while fewer entries than
+	 * buffers are queued, the input thread pops an entry when it's done
+	 * with it.  the queue itself may have been rounded up to more room */
+	if (!input_has_space(video, input) ||
+	    queued_frames(input) >= input->num_buffers) {
+		/* this input is still busy with previous frames, so only this
+		 * input skips the frame rather than every input */
+		skip_input_frame(input);
+		return;
+	}
+
+	buffer = &input->buffers[input->next_buffer];
+	if (++input->next_buffer == input->num_buffers)
+		input->next_buffer = 0;
+
+	video_frame_copy(buffer, (const struct video_frame *)frame,
+			 input->buffer_format, input->buffer_height);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		qf.frame.data[i] = buffer->data[i];
+		qf.frame.linesize[i] = buffer->linesize[i];
+	}
+	qf.frame.timestamp = frame->timestamp;
+
+	circlebuf_spsc_push(&input->queue, &qf, sizeof(qf));
+	update_max_queued(input);
+	os_sem_post(input->queue_semaphore);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -135,11 +342,18 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		struct video_data frame = frame_info->frame;
 
+		if (input->threaded) {
+			queue_input_frame(video, input, &frame);
+			continue;
+		}
+
 		if (scale_video_output(input, &frame))
 			input->callback(input->param, &frame);
+
+		os_atomic_inc_long(&input->total_frames);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -271,7 +485,7 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
@@ -289,7 +503,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -297,6 +511,66 @@ static size_t video_get_input_idx(const video_t *video,
 	return DARRAY_INVALID;
 }
 
+static inline bool
+video_input_start_thread(struct video_input *input, struct video_output *video,
+			 const struct video_input_queue_info *queue)
+{
+	size_t max_depth = video->info.cache_size > 1
+				   ? video->info.cache_size - 1
+				   : 1;
+	size_t entries;
+
+	input->queue_depth = MAX_INPUT_QUEUE;
+	input->policy = VIDEO_INPUT_DROP_NEWEST;
+
+	if (queue) {
+		if (queue->depth)
+			input->queue_depth = queue->depth;
+		input->policy = queue->policy;
+	}
+	if (input->queue_depth > max_depth)
+		input->queue_depth = max_depth;
+
+	entries = input->queue_depth;
+	if (input->policy == VIDEO_INPUT_DROP_OLDEST)
+		entries *= 2;
+
+	if (!circlebuf_spsc_init(&input->queue,
+				 sizeof(struct queued_frame) * entries))
+		return false;
+
+	input->buffer_format = video->info.format;
+	input->buffer_height = video->info.height;
+	input->num_buffers = entries;
+	input->next_buffer = 0;
+	input->buffers = bzalloc(sizeof(struct video_frame) * entries);
+	for (size_t i = 0; i < entries; i++)
+		video_frame_init(&input->buffers[i], video->info.format,
+				 video->info.width, video->info.height);
+
+	if (os_sem_init(&input->queue_semaphore, 0) != 0)
+		goto fail_sem;
+	if (input->policy == VIDEO_INPUT_BLOCK &&
+	    os_event_init(&input->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+	if (pthread_create(&input->thread, NULL, video_input_thread, input) !=
+	    0)
+		goto fail_thread;
+
+	input->threaded = true;
+	return true;
+
+fail_thread:
+	os_event_destroy(input->space_event);
+	input->space_event = NULL;
+fail_event:
+	os_sem_destroy(input->queue_semaphore);
+fail_sem:
+	free_input_buffers(input);
+	circlebuf_spsc_free(&input->queue);
+	return false;
+}
+
 static inline bool video_input_init(struct video_input *input,
 				    struct video_output *video)
 {
@@ -340,8 +614,9 @@ static inline void reset_frames(video_t *video)
 	os_atomic_set_long(&video->total_frames, 0);
 }
 
-bool video_output_connect(
+static bool video_output_connect_internal(
 	video_t *video, const struct video_scale_info *conversion,
+	const struct video_input_queue_info *queue,
 	void (*callback)(void *param, struct video_data *frame), void *param)
 {
 	bool success = false;
@@ -352,26 +627,32 @@ bool video_output_connect(
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->callback = callback;
+		input->param = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
+
+		success = video_input_init(input, video);
+		if (success && (queue || video->threaded_inputs) &&
+		    !video_input_start_thread(input, video, queue)) {
+			blog(LOG_WARNING, "video_output_connect: Failed to "
+					  "create input thread, falling "
+					  "back to video thread");
+		}
 
-		success = video_input_init(&input, video);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -380,6 +661,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -388,6 +671,26 @@ bool video_output_connect(
 	return success;
 }
 
+bool video_output_connect(
+	video_t *video, const struct video_scale_info *conversion,
+	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	return video_output_connect_internal(video, conversion, NULL, callback,
+					     param);
+}
+
+bool video_output_connect_queued(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_input_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param)
+{
+	struct video_input_queue_info def = {0};
+
+	return video_output_connect_internal(video, conversion,
+					     queue ? queue : &def, callback,
+					     param);
+}
+
 static void log_skipped(video_t *video)
 {
 	long skipped = os_atomic_load_long(&video->skipped_frames);
@@ -405,6 +708,18 @@ static void log_skipped(video_t *video)
 		     percentage_skipped);
 }
 
+static void log_input_skipped(struct video_input *input)
+{
+	long skipped = os_atomic_load_long(&input->skipped_frames);
+	long total = os_atomic_load_long(&input->total_frames);
+
+	if (skipped)
+		blog(LOG_INFO,
+		     "Video input disconnected, number of skipped frames "
+		     "due to input lag: %ld/%ld (%0.1f%%)",
+		     skipped, total, (double)skipped / (double)total * 100.0);
+}
+
 void video_output_disconnect(video_t *video,
 			     void (*callback)(void *param,
 					      struct video_data *frame),
@@ -417,7 +732,12 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		struct video_input *input = video->inputs.array[idx];
+
+		/* stop the input thread first so the frame counts are final */
+		video_input_stop(input);
+		log_input_skipped(input);
+		video_input_free(input);
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -554,6 +874,109 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+void video_output_set_threaded_inputs(video_t *video, bool threaded)
+{
+	if (!video)
+		return;
+
+	pthread_mutex_lock(&video->input_mutex);
+	video->threaded_inputs = threaded;
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
+bool video_output_threaded_inputs(const video_t *video)
+{
+	return video ? video->threaded_inputs : false;
+}
+
+static bool get_input_frames(video_t *video,
+			     void (*callback)(void *param,
+					      struct video_data *frame),
+			     void *param, uint32_t *skipped, uint32_t *total)
+{
+	bool found = false;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+		*skipped = (uint32_t)os_atomic_load_long(
+			&input->skipped_frames);
+		*total = (uint32_t)os_atomic_load_long(&input->total_frames);
+		found = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return found;
+}
+
+uint32_t video_output_get_input_skipped_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param)
+{
+	uint32_t skipped = 0, total = 0;
+	get_input_frames(video, callback, param, &skipped, &total);
+	return skipped;
+}
+
+uint32_t video_output_get_input_total_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param)
+{
+	uint32_t skipped = 0, total = 0;
+	get_input_frames(video, callback, param, &skipped, &total);
+	return total;
+}
+
+bool video_output_get_input_stats(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, struct video_input_stats *stats)
+{
+	bool found = false;
+
+	if (!video || !callback || !stats)
+		return false;
+
+	memset(stats, 0, sizeof(*stats));
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		stats->total_frames =
+			(uint32_t)os_atomic_load_long(&input->total_frames);
+		stats->skipped_frames =
+			(uint32_t)os_atomic_load_long(&input->skipped_frames);
+
+		if (input->threaded) {
+			size_t queued = queued_frames(input);
+			if (queued > input->queue_depth)
+				queued = input->queue_depth;
+
+			stats->queue_depth = (uint32_t)input->queue_depth;
+			stats->queued_frames = (uint32_t)queued;
+			stats->max_queued_frames =
+				(uint32_t)os_atomic_load_long(
+					&input->max_queued);
+		}
+
+		for (size_t i = 0; i < VIDEO_INPUT_LATENCY_BUCKETS; i++)
+			stats->latency[i] = (uint32_t)os_atomic_load_long(
+				&input->latency[i]);
+
+		found = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return found;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
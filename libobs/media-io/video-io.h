@@ -261,6 +261,60 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/* When enabled, inputs connected afterwards each get their own thread with a
+ * small queue of frames, so scaling and callbacks of different inputs run in
+ * parallel and a slow input only skips its own frames. */
+EXPORT void video_output_set_threaded_inputs(video_t *video, bool threaded);
+EXPORT bool video_output_threaded_inputs(const video_t *video);
+
+/* What a threaded input does with a new frame when its queue is full */
+enum video_input_drop_policy {
+	VIDEO_INPUT_DROP_NEWEST,
+	VIDEO_INPUT_DROP_OLDEST,
+	VIDEO_INPUT_BLOCK,
+};
+
+struct video_input_queue_info {
+	size_t depth; /* 0 for the default */
+	enum video_input_drop_policy policy;
+};
+
+#define VIDEO_INPUT_LATENCY_BUCKETS 8
+
+struct video_input_stats {
+	uint32_t total_frames;
+	uint32_t skipped_frames;
+
+	uint32_t queue_depth;
+	uint32_t queued_frames;
+	uint32_t max_queued_frames;
+
+	/* frames by time from being queued until the callback returned,
+	 * bucket i counts frames below (1 << i) ms, the last bucket counts
+	 * everything slower */
+	uint32_t latency[VIDEO_INPUT_LATENCY_BUCKETS];
+};
+
+/* Connects an input that always gets its own thread, with its own queue
+ * depth and drop policy.  Queued frames are copies, so a slow input doesn't
+ * hold up other inputs.  The depth is limited to one less than the cache
+ * size of the video output. */
+EXPORT bool video_output_connect_queued(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_input_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param);
+
+EXPORT bool video_output_get_input_stats(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, struct video_input_stats *stats);
+
+EXPORT uint32_t video_output_get_input_skipped_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param);
+EXPORT uint32_t video_output_get_input_total_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-mix.h"
 
 struct ts_info {
 	uint64_t start;
@@ -27,6 +28,8 @@ struct ts_info {
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
 #define MAX_BUFFERING_TICKS 45
+#define MAX_AUDIO_RENDER_THREADS 4
+#define PARALLEL_AUDIO_MIN 4
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -38,7 +41,10 @@ static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 			da_push_back(audio->render_order, &s);
 	}
 
-	UNUSED_PARAMETER(parent);
+	/* the tree is enumerated children first, so the depth of the source
+	 * is final by the time it's pushed by its parent */
+	if (parent && parent->audio_render_depth <= source->audio_render_depth)
+		parent->audio_render_depth = source->audio_render_depth + 1;
 }
 
 static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
@@ -47,8 +53,9 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 }
 
 static inline void mix_audio(struct audio_output_data *mixes,
-			     obs_source_t *source, size_t channels,
-			     size_t sample_rate, struct ts_info *ts)
+			     obs_source_t *source, uint32_t mixers,
+			     size_t channels, size_t sample_rate,
+			     struct ts_info *ts, audio_mix_func_t mix_floats)
 {
 	size_t total_floats = AUDIO_OUTPUT_FRAMES;
 	size_t start_point = 0;
@@ -65,18 +72,19 @@ static inline void mix_audio(struct audio_output_data *mixes,
 		total_floats -= start_point;
 	}
 
+	/* mixes the source isn't assigned to are silent, and inactive mixes
+	 * aren't output at all, so there's no need to add either of them */
+	mixers &= source->audio_mixers;
+
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
 
-			mix += start_point;
-			end = aud + total_floats;
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *mix = mixes[mix_idx].data[ch] + start_point;
+			float *aud = source->audio_output_buf[mix_idx][ch];
 
-			while (aud < end)
-				*(mix++) += *(aud++);
+			mix_floats(mix, aud, total_floats);
 		}
 	}
 }
@@ -437,8 +445,130 @@ static inline const char *calc_min_ts(struct obs_core_data *data,
 
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
-	for (size_t i = 0; i < audio->render_order.num; i++)
-		obs_source_release(audio->render_order.array[i]);
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		source->audio_render_depth = 0;
+		obs_source_release(source);
+	}
+}
+
+/* sources only mix in the audio of their children, so sources of the same
+ * depth never depend on each other.  the order within a stage stays the
+ * render order */
+static void build_render_stages(struct obs_core_audio *audio)
+{
+	size_t max_depth = 0;
+
+	da_resize(audio->render_stages, 0);
+	da_resize(audio->render_stage_ends, 0);
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		if (source->audio_render_depth > max_depth)
+			max_depth = source->audio_render_depth;
+	}
+
+	for (size_t depth = 0; depth <= max_depth; depth++) {
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+
+			if (source->audio_render_depth == depth)
+				da_push_back(audio->render_stages, &source);
+		}
+
+		da_push_back(audio->render_stage_ends,
+			     &audio->render_stages.num);
+	}
+}
+
+struct audio_render_job {
+	struct obs_core_audio *audio;
+	obs_source_t **sources;
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t audio_size;
+	uint64_t start_ts;
+};
+
+static void render_audio_source(const struct audio_render_job *job,
+				obs_source_t *source)
+{
+	obs_source_audio_render(source, job->mixers, job->channels,
+				job->sample_rate, job->audio_size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (job->audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+	    source->audio_ts < job->start_ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
+#if DEBUG_AUDIO == 1
+			/* this should really be fixed */
+			assert(false);
+#endif
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			bool rerender =
+				ignore_audio(source, job->channels,
+					     job->sample_rate, job->start_ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, job->mixers,
+							job->channels,
+							job->sample_rate,
+							job->audio_size);
+		}
+	}
+}
+
+static void render_audio_job(void *param, size_t idx)
+{
+	struct audio_render_job *job = param;
+	render_audio_source(job, job->sources[idx]);
+}
+
+static void render_audio_stages(struct audio_render_job *job)
+{
+	struct obs_core_audio *audio = job->audio;
+	size_t start = 0;
+
+	build_render_stages(audio);
+
+	for (size_t i = 0; i < audio->render_stage_ends.num; i++) {
+		size_t end = audio->render_stage_ends.array[i];
+		size_t count = end - start;
+
+		job->sources = audio->render_stages.array + start;
+		start = end;
+
+		if (count < PARALLEL_AUDIO_MIN) {
+			for (size_t j = 0; j < count; j++)
+				render_audio_source(job, job->sources[j]);
+			continue;
+		}
+
+		if (!audio->render_pool) {
+			int threads = os_get_logical_cores() - 1;
+			if (threads > MAX_AUDIO_RENDER_THREADS)
+				threads = MAX_AUDIO_RENDER_THREADS;
+			audio->render_pool =
+				os_job_pool_create("obs audio", threads);
+		}
+
+		os_job_pool_run(audio->render_pool, render_audio_job, job,
+				count);
+	}
 }
 
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
@@ -493,43 +623,16 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
-		    source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
-#if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
-#endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels,
-							     sample_rate,
-							     ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
-			}
-		}
-	}
+	struct audio_render_job job = {
+		.audio = audio,
+		.mixers = mixers,
+		.channels = channels,
+		.sample_rate = sample_rate,
+		.audio_size = audio_size,
+		.start_ts = ts.start,
+	};
+
+	render_audio_stages(&job);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -546,6 +649,8 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	/* ------------------------------------------------ */
 	/* mix audio */
 	if (!audio->buffering_wait_ticks) {
+		audio_mix_func_t mix_floats = audio_get_mix_func();
+
 		for (size_t i = 0; i < audio->root_nodes.num; i++) {
 			obs_source_t *source = audio->root_nodes.array[i];
 
@@ -555,8 +660,8 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 			pthread_mutex_lock(&source->audio_buf_mutex);
 
 			if (source->audio_output_buf[0][0] && source->audio_ts)
-				mix_audio(mixes, source, channels, sample_rate,
-					  &ts);
+				mix_audio(mixes, source, mixers, channels,
+					  sample_rate, &ts, mix_floats);
 
 			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
@@ -20,6 +20,7 @@
 #include "util/dstr.h"
 #include "util/darray.h"
 #include "util/platform.h"
+#include "util/array-serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
@@ -32,6 +33,8 @@ struct obs_data_item {
 	volatile long ref;
 	struct obs_data *parent;
 	struct obs_data_item *next;
+	struct obs_data_item *prev;
+	uint32_t hash;
 	enum obs_data_type type;
 	size_t name_len;
 	size_t data_len;
@@ -46,6 +49,19 @@ struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t num_items;
+
+	/* open addressing hash table of the items, only built once there are
+	 * enough items for walking the list to get expensive */
+	struct obs_data_item **index;
+	size_t index_mask;
+
+	/* objects loaded from the binary form only get their items once they
+	 * are actually used */
+	struct obs_data_binary *binary;
+	uint32_t binary_offset;
+	volatile bool lazy;
 };
 
 struct obs_data_array {
@@ -61,6 +77,16 @@ struct obs_data_number {
 	};
 };
 
+struct obs_data_binary;
+static void obs_data_binary_release(struct obs_data_binary *bin);
+static void load_binary_object(struct obs_data *data);
+
+static inline void obs_data_ensure_loaded(struct obs_data *data)
+{
+	if (os_atomic_load_bool(&data->lazy))
+		load_binary_object(data);
+}
+
 /* ------------------------------------------------------------------------- */
 /* Item structure, designed to be one allocation only */
 
@@ -261,6 +287,19 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
+/* FNV-1a */
+static inline uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 static struct obs_data_item *obs_data_item_create(const char *name,
 						  const void *data, size_t size,
 						  enum obs_data_type type,
@@ -297,50 +336,183 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 
 	strcpy(get_item_name(item), name);
 	memcpy(get_item_data(item), data, size);
+	item->hash = hash_name(name);
 
 	item_data_addref(item);
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-						 struct obs_data_item *current)
+/* ------------------------------------------------------------------------- */
+/* Item list and index
+ *
+ *   Items are kept sorted by name in a doubly linked list, which is the order
+ * they are iterated and saved in.  Once an object has INDEX_MIN_ITEMS items,
+ * lookups by name go through a linear probing hash table instead of walking
+ * the list.  The table is only changed when items are added or removed, so
+ * looking up items never modifies the object. */
+
+#define INDEX_MIN_ITEMS 16
+
+/* only compares pointers, so this also works for an item that was just
+ * reallocated */
+static inline size_t index_find(struct obs_data *data,
+				struct obs_data_item *item, uint32_t hash)
 {
-	if (!current || !data)
-		return NULL;
+	size_t pos = hash & data->index_mask;
 
-	struct obs_data_item **prev_next = &data->first_item;
-	struct obs_data_item *item = data->first_item;
+	while (data->index[pos] != item)
+		pos = (pos + 1) & data->index_mask;
 
-	while (item) {
-		if (item == current)
-			return prev_next;
+	return pos;
+}
 
-		prev_next = &item->next;
-		item = item->next;
+static inline void index_insert(struct obs_data *data,
+				struct obs_data_item *item)
+{
+	size_t pos = item->hash & data->index_mask;
+
+	while (data->index[pos])
+		pos = (pos + 1) & data->index_mask;
+
+	data->index[pos] = item;
+}
+
+static void index_rebuild(struct obs_data *data, size_t size)
+{
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item *));
+	data->index_mask = size - 1;
+
+	for (struct obs_data_item *item = data->first_item; item;
+	     item = item->next)
+		index_insert(data, item);
+}
+
+/* called once the item is in the list, keeps the table at most half full */
+static void index_add(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t size = data->index ? data->index_mask + 1 : INDEX_MIN_ITEMS;
+
+	/* once built the index is kept up to date even if the object
+	 * shrinks again, lookups use it whenever it exists */
+	if (!data->index && data->num_items < INDEX_MIN_ITEMS)
+		return;
+
+	if (!data->index || data->num_items * 2 > size) {
+		while (data->num_items * 2 > size)
+			size *= 2;
+		index_rebuild(data, size);
+	} else {
+		index_insert(data, item);
 	}
+}
 
-	return NULL;
+/* moves entries back in to the hole left by the removed item, so lookups
+ * never need tombstones */
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = data->index_mask;
+	size_t hole = index_find(data, item, item->hash);
+	size_t pos = (hole + 1) & mask;
+	struct obs_data_item *cur;
+
+	while ((cur = data->index[pos]) != NULL) {
+		size_t home = cur->hash & mask;
+
+		if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+			data->index[hole] = cur;
+			hole = pos;
+		}
+
+		pos = (pos + 1) & mask;
+	}
+
+	data->index[hole] = NULL;
 }
 
-static inline void obs_data_item_detach(struct obs_data_item *item)
+static void obs_data_item_attach(struct obs_data *data,
+				 struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(item->parent, item);
+	const char *name = get_item_name(item);
+	struct obs_data_item *prev = data->last_item;
 
-	if (prev_next) {
-		*prev_next = item->next;
-		item->next = NULL;
+	/* json and copies of other objects add items in order, so check the
+	 * end of the list before walking it */
+	if (prev && strcmp(get_item_name(prev), name) > 0) {
+		struct obs_data_item *cur = data->first_item;
+
+		prev = NULL;
+		while (cur && strcmp(get_item_name(cur), name) < 0) {
+			prev = cur;
+			cur = cur->next;
+		}
 	}
+
+	item->parent = data;
+	item->prev = prev;
+	item->next = prev ? prev->next : data->first_item;
+
+	if (item->next)
+		item->next->prev = item;
+	else
+		data->last_item = item;
+
+	if (prev)
+		prev->next = item;
+	else
+		data->first_item = item;
+
+	data->num_items++;
+	index_add(data, item);
 }
 
+static inline void obs_data_item_detach(struct obs_data_item *item)
+{
+	struct obs_data *data = item->parent;
+
+	if (!data)
+		return;
+
+	if (data->index)
+		index_remove(data, item);
+
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		data->first_item = item->next;
+
+	if (item->next)
+		item->next->prev = item->prev;
+	else
+		data->last_item = item->prev;
+
+	data->num_items--;
+	item->parent = NULL;
+	item->next = NULL;
+	item->prev = NULL;
+}
+
+/* updates the pointers to an item that was reallocated */
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 					  struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(new_ptr->parent, old_ptr);
+	struct obs_data *data = new_ptr->parent;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+	if (!data)
+		return;
+
+	if (new_ptr->prev)
+		new_ptr->prev->next = new_ptr;
+	else
+		data->first_item = new_ptr;
+
+	if (new_ptr->next)
+		new_ptr->next->prev = new_ptr;
+	else
+		data->last_item = new_ptr;
+
+	if (data->index)
+		data->index[index_find(data, old_ptr, new_ptr->hash)] = new_ptr;
 }
 
 static struct obs_data_item *
@@ -708,12 +880,18 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	while (item) {
 		struct obs_data_item *next = item->next;
+
+		/* items can outlive the object if something still holds a
+		 * reference to them */
+		item->parent = NULL;
 		obs_data_item_release(&item);
 		item = next;
 	}
 
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
+	obs_data_binary_release(data->binary);
+	bfree(data->index);
 	bfree(data);
 }
 
@@ -767,12 +945,684 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 	return false;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Binary form
+ *
+ * Everything is little-endian and addressed by its offset from the start of
+ * the buffer, so the file can be used as it was read (or mapped):
+ *
+ *   header:  "OBSD" | u32 version | u32 string count | u32 string table
+ *            offset | u32 root object offset | u32 total size
+ *   object:  u32 item count, then per item: u32 name | u8 type | value
+ *   array:   u32 object count | u32 object offsets[count]
+ *   strings: u32 offsets[count], each to: u32 length | bytes | 0
+ *
+ * Names and string values are indices into the string table, so every
+ * string is only stored once.  Objects and arrays are written before
+ * anything that refers to them, which means a valid offset always points
+ * backwards and there can't be any cycles.
+ *
+ * Only the header is checked when loading, every object is decoded
+ * the first time something uses it, so the settings of a source aren't
+ * touched until that source is created. */
+
+#define BINARY_MAGIC "OBSD"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 24
+
+enum binary_type {
+	BINARY_STRING = 1,
+	BINARY_INT,
+	BINARY_DOUBLE,
+	BINARY_FALSE,
+	BINARY_TRUE,
+	BINARY_OBJECT,
+	BINARY_ARRAY,
+};
+
+struct obs_data_binary {
+	volatile long ref;
+	uint8_t *buf;
+	uint32_t size;
+	uint32_t string_count;
+	uint32_t string_table;
+};
+
+/* only guards handing the decoded items over to a lazy object, decoding
+ * itself happens outside of it */
+static pthread_mutex_t binary_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void obs_data_binary_release(struct obs_data_binary *bin)
+{
+	if (bin && os_atomic_dec_long(&bin->ref) == 0) {
+		bfree(bin->buf);
+		bfree(bin);
+	}
+}
+
+static obs_data_t *obs_data_create_lazy(struct obs_data_binary *bin,
+					uint32_t offset)
+{
+	struct obs_data *data = obs_data_create();
+
+	os_atomic_inc_long(&bin->ref);
+	data->binary = bin;
+	data->binary_offset = offset;
+	data->lazy = true;
+	return data;
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t val)
+{
+	p[0] = (uint8_t)val;
+	p[1] = (uint8_t)(val >> 8);
+	p[2] = (uint8_t)(val >> 16);
+	p[3] = (uint8_t)(val >> 24);
+}
+
+struct binary_reader {
+	const struct obs_data_binary *bin;
+	uint32_t pos;
+	bool error;
+};
+
+static inline bool reader_has(struct binary_reader *r, uint32_t size)
+{
+	if (!r->error && r->pos <= r->bin->size &&
+	    r->bin->size - r->pos >= size)
+		return true;
+
+	r->error = true;
+	return false;
+}
+
+static inline uint8_t read_u8(struct binary_reader *r)
+{
+	if (!reader_has(r, 1))
+		return 0;
+	return r->bin->buf[r->pos++];
+}
+
+static inline uint32_t read_u32(struct binary_reader *r)
+{
+	uint32_t val;
+
+	if (!reader_has(r, 4))
+		return 0;
+
+	val = get_u32(r->bin->buf + r->pos);
+	r->pos += 4;
+	return val;
+}
+
+static inline uint64_t read_u64(struct binary_reader *r)
+{
+	uint64_t val = read_u32(r);
+	return val | ((uint64_t)read_u32(r) << 32);
+}
+
+/* offsets of objects and arrays have to point before what refers to them */
+static inline uint32_t read_offset(struct binary_reader *r, uint32_t start)
+{
+	uint32_t offset = read_u32(r);
+	if (offset >= start)
+		r->error = true;
+	return offset;
+}
+
+static const char *read_string(struct binary_reader *r)
+{
+	const struct obs_data_binary *bin = r->bin;
+	uint32_t id = read_u32(r);
+	struct binary_reader str = {bin, 0, false};
+	uint32_t len;
+
+	if (r->error)
+		return NULL;
+
+	if (id >= bin->string_count) {
+		r->error = true;
+		return NULL;
+	}
+
+	str.pos = get_u32(bin->buf + bin->string_table + id * 4);
+	len = read_u32(&str);
+
+	if (!reader_has(&str, len) || str.pos + len == bin->size ||
+	    bin->buf[str.pos + len] != 0) {
+		r->error = true;
+		return NULL;
+	}
+
+	return (const char *)bin->buf + str.pos;
+}
+
+static obs_data_array_t *read_array(struct obs_data_binary *bin,
+				    uint32_t offset)
+{
+	struct binary_reader r = {bin, offset, false};
+	uint32_t count = read_u32(&r);
+	obs_data_array_t *array;
+
+	if (!reader_has(&r, 0) || count > (bin->size - r.pos) / 4)
+		return NULL;
+
+	array = obs_data_array_create();
+	da_reserve(array->objects, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t obj_offset = read_offset(&r, offset);
+		obs_data_t *obj;
+
+		if (r.error) {
+			obs_data_array_release(array);
+			return NULL;
+		}
+
+		obj = obs_data_create_lazy(bin, obj_offset);
+		da_push_back(array->objects, &obj);
+	}
+
+	return array;
+}
+
+static void read_object(struct obs_data_binary *bin, uint32_t offset,
+			obs_data_t *data)
+{
+	struct binary_reader r = {bin, offset, false};
+	uint32_t count = read_u32(&r);
+
+	for (uint32_t i = 0; i < count && !r.error; i++) {
+		const char *name = read_string(&r);
+		uint8_t type = read_u8(&r);
+		const char *str;
+		uint64_t num;
+		uint32_t pos;
+		obs_data_t *obj;
+		obs_data_array_t *array;
+
+		if (r.error)
+			break;
+
+		switch (type) {
+		case BINARY_STRING:
+			str = read_string(&r);
+			if (str)
+				obs_data_set_string(data, name, str);
+			break;
+		case BINARY_INT:
+		case BINARY_DOUBLE:
+			num = read_u64(&r);
+			if (r.error)
+				break;
+
+			if (type == BINARY_INT) {
+				obs_data_set_int(data, name, (long long)num);
+			} else {
+				double val;
+				memcpy(&val, &num, sizeof(val));
+				obs_data_set_double(data, name, val);
+			}
+			break;
+		case BINARY_FALSE:
+		case BINARY_TRUE:
+			obs_data_set_bool(data, name, type == BINARY_TRUE);
+			break;
+		case BINARY_OBJECT:
+			pos = read_offset(&r, offset);
+			if (r.error)
+				break;
+
+			obj = obs_data_create_lazy(bin, pos);
+			obs_data_set_obj(data, name, obj);
+			obs_data_release(obj);
+			break;
+		case BINARY_ARRAY:
+			pos = read_offset(&r, offset);
+			array = r.error ? NULL : read_array(bin, pos);
+			if (!array) {
+				r.error = true;
+				break;
+			}
+
+			obs_data_set_array(data, name, array);
+			obs_data_array_release(array);
+			break;
+		default:
+			r.error = true;
+		}
+	}
+
+	if (r.error)
+		blog(LOG_WARNING,
+		     "obs-data.c: [read_object] "
+		     "Corrupt binary object at offset %u",
+		     offset);
+}
+
+static void load_binary_object(struct obs_data *data)
+{
+	struct obs_data_binary *bin;
+	obs_data_t *loaded;
+	uint32_t offset;
+
+	pthread_mutex_lock(&binary_mutex);
+	bin = data->binary;
+	offset = data->binary_offset;
+	if (bin)
+		os_atomic_inc_long(&bin->ref);
+	pthread_mutex_unlock(&binary_mutex);
+
+	if (!bin)
+		return;
+
+	/* decoded without the lock so objects being used on different
+	 * threads don't wait on each other, if two threads race for the same
+	 * object one of them just throws its copy away */
+	loaded = obs_data_create();
+	read_object(bin, offset, loaded);
+
+	pthread_mutex_lock(&binary_mutex);
+	if (data->binary) {
+		data->first_item = loaded->first_item;
+		data->last_item = loaded->last_item;
+		data->num_items = loaded->num_items;
+		data->index = loaded->index;
+		data->index_mask = loaded->index_mask;
+
+		for (struct obs_data_item *item = data->first_item; item;
+		     item = item->next)
+			item->parent = data;
+
+		loaded->first_item = NULL;
+		loaded->last_item = NULL;
+		loaded->num_items = 0;
+		loaded->index = NULL;
+		loaded->index_mask = 0;
+
+		obs_data_binary_release(data->binary);
+		data->binary = NULL;
+		os_atomic_set_bool(&data->lazy, false);
+	}
+	pthread_mutex_unlock(&binary_mutex);
+
+	obs_data_release(loaded);
+	obs_data_binary_release(bin);
+}
+
+static obs_data_t *obs_data_create_from_binary_buf(uint8_t *buf, size_t size)
+{
+	struct obs_data_binary *bin;
+	uint32_t string_count, string_table, root;
+	obs_data_t *data;
+
+	if (size < BINARY_HEADER_SIZE || size > UINT32_MAX ||
+	    memcmp(buf, BINARY_MAGIC, 4) != 0)
+		goto invalid;
+
+	string_count = get_u32(buf + 8);
+	string_table = get_u32(buf + 12);
+	root = get_u32(buf + 16);
+
+	if (get_u32(buf + 4) != BINARY_VERSION ||
+	    get_u32(buf + 20) != size || root < BINARY_HEADER_SIZE ||
+	    root >= string_table ||
+	    (uint64_t)string_table + (uint64_t)string_count * 4 > size)
+		goto invalid;
+
+	bin = bzalloc(sizeof(struct obs_data_binary));
+	bin->ref = 1;
+	bin->buf = buf;
+	bin->size = (uint32_t)size;
+	bin->string_count = string_count;
+	bin->string_table = string_table;
+
+	data = obs_data_create_lazy(bin, root);
+	obs_data_binary_release(bin);
+	return data;
+
+invalid:
+	blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+			"Invalid or unsupported binary data");
+	bfree(buf);
+	return NULL;
+}
+
+obs_data_t *obs_data_create_from_binary(const void *buf, size_t size)
+{
+	uint8_t *copy;
+
+	if (!buf)
+		return NULL;
+
+	copy = bmemdup(buf, size);
+	return obs_data_create_from_binary_buf(copy, size);
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *file)
+{
+	FILE *f = os_fopen(file, "rb");
+	uint8_t *buf;
+	int64_t size;
+
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size <= 0 || size > UINT32_MAX) {
+		fclose(f);
+		return NULL;
+	}
+
+	buf = bmalloc((size_t)size);
+	if (fread(buf, (size_t)size, 1, f) != 1) {
+		blog(LOG_ERROR,
+		     "obs-data.c: [obs_data_create_from_binary_file] "
+		     "Failed reading %s",
+		     file);
+		bfree(buf);
+		fclose(f);
+		return NULL;
+	}
+
+	fclose(f);
+	return obs_data_create_from_binary_buf(buf, (size_t)size);
+}
+
+struct binary_writer {
+	struct serializer s;
+	struct array_output_data out;
+
+	DARRAY(const char *) strings;
+	uint32_t *slots; /* string index + 1, 0 when empty */
+	size_t slot_mask;
+};
+
+static void writer_rehash(struct binary_writer *w)
+{
+	size_t size = (w->slot_mask + 1) * 2;
+
+	bfree(w->slots);
+	w->slots = bzalloc(size * sizeof(uint32_t));
+	w->slot_mask = size - 1;
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		size_t pos = hash_name(w->strings.array[i]) & w->slot_mask;
+
+		while (w->slots[pos])
+			pos = (pos + 1) & w->slot_mask;
+		w->slots[pos] = (uint32_t)i + 1;
+	}
+}
+
+static uint32_t intern_string(struct binary_writer *w, const char *str)
+{
+	size_t pos = hash_name(str) & w->slot_mask;
+	uint32_t id;
+
+	while ((id = w->slots[pos]) != 0) {
+		if (strcmp(w->strings.array[id - 1], str) == 0)
+			return id - 1;
+
+		pos = (pos + 1) & w->slot_mask;
+	}
+
+	id = (uint32_t)w->strings.num;
+	da_push_back(w->strings, &str);
+	w->slots[pos] = id + 1;
+
+	if (w->strings.num * 2 > w->slot_mask)
+		writer_rehash(w);
+	return id;
+}
+
+static inline uint32_t writer_pos(struct binary_writer *w)
+{
+	return (uint32_t)w->out.bytes.num;
+}
+
+static inline bool binary_item_saved(struct obs_data_item *item)
+{
+	if (!obs_data_item_has_user_value(item))
+		return false;
+
+	return item->type == OBS_DATA_STRING ||
+	       item->type == OBS_DATA_NUMBER ||
+	       item->type == OBS_DATA_BOOLEAN ||
+	       item->type == OBS_DATA_OBJECT || item->type == OBS_DATA_ARRAY;
+}
+
+static uint32_t write_object(struct binary_writer *w, obs_data_t *data);
+
+static uint32_t write_array(struct binary_writer *w, obs_data_array_t *array)
+{
+	size_t count = array ? array->objects.num : 0;
+	DARRAY(uint32_t) offsets;
+	uint32_t pos;
+
+	da_init(offsets);
+	da_reserve(offsets, count);
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t offset = write_object(w, array->objects.array[i]);
+		da_push_back(offsets, &offset);
+	}
+
+	pos = writer_pos(w);
+	s_wl32(&w->s, (uint32_t)count);
+	for (size_t i = 0; i < count; i++)
+		s_wl32(&w->s, offsets.array[i]);
+
+	da_free(offsets);
+	return pos;
+}
+
+static uint32_t write_object(struct binary_writer *w, obs_data_t *data)
+{
+	struct obs_data_item *first = NULL;
+	DARRAY(uint32_t) children;
+	uint32_t count = 0;
+	uint32_t pos;
+	size_t child = 0;
+
+	if (data) {
+		obs_data_ensure_loaded(data);
+		first = data->first_item;
+	}
+
+	/* objects and arrays go first so their offsets are known */
+	da_init(children);
+
+	for (struct obs_data_item *item = first; item; item = item->next) {
+		uint32_t offset;
+
+		if (!binary_item_saved(item))
+			continue;
+
+		count++;
+
+		if (item->type == OBS_DATA_OBJECT) {
+			offset = write_object(w, get_item_obj(item));
+			da_push_back(children, &offset);
+		} else if (item->type == OBS_DATA_ARRAY) {
+			offset = write_array(w, get_item_array(item));
+			da_push_back(children, &offset);
+		}
+	}
+
+	pos = writer_pos(w);
+	s_wl32(&w->s, count);
+
+	for (struct obs_data_item *item = first; item; item = item->next) {
+		const char *str;
+
+		if (!binary_item_saved(item))
+			continue;
+
+		s_wl32(&w->s, intern_string(w, get_item_name(item)));
+
+		switch (item->type) {
+		case OBS_DATA_STRING:
+			str = obs_data_item_get_string(item);
+			s_w8(&w->s, BINARY_STRING);
+			s_wl32(&w->s, intern_string(w, str));
+			break;
+		case OBS_DATA_NUMBER:
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+				s_w8(&w->s, BINARY_INT);
+				s_wl64(&w->s,
+				       (uint64_t)obs_data_item_get_int(item));
+			} else {
+				s_w8(&w->s, BINARY_DOUBLE);
+				s_wld(&w->s, obs_data_item_get_double(item));
+			}
+			break;
+		case OBS_DATA_BOOLEAN:
+			s_w8(&w->s, obs_data_item_get_bool(item)
+					    ? BINARY_TRUE
+					    : BINARY_FALSE);
+			break;
+		case OBS_DATA_OBJECT:
+			s_w8(&w->s, BINARY_OBJECT);
+			s_wl32(&w->s, children.array[child++]);
+			break;
+		case OBS_DATA_ARRAY:
+			s_w8(&w->s, BINARY_ARRAY);
+			s_wl32(&w->s, children.array[child++]);
+			break;
+		default:
+			break;
+		}
+	}
+
+	da_free(children);
+	return pos;
+}
+
+static void write_string_table(struct binary_writer *w)
+{
+	uint32_t offset = writer_pos(w) + (uint32_t)w->strings.num * 4;
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		s_wl32(&w->s, offset);
+		offset += 4 + (uint32_t)strlen(w->strings.array[i]) + 1;
+	}
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		const char *str = w->strings.array[i];
+		size_t len = strlen(str);
+
+		s_wl32(&w->s, (uint32_t)len);
+		s_write(&w->s, str, len + 1);
+	}
+}
+
+void *obs_data_get_binary(obs_data_t *data, size_t *size)
+{
+	struct binary_writer w = {0};
+	uint8_t header[BINARY_HEADER_SIZE] = {0};
+	uint32_t root, string_table;
+	uint8_t *buf = NULL;
+
+	if (size)
+		*size = 0;
+	if (!data || !size)
+		return NULL;
+
+	array_output_serializer_init(&w.s, &w.out);
+	w.slot_mask = 255;
+	w.slots = bzalloc((w.slot_mask + 1) * sizeof(uint32_t));
+
+	/* the header gets filled in once everything else is written */
+	s_write(&w.s, header, sizeof(header));
+
+	root = write_object(&w, data);
+	string_table = writer_pos(&w);
+	write_string_table(&w);
+
+	if (w.out.bytes.num > UINT32_MAX) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_get_binary] "
+				"Data is too large for the binary form");
+		array_output_serializer_free(&w.out);
+		goto cleanup;
+	}
+
+	buf = w.out.bytes.array;
+	memcpy(buf, BINARY_MAGIC, 4);
+	put_u32(buf + 4, BINARY_VERSION);
+	put_u32(buf + 8, (uint32_t)w.strings.num);
+	put_u32(buf + 12, string_table);
+	put_u32(buf + 16, root);
+	put_u32(buf + 20, (uint32_t)w.out.bytes.num);
+	*size = w.out.bytes.num;
+
+cleanup:
+	da_free(w.strings);
+	bfree(w.slots);
+	return buf;
+}
+
+bool obs_data_save_binary(obs_data_t *data, const char *file)
+{
+	size_t size;
+	void *buf = obs_data_get_binary(data, &size);
+	bool success = false;
+
+	if (buf) {
+		success = os_quick_write_utf8_file(file, buf, size, false);
+		bfree(buf);
+	}
+
+	return success;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+			       const char *temp_ext, const char *backup_ext)
+{
+	size_t size;
+	void *buf = obs_data_get_binary(data, &size);
+	bool success = false;
+
+	if (buf) {
+		success = os_quick_write_utf8_file_safe(
+			file, buf, size, false, temp_ext, backup_ext);
+		bfree(buf);
+	}
+
+	return success;
+}
+
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data)
 		return NULL;
 
-	struct obs_data_item *item = data->first_item;
+	struct obs_data_item *item;
+
+	obs_data_ensure_loaded(data);
+
+	if (data->index) {
+		uint32_t hash = hash_name(name);
+		size_t pos = hash & data->index_mask;
+
+		while ((item = data->index[pos]) != NULL) {
+			if (item->hash == hash &&
+			    strcmp(get_item_name(item), name) == 0)
+				return item;
+
+			pos = (pos + 1) & data->index_mask;
+		}
+
+		return NULL;
+	}
+
+	item = data->first_item;
 
 	while (item) {
 		if (strcmp(get_item_name(item), name) == 0)
@@ -794,31 +1644,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || !*item) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 						default_data, autoselect_data);
-
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next;
-		     obs_data_item_next(&prev), obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		if (new_item)
+			obs_data_item_attach(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -950,6 +1777,7 @@ void obs_data_apply(obs_data_t *target, obs_data_t *apply_data)
 	if (!target || !apply_data || target == apply_data)
 		return;
 
+	obs_data_ensure_loaded(apply_data);
 	item = apply_data->first_item;
 
 	while (item) {
@@ -1003,6 +1831,7 @@ void obs_data_clear(obs_data_t *target)
 	if (!target)
 		return;
 
+	obs_data_ensure_loaded(target);
 	item = target->first_item;
 
 	while (item) {
@@ -1452,6 +2281,8 @@ obs_data_item_t *obs_data_first(obs_data_t *data)
 	if (!data)
 		return NULL;
 
+	obs_data_ensure_loaded(data);
+
 	if (data->first_item)
 		os_atomic_inc_long(&data->first_item->ref);
 	return data->first_item;
@@ -208,8 +208,17 @@ static void add_connection(struct obs_encoder *encoder)
 		struct video_scale_info info = {0};
 		get_video_info(encoder, &info);
 
+		/* a stop deferred by the last session must not hold back
+		 * this one, whichever way it's connected */
+		os_atomic_set_bool(&encoder->queued_stop, false);
+
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
+		} else if (encoder->video_queue.depth) {
+			encoder->video_queued = true;
+			start_queued_raw_video(encoder->media, &info,
+					       &encoder->video_queue,
+					       receive_video, encoder);
 		} else {
 			start_raw_video(encoder->media, &info, receive_video,
 					encoder);
@@ -229,6 +238,7 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 			stop_gpu_encode(encoder);
 		} else {
 			stop_raw_video(encoder->media, receive_video, encoder);
+			encoder->video_queued = false;
 		}
 	}
 
@@ -856,7 +866,6 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 				    struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
@@ -864,25 +873,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.size = size + packet->size;
+	first_packet.data = obs_packet_pool_alloc(first_packet.size);
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -919,13 +925,39 @@ void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+static void queued_full_stop(void *param)
+{
+	obs_encoder_t *encoder = param;
+
+	/* may have been stopped normally in the meantime */
+	if (encoder_active(encoder) && encoder->video_queued)
+		full_stop(encoder);
+	obs_encoder_release(encoder);
+}
+
+/* the video-io input thread can't disconnect its own input, so leave that to
+ * the graphics thread */
+static void defer_full_stop(struct obs_encoder *encoder)
+{
+	if (os_atomic_exchange_bool(&encoder->queued_stop, true))
+		return;
+
+	encoder = obs_encoder_get_ref(encoder);
+	if (encoder)
+		obs_queue_task(OBS_TASK_GRAPHICS, queued_full_stop, encoder,
+			       false);
+}
+
 void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 			     bool received, struct encoder_packet *pkt)
 {
 	if (!success) {
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
 		     encoder->context.name);
-		full_stop(encoder);
+		if (encoder->video_queued)
+			defer_full_stop(encoder);
+		else
+			full_stop(encoder);
 		return;
 	}
 
@@ -947,10 +979,19 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
-		for (size_t i = encoder->callbacks.num; i > 0; i--) {
-			struct encoder_callback *cb;
-			cb = encoder->callbacks.array + (i - 1);
-			send_packet(encoder, cb, pkt);
+		/* copy the encoder's data once, every output then just takes
+		 * a reference to the same packet */
+		if (encoder->callbacks.num) {
+			struct encoder_packet shared;
+			obs_encoder_packet_create_instance(&shared, pkt);
+
+			for (size_t i = encoder->callbacks.num; i > 0; i--) {
+				struct encoder_callback *cb;
+				cb = encoder->callbacks.array + (i - 1);
+				send_packet(encoder, cb, &shared);
+			}
+
+			obs_encoder_packet_release(&shared);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
@@ -1024,6 +1065,9 @@ static void receive_video(void *param, struct video_data *frame)
 	struct obs_encoder *pair = encoder->paired_encoder;
 	struct encoder_frame enc_frame;
 
+	if (os_atomic_load_bool(&encoder->queued_stop))
+		goto wait_for_audio;
+
 	if (!encoder->first_received && pair) {
 		if (!pair->first_received ||
 		    pair->first_raw_ts > frame->timestamp) {
@@ -1311,12 +1355,8 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 					const struct encoder_packet *src)
 {
-	long *p_refs;
-
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = obs_packet_pool_alloc(src->size);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1354,13 +1394,55 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 
 	if (pkt->data) {
 		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
+		long refs = os_atomic_dec_long(p_refs);
+
+		if (refs == OBS_PACKET_POOL_REF_FLAG)
+			obs_packet_pool_release(pkt->data);
+		else if (refs == 0)
 			bfree(p_refs);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
 
+void obs_encoder_set_video_queue(obs_encoder_t *encoder, size_t depth,
+				 enum video_input_drop_policy policy)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_video_queue"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING,
+		     "obs_encoder_set_video_queue: "
+		     "encoder '%s' is not a video encoder",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+	if (encoder_active(encoder)) {
+		blog(LOG_WARNING,
+		     "encoder '%s': Cannot set the video queue "
+		     "while the encoder is active",
+		     obs_encoder_get_name(encoder));
+		return;
+	}
+
+	encoder->video_queue.depth = depth;
+	encoder->video_queue.policy = policy;
+}
+
+bool obs_encoder_get_video_queue_stats(const obs_encoder_t *encoder,
+				       struct video_input_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_video_queue_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_video_queue_stats"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO || !encoder->media)
+		return false;
+
+	return video_output_get_input_stats(encoder->media, receive_video,
+					    (void *)encoder, stats);
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 					    enum video_format format)
 {
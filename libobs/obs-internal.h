@@ -24,6 +24,7 @@
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
+#include "util/job-pool.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -328,6 +329,13 @@ struct obs_core_audio {
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* render_order grouped into stages, the sources of a stage only
+	 * depend on sources of earlier stages so they're rendered in
+	 * parallel */
+	DARRAY(struct obs_source *) render_stages;
+	DARRAY(size_t) render_stage_ends;
+	os_job_pool_t *render_pool;
+
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
 	int buffering_wait_ticks;
@@ -360,6 +368,18 @@ struct obs_core_data {
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
+	/* sources that get ticked every frame, see obs_source_wake_tick.
+	 * tick_sources is protected by sources_mutex, sources woken up from
+	 * other threads wait in tick_pending until the next tick */
+	DARRAY(struct obs_source *) tick_sources;
+	DARRAY(struct obs_source *) tick_pending;
+	pthread_mutex_t tick_pending_mutex;
+
+	/* only used by the graphics thread while ticking */
+	DARRAY(struct obs_source *) tick_refs;
+	DARRAY(struct obs_source *) tick_async;
+	os_job_pool_t *tick_pool;
+
 	struct obs_view main_view;
 
 	long long unnamed_index;
@@ -474,6 +494,10 @@ extern void stop_raw_video(video_t *video,
 			   void (*callback)(void *param,
 					    struct video_data *frame),
 			   void *param);
+extern void start_queued_raw_video(
+	video_t *video, const struct video_scale_info *conversion,
+	const struct video_input_queue_info *queue,
+	void (*callback)(void *param, struct video_data *frame), void *param);
 
 /* ------------------------------------------------------------------------- */
 /* obs shared context data */
@@ -563,6 +587,22 @@ struct async_frame {
 	bool used;
 };
 
+/* frame whose data is owned by the source, see obs_source_output_video_owned */
+struct async_owned_frame {
+	struct obs_source_frame *frame;
+	obs_source_frame_release_t release;
+	void *param;
+};
+
+/* set in the refs of an owned frame, which is allocated as an owned_frame so
+ * it can be handed back to its source even when released without one */
+#define OWNED_FRAME_REF_FLAG (1L << (sizeof(long) * 8 - 2))
+
+struct owned_frame {
+	struct obs_source_frame frame;
+	struct obs_source *source;
+};
+
 enum audio_action_type {
 	AUDIO_ACTION_VOL,
 	AUDIO_ACTION_MUTE,
@@ -624,6 +664,13 @@ struct obs_source {
 	bool active;
 	bool showing;
 
+	/* tick_listed is set while the source is in the tick list, tick_wake
+	 * keeps it there for at least one more tick.  sources that aren't
+	 * tick_always leave the list once they're hidden */
+	volatile bool tick_listed;
+	volatile bool tick_wake;
+	bool tick_always;
+
 	/* used to temporarily disable sources if needed */
 	bool enabled;
 
@@ -648,6 +695,10 @@ struct obs_source {
 	struct obs_source *next_audio_source;
 	struct obs_source **prev_next_audio_source;
 	uint64_t audio_ts;
+
+	/* longest chain of audio children below the source, only used by the
+	 * audio thread while building the render order */
+	size_t audio_render_depth;
 	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
 	DARRAY(struct audio_action) audio_actions;
@@ -689,6 +740,7 @@ struct obs_source {
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
+	DARRAY(struct async_owned_frame) async_owned;
 	pthread_mutex_t async_mutex;
 	uint32_t async_width;
 	uint32_t async_height;
@@ -846,6 +898,10 @@ convert_video_format(enum video_format format)
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_async_frame_tick(obs_source_t *source);
+extern void obs_source_video_tick_sync(obs_source_t *source, float seconds);
+extern void obs_source_wake_tick(obs_source_t *source);
+extern bool obs_source_needs_tick(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
 
@@ -1010,10 +1066,12 @@ struct obs_output {
 static inline void do_output_signal(struct obs_output *output,
 				    const char *signal)
 {
-	struct calldata params = {0};
+	struct calldata params;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "output", output);
 	signal_handler_signal(output->context.signals, signal, &params);
-	calldata_free(&params);
 }
 
 extern void process_delay(void *data, struct encoder_packet *packet);
@@ -1032,6 +1090,18 @@ extern void obs_output_remove_encoder(struct obs_output *output,
 extern void
 obs_encoder_packet_create_instance(struct encoder_packet *dst,
 				   const struct encoder_packet *src);
+
+/* packet data pool, obs-packet-pool.c */
+extern void obs_packet_pool_init(void);
+extern void obs_packet_pool_free(void);
+/** Allocates reference counted packet data with a reference count of 1 */
+extern void *obs_packet_pool_alloc(size_t size);
+extern void obs_packet_pool_release(void *data);
+
+/* Set in the reference count of data from the pool.  Packet data that plugins
+ * allocate themselves as bmalloc(sizeof(long) + size) has a plain reference
+ * count in front of it, and is freed with bfree instead. */
+#define OBS_PACKET_POOL_REF_FLAG (1L << (sizeof(long) * 8 - 2))
 void obs_output_destroy(obs_output_t *output);
 
 /* ------------------------------------------------------------------------- */
@@ -1070,6 +1140,13 @@ struct obs_encoder {
 	uint32_t scaled_height;
 	enum video_format preferred_format;
 
+	/* raw video is encoded on a thread of video-io's when the queue
+	 * depth is set, encode errors then have to stop the encoder from
+	 * another thread */
+	struct video_input_queue_info video_queue;
+	bool video_queued;
+	volatile bool queued_stop;
+
 	volatile bool active;
 	volatile bool paused;
 	bool initialized;
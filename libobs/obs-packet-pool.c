@@ -0,0 +1,238 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/*
+ * Encoder packet data pool.
+ *
+ * Packet data is allocated in power of two size classes and released blocks
+ * are kept on a free list per class, so a running encoder ends up reusing the
+ * same handful of blocks instead of hitting the heap for every packet.
+ *
+ * Every block starts with a 32 byte header.  The reference count is the last
+ * member so it sits right in front of the data, which is where
+ * obs_encoder_packet_ref/release have always expected it.  It has
+ * OBS_PACKET_POOL_REF_FLAG set, so that data allocated outside of libobs with
+ * just a long in front of it can still be told apart and freed with bfree.
+ */
+
+#define POOL_MIN_SHIFT 8  /* 256 bytes */
+#define POOL_MAX_SHIFT 22 /* 4 MiB */
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_UNPOOLED POOL_CLASSES
+/* allocated while the pool was not running, not included in the stats */
+#define POOL_UNTRACKED (POOL_CLASSES + 1)
+
+/* free blocks beyond this are given back to the heap */
+#define POOL_MAX_CACHED_BYTES (64 * 1024 * 1024)
+
+#define HEADER_SIZE 32
+
+struct packet_header {
+	union {
+		/* while on a free list */
+		struct packet_header *next;
+		/* while in use */
+		size_t size;
+	};
+	uint32_t size_class;
+	uint8_t pad[HEADER_SIZE - sizeof(size_t) - sizeof(uint32_t) -
+		    sizeof(long)];
+	long refs;
+};
+
+struct packet_pool {
+	bool enabled;
+	pthread_mutex_t mutex;
+	struct packet_header *free_blocks[POOL_CLASSES];
+
+	struct obs_encoder_packet_pool_stats stats;
+};
+
+static struct packet_pool pool = {0};
+
+static inline size_t class_size(uint32_t size_class)
+{
+	return (size_t)1 << (size_class + POOL_MIN_SHIFT);
+}
+
+static inline uint32_t get_size_class(size_t size)
+{
+	uint32_t size_class = 0;
+
+	while (size_class < POOL_CLASSES && class_size(size_class) < size)
+		size_class++;
+
+	return size_class;
+}
+
+static inline struct packet_header *get_header(void *data)
+{
+	return (struct packet_header *)((uint8_t *)data - HEADER_SIZE);
+}
+
+static inline void add_in_use(size_t size)
+{
+	struct obs_encoder_packet_pool_stats *stats = &pool.stats;
+	size_t total;
+
+	stats->bytes_in_use += size;
+	if (stats->bytes_in_use > stats->peak_bytes_in_use)
+		stats->peak_bytes_in_use = stats->bytes_in_use;
+
+	total = stats->bytes_in_use + stats->bytes_cached;
+	if (total > stats->peak_bytes)
+		stats->peak_bytes = total;
+}
+
+void obs_packet_pool_init(void)
+{
+	memset(&pool, 0, sizeof(pool));
+	pthread_mutex_init_value(&pool.mutex);
+
+	if (pthread_mutex_init(&pool.mutex, NULL) != 0) {
+		blog(LOG_WARNING, "Failed to create packet pool mutex, "
+				  "packets will not be pooled");
+		return;
+	}
+
+	pool.enabled = true;
+}
+
+void obs_packet_pool_free(void)
+{
+	if (!pool.enabled)
+		return;
+
+	blog(LOG_INFO,
+	     "Encoder packet pool: %" PRIu64 " allocations, %" PRIu64
+	     " reused, peak memory: %.1f MiB",
+	     pool.stats.allocations, pool.stats.pool_hits,
+	     (double)pool.stats.peak_bytes / (1024.0 * 1024.0));
+
+	for (size_t i = 0; i < POOL_CLASSES; i++) {
+		struct packet_header *block = pool.free_blocks[i];
+
+		while (block) {
+			struct packet_header *next = block->next;
+			bfree(block);
+			block = next;
+		}
+	}
+
+	pool.enabled = false;
+	pthread_mutex_destroy(&pool.mutex);
+}
+
+void *obs_packet_pool_alloc(size_t size)
+{
+	struct packet_header *block = NULL;
+	uint32_t size_class = get_size_class(size);
+
+	if (!pool.enabled)
+		size_class = POOL_UNTRACKED;
+
+	if (size_class < POOL_CLASSES) {
+		size_t block_size = class_size(size_class);
+
+		pthread_mutex_lock(&pool.mutex);
+
+		block = pool.free_blocks[size_class];
+		if (block) {
+			pool.free_blocks[size_class] = block->next;
+			pool.stats.bytes_cached -= block_size;
+			pool.stats.pool_hits++;
+		} else {
+			pool.stats.pool_misses++;
+		}
+
+		pool.stats.allocations++;
+		add_in_use(block_size);
+
+		pthread_mutex_unlock(&pool.mutex);
+
+		if (!block)
+			block = bmalloc(HEADER_SIZE + block_size);
+
+	} else {
+		block = bmalloc(HEADER_SIZE + size);
+
+		if (size_class == POOL_UNPOOLED) {
+			pthread_mutex_lock(&pool.mutex);
+			pool.stats.allocations++;
+			pool.stats.oversized++;
+			add_in_use(size);
+			pthread_mutex_unlock(&pool.mutex);
+		}
+	}
+
+	block->size = size;
+	block->size_class = size_class;
+	block->refs = OBS_PACKET_POOL_REF_FLAG | 1;
+	return (uint8_t *)block + HEADER_SIZE;
+}
+
+void obs_packet_pool_release(void *data)
+{
+	struct packet_header *block = get_header(data);
+	uint32_t size_class = block->size_class;
+
+	if (!pool.enabled || size_class == POOL_UNTRACKED) {
+		bfree(block);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+
+	if (size_class == POOL_UNPOOLED) {
+		pool.stats.bytes_in_use -= block->size;
+		pthread_mutex_unlock(&pool.mutex);
+		bfree(block);
+		return;
+	}
+
+	size_t block_size = class_size(size_class);
+	pool.stats.bytes_in_use -= block_size;
+
+	if (pool.stats.bytes_cached + block_size <= POOL_MAX_CACHED_BYTES) {
+		block->next = pool.free_blocks[size_class];
+		pool.free_blocks[size_class] = block;
+		pool.stats.bytes_cached += block_size;
+		block = NULL;
+	}
+
+	pthread_mutex_unlock(&pool.mutex);
+
+	bfree(block);
+}
+
+void obs_encoder_packet_pool_get_stats(
+	struct obs_encoder_packet_pool_stats *stats)
+{
+	if (!stats)
+		return;
+
+	if (!pool.enabled) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	*stats = pool.stats;
+	pthread_mutex_unlock(&pool.mutex);
+}
@@ -241,6 +241,50 @@ static void obs_source_init_finalize(struct obs_source *source)
 
 	obs_context_data_insert(&source->context, &obs->data.sources_mutex,
 				&obs->data.first_source);
+
+	source->tick_always =
+		source->info.type == OBS_SOURCE_TYPE_TRANSITION ||
+		(source->info.output_flags & OBS_SOURCE_ASYNC) != 0 ||
+		(source->info.video_tick &&
+		 (source->info.output_flags & OBS_SOURCE_TICK_WHILE_SHOWING) ==
+			 0);
+	obs_source_wake_tick(source);
+}
+
+/* puts the source in the tick list if it isn't already */
+void obs_source_wake_tick(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	os_atomic_set_bool(&source->tick_wake, true);
+
+	if (!os_atomic_exchange_bool(&source->tick_listed, true)) {
+		pthread_mutex_lock(&data->tick_pending_mutex);
+		da_push_back(data->tick_pending, &source);
+		pthread_mutex_unlock(&data->tick_pending_mutex);
+	}
+}
+
+bool obs_source_needs_tick(obs_source_t *source)
+{
+	return source->tick_always || source->showing || source->active ||
+	       os_atomic_load_long(&source->show_refs) > 0 ||
+	       os_atomic_load_long(&source->activate_refs) > 0 ||
+	       os_atomic_load_long(&source->defer_update_count) > 0 ||
+	       os_atomic_load_bool(&source->tick_wake);
+}
+
+static void obs_source_tick_remove(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->sources_mutex);
+	da_erase_item(data->tick_sources, &source);
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	pthread_mutex_lock(&data->tick_pending_mutex);
+	da_erase_item(data->tick_pending, &source);
+	pthread_mutex_unlock(&data->tick_pending_mutex);
 }
 
 static bool obs_source_hotkey_mute(void *data, obs_hotkey_pair_id id,
@@ -609,6 +653,12 @@ static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 		obs_source_frame_destroy(frame);
 }
 
+static inline void release_owned_frame(struct async_owned_frame *of)
+{
+	of->release(of->param, of->frame);
+	bfree(of->frame);
+}
+
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 					     obs_source_t *filter);
 
@@ -657,6 +707,8 @@ void obs_source_destroy(struct obs_source *source)
 
 	for (i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
+	for (i = 0; i < source->async_owned.num; i++)
+		release_owned_frame(&source->async_owned.array[i]);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -689,6 +741,7 @@ void obs_source_destroy(struct obs_source *source)
 	da_free(source->caption_cb_list);
 	da_free(source->async_cache);
 	da_free(source->async_frames);
+	da_free(source->async_owned);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_actions_mutex);
@@ -698,6 +751,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->caption_cb_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
 	obs_data_release(source->private_settings);
+	obs_source_tick_remove(source);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id) {
@@ -934,6 +988,7 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		os_atomic_inc_long(&source->defer_update_count);
+		obs_source_wake_tick(source);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
@@ -1052,6 +1107,7 @@ static void activate_tree(obs_source_t *parent, obs_source_t *child,
 			  void *param)
 {
 	os_atomic_inc_long(&child->activate_refs);
+	obs_source_wake_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1061,6 +1117,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 			    void *param)
 {
 	os_atomic_dec_long(&child->activate_refs);
+	obs_source_wake_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1069,6 +1126,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
+	obs_source_wake_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1077,6 +1135,7 @@ static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 static void hide_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_dec_long(&child->show_refs);
+	obs_source_wake_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1088,6 +1147,7 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 		return;
 
 	os_atomic_inc_long(&source->show_refs);
+	obs_source_wake_tick(source);
 	obs_source_enum_active_tree(source, show_tree, NULL);
 
 	if (type == MAIN_VIEW) {
@@ -1103,6 +1163,7 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 
 	if (os_atomic_load_long(&source->show_refs) > 0) {
 		os_atomic_dec_long(&source->show_refs);
+		obs_source_wake_tick(source);
 		obs_source_enum_active_tree(source, hide_tree, NULL);
 	}
 
@@ -1120,7 +1181,9 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 bool set_async_texture_size(struct obs_source *source,
 			    const struct obs_source_frame *frame);
 
-static void async_tick(obs_source_t *source)
+/* only touches the frame queue, so the graphics thread can have this done for
+ * a lot of sources at once on other threads */
+void obs_source_async_frame_tick(obs_source_t *source)
 {
 	uint64_t sys_time = obs->video.video_time;
 
@@ -1139,24 +1202,35 @@ static void async_tick(obs_source_t *source)
 
 	source->last_sys_timestamp = sys_time;
 	pthread_mutex_unlock(&source->async_mutex);
-
-	if (source->cur_async_frame)
-		source->async_update_texture =
-			set_async_texture_size(source, source->cur_async_frame);
 }
 
 void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+		obs_source_async_frame_tick(source);
+
+	obs_source_video_tick_sync(source, seconds);
+}
+
+/* the rest of the tick, has to be called on the graphics thread after
+ * obs_source_async_frame_tick */
+void obs_source_video_tick_sync(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
+	if (!obs_source_valid(source, "obs_source_video_tick_sync"))
 		return;
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source, seconds);
 
-	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
-		async_tick(source);
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
+	    source->cur_async_frame)
+		source->async_update_texture =
+			set_async_texture_size(source, source->cur_async_frame);
 
 	if (os_atomic_load_long(&source->defer_update_count) > 0)
 		obs_source_deferred_update(source);
@@ -2278,6 +2352,10 @@ void obs_source_video_render(obs_source_t *source)
 	if (!obs_source_valid(source, "obs_source_video_render"))
 		return;
 
+	/* hidden sources that are rendered anyway need their next tick */
+	if (!source->showing && !os_atomic_load_bool(&source->tick_wake))
+		obs_source_wake_tick(source);
+
 	obs_source_addref(source);
 	render_video(source);
 	obs_source_release(source);
@@ -2764,11 +2842,42 @@ static inline bool async_texture_changed(struct obs_source *source,
 	       source->async_cache_height != frame->height || prev != cur;
 }
 
+static inline bool release_owned_frame_ptr(struct obs_source *source,
+					   struct obs_source_frame *frame)
+{
+	for (size_t i = 0; i < source->async_owned.num; i++) {
+		struct async_owned_frame *of = &source->async_owned.array[i];
+
+		if (of->frame == frame) {
+			release_owned_frame(of);
+			da_erase(source->async_owned, i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
+	/* owned frames that are still queued are released here, owned frames
+	 * currently held through obs_source_get_frame are released once
+	 * obs_source_release_frame is called on them */
+	if (source->async_owned.num) {
+		for (size_t i = 0; i < source->async_frames.num; i++)
+			release_owned_frame_ptr(source,
+						source->async_frames.array[i]);
+		if (source->cur_async_frame)
+			release_owned_frame_ptr(source,
+						source->cur_async_frame);
+		if (source->prev_async_frame)
+			release_owned_frame_ptr(source,
+						source->prev_async_frame);
+	}
+
 	da_resize(source->async_cache, 0);
 	da_resize(source->async_frames, 0);
 	source->cur_async_frame = NULL;
@@ -2862,6 +2971,13 @@ obs_source_output_video_internal(obs_source_t *source,
 
 	if (!frame) {
 		source->async_active = false;
+
+		/* the source may be about to free the data of its owned frames,
+		 * so give them back now */
+		pthread_mutex_lock(&source->async_mutex);
+		if (source->async_owned.num)
+			free_async_cache(source);
+		pthread_mutex_unlock(&source->async_mutex);
 		return;
 	}
 
@@ -2896,6 +3012,65 @@ void obs_source_output_video(obs_source_t *source,
 	obs_source_output_video_internal(source, &new_frame);
 }
 
+void obs_source_output_video_owned(obs_source_t *source,
+				   const struct obs_source_frame *frame,
+				   obs_source_frame_release_t release,
+				   void *param)
+{
+	struct async_owned_frame of;
+
+	if (!frame || !release) {
+		obs_source_output_video(source, frame);
+		return;
+	}
+
+	/* release always gets a copy of the frame, the same as when it is
+	 * called once libobs is done with a queued frame */
+	if (!obs_source_valid(source, "obs_source_output_video_owned")) {
+		struct obs_source_frame copy = *frame;
+		release(param, &copy);
+		return;
+	}
+
+	struct owned_frame *owned = bmalloc(sizeof(*owned));
+	owned->frame = *frame;
+	owned->source = source;
+
+	of.frame = &owned->frame;
+	of.frame->full_range = format_is_yuv(frame->format) ? frame->full_range
+							    : true;
+	of.frame->refs = OWNED_FRAME_REF_FLAG | 1;
+	of.frame->prev_frame = false;
+	of.release = release;
+	of.param = param;
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		free_async_cache(source);
+		source->last_frame_ts = 0;
+		pthread_mutex_unlock(&source->async_mutex);
+
+		release_owned_frame(&of);
+		return;
+	}
+
+	if (async_texture_changed(source, of.frame)) {
+		free_async_cache(source);
+		source->async_cache_width = frame->width;
+		source->async_cache_height = frame->height;
+	}
+
+	source->async_cache_format = frame->format;
+	source->async_cache_full_range = of.frame->full_range;
+
+	da_push_back(source->async_owned, &of);
+	da_push_back(source->async_frames, &of.frame);
+	source->async_active = true;
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 void obs_source_output_video2(obs_source_t *source,
 			      const struct obs_source_frame2 *frame)
 {
@@ -3383,9 +3558,12 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 
 		if (f->frame == frame) {
 			f->used = false;
-			break;
+			return;
 		}
 	}
+
+	if (frame && source->async_owned.num)
+		release_owned_frame_ptr(source, frame);
 }
 
 /* #define DEBUG_ASYNC_FRAMES 1 */
@@ -3532,6 +3710,11 @@ void obs_source_release_frame(obs_source_t *source,
 	if (!frame)
 		return;
 
+	/* owned frames always go back to their source, so that its release
+	 * callback is called instead of freeing the caller's data */
+	if (!source && (frame->refs & OWNED_FRAME_REF_FLAG))
+		source = ((struct owned_frame *)frame)->source;
+
 	if (!source) {
 		obs_source_frame_destroy(frame);
 	} else {
@@ -191,6 +191,20 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CEA_708 (1 << 14)
 
+/**
+ * Source type can be created on another thread at the same time as other
+ * sources, so obs_load_sources_threaded may create it on a worker thread.
+ */
+#define OBS_SOURCE_PARALLEL_LOAD (1 << 15)
+
+/**
+ * Source type's video_tick only has work to do while the source is showing.
+ *
+ * Sources of this type are not ticked while hidden, except for the tick where
+ * they become hidden and ticks following a render while hidden.
+ */
+#define OBS_SOURCE_TICK_WHILE_SHOWING (1 << 16)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
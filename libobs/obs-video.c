@@ -29,10 +29,64 @@
 #include <windows.h>
 #endif
 
+#define MAX_TICK_THREADS 4
+#define PARALLEL_ASYNC_MIN 4
+
+static void async_frame_tick(void *param, size_t idx)
+{
+	struct obs_source **sources = param;
+	obs_source_async_frame_tick(sources[idx]);
+}
+
+static inline void tick_async_frames(struct obs_core_data *data)
+{
+	size_t count = data->tick_async.num;
+
+	if (count < PARALLEL_ASYNC_MIN) {
+		for (size_t i = 0; i < count; i++)
+			obs_source_async_frame_tick(data->tick_async.array[i]);
+		return;
+	}
+
+	if (!data->tick_pool) {
+		int threads = os_get_logical_cores() - 1;
+		if (threads > MAX_TICK_THREADS)
+			threads = MAX_TICK_THREADS;
+		data->tick_pool = os_job_pool_create("obs tick", threads);
+	}
+
+	os_job_pool_run(data->tick_pool, async_frame_tick,
+			data->tick_async.array, count);
+}
+
+/* removes sources that are no longer shown or active from the tick list, they
+ * get put back in by obs_source_wake_tick */
+static inline void prune_tick_sources(struct obs_core_data *data)
+{
+	for (size_t i = data->tick_sources.num; i > 0; i--) {
+		struct obs_source *source = data->tick_sources.array[i - 1];
+
+		if (obs_source_needs_tick(source))
+			continue;
+
+		os_atomic_set_bool(&source->tick_listed, false);
+
+		/* woken up again in the meantime, but saw it was listed */
+		if (obs_source_needs_tick(source) &&
+		    !os_atomic_exchange_bool(&source->tick_listed, true))
+			continue;
+
+		da_erase(data->tick_sources, i - 1);
+	}
+}
+
+static const char *tick_callbacks_name = "tick_callbacks";
+static const char *tick_async_frames_name = "async_frames";
+static const char *tick_video_tick_name = "video_tick";
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
-	struct obs_source *source;
 	uint64_t delta_time;
 	float seconds;
 
@@ -46,6 +100,7 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	/* ------------------------------------- */
 	/* call tick callbacks                   */
 
+	profile_start(tick_callbacks_name);
 	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
 
 	for (size_t i = obs->data.tick_callbacks.num; i > 0; i--) {
@@ -55,25 +110,50 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	}
 
 	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+	profile_end(tick_callbacks_name);
 
 	/* ------------------------------------- */
 	/* call the tick function of each source */
 
 	pthread_mutex_lock(&data->sources_mutex);
 
-	source = data->first_source;
-	while (source) {
-		struct obs_source *cur_source = obs_source_get_ref(source);
-		source = (struct obs_source *)source->context.next;
+	pthread_mutex_lock(&data->tick_pending_mutex);
+	da_push_back_da(data->tick_sources, data->tick_pending);
+	da_resize(data->tick_pending, 0);
+	pthread_mutex_unlock(&data->tick_pending_mutex);
 
-		if (cur_source) {
-			obs_source_video_tick(cur_source, seconds);
-			obs_source_release(cur_source);
-		}
+	for (size_t i = 0; i < data->tick_sources.num; i++) {
+		struct obs_source *source =
+			obs_source_get_ref(data->tick_sources.array[i]);
+		if (!source)
+			continue;
+
+		os_atomic_set_bool(&source->tick_wake, false);
+		da_push_back(data->tick_refs, &source);
+
+		if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+			da_push_back(data->tick_async, &source);
 	}
 
+	profile_start(tick_async_frames_name);
+	tick_async_frames(data);
+	profile_end(tick_async_frames_name);
+
+	profile_start(tick_video_tick_name);
+	for (size_t i = 0; i < data->tick_refs.num; i++)
+		obs_source_video_tick_sync(data->tick_refs.array[i], seconds);
+	profile_end(tick_video_tick_name);
+
+	prune_tick_sources(data);
+
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	for (size_t i = 0; i < data->tick_refs.num; i++)
+		obs_source_release(data->tick_refs.array[i]);
+
+	da_resize(data->tick_refs, 0);
+	da_resize(data->tick_async, 0);
+
 	return cur_time;
 }
 
@@ -19,6 +19,7 @@
 
 #include "graphics/matrix4.h"
 #include "callback/calldata.h"
+#include "media-io/format-conversion.h"
 
 #include "obs.h"
 #include "obs-internal.h"
@@ -603,9 +604,13 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	os_job_pool_destroy(audio->render_pool);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->render_stages);
+	da_free(audio->render_stage_ends);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
@@ -624,6 +629,7 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.tick_pending_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -643,6 +649,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&obs->data.draw_callbacks_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->tick_pending_mutex, NULL) != 0)
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
@@ -703,6 +711,12 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
+	os_job_pool_destroy(data->tick_pool);
+	pthread_mutex_destroy(&data->tick_pending_mutex);
+	da_free(data->tick_sources);
+	da_free(data->tick_pending);
+	da_free(data->tick_refs);
+	da_free(data->tick_async);
 	obs_data_release(data->private_data);
 }
 
@@ -863,6 +877,8 @@ static bool obs_init(const char *locale, const char *module_config_path,
 
 	log_system_info();
 
+	obs_packet_pool_init();
+
 	if (!obs_init_data())
 		return false;
 	if (!obs_init_handlers())
@@ -1041,6 +1057,8 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_packet_pool_free();
+	format_conversion_free();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1427,7 +1445,10 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	struct obs_source *prev_source;
 	struct obs_view *view = &obs->data.main_view;
-	struct calldata params = {0};
+	struct calldata params;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
 
 	pthread_mutex_lock(&view->channels_mutex);
 
@@ -1440,7 +1461,6 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 	calldata_set_ptr(&params, "source", source);
 	signal_handler_signal(obs->signals, "channel_change", &params);
 	calldata_get_ptr(&params, "source", &source);
-	calldata_free(&params);
 
 	view->channels[channel] = source;
 
@@ -1722,12 +1742,13 @@ gs_texture_t *obs_get_main_texture(void)
 
 void obs_set_master_volume(float volume)
 {
-	struct calldata data = {0};
+	struct calldata data;
+	uint8_t stack[128];
 
+	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_float(&data, "volume", volume);
 	signal_handler_signal(obs->signals, "master_volume", &data);
 	volume = (float)calldata_float(&data, "volume");
-	calldata_free(&data);
 
 	obs->audio.user_volume = volume;
 }
@@ -1873,6 +1894,22 @@ obs_source_t *obs_load_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data);
 }
 
+/* tell sources that we want to load */
+static void obs_load_source_finish(obs_source_t *source,
+				   obs_data_t *source_data,
+				   obs_load_source_cb cb, void *private_data)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		obs_transition_load(source, source_data);
+	obs_source_load(source);
+	for (size_t i = source->filters.num; i > 0; i--) {
+		obs_source_t *filter = source->filters.array[i - 1];
+		obs_source_load(filter);
+	}
+	if (cb)
+		cb(private_data, source);
+}
+
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		      void *private_data)
 {
@@ -1897,22 +1934,12 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		obs_data_release(source_data);
 	}
 
-	/* tell sources that we want to load */
 	for (i = 0; i < sources.num; i++) {
 		obs_source_t *source = sources.array[i];
 		obs_data_t *source_data = obs_data_array_item(array, i);
-		if (source) {
-			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
-				obs_transition_load(source, source_data);
-			obs_source_load(source);
-			for (size_t i = source->filters.num; i > 0; i--) {
-				obs_source_t *filter =
-					source->filters.array[i - 1];
-				obs_source_load(filter);
-			}
-			if (cb)
-				cb(private_data, source);
-		}
+		if (source)
+			obs_load_source_finish(source, source_data, cb,
+					       private_data);
 		obs_data_release(source_data);
 	}
 
@@ -1924,6 +1951,292 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	da_free(sources);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Threaded source loading
+ *
+ * Sources are created in waves: a scene or group has to wait for the sources
+ * its items refer to, everything else (filters are created along with their
+ * parent) goes in the first wave.  Sources of types flagged with
+ * OBS_SOURCE_PARALLEL_LOAD are spread over worker threads, as long as all of
+ * their filters are flagged as well; everything else is created on the
+ * calling thread under sources_mutex, the same as obs_load_sources.  Loading
+ * them afterwards happens on the calling thread in the original order. */
+
+#define MAX_LOAD_THREADS 8
+
+struct load_entry {
+	obs_data_t *data;
+	obs_source_t *source;
+	const char *profile_name;
+	DARRAY(size_t) deps;
+	int wave;
+	bool parallel;
+};
+
+struct load_wave {
+	struct load_entry *entries;
+	DARRAY(size_t) parallel;
+	volatile long next;
+};
+
+static const char *load_sources_name = "obs_load_sources_threaded";
+static const char *load_sources_create_name = "create";
+static const char *load_sources_load_name = "load";
+static const char *load_sources_thread_name = "obs_load_sources_thread";
+
+static inline bool is_scene_id(const char *id)
+{
+	return strcmp(id, "scene") == 0 || strcmp(id, "group") == 0;
+}
+
+static bool parallel_load_type(obs_data_t *source_data)
+{
+	const char *id = obs_data_get_string(source_data, "versioned_id");
+	uint32_t flags;
+
+	if (!*id)
+		id = obs_data_get_string(source_data, "id");
+
+	flags = obs_get_source_output_flags(id);
+	return (flags & OBS_SOURCE_PARALLEL_LOAD) != 0;
+}
+
+/* filters are created along with their parent, so they have to allow it
+ * as well */
+static bool parallel_load_entry(obs_data_t *source_data)
+{
+	obs_data_array_t *filters;
+	bool parallel;
+
+	if (!parallel_load_type(source_data))
+		return false;
+
+	filters = obs_data_get_array(source_data, "filters");
+	parallel = true;
+
+	for (size_t i = 0; parallel && i < obs_data_array_count(filters); i++) {
+		obs_data_t *filter_data = obs_data_array_item(filters, i);
+		parallel = parallel_load_type(filter_data);
+		obs_data_release(filter_data);
+	}
+
+	obs_data_array_release(filters);
+	return parallel;
+}
+
+static void load_entry_init(struct load_entry *entry, obs_data_t *source_data)
+{
+	const char *name = obs_data_get_string(source_data, "name");
+
+	entry->data = source_data;
+	entry->wave = -1;
+	entry->parallel = parallel_load_entry(source_data);
+	entry->profile_name = profile_store_name(obs_get_profiler_name_store(),
+						 "obs_load_source(%s)", name);
+}
+
+static void load_entry_find_deps(struct load_entry *entries, size_t idx,
+				 obs_data_t *names)
+{
+	struct load_entry *entry = &entries[idx];
+	obs_data_t *settings;
+	obs_data_array_t *items;
+
+	if (!is_scene_id(obs_data_get_string(entry->data, "id")))
+		return;
+
+	settings = obs_data_get_obj(entry->data, "settings");
+	items = obs_data_get_array(settings, "items");
+
+	for (size_t i = 0; i < obs_data_array_count(items); i++) {
+		obs_data_t *item = obs_data_array_item(items, i);
+		const char *name = obs_data_get_string(item, "name");
+
+		if (obs_data_has_user_value(names, name)) {
+			size_t dep = (size_t)obs_data_get_int(names, name);
+			if (dep != idx)
+				da_push_back(entry->deps, &dep);
+		}
+
+		obs_data_release(item);
+	}
+
+	obs_data_array_release(items);
+	obs_data_release(settings);
+}
+
+/* a source goes one wave after the last source it refers to */
+static int load_entry_wave(struct load_entry *entries, size_t idx)
+{
+	struct load_entry *entry = &entries[idx];
+	int wave = 0;
+
+	/* scenes referring to each other, the load step sorts that out */
+	if (entry->wave == -2)
+		return 0;
+	if (entry->wave >= 0)
+		return entry->wave;
+
+	entry->wave = -2;
+
+	for (size_t i = 0; i < entry->deps.num; i++) {
+		int dep_wave = load_entry_wave(entries, entry->deps.array[i]);
+		if (dep_wave + 1 > wave)
+			wave = dep_wave + 1;
+	}
+
+	entry->wave = wave;
+	return wave;
+}
+
+static void load_entry_create(struct load_entry *entry)
+{
+	profile_start(entry->profile_name);
+	entry->source = obs_load_source(entry->data);
+	profile_end(entry->profile_name);
+}
+
+static void load_wave_run(struct load_wave *wave)
+{
+	for (;;) {
+		size_t i = (size_t)os_atomic_inc_long(&wave->next) - 1;
+		if (i >= wave->parallel.num)
+			break;
+
+		load_entry_create(&wave->entries[wave->parallel.array[i]]);
+	}
+}
+
+static void *load_sources_thread(void *param)
+{
+	os_set_thread_name("obs_load_sources");
+
+	profile_start(load_sources_thread_name);
+	load_wave_run(param);
+	profile_end(load_sources_thread_name);
+	return NULL;
+}
+
+static void load_sources_wave(struct load_entry *entries, size_t count,
+			      int wave_idx, size_t max_threads)
+{
+	struct load_wave wave = {.entries = entries};
+	DARRAY(pthread_t) threads;
+
+	da_init(wave.parallel);
+	da_init(threads);
+
+	for (size_t i = 0; i < count; i++) {
+		if (entries[i].wave == wave_idx && entries[i].parallel)
+			da_push_back(wave.parallel, &i);
+	}
+
+	/* the calling thread takes its share as well */
+	for (size_t i = 1; i < max_threads && i < wave.parallel.num; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, load_sources_thread,
+				   &wave) != 0)
+			break;
+		da_push_back(threads, &thread);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (entries[i].wave != wave_idx || entries[i].parallel)
+			continue;
+
+		pthread_mutex_lock(&obs->data.sources_mutex);
+		load_entry_create(&entries[i]);
+		pthread_mutex_unlock(&obs->data.sources_mutex);
+	}
+
+	load_wave_run(&wave);
+
+	for (size_t i = 0; i < threads.num; i++)
+		pthread_join(threads.array[i], NULL);
+
+	da_free(threads);
+	da_free(wave.parallel);
+}
+
+void obs_load_sources_threaded(obs_data_array_t *array, obs_load_source_cb cb,
+			       void *private_data)
+{
+	struct obs_core_data *data = &obs->data;
+	size_t count = obs_data_array_count(array);
+	size_t max_threads;
+	struct load_entry *entries;
+	obs_data_t *names;
+	int waves = 0;
+
+	if (!count)
+		return;
+
+	profile_start(load_sources_name);
+
+	entries = bzalloc(count * sizeof(struct load_entry));
+	names = obs_data_create();
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *source_data = obs_data_array_item(array, i);
+		const char *name = obs_data_get_string(source_data, "name");
+
+		load_entry_init(&entries[i], source_data);
+		obs_data_set_int(names, name, (long long)i);
+	}
+
+	for (size_t i = 0; i < count; i++)
+		load_entry_find_deps(entries, i, names);
+
+	for (size_t i = 0; i < count; i++) {
+		int wave = load_entry_wave(entries, i);
+		if (wave > waves)
+			waves = wave;
+	}
+
+	max_threads = (size_t)os_get_logical_cores();
+	if (max_threads > MAX_LOAD_THREADS)
+		max_threads = MAX_LOAD_THREADS;
+	if (max_threads < 1)
+		max_threads = 1;
+
+	profile_start(load_sources_create_name);
+	for (int wave = 0; wave <= waves; wave++)
+		load_sources_wave(entries, count, wave, max_threads);
+	profile_end(load_sources_create_name);
+
+	profile_start(load_sources_load_name);
+	pthread_mutex_lock(&data->sources_mutex);
+
+	for (size_t i = 0; i < count; i++) {
+		struct load_entry *entry = &entries[i];
+
+		if (entry->source) {
+			profile_start(entry->profile_name);
+			obs_load_source_finish(entry->source, entry->data, cb,
+					       private_data);
+			profile_end(entry->profile_name);
+		}
+	}
+
+	pthread_mutex_unlock(&data->sources_mutex);
+	profile_end(load_sources_load_name);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_source_release(entries[i].source);
+		obs_data_release(entries[i].data);
+		da_free(entries[i].deps);
+	}
+
+	obs_data_release(names);
+	bfree(entries);
+
+	blog(LOG_INFO, "Loaded %d sources in %d waves on up to %d threads",
+	     (int)count, waves + 1, (int)max_threads);
+
+	profile_end(load_sources_name);
+}
+
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
@@ -2346,6 +2659,18 @@ void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 	video_output_connect(v, conversion, callback, param);
 }
 
+void start_queued_raw_video(video_t *v,
+			    const struct video_scale_info *conversion,
+			    const struct video_input_queue_info *queue,
+			    void (*callback)(void *param,
+					     struct video_data *frame),
+			    void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	os_atomic_inc_long(&video->raw_active);
+	video_output_connect_queued(v, conversion, queue, callback, param);
+}
+
 void stop_raw_video(video_t *v,
 		    void (*callback)(void *param, struct video_data *frame),
 		    void *param)
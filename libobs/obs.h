@@ -705,6 +705,17 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 			     void *private_data);
 
+/**
+ * Loads sources from a data array, creating sources of types flagged with
+ * OBS_SOURCE_PARALLEL_LOAD that don't depend on each other on worker threads.
+ * Everything else is created on the calling thread.  Loading the created
+ * sources and the callback still happen on the calling thread in the order of
+ * the array.
+ */
+EXPORT void obs_load_sources_threaded(obs_data_array_t *array,
+				      obs_load_source_cb cb,
+				      void *private_data);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -1233,6 +1244,33 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+/**
+ * Called by libobs when it no longer needs the data of a frame that was output
+ * with obs_source_output_video_owned.  This is called with the source's async
+ * mutex held, so it should not call back into the source's video functions.
+ */
+typedef void (*obs_source_frame_release_t)(void *param,
+					   struct obs_source_frame *frame);
+
+/**
+ * Outputs asynchronous video data without copying it.  Instead of copying the
+ * frame data into its own buffers, libobs keeps references to the planes of
+ * the frame and calls the release callback once the frame has been uploaded
+ * or dropped.  The frame data must remain valid until then.
+ *
+ * If the frame could not be queued, the release callback is called before
+ * this function returns.  Outputting a NULL frame releases the owned frames
+ * libobs still holds, except for frames held through obs_source_get_frame.
+ *
+ * The frame passed to the release callback is always a copy libobs made of
+ * the frame passed in here, never the same pointer, so use param to tell
+ * which of the caller's frames is being released.
+ */
+EXPORT void obs_source_output_video_owned(obs_source_t *source,
+					  const struct obs_source_frame *frame,
+					  obs_source_frame_release_t release,
+					  void *param);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -1275,7 +1313,11 @@ EXPORT void obs_source_update_properties(obs_source_t *source);
 /** Gets the current async video frame */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
-/** Releases the current async video frame */
+/**
+ * Releases the current async video frame.  Frames output with
+ * obs_source_output_video_owned go back to their source even if source is
+ * NULL, so their release callback is still called.
+ */
 EXPORT void obs_source_release_frame(obs_source_t *source,
 				     struct obs_source_frame *frame);
 
@@ -2084,6 +2126,25 @@ EXPORT void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 EXPORT enum video_format
 obs_encoder_get_preferred_video_format(const obs_encoder_t *encoder);
 
+/**
+ * For video encoders, encodes raw frames on a thread of their own with a
+ * queue of up to depth frames instead of on the video thread, so a slow
+ * encoder doesn't hold up other raw video consumers.  policy sets what happens
+ * to new frames while the queue is full.  A depth of 0 encodes on the video
+ * thread again.  If the encoder is active, this function will trigger a
+ * warning, and do nothing.
+ */
+EXPORT void obs_encoder_set_video_queue(obs_encoder_t *encoder, size_t depth,
+					enum video_input_drop_policy policy);
+
+/**
+ * For video encoders, gets the frame counts, queue depth and latency
+ * histogram of the encoder's raw video input.  Returns false if the encoder
+ * isn't encoding raw video.
+ */
+EXPORT bool obs_encoder_get_video_queue_stats(const obs_encoder_t *encoder,
+					      struct video_input_stats *stats);
+
 /** Gets the default settings for an encoder type */
 EXPORT obs_data_t *obs_encoder_defaults(const char *id);
 EXPORT obs_data_t *obs_encoder_get_defaults(const obs_encoder_t *encoder);
@@ -2148,10 +2209,36 @@ OBS_DEPRECATED
 EXPORT void obs_free_encoder_packet(struct encoder_packet *packet);
 #endif
 
+/**
+ * Packet data is reference counted, the count is a long right in front of the
+ * data.  Plugins that build their own reference counted packets allocate
+ * bmalloc(sizeof(long) + size) with the count set to 1, which is freed with
+ * bfree when the last reference is released.
+ */
 EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 				   struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+struct obs_encoder_packet_pool_stats {
+	uint64_t allocations;
+	/** Allocations served from a previously released block */
+	uint64_t pool_hits;
+	uint64_t pool_misses;
+	/** Allocations too large to be pooled */
+	uint64_t oversized;
+
+	size_t bytes_in_use;
+	size_t peak_bytes_in_use;
+	/** Released blocks kept around for reuse */
+	size_t bytes_cached;
+	/** Peak of in use and cached bytes combined */
+	size_t peak_bytes;
+};
+
+/** Gets statistics of the pool encoder packet data is allocated from */
+EXPORT void obs_encoder_packet_pool_get_stats(
+	struct obs_encoder_packet_pool_stats *stats);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder,
 					 const char *reroute_id);
 
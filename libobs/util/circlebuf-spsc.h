@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+#include <limits.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed capacity single-producer/single-consumer circular buffer.
+ *
+ * One thread may push while another thread pops without any locking.  The
+ * buffer never reallocates, so pushing fails when there is not enough free
+ * space.  The read and write positions are on separate cache lines to prevent
+ * the two threads from invalidating each other's caches.
+ *
+ * Functions marked (producer) may only be called from the producing thread,
+ * functions marked (consumer) only from the consuming thread.
+ */
+
+#define CIRCLEBUF_SPSC_CACHE_LINE 64
+
+struct circlebuf_spsc {
+	uint8_t *data;
+	size_t capacity;
+	size_t mask;
+	uint8_t pad0[CIRCLEBUF_SPSC_CACHE_LINE - sizeof(uint8_t *) -
+		     sizeof(size_t) * 2];
+
+	/* written by the producer only */
+	volatile long write_pos;
+	uint8_t pad1[CIRCLEBUF_SPSC_CACHE_LINE - sizeof(long)];
+
+	/* written by the consumer only */
+	volatile long read_pos;
+	uint8_t pad2[CIRCLEBUF_SPSC_CACHE_LINE - sizeof(long)];
+};
+
+/* positions are free-running and are only ever compared as differences, so
+ * wrapping around is fine as long as the capacity fits in a long */
+static inline size_t circlebuf_spsc_pos(const volatile long *pos)
+{
+	return (size_t)(unsigned long)os_atomic_load_long(pos);
+}
+
+static inline size_t circlebuf_spsc_diff(size_t a, size_t b)
+{
+	return (size_t)(unsigned long)((unsigned long)a - (unsigned long)b);
+}
+
+/** Allocates the buffer, capacity is rounded up to a power of two */
+static inline bool circlebuf_spsc_init(struct circlebuf_spsc *cb,
+				       size_t capacity)
+{
+	size_t size = 1;
+
+	memset(cb, 0, sizeof(*cb));
+
+	if (!capacity || capacity > (size_t)LONG_MAX / 2)
+		return false;
+
+	while (size < capacity)
+		size <<= 1;
+
+	cb->data = (uint8_t *)bmalloc(size);
+	cb->capacity = size;
+	cb->mask = size - 1;
+	return true;
+}
+
+static inline void circlebuf_spsc_free(struct circlebuf_spsc *cb)
+{
+	bfree(cb->data);
+	memset(cb, 0, sizeof(*cb));
+}
+
+/** Amount of data that can currently be read */
+static inline size_t circlebuf_spsc_size(const struct circlebuf_spsc *cb)
+{
+	size_t write_pos = circlebuf_spsc_pos(&cb->write_pos);
+	size_t read_pos = circlebuf_spsc_pos(&cb->read_pos);
+	return circlebuf_spsc_diff(write_pos, read_pos);
+}
+
+/** Amount of data that can currently be written */
+static inline size_t circlebuf_spsc_avail(const struct circlebuf_spsc *cb)
+{
+	return cb->capacity - circlebuf_spsc_size(cb);
+}
+
+/* ------------------------------------------------------------------------- */
+/* bulk access: get pointers in to the buffer, then commit what was used */
+
+/**
+ * (producer) Gets up to two regions that can be written to directly.  Returns
+ * the total writable size.  Call circlebuf_spsc_commit_write afterwards.
+ */
+static inline size_t circlebuf_spsc_write_regions(struct circlebuf_spsc *cb,
+						  void **ptr1, size_t *size1,
+						  void **ptr2, size_t *size2)
+{
+	size_t write_pos = circlebuf_spsc_pos(&cb->write_pos);
+	size_t avail = circlebuf_spsc_avail(cb);
+	size_t offset = write_pos & cb->mask;
+	size_t first = cb->capacity - offset;
+
+	if (first > avail)
+		first = avail;
+
+	*ptr1 = cb->data + offset;
+	*size1 = first;
+	*ptr2 = cb->data;
+	*size2 = avail - first;
+	return avail;
+}
+
+/** (producer) Makes size bytes of written data visible to the consumer */
+static inline void circlebuf_spsc_commit_write(struct circlebuf_spsc *cb,
+					       size_t size)
+{
+	size_t write_pos = circlebuf_spsc_pos(&cb->write_pos);
+	os_atomic_store_long(&cb->write_pos, (long)(write_pos + size));
+}
+
+/**
+ * (consumer) Gets up to two regions of data that can be read directly.
+ * Returns the total readable size.  Call circlebuf_spsc_commit_read once the
+ * data is no longer needed.
+ */
+static inline size_t circlebuf_spsc_read_regions(struct circlebuf_spsc *cb,
+						 const void **ptr1,
+						 size_t *size1,
+						 const void **ptr2,
+						 size_t *size2)
+{
+	size_t read_pos = circlebuf_spsc_pos(&cb->read_pos);
+	size_t size = circlebuf_spsc_size(cb);
+	size_t offset = read_pos & cb->mask;
+	size_t first = cb->capacity - offset;
+
+	if (first > size)
+		first = size;
+
+	*ptr1 = cb->data + offset;
+	*size1 = first;
+	*ptr2 = cb->data;
+	*size2 = size - first;
+	return size;
+}
+
+/** (consumer) Releases size bytes of read data back to the producer */
+static inline void circlebuf_spsc_commit_read(struct circlebuf_spsc *cb,
+					      size_t size)
+{
+	size_t read_pos = circlebuf_spsc_pos(&cb->read_pos);
+	os_atomic_store_long(&cb->read_pos, (long)(read_pos + size));
+}
+
+/* ------------------------------------------------------------------------- */
+/* copying access */
+
+/** (producer) Pushes all of the data, or nothing if there isn't enough room */
+static inline bool circlebuf_spsc_push(struct circlebuf_spsc *cb,
+				       const void *data, size_t size)
+{
+	void *ptr1, *ptr2;
+	size_t size1, size2;
+
+	if (circlebuf_spsc_write_regions(cb, &ptr1, &size1, &ptr2, &size2) <
+	    size)
+		return false;
+
+	if (size <= size1) {
+		memcpy(ptr1, data, size);
+	} else {
+		memcpy(ptr1, data, size1);
+		memcpy(ptr2, (const uint8_t *)data + size1, size - size1);
+	}
+
+	circlebuf_spsc_commit_write(cb, size);
+	return true;
+}
+
+/** (consumer) Copies data from the front without removing it */
+static inline bool circlebuf_spsc_peek(struct circlebuf_spsc *cb, void *data,
+				       size_t size)
+{
+	const void *ptr1, *ptr2;
+	size_t size1, size2;
+
+	if (circlebuf_spsc_read_regions(cb, &ptr1, &size1, &ptr2, &size2) <
+	    size)
+		return false;
+
+	if (data) {
+		if (size <= size1) {
+			memcpy(data, ptr1, size);
+		} else {
+			memcpy(data, ptr1, size1);
+			memcpy((uint8_t *)data + size1, ptr2, size - size1);
+		}
+	}
+
+	return true;
+}
+
+/** (consumer) Pops data from the front, data can be NULL to discard it */
+static inline bool circlebuf_spsc_pop(struct circlebuf_spsc *cb, void *data,
+				      size_t size)
+{
+	if (!circlebuf_spsc_peek(cb, data, size))
+		return false;
+
+	circlebuf_spsc_commit_read(cb, size);
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
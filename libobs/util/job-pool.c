@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "job-pool.h"
+#include "threading.h"
+#include "darray.h"
+#include "bmem.h"
+
+struct os_job_pool {
+	char *name;
+	DARRAY(pthread_t) threads;
+
+	pthread_mutex_t run_mutex;
+	os_sem_t *wake;
+	os_event_t *done;
+	volatile bool stop;
+
+	/* the current batch */
+	os_job_func_t func;
+	void *param;
+	size_t count;
+	volatile long next;
+	volatile long busy;
+};
+
+static void job_pool_work(os_job_pool_t *pool)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&pool->next) - 1;
+		if (idx >= pool->count)
+			break;
+
+		pool->func(pool->param, idx);
+	}
+}
+
+static void *job_pool_thread(void *param)
+{
+	os_job_pool_t *pool = param;
+
+	os_set_thread_name(pool->name);
+
+	for (;;) {
+		os_sem_wait(pool->wake);
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		job_pool_work(pool);
+
+		if (os_atomic_dec_long(&pool->busy) == 0)
+			os_event_signal(pool->done);
+	}
+
+	return NULL;
+}
+
+os_job_pool_t *os_job_pool_create(const char *name, size_t threads)
+{
+	os_job_pool_t *pool = bzalloc(sizeof(struct os_job_pool));
+
+	pool->name = bstrdup(name ? name : "job pool");
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&pool->wake, 0) != 0)
+		goto fail_sem;
+	if (os_event_init(&pool->done, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+
+	for (size_t i = 0; i < threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, job_pool_thread, pool) != 0)
+			break;
+		da_push_back(pool->threads, &thread);
+	}
+
+	return pool;
+
+fail_event:
+	os_sem_destroy(pool->wake);
+fail_sem:
+	pthread_mutex_destroy(&pool->run_mutex);
+fail_mutex:
+	bfree(pool->name);
+	bfree(pool);
+	return NULL;
+}
+
+void os_job_pool_destroy(os_job_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	os_atomic_set_bool(&pool->stop, true);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		os_sem_post(pool->wake);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	os_event_destroy(pool->done);
+	os_sem_destroy(pool->wake);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->name);
+	bfree(pool);
+}
+
+size_t os_job_pool_get_threads(const os_job_pool_t *pool)
+{
+	return pool ? pool->threads.num : 0;
+}
+
+void os_job_pool_run(os_job_pool_t *pool, os_job_func_t func, void *param,
+		     size_t count)
+{
+	size_t wake_count;
+
+	if (!count)
+		return;
+
+	/* single jobs aren't worth waking anything up for */
+	if (!pool || !pool->threads.num || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			func(param, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_mutex);
+
+	wake_count = count - 1;
+	if (wake_count > pool->threads.num)
+		wake_count = pool->threads.num;
+
+	pool->func = func;
+	pool->param = param;
+	pool->count = count;
+	pool->next = 0;
+	pool->busy = (long)wake_count;
+
+	for (size_t i = 0; i < wake_count; i++)
+		os_sem_post(pool->wake);
+
+	job_pool_work(pool);
+
+	/* the batch belongs to the pool until every thread that was woken up
+	 * is done with it */
+	os_event_wait(pool->done);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Job pool
+ *
+ *   Runs a batch of independent jobs over a fixed set of worker threads and
+ * returns once all of them are done.  The calling thread runs jobs as well,
+ * so a pool created with no threads just runs everything on the caller.
+ *
+ *   Meant for short bursts of work that gets repeated often (per frame work
+ * on every source and such), so the threads are kept around and only woken
+ * up when there's something to do.  Only one batch runs at a time.
+ */
+
+struct os_job_pool;
+typedef struct os_job_pool os_job_pool_t;
+
+typedef void (*os_job_func_t)(void *param, size_t idx);
+
+EXPORT os_job_pool_t *os_job_pool_create(const char *name, size_t threads);
+EXPORT void os_job_pool_destroy(os_job_pool_t *pool);
+
+/** Number of worker threads, not counting the calling thread */
+EXPORT size_t os_job_pool_get_threads(const os_job_pool_t *pool);
+
+/** Calls func(param, idx) for each idx below count */
+EXPORT void os_job_pool_run(os_job_pool_t *pool, os_job_func_t func,
+			    void *param, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -263,6 +263,130 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+/* Every thread records its begin/end events into its own ring, so recording
+ * takes no locks.  A ring is only registered once, the first time its thread
+ * records an event while tracing is enabled.  When the thread exits, its ring
+ * is kept (so its events can still be dumped) until a new thread reuses it. */
+typedef struct trace_event trace_event;
+struct trace_event {
+	const char *name;
+	uint64_t time;
+	bool begin;
+};
+
+typedef struct trace_buffer trace_buffer;
+struct trace_buffer {
+	trace_buffer *next;
+	long thread_id;
+	const char *thread_name;
+	bool in_use;
+	size_t mask;
+	volatile long written;
+	trace_event *events;
+};
+
+static volatile bool trace_enabled = false;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t trace_events_per_thread = 0;
+static trace_buffer *trace_buffers = NULL;
+static long trace_thread_count = 0;
+static volatile long trace_generation = 0;
+
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+static THREAD_LOCAL trace_buffer *thread_trace = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+
+static void release_trace_buffer(void *data)
+{
+	pthread_mutex_lock(&trace_mutex);
+	/* the ring is already gone if profiler_free was called since */
+	if (thread_trace_generation == trace_generation)
+		((trace_buffer *)data)->in_use = false;
+	pthread_mutex_unlock(&trace_mutex);
+
+	thread_trace = NULL;
+}
+
+static void create_trace_key(void)
+{
+	pthread_key_create(&trace_key, release_trace_buffer);
+}
+
+static trace_buffer *reuse_trace_buffer(void)
+{
+	for (trace_buffer *buffer = trace_buffers; buffer;
+	     buffer = buffer->next) {
+		if (!buffer->in_use &&
+		    buffer->mask == trace_events_per_thread - 1) {
+			buffer->written = 0;
+			return buffer;
+		}
+	}
+
+	return NULL;
+}
+
+static trace_buffer *create_trace_buffer(const char *name)
+{
+	trace_buffer *buffer = NULL;
+
+	pthread_once(&trace_key_once, create_trace_key);
+
+	pthread_mutex_lock(&trace_mutex);
+	if (trace_events_per_thread) {
+		buffer = reuse_trace_buffer();
+		if (!buffer) {
+			buffer = bzalloc(sizeof(trace_buffer));
+			buffer->mask = trace_events_per_thread - 1;
+			buffer->events = bzalloc(trace_events_per_thread *
+						 sizeof(trace_event));
+			buffer->next = trace_buffers;
+			trace_buffers = buffer;
+		}
+
+		buffer->thread_id = ++trace_thread_count;
+		buffer->thread_name = name;
+		buffer->in_use = true;
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	if (buffer)
+		pthread_setspecific(trace_key, buffer);
+
+	return buffer;
+}
+
+static void trace_record(const char *name, uint64_t time, bool begin)
+{
+	long generation = os_atomic_load_long(&trace_generation);
+	trace_buffer *buffer = thread_trace;
+
+	/* the rings were freed by profiler_free since this thread last
+	 * recorded an event */
+	if (thread_trace_generation != generation) {
+		thread_trace_generation = generation;
+		buffer = NULL;
+	}
+
+	if (!buffer) {
+		buffer = create_trace_buffer(name);
+		if (!buffer)
+			return;
+
+		thread_trace = buffer;
+	}
+
+	long pos = buffer->written;
+	trace_event *event = &buffer->events[(size_t)pos & buffer->mask];
+	event->name = name;
+	event->time = time;
+	event->begin = begin;
+
+	os_atomic_set_long(&buffer->written, pos + 1);
+}
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -367,6 +491,9 @@ static void merge_context(profile_call *context)
 
 void profile_start(const char *name)
 {
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_record(name, os_gettime_ns(), true);
+
 	if (!thread_enabled)
 		return;
 
@@ -395,6 +522,9 @@ void profile_start(const char *name)
 void profile_end(const char *name)
 {
 	uint64_t end = os_gettime_ns();
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_record(name, end, false);
+
 	if (!thread_enabled)
 		return;
 
@@ -825,6 +955,167 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	pthread_mutex_lock(&trace_mutex);
+	os_atomic_set_bool(&trace_enabled, false);
+	os_atomic_inc_long(&trace_generation);
+	trace_buffer *buffer = trace_buffers;
+	trace_buffers = NULL;
+	trace_thread_count = 0;
+	pthread_mutex_unlock(&trace_mutex);
+
+	while (buffer) {
+		trace_buffer *next = buffer->next;
+		bfree(buffer->events);
+		bfree(buffer);
+		buffer = next;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Tracing */
+
+void profiler_trace_start(size_t events_per_thread)
+{
+	size_t size = 64;
+
+	while (size < events_per_thread)
+		size <<= 1;
+
+	/* threads that already have a ring keep its size */
+	pthread_mutex_lock(&trace_mutex);
+	trace_events_per_thread = size;
+	os_atomic_set_bool(&trace_enabled, true);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void profiler_trace_stop(void)
+{
+	os_atomic_set_bool(&trace_enabled, false);
+}
+
+typedef DARRAY(trace_event) trace_events_t;
+
+static void copy_trace_events(trace_buffer *buffer, trace_events_t *events)
+{
+	long size = (long)buffer->mask + 1;
+	long end = os_atomic_load_long(&buffer->written);
+	long start = end > size ? end - size : 0;
+
+	da_resize((*events), 0);
+	for (long i = start; i < end; i++) {
+		trace_event *event = &buffer->events[(size_t)i & buffer->mask];
+		da_push_back((*events), event);
+	}
+
+	/* the thread keeps recording while its events are copied, drop the
+	 * ones it may have overwritten in the meantime */
+	long written = os_atomic_load_long(&buffer->written);
+	long overwritten = written - size + 1 - start;
+	if (overwritten > 0) {
+		size_t count = (size_t)overwritten < events->num
+				       ? (size_t)overwritten
+				       : events->num;
+		da_erase_range((*events), 0, count);
+	}
+}
+
+static void dstr_cat_json_string(struct dstr *buffer, const char *str)
+{
+	dstr_cat_ch(buffer, '"');
+	for (; str && *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(buffer, '\\');
+			dstr_cat_ch(buffer, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(buffer, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(buffer, (char)ch);
+		}
+	}
+	dstr_cat_ch(buffer, '"');
+}
+
+typedef struct trace_snapshot trace_snapshot;
+struct trace_snapshot {
+	long thread_id;
+	const char *thread_name;
+	trace_events_t events;
+};
+
+static void dump_trace_thread(FILE *f, trace_snapshot *snapshot, bool *first)
+{
+	struct dstr out = {0};
+	size_t depth = 0;
+
+	dstr_printf(&out,
+		    "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		    "\"tid\":%ld,\"args\":{\"name\":",
+		    *first ? "" : ",\n", snapshot->thread_id);
+	dstr_cat_json_string(&out, snapshot->thread_name);
+	dstr_cat(&out, "}}");
+	*first = false;
+
+	for (size_t i = 0; i < snapshot->events.num; i++) {
+		trace_event *event = &snapshot->events.array[i];
+
+		/* the begin events of these were overwritten already */
+		if (!event->begin && !depth)
+			continue;
+
+		depth = event->begin ? depth + 1 : depth - 1;
+
+		dstr_cat(&out, ",\n{\"name\":");
+		dstr_cat_json_string(&out, event->name);
+		dstr_catf(&out,
+			  ",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03" PRIu64
+			  ",\"pid\":1,\"tid\":%ld}",
+			  event->begin ? 'B' : 'E', event->time / 1000,
+			  event->time % 1000, snapshot->thread_id);
+	}
+
+	if (out.len)
+		fwrite(out.array, 1, out.len, f);
+	dstr_free(&out);
+}
+
+bool profiler_trace_dump_json(const char *filename)
+{
+	DARRAY(trace_snapshot) snapshots = {0};
+	bool first = true;
+	bool success = false;
+
+	/* copy the events under the lock, the file is written without it so
+	 * threads starting to trace don't wait on the disk */
+	pthread_mutex_lock(&trace_mutex);
+	for (trace_buffer *buffer = trace_buffers; buffer;
+	     buffer = buffer->next) {
+		trace_snapshot *snapshot = da_push_back_new(snapshots);
+		snapshot->thread_id = buffer->thread_id;
+		snapshot->thread_name = buffer->thread_name;
+		copy_trace_events(buffer, &snapshot->events);
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	FILE *f = os_fopen(filename, "wb");
+	if (f) {
+		fputs("{\"traceEvents\":[\n", f);
+
+		for (size_t i = 0; i < snapshots.num; i++)
+			dump_trace_thread(f, &snapshots.array[i], &first);
+
+		fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+		fclose(f);
+		success = true;
+	}
+
+	for (size_t i = 0; i < snapshots.num; i++)
+		da_free(snapshots.array[i].events);
+	da_free(snapshots);
+
+	return success;
 }
 
 /* ------------------------------------------------------------------------- */
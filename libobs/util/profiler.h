@@ -33,6 +33,27 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Tracing */
+
+/**
+ * Starts recording the begin and end of every profile call into a ring of
+ * events per thread, which can be dumped with profiler_trace_dump_json to see
+ * when calls happened and how threads overlapped.  Only the most recent
+ * events_per_thread events (rounded up to a power of two) of each thread are
+ * kept.  The ring of a thread that exited is reused by the next thread that
+ * records events.  Tracing does not depend on profiler_start.
+ */
+EXPORT void profiler_trace_start(size_t events_per_thread);
+EXPORT void profiler_trace_stop(void);
+
+/**
+ * Writes the recorded events as a Chrome trace event JSON file, which can be
+ * opened with chrome://tracing or the Perfetto UI.  Can be called while
+ * tracing.
+ */
+EXPORT bool profiler_trace_dump_json(const char *filename);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
@@ -33,6 +33,8 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 	enq.memory = V4L2_MEMORY_MMAP;
 
 	for (enq.index = 0; enq.index < buf->count; ++enq.index) {
+		if (buf->info[enq.index].held)
+			continue;
 		if (v4l2_ioctl(dev, VIDIOC_QBUF, &enq) < 0) {
 			blog(LOG_ERROR, "unable to queue buffer");
 			return -1;
@@ -48,6 +50,23 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf)
 	return 0;
 }
 
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, uint32_t index)
+{
+	struct v4l2_buffer enq;
+
+	memset(&enq, 0, sizeof(enq));
+	enq.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	enq.memory = V4L2_MEMORY_MMAP;
+	enq.index = index;
+
+	if (v4l2_ioctl(dev, VIDIOC_QBUF, &enq) < 0) {
+		blog(LOG_ERROR, "unable to queue buffer");
+		return -1;
+	}
+
+	return 0;
+}
+
 int_fast32_t v4l2_stop_capture(int_fast32_t dev)
 {
 	enum v4l2_buf_type type;
@@ -100,13 +119,14 @@ int_fast32_t v4l2_query_all_buffers(int_fast32_t dev,
 }
 #endif
 
-int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
+int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf,
+			      uint32_t count)
 {
 	struct v4l2_requestbuffers req;
 	struct v4l2_buffer map;
 
 	memset(&req, 0, sizeof(req));
-	req.count = 4;
+	req.count = count;
 	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	req.memory = V4L2_MEMORY_MMAP;
 
@@ -35,6 +35,8 @@ struct v4l2_mmap_info {
 	size_t length;
 	/** start address of the mapped buffer */
 	void *start;
+	/** buffer is held by libobs and must not be queued */
+	bool held;
 };
 
 /**
@@ -165,8 +167,8 @@ static void v4l2_unpack_tuple(int *a, int *b, int packed)
 /**
  * Start the video capture on the device.
  *
- * This enqueues the memory mapped buffers and instructs the device to start
- * the video stream.
+ * This enqueues the memory mapped buffers that are not held and instructs the
+ * device to start the video stream.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
@@ -175,6 +177,16 @@ static void v4l2_unpack_tuple(int *a, int *b, int packed)
  */
 int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf);
 
+/**
+ * Enqueue a single memory mapped buffer
+ *
+ * @param dev handle for the v4l2 device
+ * @param index index of the buffer
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, uint32_t index);
+
 /**
  * Stop the video capture on the device.
  *
@@ -215,14 +227,17 @@ int_fast32_t v4l2_query_all_buffers(int_fast32_t dev,
 /**
  * Create memory mapping for buffers
  *
- * This tries to map at least 2, preferably 4, buffers to application memory.
+ * This tries to map at least 2, preferably count, buffers to application
+ * memory.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
+ * @param count number of buffers to request
  *
  * @return negative on failure
  */
-int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf);
+int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf,
+			      uint32_t count);
 
 /**
  * Destroy the memory mapping for buffers
@@ -37,6 +37,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "v4l2-controls.h"
 #include "v4l2-helpers.h"
+#include "v4l2-mjpeg.h"
 
 #if HAVE_UDEV
 #include "v4l2-udev.h"
@@ -62,6 +63,52 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/* buffers that always stay queued on the device in zero copy mode */
+#define V4L2_MIN_QUEUED_BUFFERS 2
+
+struct v4l2_ring;
+
+/**
+ * Slot of a buffer in the zero copy ring, used as the release callback param
+ */
+struct v4l2_ring_slot {
+	struct v4l2_ring *ring;
+	uint32_t index;
+};
+
+/**
+ * Memory mapped buffers that are handed to libobs without copying
+ *
+ * A buffer held by libobs is only queued on the device again once libobs
+ * releases the frame.  The ring owns the device handle and the mappings so
+ * that libobs can still release frames after the capture stopped, and is
+ * freed with the last release.
+ */
+struct v4l2_ring {
+	pthread_mutex_t mutex;
+	int_fast32_t dev;
+	struct v4l2_buffer_data buffers;
+	struct v4l2_ring_slot *slots;
+	volatile long held;
+	bool streaming;
+	bool stopped;
+};
+
+/**
+ * Capture statistics, written by the capture thread
+ */
+struct v4l2_stats {
+	volatile long max_held;
+	volatile long dropped_frames;
+	volatile long late_frames;
+	volatile long copied_frames;
+	volatile long jitter_us;
+	volatile long max_jitter_us;
+
+	uint64_t last_dequeue;
+	uint32_t last_sequence;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -91,6 +138,16 @@ struct v4l2_data {
 
 	bool auto_reset;
 	int timeout_frames;
+
+	bool zero_copy;
+	int buffer_count;
+	int mjpeg_threads;
+	/* the ring and mjpeg pointers are protected by ring_mutex for the
+	 * stats proc */
+	struct v4l2_ring *ring;
+	struct v4l2_mjpeg *mjpeg;
+	pthread_mutex_t ring_mutex;
+	struct v4l2_stats stats;
 };
 
 /* forward declarations */
@@ -98,6 +155,15 @@ static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 static void v4l2_update(void *vptr, obs_data_t *settings);
 
+/**
+ * Check if a pixel format can be captured, either directly or by decoding it
+ */
+static inline bool v4l2_format_supported(uint_fast32_t format)
+{
+	return format == V4L2_PIX_FMT_MJPEG ||
+	       v4l2_to_obs_video_format(format) != VIDEO_FORMAT_NONE;
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -149,6 +215,273 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+/**
+ * Create a zero copy ring, this takes over the device handle and the buffers
+ */
+static struct v4l2_ring *v4l2_ring_create(int_fast32_t dev,
+					  struct v4l2_buffer_data *buffers)
+{
+	struct v4l2_ring *ring = bzalloc(sizeof(struct v4l2_ring));
+
+	pthread_mutex_init_value(&ring->mutex);
+	if (pthread_mutex_init(&ring->mutex, NULL) != 0) {
+		bfree(ring);
+		return NULL;
+	}
+
+	ring->dev = dev;
+	ring->buffers = *buffers;
+	ring->slots = bzalloc(buffers->count * sizeof(struct v4l2_ring_slot));
+	for (uint_fast32_t i = 0; i < buffers->count; ++i) {
+		ring->slots[i].ring = ring;
+		ring->slots[i].index = (uint32_t)i;
+	}
+
+	memset(buffers, 0, sizeof(*buffers));
+	return ring;
+}
+
+static void v4l2_ring_destroy(struct v4l2_ring *ring)
+{
+	v4l2_destroy_mmap(&ring->buffers);
+	if (ring->dev != -1)
+		v4l2_close(ring->dev);
+
+	pthread_mutex_destroy(&ring->mutex);
+	bfree(ring->slots);
+	bfree(ring);
+}
+
+/**
+ * Called once capture stopped, frees the ring unless libobs still holds
+ * buffers
+ */
+static void v4l2_ring_stop(struct v4l2_ring *ring)
+{
+	bool destroy;
+
+	pthread_mutex_lock(&ring->mutex);
+	ring->stopped = true;
+	destroy = os_atomic_load_long(&ring->held) == 0;
+	pthread_mutex_unlock(&ring->mutex);
+
+	if (destroy)
+		v4l2_ring_destroy(ring);
+}
+
+/**
+ * Mark a dequeued buffer as held by libobs, fails if this would leave too
+ * few buffers queued on the device
+ */
+static bool v4l2_ring_hold(struct v4l2_ring *ring, uint32_t index,
+			   struct v4l2_stats *stats)
+{
+	long held;
+
+	pthread_mutex_lock(&ring->mutex);
+
+	held = os_atomic_load_long(&ring->held);
+	if ((uint_fast32_t)held + V4L2_MIN_QUEUED_BUFFERS >=
+	    ring->buffers.count) {
+		pthread_mutex_unlock(&ring->mutex);
+		return false;
+	}
+
+	ring->buffers.info[index].held = true;
+	held = os_atomic_inc_long(&ring->held);
+
+	pthread_mutex_unlock(&ring->mutex);
+
+	if (held > os_atomic_load_long(&stats->max_held))
+		os_atomic_set_long(&stats->max_held, held);
+	return true;
+}
+
+/**
+ * Release callback for frames output with obs_source_output_video_owned
+ */
+static void v4l2_release_frame(void *param, struct obs_source_frame *frame)
+{
+	struct v4l2_ring_slot *slot = param;
+	struct v4l2_ring *ring = slot->ring;
+	bool destroy;
+
+	pthread_mutex_lock(&ring->mutex);
+
+	ring->buffers.info[slot->index].held = false;
+	os_atomic_dec_long(&ring->held);
+
+	if (ring->streaming)
+		v4l2_queue_buffer(ring->dev, slot->index);
+
+	destroy = ring->stopped && os_atomic_load_long(&ring->held) == 0;
+
+	pthread_mutex_unlock(&ring->mutex);
+
+	if (destroy)
+		v4l2_ring_destroy(ring);
+
+	UNUSED_PARAMETER(frame);
+}
+
+static int_fast32_t v4l2_capture_start(struct v4l2_data *data)
+{
+	struct v4l2_ring *ring = data->ring;
+	int_fast32_t ret;
+
+	if (!ring)
+		return v4l2_start_capture(data->dev, &data->buffers);
+
+	pthread_mutex_lock(&ring->mutex);
+	ret = v4l2_start_capture(ring->dev, &ring->buffers);
+	ring->streaming = ret == 0;
+	pthread_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+static int_fast32_t v4l2_capture_reset(struct v4l2_data *data)
+{
+	struct v4l2_ring *ring = data->ring;
+	int_fast32_t ret;
+
+	if (!ring)
+		return v4l2_reset_capture(data->dev, &data->buffers);
+
+	/* buffers libobs holds are queued again once they are released */
+	pthread_mutex_lock(&ring->mutex);
+	ret = v4l2_reset_capture(ring->dev, &ring->buffers);
+	ring->streaming = ret == 0;
+	pthread_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+static void v4l2_capture_stop(struct v4l2_data *data)
+{
+	struct v4l2_ring *ring = data->ring;
+
+	if (!ring) {
+		v4l2_stop_capture(data->dev);
+		return;
+	}
+
+	pthread_mutex_lock(&ring->mutex);
+	ring->streaming = false;
+	v4l2_stop_capture(ring->dev);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+static int v4l2_dequeue(struct v4l2_data *data, struct v4l2_buffer *buf)
+{
+	struct v4l2_ring *ring = data->ring;
+	int ret;
+
+	if (!ring)
+		return v4l2_ioctl(data->dev, VIDIOC_DQBUF, buf);
+
+	pthread_mutex_lock(&ring->mutex);
+	ret = v4l2_ioctl(ring->dev, VIDIOC_DQBUF, buf);
+	pthread_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+/**
+ * Hand a dequeued buffer to libobs
+ *
+ * In zero copy mode the buffer is referenced by libobs and queued again once
+ * libobs releases it, unless too few buffers would be left on the device, in
+ * which case the frame is copied like in the normal mode.
+ *
+ * @return negative if the buffer could not be queued again
+ */
+static int v4l2_output_buffer(struct v4l2_data *data, struct v4l2_buffer *buf,
+			      struct obs_source_frame *out,
+			      const size_t *plane_offsets)
+{
+	struct v4l2_ring *ring = data->ring;
+	struct v4l2_buffer_data *buffers = ring ? &ring->buffers
+						: &data->buffers;
+	uint8_t *start = (uint8_t *)buffers->info[buf->index].start;
+	int ret;
+
+	for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+		out->data[i] = start + plane_offsets[i];
+
+	if (ring && v4l2_ring_hold(ring, buf->index, &data->stats)) {
+		obs_source_output_video_owned(data->source, out,
+					      v4l2_release_frame,
+					      &ring->slots[buf->index]);
+		return 0;
+	}
+
+	obs_source_output_video(data->source, out);
+
+	if (!ring)
+		return v4l2_ioctl(data->dev, VIDIOC_QBUF, buf);
+
+	os_atomic_inc_long(&data->stats.copied_frames);
+
+	pthread_mutex_lock(&ring->mutex);
+	ret = v4l2_ioctl(ring->dev, VIDIOC_QBUF, buf);
+	pthread_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+/**
+ * Queue a dequeued MJPEG buffer for decoding
+ *
+ * The compressed data is copied by the decoder pool, so the buffer can be
+ * queued on the device again right away.
+ *
+ * @return negative if the buffer could not be queued again
+ */
+static int v4l2_output_mjpeg(struct v4l2_data *data, struct v4l2_buffer *buf,
+			     uint64_t timestamp)
+{
+	uint8_t *start = (uint8_t *)data->buffers.info[buf->index].start;
+
+	v4l2_mjpeg_decode(data->mjpeg, start, buf->bytesused, timestamp);
+	return v4l2_ioctl(data->dev, VIDIOC_QBUF, buf);
+}
+
+/**
+ * Update the dequeue statistics
+ *
+ * Dropped frames are gaps in the sequence numbers of the device, late frames
+ * are frames dequeued more than 1.5 frame periods after the previous one, and
+ * the jitter is the smoothed deviation of the dequeue interval from the frame
+ * period.
+ */
+static void v4l2_update_stats(struct v4l2_stats *stats,
+			      const struct v4l2_buffer *buf, uint64_t period)
+{
+	uint64_t now = os_gettime_ns();
+
+	if (stats->last_dequeue) {
+		uint64_t interval = now - stats->last_dequeue;
+		uint64_t diff = interval > period ? interval - period
+						  : period - interval;
+		long diff_us = (long)(diff / 1000);
+		long jitter = os_atomic_load_long(&stats->jitter_us);
+
+		jitter += (diff_us - jitter) / 16;
+		os_atomic_set_long(&stats->jitter_us, jitter);
+
+		if (diff_us > os_atomic_load_long(&stats->max_jitter_us))
+			os_atomic_set_long(&stats->max_jitter_us, diff_us);
+		if (interval > period * 3 / 2)
+			os_atomic_inc_long(&stats->late_frames);
+		if (buf->sequence > stats->last_sequence + 1)
+			os_atomic_set_long(
+				&stats->dropped_frames,
+				os_atomic_load_long(&stats->dropped_frames) +
+					(long)(buf->sequence -
+					       stats->last_sequence - 1));
+	}
+
+	stats->last_dequeue = now;
+	stats->last_sequence = buf->sequence;
+}
+
 /*
  * Worker thread to get video data
  */
@@ -157,7 +490,6 @@ static void *v4l2_thread(void *vptr)
 	V4L2_DATA(vptr);
 	int r;
 	fd_set fds;
-	uint8_t *start;
 	uint64_t frames;
 	uint64_t first_ts;
 	struct timeval tv;
@@ -167,6 +499,7 @@ static void *v4l2_thread(void *vptr)
 	int fps_num, fps_denom;
 	float ffps;
 	uint64_t timeout_usec;
+	uint64_t period;
 
 	blog(LOG_DEBUG, "%s: new capture thread", data->device_id);
 	os_set_thread_name("v4l2: capture");
@@ -179,8 +512,9 @@ static void *v4l2_thread(void *vptr)
 	timeout_usec = (1000000 * data->timeout_frames) / ffps;
 	blog(LOG_INFO, "%s: select timeout set to %ldus (%dx frame periods)",
 	     data->device_id, timeout_usec, data->timeout_frames);
+	period = fps_denom ? (uint64_t)fps_num * 1000000000ULL / fps_denom : 0;
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	if (v4l2_capture_start(data) < 0)
 		goto exit;
 
 	blog(LOG_DEBUG, "%s: new capture started", data->device_id);
@@ -210,7 +544,9 @@ static void *v4l2_thread(void *vptr)
 			     data->device_id);
 
 #ifdef _DEBUG
-			v4l2_query_all_buffers(data->dev, &data->buffers);
+			v4l2_query_all_buffers(data->dev,
+					       data->ring ? &data->ring->buffers
+							  : &data->buffers);
 #endif
 
 			if (v4l2_ioctl(data->dev, VIDIOC_LOG_STATUS) < 0) {
@@ -219,8 +555,7 @@ static void *v4l2_thread(void *vptr)
 			}
 
 			if (data->auto_reset) {
-				if (v4l2_reset_capture(data->dev,
-						       &data->buffers) == 0)
+				if (v4l2_capture_reset(data) == 0)
 					blog(LOG_INFO,
 					     "%s: stream reset successful",
 					     data->device_id);
@@ -235,7 +570,7 @@ static void *v4l2_thread(void *vptr)
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.memory = V4L2_MEMORY_MMAP;
 
-		if (v4l2_ioctl(data->dev, VIDIOC_DQBUF, &buf) < 0) {
+		if (v4l2_dequeue(data, &buf) < 0) {
 			if (errno == EAGAIN) {
 				blog(LOG_DEBUG, "%s: ioctl dqbuf eagain",
 				     data->device_id);
@@ -251,17 +586,19 @@ static void *v4l2_thread(void *vptr)
 		     data->device_id, buf.timestamp.tv_usec, buf.index,
 		     buf.flags, buf.sequence, buf.length, buf.bytesused);
 
+		v4l2_update_stats(&data->stats, &buf, period);
+
 		out.timestamp = timeval2ns(buf.timestamp);
 		if (!frames)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *)data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+		if (data->mjpeg)
+			r = v4l2_output_mjpeg(data, &buf, out.timestamp);
+		else
+			r = v4l2_output_buffer(data, &buf, &out, plane_offsets);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+		if (r < 0) {
 			blog(LOG_ERROR, "%s: failed to enqueue buffer",
 			     data->device_id);
 			break;
@@ -272,9 +609,34 @@ static void *v4l2_thread(void *vptr)
 
 	blog(LOG_INFO, "%s: Stopped capture after %" PRIu64 " frames",
 	     data->device_id, frames);
+	blog(LOG_INFO,
+	     "%s: dropped frames: %ld, late frames: %ld, "
+	     "dequeue jitter: %.2fms (max %.2fms)",
+	     data->device_id, os_atomic_load_long(&data->stats.dropped_frames),
+	     os_atomic_load_long(&data->stats.late_frames),
+	     (double)os_atomic_load_long(&data->stats.jitter_us) / 1000.0,
+	     (double)os_atomic_load_long(&data->stats.max_jitter_us) / 1000.0);
+	if (data->ring)
+		blog(LOG_INFO,
+		     "%s: zero copy: at most %ld buffers held, "
+		     "%ld frames copied",
+		     data->device_id,
+		     os_atomic_load_long(&data->stats.max_held),
+		     os_atomic_load_long(&data->stats.copied_frames));
+	if (data->mjpeg) {
+		struct v4l2_mjpeg_stats stats;
+
+		v4l2_mjpeg_get_stats(data->mjpeg, &stats);
+		blog(LOG_INFO,
+		     "%s: mjpeg: %ld frames decoded, %ld dropped, "
+		     "%ld failed, at most %ld pending",
+		     data->device_id, stats.decoded_frames,
+		     stats.dropped_frames, stats.failed_frames,
+		     stats.max_pending);
+	}
 
 exit:
-	v4l2_stop_capture(data->dev);
+	v4l2_capture_stop(data);
 	return NULL;
 }
 
@@ -296,6 +658,9 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "buffering", true);
 	obs_data_set_default_bool(settings, "auto_reset", false);
 	obs_data_set_default_int(settings, "timeout_frames", 5);
+	obs_data_set_default_bool(settings, "zero_copy", false);
+	obs_data_set_default_int(settings, "buffer_count", 4);
+	obs_data_set_default_int(settings, "mjpeg_threads", 2);
 }
 
 /**
@@ -456,8 +821,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat) !=
-		    VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 						  fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -862,6 +1226,13 @@ static obs_properties_t *v4l2_properties(void *vptr)
 			       obs_module_text("FramesUntilTimeout"), 2, 120,
 			       1);
 
+	obs_properties_add_bool(props, "zero_copy",
+				obs_module_text("ZeroCopy"));
+	obs_properties_add_int(props, "buffer_count",
+			       obs_module_text("BufferCount"), 2, 32, 1);
+	obs_properties_add_int(props, "mjpeg_threads",
+			       obs_module_text("MJPEGThreads"), 1, 16, 1);
+
 	// a group to contain the camera control
 	obs_properties_t *ctrl_props = obs_properties_create();
 	obs_properties_add_group(props, "controls",
@@ -890,6 +1261,31 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+	if (data->mjpeg) {
+		struct v4l2_mjpeg *mjpeg = data->mjpeg;
+
+		pthread_mutex_lock(&data->ring_mutex);
+		data->mjpeg = NULL;
+		pthread_mutex_unlock(&data->ring_mutex);
+
+		v4l2_mjpeg_destroy(mjpeg);
+	}
+
+	if (data->ring) {
+		struct v4l2_ring *ring = data->ring;
+
+		/* libobs gives back the buffers it still holds, the ring
+		 * stays around for any that are released later */
+		obs_source_output_video(data->source, NULL);
+
+		pthread_mutex_lock(&data->ring_mutex);
+		data->ring = NULL;
+		pthread_mutex_unlock(&data->ring_mutex);
+
+		v4l2_ring_stop(ring);
+		data->dev = -1;
+	}
+
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -910,6 +1306,8 @@ static void v4l2_destroy(void *vptr)
 	if (data->device_id)
 		bfree(data->device_id);
 
+	pthread_mutex_destroy(&data->ring_mutex);
+
 #if HAVE_UDEV
 	signal_handler_t *sh = v4l2_get_udev_signalhandler();
 
@@ -980,7 +1378,7 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -998,10 +1396,35 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float)fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	if (v4l2_create_mmap(data->dev, &data->buffers, data->buffer_count) <
+	    0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
+	blog(LOG_INFO, "Buffers: %d", (int)data->buffers.count);
+
+	memset(&data->stats, 0, sizeof(data->stats));
+
+	if (data->pixfmt == V4L2_PIX_FMT_MJPEG) {
+		struct v4l2_mjpeg *mjpeg = v4l2_mjpeg_create(
+			data->source, data->mjpeg_threads, data->color_range);
+		if (!mjpeg)
+			goto fail;
+
+		pthread_mutex_lock(&data->ring_mutex);
+		data->mjpeg = mjpeg;
+		pthread_mutex_unlock(&data->ring_mutex);
+	} else if (data->zero_copy) {
+		struct v4l2_ring *ring =
+			v4l2_ring_create(data->dev, &data->buffers);
+		if (!ring)
+			goto fail;
+
+		pthread_mutex_lock(&data->ring_mutex);
+		data->ring = ring;
+		pthread_mutex_unlock(&data->ring_mutex);
+		blog(LOG_INFO, "Zero copy capture enabled");
+	}
 
 	/* start the capture thread */
 	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
@@ -1071,6 +1494,12 @@ static bool v4l2_settings_changed(struct v4l2_data *data, obs_data_t *settings)
 
 		res |= data->color_range !=
 		       obs_data_get_int(settings, "color_range");
+		res |= data->zero_copy !=
+		       obs_data_get_bool(settings, "zero_copy");
+		res |= data->buffer_count !=
+		       obs_data_get_int(settings, "buffer_count");
+		res |= data->mjpeg_threads !=
+		       obs_data_get_int(settings, "mjpeg_threads");
 	} else {
 		res = true;
 	}
@@ -1108,6 +1537,9 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->color_range = obs_data_get_int(settings, "color_range");
 	data->auto_reset = obs_data_get_bool(settings, "auto_reset");
 	data->timeout_frames = obs_data_get_int(settings, "timeout_frames");
+	data->zero_copy = obs_data_get_bool(settings, "zero_copy");
+	data->buffer_count = obs_data_get_int(settings, "buffer_count");
+	data->mjpeg_threads = obs_data_get_int(settings, "mjpeg_threads");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -1115,6 +1547,39 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 		v4l2_init(data);
 }
 
+static void v4l2_get_capture_stats(void *vptr, calldata_t *cd)
+{
+	V4L2_DATA(vptr);
+	struct v4l2_stats *stats = &data->stats;
+	struct v4l2_mjpeg_stats mjpeg = {0};
+	long held = 0;
+
+	pthread_mutex_lock(&data->ring_mutex);
+	if (data->ring)
+		held = os_atomic_load_long(&data->ring->held);
+	if (data->mjpeg)
+		v4l2_mjpeg_get_stats(data->mjpeg, &mjpeg);
+	pthread_mutex_unlock(&data->ring_mutex);
+
+	calldata_set_int(cd, "held", held);
+	calldata_set_int(cd, "max_held", os_atomic_load_long(&stats->max_held));
+	calldata_set_int(cd, "dropped_frames",
+			 os_atomic_load_long(&stats->dropped_frames));
+	calldata_set_int(cd, "late_frames",
+			 os_atomic_load_long(&stats->late_frames));
+	calldata_set_int(cd, "copied_frames",
+			 os_atomic_load_long(&stats->copied_frames));
+	calldata_set_float(cd, "jitter_ms",
+			   (double)os_atomic_load_long(&stats->jitter_us) /
+				   1000.0);
+	calldata_set_float(cd, "max_jitter_ms",
+			   (double)os_atomic_load_long(&stats->max_jitter_us) /
+				   1000.0);
+	calldata_set_int(cd, "decoded_frames", mjpeg.decoded_frames);
+	calldata_set_int(cd, "decode_dropped_frames", mjpeg.dropped_frames);
+	calldata_set_int(cd, "decode_failed_frames", mjpeg.failed_frames);
+}
+
 static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct v4l2_data *data = bzalloc(sizeof(struct v4l2_data));
@@ -1122,6 +1587,22 @@ static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 	data->source = source;
 	data->resolution_unchanged = false;
 	data->framerate_unchanged = false;
+	pthread_mutex_init_value(&data->ring_mutex);
+	if (pthread_mutex_init(&data->ring_mutex, NULL) != 0) {
+		bfree(data);
+		return NULL;
+	}
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph,
+			 "void get_capture_stats(out int held, "
+			 "out int max_held, out int dropped_frames, "
+			 "out int late_frames, out int copied_frames, "
+			 "out float jitter_ms, out float max_jitter_ms, "
+			 "out int decoded_frames, "
+			 "out int decode_dropped_frames, "
+			 "out int decode_failed_frames)",
+			 v4l2_get_capture_stats, data);
 
 	/* Bitch about build problems ... */
 #ifndef V4L2_CAP_DEVICE_CAPS
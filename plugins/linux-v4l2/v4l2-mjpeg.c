@@ -0,0 +1,440 @@
+/*
+Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/platform.h>
+
+#include <libavcodec/avcodec.h>
+
+#include "v4l2-mjpeg.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-mjpeg: " msg, ##__VA_ARGS__)
+
+/* frames that can be in flight per decode thread */
+#define JOBS_PER_THREAD 2
+
+enum job_state {
+	JOB_FREE,
+	JOB_FILLING,
+	JOB_QUEUED,
+	JOB_DECODING,
+	JOB_DONE,
+	JOB_FAILED,
+};
+
+struct mjpeg_job {
+	enum job_state state;
+	uint64_t sequence;
+	uint64_t timestamp;
+
+	uint8_t *packet;
+	size_t packet_size;
+	size_t packet_capacity;
+
+	AVFrame *frame;
+};
+
+struct mjpeg_decoder {
+	struct v4l2_mjpeg *mjpeg;
+	AVCodecContext *context;
+	pthread_t thread;
+	bool thread_active;
+};
+
+struct v4l2_mjpeg {
+	obs_source_t *source;
+	enum video_range_type range;
+
+	pthread_mutex_t mutex;
+	os_sem_t *pending;
+	volatile bool stop;
+
+	struct mjpeg_decoder *decoders;
+	size_t num_decoders;
+	struct mjpeg_job *jobs;
+	size_t num_jobs;
+
+	/* sequence of the next frame queued and of the next frame output,
+	 * frames are only output in sequence order */
+	uint64_t next_sequence;
+	uint64_t output_sequence;
+	bool outputting;
+
+	struct v4l2_mjpeg_stats stats;
+};
+
+static inline enum video_format convert_pixel_format(int f)
+{
+	switch (f) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return VIDEO_FORMAT_I444;
+	default:;
+	}
+
+	return VIDEO_FORMAT_NONE;
+}
+
+static void release_frame(void *param, struct obs_source_frame *frame)
+{
+	AVFrame *av_frame = param;
+
+	av_frame_free(&av_frame);
+	UNUSED_PARAMETER(frame);
+}
+
+/*
+ * Hands the decoded planes to libobs, the frame buffers stay referenced until
+ * libobs releases the frame
+ */
+static void output_job(struct v4l2_mjpeg *mjpeg, struct mjpeg_job *job)
+{
+	struct obs_source_frame out = {0};
+	enum video_range_type range = mjpeg->range;
+	AVFrame *frame = av_frame_alloc();
+
+	if (!frame)
+		return;
+
+	av_frame_move_ref(frame, job->frame);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out.data[i] = frame->data[i];
+		out.linesize[i] = frame->linesize[i];
+	}
+
+	out.width = frame->width;
+	out.height = frame->height;
+	out.format = convert_pixel_format(frame->format);
+	out.timestamp = job->timestamp;
+
+	/* JPEG is full range unless the stream says otherwise */
+	if (range == VIDEO_RANGE_DEFAULT)
+		range = (frame->color_range == AVCOL_RANGE_MPEG)
+				? VIDEO_RANGE_PARTIAL
+				: VIDEO_RANGE_FULL;
+
+	out.full_range = range == VIDEO_RANGE_FULL;
+	video_format_get_parameters(VIDEO_CS_DEFAULT, range, out.color_matrix,
+				    out.color_range_min, out.color_range_max);
+
+	obs_source_output_video_owned(mjpeg->source, &out, release_frame,
+				      frame);
+}
+
+static struct mjpeg_job *find_job(struct v4l2_mjpeg *mjpeg, uint64_t sequence)
+{
+	for (size_t i = 0; i < mjpeg->num_jobs; i++) {
+		struct mjpeg_job *job = &mjpeg->jobs[i];
+
+		if (job->state != JOB_FREE && job->sequence == sequence)
+			return job;
+	}
+
+	return NULL;
+}
+
+static inline bool job_finished(struct mjpeg_job *job)
+{
+	return job && (job->state == JOB_DONE || job->state == JOB_FAILED);
+}
+
+/*
+ * Marks a job as finished and outputs all frames that are next in sequence.
+ * Only one thread outputs at a time, a thread that finishes a frame while
+ * another one is outputting leaves its frame to that thread.
+ */
+static void finish_job(struct v4l2_mjpeg *mjpeg, struct mjpeg_job *job,
+		       bool success)
+{
+	pthread_mutex_lock(&mjpeg->mutex);
+
+	job->state = success ? JOB_DONE : JOB_FAILED;
+	if (!success)
+		mjpeg->stats.failed_frames++;
+
+	if (mjpeg->outputting) {
+		pthread_mutex_unlock(&mjpeg->mutex);
+		return;
+	}
+
+	mjpeg->outputting = true;
+
+	while (job_finished(job = find_job(mjpeg, mjpeg->output_sequence))) {
+		bool decoded = job->state == JOB_DONE;
+
+		mjpeg->output_sequence++;
+
+		if (decoded) {
+			pthread_mutex_unlock(&mjpeg->mutex);
+			output_job(mjpeg, job);
+			pthread_mutex_lock(&mjpeg->mutex);
+
+			mjpeg->stats.decoded_frames++;
+		}
+
+		job->state = JOB_FREE;
+	}
+
+	mjpeg->outputting = false;
+
+	pthread_mutex_unlock(&mjpeg->mutex);
+}
+
+static struct mjpeg_job *take_job(struct v4l2_mjpeg *mjpeg)
+{
+	struct mjpeg_job *job = NULL;
+
+	for (size_t i = 0; i < mjpeg->num_jobs; i++) {
+		struct mjpeg_job *cur = &mjpeg->jobs[i];
+
+		if (cur->state != JOB_QUEUED)
+			continue;
+		if (!job || cur->sequence < job->sequence)
+			job = cur;
+	}
+
+	if (job)
+		job->state = JOB_DECODING;
+	return job;
+}
+
+static bool decode_job(struct mjpeg_decoder *decoder, struct mjpeg_job *job)
+{
+	AVPacket packet;
+	int ret;
+
+	av_init_packet(&packet);
+	packet.data = job->packet;
+	packet.size = (int)job->packet_size;
+
+	av_frame_unref(job->frame);
+
+	ret = avcodec_send_packet(decoder->context, &packet);
+	if (ret == 0)
+		ret = avcodec_receive_frame(decoder->context, job->frame);
+
+	if (ret < 0)
+		return false;
+
+	return convert_pixel_format(job->frame->format) != VIDEO_FORMAT_NONE;
+}
+
+static void *decode_thread(void *param)
+{
+	struct mjpeg_decoder *decoder = param;
+	struct v4l2_mjpeg *mjpeg = decoder->mjpeg;
+	struct mjpeg_job *job;
+
+	os_set_thread_name("v4l2: mjpeg decode");
+
+	while (os_sem_wait(mjpeg->pending) == 0) {
+		if (os_atomic_load_bool(&mjpeg->stop))
+			break;
+
+		pthread_mutex_lock(&mjpeg->mutex);
+		job = take_job(mjpeg);
+		pthread_mutex_unlock(&mjpeg->mutex);
+
+		if (job)
+			finish_job(mjpeg, job, decode_job(decoder, job));
+	}
+
+	return NULL;
+}
+
+static bool init_decoder(struct v4l2_mjpeg *mjpeg,
+			 struct mjpeg_decoder *decoder, AVCodec *codec)
+{
+	decoder->mjpeg = mjpeg;
+	decoder->context = avcodec_alloc_context3(codec);
+	if (!decoder->context)
+		return false;
+
+	/* the pool decodes frames in parallel, not slices of a frame */
+	decoder->context->thread_count = 1;
+
+	if (avcodec_open2(decoder->context, codec, NULL) < 0) {
+		blog(LOG_ERROR, "Failed to open decoder");
+		return false;
+	}
+
+	if (pthread_create(&decoder->thread, NULL, decode_thread, decoder) !=
+	    0) {
+		blog(LOG_ERROR, "Failed to create decode thread");
+		return false;
+	}
+
+	decoder->thread_active = true;
+	return true;
+}
+
+struct v4l2_mjpeg *v4l2_mjpeg_create(obs_source_t *source, int threads,
+				     enum video_range_type range)
+{
+	struct v4l2_mjpeg *mjpeg = bzalloc(sizeof(struct v4l2_mjpeg));
+	AVCodec *codec;
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+	avcodec_register_all();
+#endif
+
+	if (threads < 1)
+		threads = 1;
+
+	mjpeg->source = source;
+	mjpeg->range = range;
+
+	pthread_mutex_init_value(&mjpeg->mutex);
+	if (pthread_mutex_init(&mjpeg->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&mjpeg->pending, 0) != 0)
+		goto fail;
+
+	codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		blog(LOG_ERROR, "MJPEG decoder not found");
+		goto fail;
+	}
+
+	mjpeg->num_jobs = (size_t)threads * JOBS_PER_THREAD;
+	mjpeg->jobs = bzalloc(mjpeg->num_jobs * sizeof(struct mjpeg_job));
+	for (size_t i = 0; i < mjpeg->num_jobs; i++) {
+		mjpeg->jobs[i].frame = av_frame_alloc();
+		if (!mjpeg->jobs[i].frame)
+			goto fail;
+	}
+
+	mjpeg->num_decoders = (size_t)threads;
+	mjpeg->decoders =
+		bzalloc(mjpeg->num_decoders * sizeof(struct mjpeg_decoder));
+	for (size_t i = 0; i < mjpeg->num_decoders; i++) {
+		if (!init_decoder(mjpeg, &mjpeg->decoders[i], codec))
+			goto fail;
+	}
+
+	blog(LOG_INFO, "Decoding with %d threads", threads);
+	return mjpeg;
+
+fail:
+	v4l2_mjpeg_destroy(mjpeg);
+	return NULL;
+}
+
+void v4l2_mjpeg_destroy(struct v4l2_mjpeg *mjpeg)
+{
+	if (!mjpeg)
+		return;
+
+	os_atomic_set_bool(&mjpeg->stop, true);
+	for (size_t i = 0; i < mjpeg->num_decoders; i++)
+		os_sem_post(mjpeg->pending);
+
+	for (size_t i = 0; i < mjpeg->num_decoders; i++) {
+		struct mjpeg_decoder *decoder = &mjpeg->decoders[i];
+
+		if (decoder->thread_active)
+			pthread_join(decoder->thread, NULL);
+		if (decoder->context)
+			avcodec_free_context(&decoder->context);
+	}
+
+	for (size_t i = 0; i < mjpeg->num_jobs; i++) {
+		av_frame_free(&mjpeg->jobs[i].frame);
+		bfree(mjpeg->jobs[i].packet);
+	}
+
+	os_sem_destroy(mjpeg->pending);
+	pthread_mutex_destroy(&mjpeg->mutex);
+	bfree(mjpeg->decoders);
+	bfree(mjpeg->jobs);
+	bfree(mjpeg);
+}
+
+static void copy_packet(struct mjpeg_job *job, const uint8_t *data,
+			size_t size)
+{
+	size_t new_size = size + AV_INPUT_BUFFER_PADDING_SIZE;
+
+	if (job->packet_capacity < new_size) {
+		job->packet = brealloc(job->packet, new_size);
+		job->packet_capacity = new_size;
+	}
+
+	memcpy(job->packet, data, size);
+	memset(job->packet + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	job->packet_size = size;
+}
+
+bool v4l2_mjpeg_decode(struct v4l2_mjpeg *mjpeg, const uint8_t *data,
+		       size_t size, uint64_t timestamp)
+{
+	struct mjpeg_job *job = NULL;
+	long pending = 1;
+
+	pthread_mutex_lock(&mjpeg->mutex);
+
+	for (size_t i = 0; i < mjpeg->num_jobs; i++) {
+		if (mjpeg->jobs[i].state != JOB_FREE)
+			pending++;
+		else if (!job)
+			job = &mjpeg->jobs[i];
+	}
+
+	if (!job) {
+		mjpeg->stats.dropped_frames++;
+		pthread_mutex_unlock(&mjpeg->mutex);
+		return false;
+	}
+
+	if (pending > mjpeg->stats.max_pending)
+		mjpeg->stats.max_pending = pending;
+
+	job->state = JOB_FILLING;
+	job->sequence = mjpeg->next_sequence++;
+	job->timestamp = timestamp;
+
+	pthread_mutex_unlock(&mjpeg->mutex);
+
+	/* only the capture thread queues frames, so a filling job can not be
+	 * touched by anyone else */
+	copy_packet(job, data, size);
+
+	pthread_mutex_lock(&mjpeg->mutex);
+	job->state = JOB_QUEUED;
+	pthread_mutex_unlock(&mjpeg->mutex);
+
+	os_sem_post(mjpeg->pending);
+	return true;
+}
+
+void v4l2_mjpeg_get_stats(struct v4l2_mjpeg *mjpeg,
+			  struct v4l2_mjpeg_stats *stats)
+{
+	pthread_mutex_lock(&mjpeg->mutex);
+	*stats = mjpeg->stats;
+	pthread_mutex_unlock(&mjpeg->mutex);
+}
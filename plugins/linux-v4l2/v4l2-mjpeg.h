@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pool of MJPEG decoders
+ *
+ * Every decode thread owns its own decoder, so consecutive frames are decoded
+ * in parallel.  Decoded frames are put back into capture order before they
+ * are output to the source, so timestamps stay monotonic.
+ */
+struct v4l2_mjpeg;
+
+/**
+ * Decoder statistics
+ */
+struct v4l2_mjpeg_stats {
+	/** frames output to the source */
+	long decoded_frames;
+	/** frames dropped because all decoders were busy */
+	long dropped_frames;
+	/** frames that failed to decode */
+	long failed_frames;
+	/** most frames waiting for or in decoding at once */
+	long max_pending;
+};
+
+/**
+ * Create a decoder pool
+ *
+ * @param source the source decoded frames are output to
+ * @param threads number of decode threads
+ * @param range color range of the frames, VIDEO_RANGE_DEFAULT to use the
+ *              range signaled by the stream
+ *
+ * @return the pool or NULL on failure
+ */
+struct v4l2_mjpeg *v4l2_mjpeg_create(obs_source_t *source, int threads,
+				     enum video_range_type range);
+
+/**
+ * Destroy a decoder pool
+ *
+ * Frames that were not decoded yet are discarded.  Frames that were already
+ * output stay valid until libobs releases them.
+ */
+void v4l2_mjpeg_destroy(struct v4l2_mjpeg *mjpeg);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied, so the capture buffer can be queued on the device
+ * again right away.
+ *
+ * @param data compressed frame
+ * @param size size of the compressed frame
+ * @param timestamp timestamp of the frame
+ *
+ * @return false if the frame was dropped
+ */
+bool v4l2_mjpeg_decode(struct v4l2_mjpeg *mjpeg, const uint8_t *data,
+		       size_t size, uint64_t timestamp);
+
+/**
+ * Get the decoder statistics
+ */
+void v4l2_mjpeg_get_stats(struct v4l2_mjpeg *mjpeg,
+			  struct v4l2_mjpeg_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
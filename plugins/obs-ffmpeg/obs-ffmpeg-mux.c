@@ -51,6 +51,13 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	}
 
 	circlebuf_free(&stream->packets);
+
+	if (stream->spill) {
+		replay_spill_free(stream->spill);
+		bfree(stream->spill);
+		stream->spill = NULL;
+	}
+
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
@@ -67,6 +74,7 @@ static void ffmpeg_mux_destroy(void *data)
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
 	da_free(stream->mux_packets);
+	replay_spill_release_segments(&stream->mux_segments.da);
 	circlebuf_free(&stream->packets);
 
 	os_process_pipe_destroy(stream->pipe);
@@ -709,6 +717,34 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	stream->in_process_mux = obs_data_get_bool(s, "in_process_mux");
+
+	if (obs_data_get_bool(s, "spill_to_disk")) {
+		const char *dir = obs_data_get_string(s, "spill_directory");
+		long long segment_mb = obs_data_get_int(s, "spill_segment_mb");
+		size_t segment_size;
+
+		if (segment_mb < 1)
+			segment_mb = 1;
+		else if (segment_mb > REPLAY_SPILL_MAX_SEGMENT_MB)
+			segment_mb = REPLAY_SPILL_MAX_SEGMENT_MB;
+		segment_size = (size_t)segment_mb * (1024 * 1024);
+
+		if (!*dir)
+			dir = obs_data_get_string(s, "directory");
+
+		stream->spill = bzalloc(sizeof(*stream->spill));
+		if (replay_spill_init(stream->spill, dir, segment_size)) {
+			info("Spilling replay buffer to '%s'",
+			     stream->spill->dir.array);
+		} else {
+			warn("Could not set up disk spill, keeping replay "
+			     "buffer in memory");
+			bfree(stream->spill);
+			stream->spill = NULL;
+		}
+	}
+
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -719,41 +755,67 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
-static bool purge_front(struct ffmpeg_muxer *stream)
+static inline bool buffer_empty(struct ffmpeg_muxer *stream)
+{
+	return stream->spill ? !stream->spill->index.size
+			     : !stream->packets.size;
+}
+
+/* returns whether the oldest buffered packet is a video keyframe */
+static bool peek_front(struct ffmpeg_muxer *stream, int64_t *dts_usec)
 {
+	if (stream->spill) {
+		struct replay_index_entry *entry =
+			replay_spill_entry(stream->spill, 0);
+		*dts_usec = entry->dts_usec;
+		return entry->type == OBS_ENCODER_VIDEO && entry->keyframe;
+	}
+
 	struct encoder_packet pkt;
-	bool keyframe;
+	circlebuf_peek_front(&stream->packets, &pkt, sizeof(pkt));
+	*dts_usec = pkt.dts_usec;
+	return pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+}
 
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
+static bool purge_front(struct ffmpeg_muxer *stream)
+{
+	bool keyframe;
+	size_t size;
 
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+	if (stream->spill) {
+		struct replay_index_entry entry;
+		replay_spill_pop_front(stream->spill, &entry);
+		keyframe = entry.type == OBS_ENCODER_VIDEO && entry.keyframe;
+		size = entry.size;
+	} else {
+		struct encoder_packet pkt;
+		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
+		keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+		size = pkt.size;
+		obs_encoder_packet_release(&pkt);
+	}
 
 	if (keyframe)
 		stream->keyframes--;
 
-	if (!stream->packets.size) {
+	if (buffer_empty(stream)) {
 		stream->cur_size = 0;
 		stream->cur_time = 0;
 	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
+		peek_front(stream, &stream->cur_time);
+		stream->cur_size -= (int64_t)size;
 	}
 
-	obs_encoder_packet_release(&pkt);
 	return keyframe;
 }
 
 static inline void purge(struct ffmpeg_muxer *stream)
 {
 	if (purge_front(stream)) {
-		struct encoder_packet pkt;
+		int64_t dts_usec;
 
 		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
+			if (peek_front(stream, &dts_usec))
 				return;
 
 			purge_front(stream);
@@ -765,7 +827,7 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 				       struct encoder_packet *pkt)
 {
 	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
+		if (buffer_empty(stream) || stream->keyframes <= 2)
 			return;
 
 		while ((stream->cur_size + (int64_t)pkt->size) >
@@ -773,24 +835,23 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 			purge(stream);
 	}
 
-	if (!stream->packets.size || stream->keyframes <= 2)
+	if (buffer_empty(stream) || stream->keyframes <= 2)
 		return;
 
 	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
 		purge(stream);
 }
 
+/* takes ownership of the packet */
 static void insert_packet(struct darray *array, struct encoder_packet *packet,
 			  int64_t video_offset, int64_t *audio_offsets,
 			  int64_t video_dts_offset, int64_t *audio_dts_offsets)
 {
-	struct encoder_packet pkt;
+	struct encoder_packet pkt = *packet;
 	DARRAY(struct encoder_packet) packets;
 	packets.da = *array;
 	size_t idx;
 
-	obs_encoder_packet_ref(&pkt, packet);
-
 	if (pkt.type == OBS_ENCODER_VIDEO) {
 		pkt.dts_usec -= video_offset;
 		pkt.dts -= video_dts_offset;
@@ -811,35 +872,51 @@ static void insert_packet(struct darray *array, struct encoder_packet *packet,
 	*array = packets.da;
 }
 
-static void *replay_buffer_mux_thread(void *data)
+static bool replay_buffer_mux_pipe(struct ffmpeg_muxer *stream)
 {
-	struct ffmpeg_muxer *stream = data;
-	bool error = false;
-
 	start_pipe(stream, stream->path.array);
 
 	if (!stream->pipe) {
 		warn("Failed to create process pipe");
-		error = true;
-		goto error;
+		return false;
 	}
 
 	if (!send_headers(stream)) {
 		warn("Could not write headers for file '%s'",
 		     stream->path.array);
-		error = true;
-		goto error;
+		return false;
 	}
 
 	for (size_t i = 0; i < stream->mux_packets.num; i++) {
 		struct encoder_packet *pkt = &stream->mux_packets.array[i];
 		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
 	}
 
-	info("Wrote replay buffer to '%s'", stream->path.array);
+	return true;
+}
+
+static void *replay_buffer_mux_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	bool error;
+
+	if (stream->in_process_mux)
+		error = replay_buffer_mux_packets(stream) != FFM_SUCCESS;
+	else
+		error = !replay_buffer_mux_pipe(stream);
+
+	if (!error)
+		info("Wrote replay buffer to '%s'", stream->path.array);
+
+	/* spilled packets point in to the segments and aren't refcounted */
+	if (stream->mux_segments.num) {
+		replay_spill_release_segments(&stream->mux_segments.da);
+	} else {
+		for (size_t i = 0; i < stream->mux_packets.num; i++)
+			obs_encoder_packet_release(
+				&stream->mux_packets.array[i]);
+	}
 
-error:
 	os_process_pipe_destroy(stream->pipe);
 	stream->pipe = NULL;
 	da_free(stream->mux_packets);
@@ -858,9 +935,28 @@ error:
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
 	const size_t size = sizeof(struct encoder_packet);
-	size_t num_packets = stream->packets.size / size;
+	struct replay_spill *spill = stream->spill;
+	size_t num_packets = spill ? replay_spill_count(spill)
+				   : stream->packets.size / size;
+	size_t first = 0;
+
+	/* with the index in memory, packets before the first keyframe can be
+	 * skipped without touching their data on disk */
+	if (spill) {
+		for (size_t i = 0; i < num_packets; i++) {
+			struct replay_index_entry *entry =
+				replay_spill_entry(spill, i);
+			if (entry->type == OBS_ENCODER_VIDEO &&
+			    entry->keyframe) {
+				first = i;
+				break;
+			}
+		}
 
-	da_reserve(stream->mux_packets, num_packets);
+		replay_spill_ref_segments(spill, &stream->mux_segments.da);
+	}
+
+	da_reserve(stream->mux_packets, num_packets - first);
 
 	/* ---------------------------- */
 	/* reorder packets */
@@ -872,25 +968,34 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
 	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
 
-	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
+	for (size_t i = first; i < num_packets; i++) {
+		struct encoder_packet pkt;
 
-		if (pkt->type == OBS_ENCODER_VIDEO) {
+		if (spill) {
+			replay_spill_get_packet(spill,
+						replay_spill_entry(spill, i),
+						&pkt);
+		} else {
+			struct encoder_packet *src;
+			src = circlebuf_data(&stream->packets, i * size);
+			obs_encoder_packet_ref(&pkt, src);
+		}
+
+		if (pkt.type == OBS_ENCODER_VIDEO) {
 			if (!found_video) {
-				video_offset = pkt->dts_usec;
-				video_dts_offset = pkt->dts;
+				video_offset = pkt.dts_usec;
+				video_dts_offset = pkt.dts;
 				found_video = true;
 			}
 		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
+			if (!found_audio[pkt.track_idx]) {
+				found_audio[pkt.track_idx] = true;
+				audio_offsets[pkt.track_idx] = pkt.dts_usec;
+				audio_dts_offsets[pkt.track_idx] = pkt.dts;
 			}
 		}
 
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
+		insert_packet(&stream->mux_packets.da, &pkt, video_offset,
 			      audio_offsets, video_dts_offset,
 			      audio_dts_offsets);
 	}
@@ -965,14 +1070,22 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
+	replay_buffer_purge(stream, packet);
 
-	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
+	if (buffer_empty(stream))
+		stream->cur_time = packet->dts_usec;
+	stream->cur_size += packet->size;
 
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
+	if (stream->spill) {
+		if (!replay_spill_push(stream->spill, packet)) {
+			warn("Failed to write packet to disk spill");
+			deactivate_replay_buffer(stream, OBS_OUTPUT_ERROR);
+			return;
+		}
+	} else {
+		obs_encoder_packet_ref(&pkt, packet);
+		circlebuf_push_back(&stream->packets, &pkt, sizeof(pkt));
+	}
 
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
 		stream->keyframes++;
@@ -998,6 +1111,9 @@ static void replay_buffer_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_bool(s, "in_process_mux", true);
+	obs_data_set_default_bool(s, "spill_to_disk", false);
+	obs_data_set_default_int(s, "spill_segment_mb", 64);
 }
 
 struct obs_output_info replay_buffer = {
@@ -10,6 +10,8 @@
 #include <util/platform.h>
 #include <util/threading.h>
 
+#include "obs-ffmpeg-replay-spill.h"
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
@@ -33,8 +35,13 @@ struct ffmpeg_muxer {
 	int keyframes;
 	obs_hotkey_id hotkey;
 	volatile bool muxing;
+	bool in_process_mux;
 	DARRAY(struct encoder_packet) mux_packets;
 
+	/* replay buffer disk spill, NULL when packets are kept in memory */
+	struct replay_spill *spill;
+	DARRAY(struct replay_segment *) mux_segments;
+
 	/* these are accessed both by replay buffer and by HLS */
 	pthread_t mux_thread;
 	bool mux_thread_joinable;
@@ -61,3 +68,6 @@ bool send_headers(struct ffmpeg_muxer *stream);
 int deactivate(struct ffmpeg_muxer *stream, int code);
 void ffmpeg_mux_stop(void *data, uint64_t ts);
 uint64_t ffmpeg_mux_total_bytes(void *data);
+
+/* writes mux_packets to path with libavformat, returns an FFM_* code */
+int replay_buffer_mux_packets(struct ffmpeg_muxer *stream);
@@ -0,0 +1,444 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/* Writes replay buffer saves directly with libavformat instead of piping
+ * every packet through the obs-ffmpeg-mux process.  The packets are already
+ * interleaved by dts when the save is started, so they can be handed to the
+ * muxer as-is, and file output goes through one large I/O buffer so that the
+ * file is written in big chunks rather than per packet. */
+
+#include "ffmpeg-mux/ffmpeg-mux.h"
+#include "obs-ffmpeg-mux.h"
+
+#include <libavformat/avformat.h>
+
+#define do_log(level, format, ...)                  \
+	blog(level, "[replay buffer: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#if LIBAVCODEC_VERSION_MAJOR >= 58
+#define CODEC_FLAG_GLOBAL_H AV_CODEC_FLAG_GLOBAL_HEADER
+#else
+#define CODEC_FLAG_GLOBAL_H CODEC_FLAG_GLOBAL_HEADER
+#endif
+
+#define REPLAY_IO_BUFFER_SIZE (4 * 1024 * 1024)
+
+struct replay_stream {
+	AVStream *stream;
+	AVCodecContext *ctx;
+};
+
+struct replay_mux {
+	struct ffmpeg_muxer *stream;
+	AVFormatContext *output;
+	AVIOContext *pb;
+	FILE *file;
+
+	struct replay_stream video;
+	struct replay_stream audio[MAX_AUDIO_MIXES];
+	size_t num_audio;
+};
+
+/* ------------------------------------------------------------------------ */
+
+static int replay_io_write(void *opaque, uint8_t *buf, int buf_size)
+{
+	struct replay_mux *rm = opaque;
+	size_t size = (size_t)buf_size;
+
+	return fwrite(buf, 1, size, rm->file) == size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t replay_io_seek(void *opaque, int64_t offset, int whence)
+{
+	struct replay_mux *rm = opaque;
+
+	if (whence == AVSEEK_SIZE)
+		return -1;
+
+	if (os_fseeki64(rm->file, offset, whence & ~AVSEEK_FORCE) != 0)
+		return AVERROR(EIO);
+
+	return os_ftelli64(rm->file);
+}
+
+static bool replay_open_file(struct replay_mux *rm, const char *path)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	uint8_t *buf;
+
+	rm->file = os_fopen(path, "wb");
+	if (!rm->file) {
+		warn("Couldn't open '%s'", path);
+		return false;
+	}
+
+	/* the I/O buffer is flushed with a single fwrite when it fills up,
+	 * so stdio buffering would only add another copy */
+	setvbuf(rm->file, NULL, _IONBF, 0);
+
+	buf = av_malloc(REPLAY_IO_BUFFER_SIZE);
+	if (!buf)
+		return false;
+
+	rm->pb = avio_alloc_context(buf, REPLAY_IO_BUFFER_SIZE, 1, rm, NULL,
+				    replay_io_write, replay_io_seek);
+	if (!rm->pb) {
+		av_free(buf);
+		return false;
+	}
+
+	rm->output->pb = rm->pb;
+	return true;
+}
+
+static void replay_mux_free(struct replay_mux *rm)
+{
+	if (rm->video.ctx)
+		avcodec_free_context(&rm->video.ctx);
+	for (size_t i = 0; i < rm->num_audio; i++)
+		avcodec_free_context(&rm->audio[i].ctx);
+
+	if (rm->output) {
+		rm->output->pb = NULL;
+		avformat_free_context(rm->output);
+	}
+
+	if (rm->pb) {
+		av_freep(&rm->pb->buffer);
+		avio_context_free(&rm->pb);
+	}
+
+	if (rm->file)
+		fclose(rm->file);
+}
+
+/* ------------------------------------------------------------------------ */
+
+static bool new_stream(struct replay_mux *rm, struct replay_stream *rs,
+		       const char *name)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	const AVCodecDescriptor *desc = avcodec_descriptor_get_by_name(name);
+	const AVCodec *codec;
+
+	if (!desc) {
+		warn("Couldn't find encoder '%s'", name);
+		return false;
+	}
+
+	codec = avcodec_find_encoder(desc->id);
+	if (!codec) {
+		warn("Couldn't create encoder '%s'", name);
+		return false;
+	}
+
+	rs->stream = avformat_new_stream(rm->output, NULL);
+	if (!rs->stream) {
+		warn("Couldn't create stream for encoder '%s'", name);
+		return false;
+	}
+
+	rs->ctx = avcodec_alloc_context3(codec);
+	if (!rs->ctx)
+		return false;
+
+	rs->stream->id = rm->output->nb_streams - 1;
+	return true;
+}
+
+static void set_extra_data(AVCodecContext *ctx, obs_encoder_t *encoder)
+{
+	uint8_t *data;
+	size_t size;
+
+	if (!obs_encoder_get_extra_data(encoder, &data, &size) || !size)
+		return;
+
+	ctx->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+	if (ctx->extradata) {
+		memcpy(ctx->extradata, data, size);
+		ctx->extradata_size = (int)size;
+	}
+}
+
+static bool create_video_stream(struct replay_mux *rm, obs_encoder_t *vencoder)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	const struct video_output_info *voi =
+		video_output_get_info(obs_get_video());
+	obs_data_t *settings = obs_encoder_get_settings(vencoder);
+	int bitrate = (int)obs_data_get_int(settings, "bitrate");
+	AVCodecContext *context;
+
+	obs_data_release(settings);
+
+	if (!new_stream(rm, &rm->video, obs_encoder_get_codec(vencoder)))
+		return false;
+
+	context = rm->video.ctx;
+	context->bit_rate = (int64_t)bitrate * 1000;
+	context->width = (int)obs_output_get_width(stream->output);
+	context->height = (int)obs_output_get_height(stream->output);
+	context->coded_width = context->width;
+	context->coded_height = context->height;
+
+	switch (voi->colorspace) {
+	case VIDEO_CS_601:
+		context->color_primaries = AVCOL_PRI_SMPTE170M;
+		context->color_trc = AVCOL_TRC_SMPTE170M;
+		context->colorspace = AVCOL_SPC_SMPTE170M;
+		break;
+	case VIDEO_CS_DEFAULT:
+	case VIDEO_CS_709:
+		context->color_primaries = AVCOL_PRI_BT709;
+		context->color_trc = AVCOL_TRC_BT709;
+		context->colorspace = AVCOL_SPC_BT709;
+		break;
+	case VIDEO_CS_SRGB:
+		context->color_primaries = AVCOL_PRI_BT709;
+		context->color_trc = AVCOL_TRC_IEC61966_2_1;
+		context->colorspace = AVCOL_SPC_BT709;
+		break;
+	}
+
+	context->color_range = voi->range == VIDEO_RANGE_FULL
+				       ? AVCOL_RANGE_JPEG
+				       : AVCOL_RANGE_MPEG;
+	context->time_base = (AVRational){voi->fps_den, voi->fps_num};
+	set_extra_data(context, vencoder);
+
+	if (rm->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_H;
+
+	rm->video.stream->time_base = context->time_base;
+	rm->video.stream->avg_frame_rate = av_inv_q(context->time_base);
+	avcodec_parameters_from_context(rm->video.stream->codecpar, context);
+	return true;
+}
+
+static bool create_audio_stream(struct replay_mux *rm, obs_encoder_t *aencoder)
+{
+	struct replay_stream *rs = &rm->audio[rm->num_audio];
+	obs_data_t *settings = obs_encoder_get_settings(aencoder);
+	int bitrate = (int)obs_data_get_int(settings, "bitrate");
+	AVCodecContext *context;
+
+	obs_data_release(settings);
+
+	if (!new_stream(rm, rs, obs_encoder_get_codec(aencoder)))
+		return false;
+
+	rm->num_audio++;
+
+	av_dict_set(&rs->stream->metadata, "title",
+		    obs_encoder_get_name(aencoder), 0);
+
+	context = rs->ctx;
+	context->bit_rate = (int64_t)bitrate * 1000;
+	context->channels = (int)audio_output_get_channels(obs_get_audio());
+	context->sample_rate = (int)obs_encoder_get_sample_rate(aencoder);
+	context->sample_fmt = AV_SAMPLE_FMT_S16;
+	context->time_base = (AVRational){1, context->sample_rate};
+	context->channel_layout =
+		av_get_default_channel_layout(context->channels);
+	//AVlib default channel layout for 4 channels is 4.0 ; fix for quad
+	if (context->channels == 4)
+		context->channel_layout = av_get_channel_layout("quad");
+	//AVlib default channel layout for 5 channels is 5.0 ; fix for 4.1
+	if (context->channels == 5)
+		context->channel_layout = av_get_channel_layout("4.1");
+	set_extra_data(context, aencoder);
+
+	if (rm->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_H;
+
+	rs->stream->time_base = context->time_base;
+	avcodec_parameters_from_context(rs->stream->codecpar, context);
+	return true;
+}
+
+static bool init_streams(struct replay_mux *rm)
+{
+	obs_output_t *output = rm->stream->output;
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(output);
+
+	if (vencoder && !create_video_stream(rm, vencoder))
+		return false;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		obs_encoder_t *aencoder =
+			obs_output_get_audio_encoder(output, i);
+		if (!aencoder)
+			break;
+		if (!create_audio_stream(rm, aencoder))
+			return false;
+	}
+
+	return rm->video.stream || rm->num_audio;
+}
+
+static int write_header(struct replay_mux *rm)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	const char *mux = obs_data_get_string(settings, "muxer_settings");
+	AVDictionary *dict = NULL;
+	int ret;
+
+	if ((ret = av_dict_parse_string(&dict, mux, "=", " ", 0)))
+		warn("Failed to parse muxer settings: %s\n%s", av_err2str(ret),
+		     mux);
+
+	obs_data_release(settings);
+
+	ret = avformat_write_header(rm->output, &dict);
+	av_dict_free(&dict);
+
+	if (ret < 0) {
+		warn("Error opening '%s': %s", stream->path.array,
+		     av_err2str(ret));
+		return ret == AVERROR(EINVAL) ? FFM_UNSUPPORTED : FFM_ERROR;
+	}
+
+	return FFM_SUCCESS;
+}
+
+static int replay_mux_init(struct replay_mux *rm)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	const char *path = stream->path.array;
+	AVOutputFormat *format;
+	int ret;
+
+	format = av_guess_format(NULL, path, NULL);
+	if (!format) {
+		warn("Couldn't find an appropriate muxer for '%s'", path);
+		return FFM_ERROR;
+	}
+
+	ret = avformat_alloc_output_context2(&rm->output, format, NULL,
+					     path);
+	if (ret < 0) {
+		warn("Couldn't initialize output context: %s",
+		     av_err2str(ret));
+		return FFM_ERROR;
+	}
+
+	if (!init_streams(rm))
+		return FFM_ERROR;
+	if (!replay_open_file(rm, path))
+		return FFM_ERROR;
+
+	return write_header(rm);
+}
+
+/* ------------------------------------------------------------------------ */
+
+static inline struct replay_stream *get_stream(struct replay_mux *rm,
+					       struct encoder_packet *pkt)
+{
+	if (pkt->type == OBS_ENCODER_VIDEO)
+		return rm->video.stream ? &rm->video : NULL;
+
+	return pkt->track_idx < rm->num_audio ? &rm->audio[pkt->track_idx]
+					      : NULL;
+}
+
+/* same conversion as the obs-ffmpeg-mux process: encoder timestamps advance
+ * in steps of the time base numerator */
+static inline int64_t rescale_ts(struct replay_stream *rs, int64_t val)
+{
+	AVRational tb = rs->ctx->time_base;
+
+	return av_rescale_q_rnd(val / tb.num, tb, rs->stream->time_base,
+				AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
+}
+
+static bool replay_mux_packet(struct replay_mux *rm,
+			      struct encoder_packet *pkt)
+{
+	struct ffmpeg_muxer *stream = rm->stream;
+	struct replay_stream *rs = get_stream(rm, pkt);
+	AVPacket packet = {0};
+	int ret;
+
+	/* the muxer might not support video/audio, or multiple audio tracks */
+	if (!rs)
+		return true;
+
+	av_init_packet(&packet);
+
+	packet.data = pkt->data;
+	packet.size = (int)pkt->size;
+	packet.stream_index = rs->stream->index;
+	packet.pts = rescale_ts(rs, pkt->pts);
+	packet.dts = rescale_ts(rs, pkt->dts);
+
+	if (pkt->keyframe)
+		packet.flags = AV_PKT_FLAG_KEY;
+
+	/* packets were sorted by dts when the save was started, so there is no
+	 * need to go through the interleaving queue, which would copy them */
+	ret = av_write_frame(rm->output, &packet);
+	if (ret < 0) {
+		warn("av_write_frame failed: %d: %s", ret, av_err2str(ret));
+
+		/* treat invalid data/arguments as non-fatal, like the
+		 * obs-ffmpeg-mux process does */
+		return ret == AVERROR_INVALIDDATA || ret == AVERROR(EINVAL);
+	}
+
+	stream->total_bytes += pkt->size;
+	return true;
+}
+
+int replay_buffer_mux_packets(struct ffmpeg_muxer *stream)
+{
+	struct replay_mux rm = {.stream = stream};
+	int ret = replay_mux_init(&rm);
+
+	if (ret != FFM_SUCCESS)
+		goto fail;
+
+	for (size_t i = 0; i < stream->mux_packets.num; i++) {
+		if (!replay_mux_packet(&rm, &stream->mux_packets.array[i])) {
+			ret = FFM_ERROR;
+			break;
+		}
+	}
+
+	if (av_write_trailer(rm.output) < 0 && ret == FFM_SUCCESS) {
+		warn("Failed to write trailer for '%s'", stream->path.array);
+		ret = FFM_ERROR;
+	}
+
+	avio_flush(rm.pb);
+	if (rm.pb->error < 0 && ret == FFM_SUCCESS) {
+		warn("Failed to write '%s': %s", stream->path.array,
+		     av_err2str(rm.pb->error));
+		ret = FFM_ERROR;
+	}
+
+fail:
+	replay_mux_free(&rm);
+	return ret;
+}
@@ -0,0 +1,364 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "obs-ffmpeg-replay-spill.h"
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+struct replay_segment {
+	volatile long refs;
+	uint32_t id;
+	uint8_t *data;
+	size_t size;
+	size_t used;
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+/* ------------------------------------------------------------------------ */
+
+#ifdef _WIN32
+static bool segment_map(struct replay_segment *seg, const char *path)
+{
+	wchar_t *wpath = NULL;
+
+	os_utf8_to_wcs_ptr(path, 0, &wpath);
+	if (!wpath)
+		return false;
+
+	/* the file goes away by itself once the mapping is closed */
+	seg->file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+				CREATE_ALWAYS,
+				FILE_ATTRIBUTE_TEMPORARY |
+					FILE_FLAG_DELETE_ON_CLOSE,
+				NULL);
+	bfree(wpath);
+
+	if (seg->file == INVALID_HANDLE_VALUE) {
+		seg->file = NULL;
+		return false;
+	}
+
+	seg->mapping = CreateFileMappingW(seg->file, NULL, PAGE_READWRITE,
+					  (DWORD)((uint64_t)seg->size >> 32),
+					  (DWORD)seg->size, NULL);
+	if (!seg->mapping)
+		return false;
+
+	seg->data = MapViewOfFile(seg->mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				  seg->size);
+	return !!seg->data;
+}
+
+static void segment_unmap(struct replay_segment *seg)
+{
+	if (seg->data)
+		UnmapViewOfFile(seg->data);
+	if (seg->mapping)
+		CloseHandle(seg->mapping);
+	if (seg->file)
+		CloseHandle(seg->file);
+}
+
+static inline void segment_finish(struct replay_segment *seg)
+{
+	UNUSED_PARAMETER(seg);
+}
+
+#else
+/* the blocks have to exist before the file is mapped, otherwise running out
+ * of disk space only shows up as SIGBUS when writing to the mapping */
+static bool segment_reserve(struct replay_segment *seg)
+{
+#ifdef __APPLE__
+	fstore_t store = {
+		.fst_flags = F_ALLOCATEALL,
+		.fst_posmode = F_PEOFPOSMODE,
+		.fst_offset = 0,
+		.fst_length = (off_t)seg->size,
+	};
+
+	if (fcntl(seg->fd, F_PREALLOCATE, &store) == -1)
+		return false;
+	return ftruncate(seg->fd, (off_t)seg->size) == 0;
+#else
+	return posix_fallocate(seg->fd, 0, (off_t)seg->size) == 0;
+#endif
+}
+
+static bool segment_map(struct replay_segment *seg, const char *path)
+{
+	void *data;
+
+	seg->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (seg->fd == -1)
+		return false;
+
+	/* the file stays accessible through the descriptor, and this way it
+	 * is never left behind on disk */
+	unlink(path);
+
+	if (!segment_reserve(seg)) {
+		blog(LOG_WARNING,
+		     "[replay buffer] Could not reserve %zu bytes for "
+		     "spill segment '%s', the disk may be full",
+		     seg->size, path);
+		return false;
+	}
+
+	data = mmap(NULL, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    seg->fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+	seg->data = data;
+	return true;
+}
+
+static void segment_unmap(struct replay_segment *seg)
+{
+	if (seg->data)
+		munmap(seg->data, seg->size);
+	if (seg->fd != -1)
+		close(seg->fd);
+}
+
+/* a full segment is only read again if a save happens, so let the kernel
+ * write it back and drop it from our resident memory */
+static inline void segment_finish(struct replay_segment *seg)
+{
+#ifdef __linux__
+	msync(seg->data, seg->size, MS_ASYNC);
+	madvise(seg->data, seg->size, MADV_DONTNEED);
+#else
+	UNUSED_PARAMETER(seg);
+#endif
+}
+#endif
+
+/* ------------------------------------------------------------------------ */
+
+static struct replay_segment *segment_create(struct replay_spill *spill,
+					     size_t size)
+{
+	struct replay_segment *seg = bzalloc(sizeof(*seg));
+	struct dstr path = {0};
+
+	seg->refs = 1;
+	seg->id = spill->next_id;
+	seg->size = size;
+#ifndef _WIN32
+	seg->fd = -1;
+#endif
+
+	dstr_printf(&path, "%s/replay-spill-%p-%u.tmp", spill->dir.array,
+		    (void *)spill, seg->id);
+
+	if (!segment_map(seg, path.array)) {
+		blog(LOG_WARNING, "[replay buffer] Failed to map spill "
+				  "segment '%s'",
+		     path.array);
+		segment_unmap(seg);
+		bfree(seg);
+		seg = NULL;
+	} else {
+		/* front_id in replay_spill_pop_front relies on the ids of the
+		 * segments being consecutive */
+		spill->next_id++;
+	}
+
+	dstr_free(&path);
+	return seg;
+}
+
+static inline void segment_release(struct replay_segment *seg)
+{
+	if (os_atomic_dec_long(&seg->refs) == 0) {
+		segment_unmap(seg);
+		bfree(seg);
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
+bool replay_spill_init(struct replay_spill *spill, const char *dir,
+		       size_t segment_size)
+{
+	memset(spill, 0, sizeof(*spill));
+
+	if (!dir || !*dir || !segment_size)
+		return false;
+
+	dstr_copy(&spill->dir, dir);
+	dstr_replace(&spill->dir, "\\", "/");
+	if (dstr_end(&spill->dir) == '/')
+		dstr_resize(&spill->dir, spill->dir.len - 1);
+
+	if (os_mkdirs(spill->dir.array) == MKDIR_ERROR) {
+		blog(LOG_WARNING,
+		     "[replay buffer] Failed to create spill "
+		     "directory '%s'",
+		     spill->dir.array);
+		dstr_free(&spill->dir);
+		return false;
+	}
+
+	if (segment_size > REPLAY_SPILL_MAX_SEGMENT_MB * 1024ULL * 1024ULL)
+		segment_size = REPLAY_SPILL_MAX_SEGMENT_MB * 1024ULL * 1024ULL;
+
+	spill->segment_size = segment_size;
+	return true;
+}
+
+void replay_spill_free(struct replay_spill *spill)
+{
+	for (size_t i = 0; i < spill->segments.num; i++)
+		segment_release(spill->segments.array[i]);
+
+	da_free(spill->segments);
+	circlebuf_free(&spill->index);
+	dstr_free(&spill->dir);
+}
+
+static inline struct replay_segment *
+get_segment(struct replay_spill *spill, uint32_t id)
+{
+	uint32_t first = spill->segments.array[0]->id;
+	return spill->segments.array[id - first];
+}
+
+bool replay_spill_push(struct replay_spill *spill,
+		       const struct encoder_packet *packet)
+{
+	struct replay_segment *seg = NULL;
+
+	if (packet->size > UINT32_MAX)
+		return false;
+
+	if (spill->segments.num)
+		seg = spill->segments.array[spill->segments.num - 1];
+
+	if (!seg || seg->size - seg->used < packet->size) {
+		size_t size = spill->segment_size;
+		if (size < packet->size)
+			size = packet->size;
+
+		if (seg)
+			segment_finish(seg);
+
+		seg = segment_create(spill, size);
+		if (!seg)
+			return false;
+
+		da_push_back(spill->segments, &seg);
+	}
+
+	struct replay_index_entry entry = {
+		.dts = packet->dts,
+		.pts = packet->pts,
+		.dts_usec = packet->dts_usec,
+		.segment = seg->id,
+		.offset = (uint32_t)seg->used,
+		.size = (uint32_t)packet->size,
+		.type = (uint8_t)packet->type,
+		.track_idx = (uint8_t)packet->track_idx,
+		.keyframe = packet->keyframe,
+	};
+
+	memcpy(seg->data + seg->used, packet->data, packet->size);
+	seg->used += packet->size;
+
+	circlebuf_push_back(&spill->index, &entry, sizeof(entry));
+	return true;
+}
+
+void replay_spill_pop_front(struct replay_spill *spill,
+			    struct replay_index_entry *entry)
+{
+	circlebuf_pop_front(&spill->index, entry, sizeof(*entry));
+
+	/* release every segment before the one the new front lives in */
+	uint32_t front_id = spill->next_id;
+	if (spill->index.size)
+		front_id = replay_spill_entry(spill, 0)->segment;
+
+	size_t num = 0;
+	while (num < spill->segments.num &&
+	       spill->segments.array[num]->id < front_id)
+		segment_release(spill->segments.array[num++]);
+
+	if (num)
+		da_erase_range(spill->segments, 0, num);
+}
+
+void replay_spill_get_packet(struct replay_spill *spill,
+			     const struct replay_index_entry *entry,
+			     struct encoder_packet *packet)
+{
+	struct replay_segment *seg = get_segment(spill, entry->segment);
+
+	memset(packet, 0, sizeof(*packet));
+	packet->data = seg->data + entry->offset;
+	packet->size = entry->size;
+	packet->dts = entry->dts;
+	packet->pts = entry->pts;
+	packet->dts_usec = entry->dts_usec;
+	packet->type = (enum obs_encoder_type)entry->type;
+	packet->track_idx = entry->track_idx;
+	packet->keyframe = entry->keyframe;
+}
+
+void replay_spill_ref_segments(struct replay_spill *spill,
+			       struct darray *segments)
+{
+	DARRAY(struct replay_segment *) refs;
+	refs.da = *segments;
+
+	for (size_t i = 0; i < spill->segments.num; i++) {
+		struct replay_segment *seg = spill->segments.array[i];
+		os_atomic_inc_long(&seg->refs);
+		da_push_back(refs, &seg);
+	}
+
+	*segments = refs.da;
+}
+
+void replay_spill_release_segments(struct darray *segments)
+{
+	DARRAY(struct replay_segment *) refs;
+	refs.da = *segments;
+
+	for (size_t i = 0; i < refs.num; i++)
+		segment_release(refs.array[i]);
+
+	da_free(refs);
+	*segments = refs.da;
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs-module.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+/*
+ * Disk spill storage for the replay buffer.
+ *
+ * Packet data is appended to fixed size memory mapped segment files and only
+ * a small index entry per packet stays in memory.  Segment files are removed
+ * from disk as soon as they are no longer referenced, which happens either
+ * when the index is purged past them or when a save that was using them is
+ * done.
+ */
+
+/* offsets and sizes in the index are 32-bit, so segments have to stay below
+ * 4 GiB */
+#define REPLAY_SPILL_MAX_SEGMENT_MB 4095
+
+struct replay_segment;
+
+struct replay_index_entry {
+	int64_t dts;
+	int64_t pts;
+	int64_t dts_usec;
+	uint32_t segment;
+	uint32_t offset;
+	uint32_t size;
+	uint8_t type;
+	uint8_t track_idx;
+	bool keyframe;
+};
+
+struct replay_spill {
+	struct dstr dir;
+	size_t segment_size;
+	uint32_t next_id;
+
+	/* oldest first, ids are consecutive */
+	DARRAY(struct replay_segment *) segments;
+	struct circlebuf index;
+};
+
+extern bool replay_spill_init(struct replay_spill *spill, const char *dir,
+			      size_t segment_size);
+extern void replay_spill_free(struct replay_spill *spill);
+
+static inline size_t replay_spill_count(const struct replay_spill *spill)
+{
+	return spill->index.size / sizeof(struct replay_index_entry);
+}
+
+static inline struct replay_index_entry *
+replay_spill_entry(struct replay_spill *spill, size_t idx)
+{
+	return circlebuf_data(&spill->index,
+			      idx * sizeof(struct replay_index_entry));
+}
+
+/** Writes the packet data to disk and adds it to the index */
+extern bool replay_spill_push(struct replay_spill *spill,
+			      const struct encoder_packet *packet);
+
+/** Removes the oldest packet, unused segments are released */
+extern void replay_spill_pop_front(struct replay_spill *spill,
+				   struct replay_index_entry *entry);
+
+/**
+ * Fills out a packet that points directly in to the mapped segment data.
+ * The packet is not reference counted, so the segment it points to must be
+ * kept alive with replay_spill_ref_segments while the packet is used.
+ */
+extern void replay_spill_get_packet(struct replay_spill *spill,
+				    const struct replay_index_entry *entry,
+				    struct encoder_packet *packet);
+
+/** Adds a reference to every current segment and appends it to segments */
+extern void replay_spill_ref_segments(struct replay_spill *spill,
+				      struct darray *segments);
+extern void replay_spill_release_segments(struct darray *segments);
@@ -56,6 +56,11 @@ struct ffmpeg_source {
 	bool is_clear_on_media_end;
 	bool restart_on_activate;
 	bool close_when_inactive;
+	bool cache_frames;
+	int cache_max_mb;
+	int cache_max_sec;
+	bool pipelined_decoding;
+	int decode_threads;
 	bool seekable;
 
 	pthread_t reconnect_thread;
@@ -89,6 +94,12 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
+	obs_property_t *cache_frames =
+		obs_properties_get(props, "cache_frames");
+	obs_property_t *cache_max_mb =
+		obs_properties_get(props, "cache_max_mb");
+	obs_property_t *cache_max_sec =
+		obs_properties_get(props, "cache_max_sec");
 	obs_property_t *reconnect_delay_sec =
 		obs_properties_get(props, "reconnect_delay_sec");
 	obs_property_set_visible(input, !enabled);
@@ -97,6 +108,9 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(local_file, enabled);
 	obs_property_set_visible(looping, enabled);
 	obs_property_set_visible(speed, enabled);
+	obs_property_set_visible(cache_frames, enabled);
+	obs_property_set_visible(cache_max_mb, enabled);
+	obs_property_set_visible(cache_max_sec, enabled);
 	obs_property_set_visible(seekable, !enabled);
 	obs_property_set_visible(reconnect_delay_sec, !enabled);
 
@@ -112,6 +126,11 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "reconnect_delay_sec", 10);
 	obs_data_set_default_int(settings, "buffering_mb", 2);
 	obs_data_set_default_int(settings, "speed_percent", 100);
+	obs_data_set_default_bool(settings, "cache_frames", false);
+	obs_data_set_default_int(settings, "cache_max_mb", 512);
+	obs_data_set_default_int(settings, "cache_max_sec", 30);
+	obs_data_set_default_bool(settings, "pipelined_decoding", false);
+	obs_data_set_default_int(settings, "decode_threads", 0);
 }
 
 static const char *media_filter =
@@ -219,6 +238,32 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 
 	obs_properties_add_bool(props, "seekable", obs_module_text("Seekable"));
 
+	prop = obs_properties_add_bool(props, "cache_frames",
+				       obs_module_text("CacheFrames"));
+	obs_property_set_long_description(
+		prop, obs_module_text("CacheFrames.ToolTip"));
+
+	prop = obs_properties_add_int(props, "cache_max_mb",
+				      obs_module_text("CacheMaxSize"), 16,
+				      8192, 16);
+	obs_property_int_set_suffix(prop, " MB");
+
+	prop = obs_properties_add_int(props, "cache_max_sec",
+				      obs_module_text("CacheMaxDuration"), 1,
+				      600, 1);
+	obs_property_int_set_suffix(prop, " S");
+
+	prop = obs_properties_add_bool(props, "pipelined_decoding",
+				       obs_module_text("PipelinedDecoding"));
+	obs_property_set_long_description(
+		prop, obs_module_text("PipelinedDecoding.ToolTip"));
+
+	prop = obs_properties_add_int(props, "decode_threads",
+				      obs_module_text("DecodeThreads"), 0, 64,
+				      1);
+	obs_property_set_long_description(
+		prop, obs_module_text("DecodeThreads.ToolTip"));
+
 	return props;
 }
 
@@ -234,13 +279,18 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		"\tis_hw_decoding:          %s\n"
 		"\tis_clear_on_media_end:   %s\n"
 		"\trestart_on_activate:     %s\n"
-		"\tclose_when_inactive:     %s",
+		"\tclose_when_inactive:     %s\n"
+		"\tcache_frames:            %s\n"
+		"\tpipelined_decoding:      %s\n"
+		"\tdecode_threads:          %d",
 		input ? input : "(null)",
 		input_format ? input_format : "(null)", s->speed_percent,
 		s->is_looping ? "yes" : "no", s->is_hw_decoding ? "yes" : "no",
 		s->is_clear_on_media_end ? "yes" : "no",
 		s->restart_on_activate ? "yes" : "no",
-		s->close_when_inactive ? "yes" : "no");
+		s->close_when_inactive ? "yes" : "no",
+		s->cache_frames ? "yes" : "no",
+		s->pipelined_decoding ? "yes" : "no", s->decode_threads);
 }
 
 static void get_frame(void *opaque, struct obs_source_frame *f)
@@ -294,6 +344,7 @@ static void media_stopped(void *opaque)
 static void ffmpeg_source_open(struct ffmpeg_source *s)
 {
 	if (s->input && *s->input) {
+		char *index_dir = obs_module_config_path("seek-index");
 		struct mp_media_info info = {
 			.opaque = s,
 			.v_cb = get_frame,
@@ -309,9 +360,17 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.hardware_decoding = s->is_hw_decoding,
 			.is_local_file = s->is_local_file || s->seekable,
 			.reconnecting = s->reconnecting,
+			.cache_frames = s->is_local_file && s->cache_frames,
+			.cache_max_size = (size_t)s->cache_max_mb * 1024 * 1024,
+			.cache_max_duration = (int64_t)s->cache_max_sec * 1000,
+			.build_index = s->is_local_file,
+			.index_dir = index_dir,
+			.pipelined = s->pipelined_decoding,
+			.decode_threads = s->decode_threads,
 		};
 
 		s->media_valid = mp_media_init(&s->media, &info);
+		bfree(index_dir);
 	}
 }
 
@@ -433,6 +492,12 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->speed_percent = (int)obs_data_get_int(settings, "speed_percent");
 	s->is_local_file = is_local_file;
 	s->seekable = obs_data_get_bool(settings, "seekable");
+	s->cache_frames = obs_data_get_bool(settings, "cache_frames");
+	s->cache_max_mb = (int)obs_data_get_int(settings, "cache_max_mb");
+	s->cache_max_sec = (int)obs_data_get_int(settings, "cache_max_sec");
+	s->pipelined_decoding =
+		obs_data_get_bool(settings, "pipelined_decoding");
+	s->decode_threads = (int)obs_data_get_int(settings, "decode_threads");
 
 	if (s->speed_percent < 1 || s->speed_percent > 200)
 		s->speed_percent = 100;
@@ -487,6 +552,26 @@ static void get_duration(void *data, calldata_t *cd)
 	calldata_set_int(cd, "duration", dur * 1000);
 }
 
+uint64_t ffmpeg_source_get_memory_usage(void *data)
+{
+	struct ffmpeg_source *s = data;
+	return s->media_valid ? mp_media_get_memory_usage(&s->media) : 0;
+}
+
+static void get_memory_usage(void *data, calldata_t *cd)
+{
+	calldata_set_int(cd, "memory_usage",
+			 (long long)ffmpeg_source_get_memory_usage(data));
+}
+
+static void seek_to_frame(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+
+	if (s->media_valid)
+		mp_media_seek_to_frame(&s->media, calldata_int(cd, "frame"));
+}
+
 static void get_nb_frames(void *data, calldata_t *cd)
 {
 	struct ffmpeg_source *s = data;
@@ -497,6 +582,14 @@ static void get_nb_frames(void *data, calldata_t *cd)
 		return;
 	}
 
+	frames = mp_media_get_frames(&s->media);
+	if (frames >= 0) {
+		calldata_set_int(cd, "num_frames", frames);
+		return;
+	}
+
+	frames = 0;
+
 	int video_stream_index = av_find_best_stream(
 		s->media.fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
 
@@ -604,6 +697,10 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 			 get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
 			 get_nb_frames, s);
+	proc_handler_add(ph, "void get_memory_usage(out int memory_usage)",
+			 get_memory_usage, s);
+	proc_handler_add(ph, "void seek_to_frame(int frame)", seek_to_frame,
+			 s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
@@ -762,12 +859,27 @@ static obs_missing_files_t *ffmpeg_source_missingfiles(void *data)
 	return files;
 }
 
+/* seek index files older than this are removed when the module is loaded, the
+ * index of a file that is still used is simply built and saved again */
+#define SEEK_INDEX_MAX_AGE (30 * 24 * 60 * 60)
+
+void ffmpeg_source_purge_seek_index(void)
+{
+	char *index_dir = obs_module_config_path("seek-index");
+	size_t count = mp_index_purge_cache(index_dir, SEEK_INDEX_MAX_AGE);
+
+	if (count)
+		FF_LOG(LOG_INFO, "Removed %zu old seek index files", count);
+	bfree(index_dir);
+}
+
 struct obs_source_info ffmpeg_source = {
 	.id = "ffmpeg_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_AUDIO |
 			OBS_SOURCE_DO_NOT_DUPLICATE |
-			OBS_SOURCE_CONTROLLABLE_MEDIA,
+			OBS_SOURCE_CONTROLLABLE_MEDIA |
+			OBS_SOURCE_PARALLEL_LOAD,
 	.get_name = ffmpeg_source_getname,
 	.create = ffmpeg_source_create,
 	.destroy = ffmpeg_source_destroy,
@@ -222,6 +222,8 @@ extern void jim_nvenc_load(void);
 extern void jim_nvenc_unload(void);
 #endif
 
+extern void ffmpeg_source_purge_seek_index(void);
+
 #if ENABLE_FFMPEG_LOGGING
 extern void obs_ffmpeg_load_logging(void);
 extern void obs_ffmpeg_unload_logging(void);
@@ -230,6 +232,7 @@ extern void obs_ffmpeg_unload_logging(void);
 bool obs_module_load(void)
 {
 	obs_register_source(&ffmpeg_source);
+	ffmpeg_source_purge_seek_index();
 	obs_register_output(&ffmpeg_output);
 	obs_register_output(&ffmpeg_muxer);
 	obs_register_output(&ffmpeg_mpegts_muxer);
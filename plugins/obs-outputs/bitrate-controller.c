@@ -0,0 +1,636 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include "bitrate-controller.h"
+
+#define MSEC_TO_NSEC 1000000ULL
+#define SEC_TO_NSEC 1000000000ULL
+#define MSEC_TO_USEC 1000LL
+
+/* number of decisions kept around for the stats API */
+#define MAX_DECISIONS 256
+
+/* increases smaller than this are not worth reconfiguring the encoder for */
+#define MIN_INCREASE_PERCENT 5
+
+struct bitrate_controller {
+	const struct bitrate_model_info *model;
+	void *data;
+	struct bitrate_controller_config config;
+
+	long bitrate;
+	long est_bitrate;
+	int64_t queue_usec;
+	double gradient;
+
+	uint64_t samples;
+	uint64_t increases;
+	uint64_t decreases;
+	struct circlebuf decisions;
+};
+
+/* ========================================================================= */
+/* delay gradient model
+ *
+ * Estimates the link throughput from how fast data gets out while the sender
+ * is backlogged, and detects congestion from the amount of queued media and
+ * how quickly it grows.  On congestion the bitrate drops below the measured
+ * throughput so that the queue can drain, afterwards it is ramped back up:
+ * slowly near the last known throughput, multiplicatively far away from it.
+ */
+
+/* throughput is measured over (at most) the last second of a backlog */
+#define RATE_WINDOW_NS (1000ULL * MSEC_TO_NSEC)
+#define MIN_RATE_WINDOW_NS (250ULL * MSEC_TO_NSEC)
+
+/* queue samples used for the gradient, about a second of video */
+#define TREND_POINTS 32
+#define MIN_TREND_POINTS 8
+
+#define QUEUE_LOW_USEC (50LL * MSEC_TO_USEC)
+#define QUEUE_OVERUSE_USEC (100LL * MSEC_TO_USEC)
+#define QUEUE_MAX_USEC (400LL * MSEC_TO_USEC)
+
+/* ms of queued media per second */
+#define GRADIENT_OVERUSE 20.0
+#define GRADIENT_DRAINING -20.0
+
+#define DECREASE_FACTOR 0.85
+#define DECREASE_HOLD_NS (1000ULL * MSEC_TO_NSEC)
+#define INCREASE_HOLD_NS (3000ULL * MSEC_TO_NSEC)
+
+/* per second */
+#define MULTIPLICATIVE_INCREASE 0.08
+#define ADDITIVE_INCREASE_PERCENT 1
+
+/* a throughput estimate this old says nothing about the link anymore */
+#define ESTIMATE_TIMEOUT_NS (30ULL * SEC_TO_NSEC)
+
+struct trend_point {
+	uint64_t ts;
+	int64_t queue_usec;
+};
+
+struct delay_gradient {
+	struct bitrate_controller_config config;
+
+	/* samples of the current backlog, within RATE_WINDOW_NS */
+	struct circlebuf backlog;
+	size_t backlog_bytes;
+	bool new_backlog;
+
+	/* throughput estimate including audio */
+	double est_total;
+	uint64_t est_ts;
+
+	struct trend_point trend[TREND_POINTS];
+	size_t trend_count;
+	size_t trend_pos;
+	double gradient;
+
+	double target;
+	uint64_t last_update_ts;
+	uint64_t last_decrease_ts;
+};
+
+static void *dg_create(const struct bitrate_controller_config *config)
+{
+	struct delay_gradient *dg = bzalloc(sizeof(*dg));
+	dg->config = *config;
+	dg->target = (double)config->max_bitrate;
+	return dg;
+}
+
+static void dg_destroy(void *data)
+{
+	struct delay_gradient *dg = data;
+	circlebuf_free(&dg->backlog);
+	bfree(dg);
+}
+
+static void dg_add_sample(void *data, const struct bitrate_sample *sample)
+{
+	struct delay_gradient *dg = data;
+	struct bitrate_sample front;
+	uint64_t dur;
+	double rate;
+
+	/* nothing was waiting, so the send rate only reflects how fast the
+	 * encoder produces data and not what the link can take */
+	if (sample->queue_usec <= 0) {
+		circlebuf_pop_front(&dg->backlog, NULL, dg->backlog.size);
+		dg->backlog_bytes = 0;
+		return;
+	}
+
+	if (!dg->backlog.size)
+		dg->new_backlog = true;
+
+	circlebuf_push_back(&dg->backlog, sample, sizeof(*sample));
+	dg->backlog_bytes += sample->size;
+
+	for (;;) {
+		circlebuf_peek_front(&dg->backlog, &front, sizeof(front));
+		if (sample->send_end - front.send_beg <= RATE_WINDOW_NS ||
+		    dg->backlog.size == sizeof(front))
+			break;
+
+		circlebuf_pop_front(&dg->backlog, NULL, sizeof(front));
+		dg->backlog_bytes -= front.size;
+	}
+
+	dur = sample->send_end - front.send_beg;
+	if (dur < MIN_RATE_WINDOW_NS)
+		return;
+
+	/* bytes per ns to kbps */
+	rate = (double)dg->backlog_bytes * 8.0 * 1000000.0 / (double)dur;
+
+	if (dg->new_backlog || dg->est_total == 0.0) {
+		dg->est_total = rate;
+		dg->new_backlog = false;
+	} else {
+		dg->est_total = dg->est_total * 0.75 + rate * 0.25;
+	}
+	dg->est_ts = sample->send_end;
+}
+
+static void dg_add_trend_point(struct delay_gradient *dg, uint64_t ts,
+			       int64_t queue_usec)
+{
+	double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+	double n, denom;
+	uint64_t base;
+
+	dg->trend[dg->trend_pos].ts = ts;
+	dg->trend[dg->trend_pos].queue_usec = queue_usec;
+	dg->trend_pos = (dg->trend_pos + 1) % TREND_POINTS;
+	if (dg->trend_count < TREND_POINTS)
+		dg->trend_count++;
+
+	if (dg->trend_count < MIN_TREND_POINTS) {
+		dg->gradient = 0.0;
+		return;
+	}
+
+	/* least squares slope of the queue duration over time, like the
+	 * trendline filter used for delay based congestion control */
+	base = dg->trend[(dg->trend_pos + TREND_POINTS - dg->trend_count) %
+			 TREND_POINTS]
+		       .ts;
+
+	for (size_t i = 0; i < dg->trend_count; i++) {
+		const struct trend_point *p = &dg->trend[i];
+		double x = (double)(p->ts - base) / (double)MSEC_TO_NSEC;
+		double y = (double)p->queue_usec / (double)MSEC_TO_USEC;
+
+		sum_x += x;
+		sum_y += y;
+		sum_xx += x * x;
+		sum_xy += x * y;
+	}
+
+	n = (double)dg->trend_count;
+	denom = n * sum_xx - sum_x * sum_x;
+
+	/* ms per ms to ms per second */
+	dg->gradient = denom > 0.0
+			       ? (n * sum_xy - sum_x * sum_y) / denom * 1000.0
+			       : 0.0;
+}
+
+static inline double dg_est_video(struct delay_gradient *dg)
+{
+	double est = dg->est_total - (double)dg->config.audio_bitrate;
+	if (dg->est_total == 0.0)
+		return 0.0;
+	return est > (double)dg->config.min_bitrate
+		       ? est
+		       : (double)dg->config.min_bitrate;
+}
+
+static void dg_update(void *data, uint64_t ts, int64_t queue_usec,
+		      long cur_bitrate, struct bitrate_model_state *state)
+{
+	struct delay_gradient *dg = data;
+	double max_bitrate = (double)dg->config.max_bitrate;
+	double est_video;
+	double dt;
+	bool overuse;
+
+	dg_add_trend_point(dg, ts, queue_usec);
+
+	dt = dg->last_update_ts
+		     ? (double)(ts - dg->last_update_ts) / (double)SEC_TO_NSEC
+		     : 0.0;
+	if (dt > 1.0)
+		dt = 1.0;
+	dg->last_update_ts = ts;
+
+	if (dg->est_total != 0.0 && ts - dg->est_ts > ESTIMATE_TIMEOUT_NS)
+		dg->est_total = 0.0;
+
+	est_video = dg_est_video(dg);
+
+	overuse = (queue_usec >= QUEUE_OVERUSE_USEC &&
+		   dg->gradient > GRADIENT_OVERUSE) ||
+		  (queue_usec >= QUEUE_MAX_USEC &&
+		   dg->gradient > GRADIENT_DRAINING);
+
+	if (overuse) {
+		if (!dg->last_decrease_ts ||
+		    ts - dg->last_decrease_ts >= DECREASE_HOLD_NS) {
+			double target = (double)cur_bitrate * DECREASE_FACTOR;
+
+			if (est_video != 0.0 &&
+			    est_video * DECREASE_FACTOR < target)
+				target = est_video * DECREASE_FACTOR;
+
+			dg->target = target;
+			dg->last_decrease_ts = ts;
+		}
+
+	} else if (queue_usec < QUEUE_LOW_USEC &&
+		   dg->gradient < GRADIENT_OVERUSE &&
+		   (!dg->last_decrease_ts ||
+		    ts - dg->last_decrease_ts >= INCREASE_HOLD_NS)) {
+
+		/* the send buffer hides a small overshoot, so stay careful
+		 * around the last measured throughput until it times out */
+		if (est_video != 0.0 && dg->target >= est_video * 0.9) {
+			dg->target += max_bitrate * dt *
+				      ADDITIVE_INCREASE_PERCENT / 100.0;
+		} else {
+			dg->target *= 1.0 + MULTIPLICATIVE_INCREASE * dt;
+		}
+	}
+
+	if (dg->target > max_bitrate)
+		dg->target = max_bitrate;
+	if (dg->target < (double)dg->config.min_bitrate)
+		dg->target = (double)dg->config.min_bitrate;
+
+	state->target = (long)dg->target;
+	state->est_bitrate = (long)dg_est_video(dg);
+	state->gradient = dg->gradient;
+}
+
+static void dg_bitrate_changed(void *data, uint64_t ts, long bitrate)
+{
+	struct delay_gradient *dg = data;
+
+	/* reset by the controller */
+	if ((double)bitrate > dg->target)
+		dg->target = (double)bitrate;
+
+	UNUSED_PARAMETER(ts);
+}
+
+static const struct bitrate_model_info delay_gradient_model = {
+	.id = BITRATE_MODEL_DELAY_GRADIENT,
+	.create = dg_create,
+	.destroy = dg_destroy,
+	.add_sample = dg_add_sample,
+	.update = dg_update,
+	.bitrate_changed = dg_bitrate_changed,
+};
+
+/* ========================================================================= */
+/* legacy model
+ *
+ * The original dynamic bitrate behavior: once more than DBR_TRIGGER_USEC of
+ * media is queued, drop to the throughput measured over the last couple of
+ * seconds, then try going up by a tenth of the original bitrate every 30
+ * seconds.
+ */
+
+#define LEGACY_INC_TIMER (30ULL * SEC_TO_NSEC)
+#define LEGACY_TRIGGER_USEC (200LL * MSEC_TO_USEC)
+#define MIN_ESTIMATE_DURATION_MS 1000
+#define MAX_ESTIMATE_DURATION_MS 2000
+
+struct legacy {
+	struct bitrate_controller_config config;
+
+	struct circlebuf frames;
+	size_t data_size;
+	long est_bitrate;
+	long prev_bitrate;
+	long cur_bitrate;
+	long inc_bitrate;
+	uint64_t inc_timeout;
+};
+
+static void *legacy_create(const struct bitrate_controller_config *config)
+{
+	struct legacy *l = bzalloc(sizeof(*l));
+	l->config = *config;
+	l->cur_bitrate = config->max_bitrate;
+	l->inc_bitrate = config->max_bitrate / 10;
+	return l;
+}
+
+static void legacy_destroy(void *data)
+{
+	struct legacy *l = data;
+	circlebuf_free(&l->frames);
+	bfree(l);
+}
+
+static void legacy_add_sample(void *data, const struct bitrate_sample *back)
+{
+	struct legacy *l = data;
+	struct bitrate_sample front;
+	uint64_t dur;
+
+	circlebuf_push_back(&l->frames, back, sizeof(*back));
+	circlebuf_peek_front(&l->frames, &front, sizeof(front));
+
+	l->data_size += back->size;
+
+	dur = (back->send_end - front.send_beg) / 1000000;
+
+	if (dur >= MAX_ESTIMATE_DURATION_MS) {
+		l->data_size -= front.size;
+		circlebuf_pop_front(&l->frames, NULL, sizeof(front));
+	}
+
+	l->est_bitrate = (dur >= MIN_ESTIMATE_DURATION_MS)
+				 ? (long)(l->data_size * 1000 / dur)
+				 : 0;
+	l->est_bitrate *= 8;
+	l->est_bitrate /= 1000;
+
+	if (l->est_bitrate) {
+		l->est_bitrate -= l->config.audio_bitrate;
+		if (l->est_bitrate < 50)
+			l->est_bitrate = 50;
+	}
+}
+
+static void legacy_update(void *data, uint64_t ts, int64_t queue_usec,
+			  long cur_bitrate, struct bitrate_model_state *state)
+{
+	struct legacy *l = data;
+	long est_bitrate = 0;
+
+	state->target = cur_bitrate;
+	state->est_bitrate = l->est_bitrate;
+	state->gradient = 0.0;
+
+	if (l->inc_timeout && ts >= l->inc_timeout) {
+		l->inc_timeout = 0;
+		l->prev_bitrate = cur_bitrate;
+		state->target = cur_bitrate + l->inc_bitrate;
+
+		if (state->target < l->config.max_bitrate)
+			l->inc_timeout = ts + LEGACY_INC_TIMER;
+		return;
+	}
+
+	if (queue_usec < LEGACY_TRIGGER_USEC)
+		return;
+
+	if (l->est_bitrate && l->est_bitrate < cur_bitrate) {
+		l->data_size = 0;
+		circlebuf_pop_front(&l->frames, NULL, l->frames.size);
+		est_bitrate = l->est_bitrate / 100 * 100;
+		if (est_bitrate < 50) {
+			est_bitrate = 50;
+		}
+	}
+
+	if (est_bitrate)
+		state->target = est_bitrate;
+	else if (l->prev_bitrate)
+		state->target = l->prev_bitrate;
+}
+
+static void legacy_bitrate_changed(void *data, uint64_t ts, long bitrate)
+{
+	struct legacy *l = data;
+
+	if (bitrate < l->cur_bitrate) {
+		l->prev_bitrate = 0;
+		l->inc_timeout = ts + LEGACY_INC_TIMER;
+	} else if (bitrate >= l->config.max_bitrate) {
+		l->inc_timeout = 0;
+	}
+
+	l->cur_bitrate = bitrate;
+}
+
+static const struct bitrate_model_info legacy_model = {
+	.id = BITRATE_MODEL_LEGACY,
+	.create = legacy_create,
+	.destroy = legacy_destroy,
+	.add_sample = legacy_add_sample,
+	.update = legacy_update,
+	.bitrate_changed = legacy_bitrate_changed,
+};
+
+/* ========================================================================= */
+
+static const struct bitrate_model_info *models[] = {
+	&delay_gradient_model,
+	&legacy_model,
+};
+
+bitrate_controller_t *
+bitrate_controller_create(const char *model_id,
+			  const struct bitrate_controller_config *config)
+{
+	for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+		if (model_id && strcmp(models[i]->id, model_id) == 0)
+			return bitrate_controller_create_custom(models[i],
+								config);
+	}
+
+	return NULL;
+}
+
+bitrate_controller_t *
+bitrate_controller_create_custom(const struct bitrate_model_info *model,
+				 const struct bitrate_controller_config *config)
+{
+	struct bitrate_controller *bc;
+
+	if (!model || !model->create || !model->update)
+		return NULL;
+
+	bc = bzalloc(sizeof(*bc));
+	bc->model = model;
+	bc->config = *config;
+	if (bc->config.min_bitrate > bc->config.max_bitrate)
+		bc->config.min_bitrate = bc->config.max_bitrate;
+	bc->bitrate = bc->config.max_bitrate;
+
+	bc->data = model->create(&bc->config);
+	if (!bc->data) {
+		bfree(bc);
+		return NULL;
+	}
+
+	return bc;
+}
+
+void bitrate_controller_destroy(bitrate_controller_t *bc)
+{
+	if (!bc)
+		return;
+
+	if (bc->model->destroy)
+		bc->model->destroy(bc->data);
+	circlebuf_free(&bc->decisions);
+	bfree(bc);
+}
+
+const char *bitrate_controller_model_id(bitrate_controller_t *bc)
+{
+	return bc ? bc->model->id : NULL;
+}
+
+void bitrate_controller_add_sample(bitrate_controller_t *bc,
+				   const struct bitrate_sample *sample)
+{
+	bc->samples++;
+	if (bc->model->add_sample)
+		bc->model->add_sample(bc->data, sample);
+}
+
+static void apply_bitrate(struct bitrate_controller *bc, uint64_t ts,
+			  enum bitrate_decision_type type, long bitrate)
+{
+	struct bitrate_decision decision = {
+		.ts = ts,
+		.type = type,
+		.prev_bitrate = bc->bitrate,
+		.bitrate = bitrate,
+		.est_bitrate = bc->est_bitrate,
+		.queue_usec = bc->queue_usec,
+		.gradient = bc->gradient,
+	};
+
+	if (bc->decisions.size == MAX_DECISIONS * sizeof(decision))
+		circlebuf_pop_front(&bc->decisions, NULL, sizeof(decision));
+	circlebuf_push_back(&bc->decisions, &decision, sizeof(decision));
+
+	if (type == BITRATE_DECISION_DECREASE)
+		bc->decreases++;
+	else if (type == BITRATE_DECISION_INCREASE)
+		bc->increases++;
+
+	bc->bitrate = bitrate;
+	if (bc->model->bitrate_changed)
+		bc->model->bitrate_changed(bc->data, ts, bitrate);
+}
+
+bool bitrate_controller_update(bitrate_controller_t *bc, uint64_t ts,
+			       int64_t queue_usec, long *bitrate)
+{
+	struct bitrate_model_state state = {.target = bc->bitrate};
+	long target;
+
+	bc->model->update(bc->data, ts, queue_usec, bc->bitrate, &state);
+
+	bc->est_bitrate = state.est_bitrate;
+	bc->gradient = state.gradient;
+	bc->queue_usec = queue_usec;
+
+	target = state.target;
+	if (target > bc->config.max_bitrate)
+		target = bc->config.max_bitrate;
+	if (target < bc->config.min_bitrate)
+		target = bc->config.min_bitrate;
+
+	if (target == bc->bitrate)
+		return false;
+
+	if (target > bc->bitrate) {
+		long step = target - bc->bitrate;
+
+		if (target != bc->config.max_bitrate &&
+		    step * 100 < bc->bitrate * MIN_INCREASE_PERCENT)
+			return false;
+
+		apply_bitrate(bc, ts, BITRATE_DECISION_INCREASE, target);
+	} else {
+		apply_bitrate(bc, ts, BITRATE_DECISION_DECREASE, target);
+	}
+
+	*bitrate = target;
+	return true;
+}
+
+bool bitrate_controller_reset(bitrate_controller_t *bc, uint64_t ts)
+{
+	if (bc->bitrate == bc->config.max_bitrate)
+		return false;
+
+	apply_bitrate(bc, ts, BITRATE_DECISION_RESET, bc->config.max_bitrate);
+	return true;
+}
+
+long bitrate_controller_get_bitrate(bitrate_controller_t *bc)
+{
+	return bc->bitrate;
+}
+
+void bitrate_controller_get_stats(bitrate_controller_t *bc,
+				  struct bitrate_controller_stats *stats)
+{
+	stats->bitrate = bc->bitrate;
+	stats->est_bitrate = bc->est_bitrate;
+	stats->min_bitrate = bc->config.min_bitrate;
+	stats->max_bitrate = bc->config.max_bitrate;
+	stats->queue_usec = bc->queue_usec;
+	stats->gradient = bc->gradient;
+	stats->samples = bc->samples;
+	stats->increases = bc->increases;
+	stats->decreases = bc->decreases;
+	stats->decisions = bc->decisions.size / sizeof(struct bitrate_decision);
+}
+
+bool bitrate_controller_get_decision(bitrate_controller_t *bc, size_t idx,
+				     struct bitrate_decision *decision)
+{
+	size_t offset = idx * sizeof(*decision);
+
+	if (offset >= bc->decisions.size)
+		return false;
+
+	memcpy(decision, circlebuf_data(&bc->decisions, offset),
+	       sizeof(*decision));
+	return true;
+}
+
+const char *bitrate_decision_type_name(enum bitrate_decision_type type)
+{
+	switch (type) {
+	case BITRATE_DECISION_DECREASE:
+		return "decrease";
+	case BITRATE_DECISION_INCREASE:
+		return "increase";
+	case BITRATE_DECISION_RESET:
+		return "reset";
+	}
+
+	return "unknown";
+}
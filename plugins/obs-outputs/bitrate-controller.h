@@ -0,0 +1,149 @@
+/******************************************************************************
+    Copyright (C) 2021 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Dynamic bitrate controller.
+ *
+ * The controller is fed a sample after every socket send and is polled with
+ * the amount of media waiting to be sent.  A congestion model turns that in
+ * to a target video bitrate, and the controller takes care of clamping,
+ * avoiding tiny encoder updates and recording every decision it makes.
+ *
+ * Nothing in here touches the network or the encoder, so the whole thing can
+ * be driven by a simulated clock.  All times are in nanoseconds and all
+ * bitrates are in kbps.  The controller is not thread safe.
+ */
+
+#define BITRATE_MODEL_DELAY_GRADIENT "delay_gradient"
+#define BITRATE_MODEL_LEGACY "legacy"
+
+struct bitrate_controller;
+typedef struct bitrate_controller bitrate_controller_t;
+
+struct bitrate_controller_config {
+	/* the bitrate the encoder was configured with, never exceeded */
+	long max_bitrate;
+	long min_bitrate;
+	/* sent along with the video but not controlled */
+	long audio_bitrate;
+};
+
+struct bitrate_sample {
+	uint64_t send_beg;
+	uint64_t send_end;
+	size_t size;
+	/* media duration that was waiting when the send started, measured
+	 * from the first packet of the send to the newest queued packet */
+	int64_t queue_usec;
+};
+
+enum bitrate_decision_type {
+	BITRATE_DECISION_DECREASE,
+	BITRATE_DECISION_INCREASE,
+	BITRATE_DECISION_RESET,
+};
+
+struct bitrate_decision {
+	uint64_t ts;
+	enum bitrate_decision_type type;
+	long prev_bitrate;
+	long bitrate;
+	/* throughput available for video, 0 if not known */
+	long est_bitrate;
+	int64_t queue_usec;
+	/* queue growth in milliseconds per second */
+	double gradient;
+};
+
+struct bitrate_controller_stats {
+	long bitrate;
+	long est_bitrate;
+	long min_bitrate;
+	long max_bitrate;
+	int64_t queue_usec;
+	double gradient;
+	uint64_t samples;
+	uint64_t increases;
+	uint64_t decreases;
+	size_t decisions;
+};
+
+/* state a model reports back on every update */
+struct bitrate_model_state {
+	long target;
+	long est_bitrate;
+	double gradient;
+};
+
+struct bitrate_model_info {
+	const char *id;
+
+	void *(*create)(const struct bitrate_controller_config *config);
+	void (*destroy)(void *data);
+
+	void (*add_sample)(void *data, const struct bitrate_sample *sample);
+
+	/**
+	 * Called for every video frame queued for sending.  cur_bitrate is
+	 * the bitrate the encoder is currently using.
+	 */
+	void (*update)(void *data, uint64_t ts, int64_t queue_usec,
+		       long cur_bitrate, struct bitrate_model_state *state);
+
+	/* optional, called when the controller applied a new bitrate */
+	void (*bitrate_changed)(void *data, uint64_t ts, long bitrate);
+};
+
+/** Creates a controller with one of the built-in models, NULL if unknown */
+extern bitrate_controller_t *
+bitrate_controller_create(const char *model_id,
+			  const struct bitrate_controller_config *config);
+extern bitrate_controller_t *bitrate_controller_create_custom(
+	const struct bitrate_model_info *model,
+	const struct bitrate_controller_config *config);
+extern void bitrate_controller_destroy(bitrate_controller_t *bc);
+
+extern const char *bitrate_controller_model_id(bitrate_controller_t *bc);
+
+extern void bitrate_controller_add_sample(bitrate_controller_t *bc,
+					  const struct bitrate_sample *sample);
+
+/**
+ * Runs the model and returns true if the bitrate should be changed, in which
+ * case the new bitrate is stored in bitrate.
+ */
+extern bool bitrate_controller_update(bitrate_controller_t *bc, uint64_t ts,
+				      int64_t queue_usec, long *bitrate);
+
+/** Goes back to the maximum bitrate, returns true if that is a change */
+extern bool bitrate_controller_reset(bitrate_controller_t *bc, uint64_t ts);
+
+extern long bitrate_controller_get_bitrate(bitrate_controller_t *bc);
+extern void
+bitrate_controller_get_stats(bitrate_controller_t *bc,
+			     struct bitrate_controller_stats *stats);
+
+/** Gets a recorded decision, 0 being the oldest one still stored */
+extern bool bitrate_controller_get_decision(bitrate_controller_t *bc,
+					    size_t idx,
+					    struct bitrate_decision *decision);
+
+extern const char *bitrate_decision_type_name(enum bitrate_decision_type type);
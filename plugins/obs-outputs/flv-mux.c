@@ -174,6 +174,7 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 {
 	int64_t offset = packet->pts - packet->dts;
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	uint32_t start_pos = (uint32_t)serializer_get_pos(s);
 
 	if (!packet->data || !packet->size)
 		return;
@@ -201,13 +202,14 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)serializer_get_pos(s) - start_pos - 1);
 }
 
 static void flv_audio(struct serializer *s, int32_t dts_offset,
 		      struct encoder_packet *packet, bool is_header)
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	uint32_t start_pos = (uint32_t)serializer_get_pos(s);
 
 	if (!packet->data || !packet->size)
 		return;
@@ -234,7 +236,7 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)serializer_get_pos(s) - start_pos - 1);
 }
 
 void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
@@ -452,6 +454,7 @@ static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
 				 size_t index)
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	uint32_t start_pos = (uint32_t)serializer_get_pos(s);
 	uint8_t *data;
 	size_t size;
 
@@ -479,7 +482,7 @@ static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
 	serialize(s, data, size);
 	bfree(data);
 
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)serializer_get_pos(s) - start_pos - 1);
 }
 
 void flv_additional_packet_mux(struct encoder_packet *packet,
@@ -501,3 +504,23 @@ void flv_additional_packet_mux(struct encoder_packet *packet,
 	*data = out.bytes.array;
 	*size = out.bytes.num;
 }
+
+void flv_packet_mux_append(struct array_output_data *output,
+			   struct encoder_packet *packet, int32_t dts_offset,
+			   bool is_header, size_t index)
+{
+	struct darray bytes = output->bytes.da;
+	struct serializer s;
+
+	/* the serializer init clears the output, keep the existing data (and
+	 * its allocation) so the buffer can be reused */
+	array_output_serializer_init(&s, output);
+	output->bytes.da = bytes;
+
+	if (index > 0)
+		flv_additional_audio(&s, dts_offset, packet, is_header, index);
+	else if (packet->type == OBS_ENCODER_VIDEO)
+		flv_video(&s, dts_offset, packet, is_header);
+	else
+		flv_audio(&s, dts_offset, packet, is_header);
+}
@@ -4063,22 +4063,12 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+static int
+EnsureChannelOut(RTMP *r, int channel)
 {
-    const RTMPPacket *prevPacket;
-    uint32_t last = 0;
-    int nSize;
-    int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
-    uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
-
-    if (packet->m_nChannel >= r->m_channelsAllocatedOut)
+    if (channel >= r->m_channelsAllocatedOut)
     {
-        int n = packet->m_nChannel + 10;
+        int n = channel + 10;
         RTMPPacket **packets = realloc(r->m_vecChannelsOut, sizeof(RTMPPacket*) * n);
         if (!packets)
         {
@@ -4091,6 +4081,24 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
         memset(r->m_vecChannelsOut + r->m_channelsAllocatedOut, 0, sizeof(RTMPPacket*) * (n - r->m_channelsAllocatedOut));
         r->m_channelsAllocatedOut = n;
     }
+    return TRUE;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    const RTMPPacket *prevPacket;
+    uint32_t last = 0;
+    int nSize;
+    int hSize, cSize;
+    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    uint32_t t;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    if (!EnsureChannelOut(r, packet->m_nChannel))
+        return FALSE;
 
     prevPacket = r->m_vecChannelsOut[packet->m_nChannel];
     if (prevPacket && packet->m_headerType != RTMP_PACKET_SIZE_LARGE)
@@ -5369,3 +5377,363 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+/* Scatter-gather output for RTMP_WriteTags.  Chunk headers are generated in
+ * to a small side buffer instead of in front of the chunk data, so the whole
+ * set of chunks can be handed to the socket in one call. */
+
+#define RTMP_WRITEV_MAX_CHUNKS 64
+#define RTMP_WRITEV_COALESCE_SIZE (64 * 1024)
+
+#ifdef _WIN32
+typedef WSABUF RTMPIOVec;
+#define IOV_BASE(v) ((v).buf)
+#define IOV_LEN(v) ((v).len)
+#else
+typedef struct iovec RTMPIOVec;
+#define IOV_BASE(v) ((v).iov_base)
+#define IOV_LEN(v) ((v).iov_len)
+#endif
+
+typedef struct RTMPChunkVec
+{
+    char headers[RTMP_WRITEV_MAX_CHUNKS][RTMP_MAX_HEADER_SIZE];
+    RTMPIOVec vec[RTMP_WRITEV_MAX_CHUNKS * 2];
+    int nChunks;
+} RTMPChunkVec;
+
+static void
+ChunkVecAdd(RTMPChunkVec *cv, int hSize, const char *body, int size)
+{
+    RTMPIOVec *v = &cv->vec[cv->nChunks * 2];
+
+    IOV_BASE(v[0]) = cv->headers[cv->nChunks];
+    IOV_LEN(v[0]) = hSize;
+    IOV_BASE(v[1]) = (char *)body;
+    IOV_LEN(v[1]) = size;
+    cv->nChunks++;
+}
+
+/* HTTP tunnels, encryption and custom send functions need the data in one
+ * piece, so copy the chunks together (in pieces small enough for the custom
+ * send buffer) and go through WriteN */
+static int
+WriteVCoalesced(RTMP *r, RTMPIOVec *vec, int count)
+{
+    char *buf = malloc(RTMP_WRITEV_COALESCE_SIZE);
+    int len = 0;
+    int i;
+
+    if (!buf)
+        return FALSE;
+
+    for (i = 0; i < count; i += 2)
+    {
+        int size = (int)(IOV_LEN(vec[i]) + IOV_LEN(vec[i + 1]));
+
+        if (len && len + size > RTMP_WRITEV_COALESCE_SIZE)
+        {
+            if (!WriteN(r, buf, len))
+                goto fail;
+            len = 0;
+        }
+
+        if (size > RTMP_WRITEV_COALESCE_SIZE)
+        {
+            if (!WriteN(r, IOV_BASE(vec[i]), (int)IOV_LEN(vec[i])) ||
+                    !WriteN(r, IOV_BASE(vec[i + 1]), (int)IOV_LEN(vec[i + 1])))
+                goto fail;
+            continue;
+        }
+
+        memcpy(buf + len, IOV_BASE(vec[i]), IOV_LEN(vec[i]));
+        len += (int)IOV_LEN(vec[i]);
+        memcpy(buf + len, IOV_BASE(vec[i + 1]), IOV_LEN(vec[i + 1]));
+        len += (int)IOV_LEN(vec[i + 1]);
+    }
+
+    if (len && !WriteN(r, buf, len))
+        goto fail;
+
+    free(buf);
+    return TRUE;
+
+fail:
+    free(buf);
+    return FALSE;
+}
+
+static int
+WriteV(RTMP *r, RTMPIOVec *vec, int count)
+{
+    int coalesce = (r->Link.protocol & RTMP_FEATURE_HTTP) ||
+                   (r->m_bCustomSend && r->m_customSendFunc) ||
+                   r->m_sb.sb_ssl != NULL;
+
+#ifdef CRYPTO
+    if (r->Link.rc4keyOut)
+        coalesce = TRUE;
+#endif
+    if (coalesce)
+        return WriteVCoalesced(r, vec, count);
+
+    while (count > 0)
+    {
+        size_t nBytes;
+#ifdef _WIN32
+        DWORD sent = 0;
+
+        if (WSASend(r->m_sb.sb_socket, vec, count, &sent, 0, NULL, NULL) != 0)
+#else
+        struct msghdr msg;
+        ssize_t sent;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = count;
+
+        sent = sendmsg(r->m_sb.sb_socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0)
+#endif
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d", __FUNCTION__,
+                     sockerr);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            r->last_error_code = sockerr;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (sent == 0)
+            return FALSE;
+
+        /* skip everything that was sent, then adjust the partially sent
+         * buffer (if any) so the next call picks up where this one ended */
+        nBytes = (size_t)sent;
+        while (count > 0 && nBytes >= IOV_LEN(*vec))
+        {
+            nBytes -= IOV_LEN(*vec);
+            vec++;
+            count--;
+        }
+
+        if (count > 0)
+        {
+            IOV_BASE(*vec) = (char *)IOV_BASE(*vec) + nBytes;
+            IOV_LEN(*vec) -= nBytes;
+        }
+    }
+
+    return TRUE;
+}
+
+static int
+FlushChunkVec(RTMP *r, RTMPChunkVec *cv)
+{
+    int ret = TRUE;
+
+    if (cv->nChunks)
+        ret = WriteV(r, cv->vec, cv->nChunks * 2);
+    cv->nChunks = 0;
+    return ret;
+}
+
+/* same header layout as RTMP_SendPacket */
+static int
+QueuePacketChunks(RTMP *r, RTMPPacket *packet, const char *body,
+                  RTMPChunkVec *cv)
+{
+    const RTMPPacket *prevPacket;
+    uint32_t last = 0;
+    uint32_t t;
+    int nSize, cSize = 0;
+    int nChunkSize = r->m_outChunkSize;
+    char *hptr, *hend, c;
+
+    if (!EnsureChannelOut(r, packet->m_nChannel))
+        return FALSE;
+
+    prevPacket = r->m_vecChannelsOut[packet->m_nChannel];
+    if (prevPacket && packet->m_headerType != RTMP_PACKET_SIZE_LARGE)
+    {
+        /* compress a bit by using the prev packet's attributes */
+        if (prevPacket->m_nBodySize == packet->m_nBodySize
+                && prevPacket->m_packetType == packet->m_packetType
+                && packet->m_headerType == RTMP_PACKET_SIZE_MEDIUM)
+            packet->m_headerType = RTMP_PACKET_SIZE_SMALL;
+
+        if (prevPacket->m_nTimeStamp == packet->m_nTimeStamp
+                && packet->m_headerType == RTMP_PACKET_SIZE_SMALL)
+            packet->m_headerType = RTMP_PACKET_SIZE_MINIMUM;
+        last = prevPacket->m_nTimeStamp;
+    }
+
+    nSize = packetSize[packet->m_headerType];
+    t = packet->m_nTimeStamp - last;
+
+    if (packet->m_nChannel > 319)
+        cSize = 2;
+    else if (packet->m_nChannel > 63)
+        cSize = 1;
+
+    c = packet->m_headerType << 6;
+    switch (cSize)
+    {
+    case 0:
+        c |= packet->m_nChannel;
+        break;
+    case 1:
+        break;
+    case 2:
+        c |= 1;
+        break;
+    }
+
+    if (cv->nChunks == RTMP_WRITEV_MAX_CHUNKS && !FlushChunkVec(r, cv))
+        return FALSE;
+
+    hptr = cv->headers[cv->nChunks];
+    hend = hptr + RTMP_MAX_HEADER_SIZE;
+
+    *hptr++ = c;
+    if (cSize)
+    {
+        int tmp = packet->m_nChannel - 64;
+        *hptr++ = tmp & 0xff;
+        if (cSize == 2)
+            *hptr++ = tmp >> 8;
+    }
+
+    if (nSize > 1)
+        hptr = AMF_EncodeInt24(hptr, hend, t > 0xffffff ? 0xffffff : t);
+
+    if (nSize > 4)
+    {
+        hptr = AMF_EncodeInt24(hptr, hend, packet->m_nBodySize);
+        *hptr++ = packet->m_packetType;
+    }
+
+    if (nSize > 8)
+        hptr += EncodeInt32LE(hptr, packet->m_nInfoField2);
+
+    if (nSize > 1 && t >= 0xffffff)
+        hptr = AMF_EncodeInt32(hptr, hend, t);
+
+    nSize = packet->m_nBodySize;
+    if (nSize < nChunkSize)
+        nChunkSize = nSize;
+
+    ChunkVecAdd(cv, (int)(hptr - cv->headers[cv->nChunks]), body, nChunkSize);
+    body += nChunkSize;
+    nSize -= nChunkSize;
+
+    while (nSize > 0)
+    {
+        if (cv->nChunks == RTMP_WRITEV_MAX_CHUNKS && !FlushChunkVec(r, cv))
+            return FALSE;
+
+        hptr = cv->headers[cv->nChunks];
+        *hptr++ = (0xc0 | c);
+        if (cSize)
+        {
+            int tmp = packet->m_nChannel - 64;
+            *hptr++ = tmp & 0xff;
+            if (cSize == 2)
+                *hptr++ = tmp >> 8;
+        }
+
+        if (nSize < nChunkSize)
+            nChunkSize = nSize;
+
+        ChunkVecAdd(cv, 1 + cSize, body, nChunkSize);
+        body += nChunkSize;
+        nSize -= nChunkSize;
+    }
+
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        r->m_vecChannelsOut[packet->m_nChannel] = malloc(sizeof(RTMPPacket));
+    if (!r->m_vecChannelsOut[packet->m_nChannel])
+        return FALSE;
+    memcpy(r->m_vecChannelsOut[packet->m_nChannel], packet, sizeof(RTMPPacket));
+    r->m_vecChannelsOut[packet->m_nChannel]->m_body = NULL;
+    return TRUE;
+}
+
+/* Sends one or more complete FLV tags.  Unlike RTMP_Write, the tags are not
+ * copied in to a packet buffer first, and all of their chunks are written
+ * with as few socket calls as possible. */
+int
+RTMP_WriteTags(RTMP *r, const char *buf, int size, int streamIdx)
+{
+    RTMPChunkVec cv;
+    RTMPPacket pkt;
+    int s2 = size;
+
+    if (r->m_write.m_nBytesRead)
+    {
+        RTMP_Log(RTMP_LOGERROR, "%s, partial RTMP_Write pending", __FUNCTION__);
+        return -1;
+    }
+
+    cv.nChunks = 0;
+
+    if (s2 >= 13 && buf[0] == 'F' && buf[1] == 'L' && buf[2] == 'V')
+    {
+        buf += 13;
+        s2 -= 13;
+    }
+
+    while (s2 > 0)
+    {
+        if (s2 < 11)
+        {
+            /* FLV pkt too small */
+            break;
+        }
+
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.m_nChannel = 0x04;	/* source channel */
+        pkt.m_nInfoField2 = r->Link.streams[streamIdx].id;
+        pkt.m_packetType = *buf++;
+        pkt.m_nBodySize = AMF_DecodeInt24(buf);
+        buf += 3;
+        pkt.m_nTimeStamp = AMF_DecodeInt24(buf);
+        buf += 3;
+        pkt.m_nTimeStamp |= *buf++ << 24;
+        buf += 3;
+        s2 -= 11;
+
+        if ((int)pkt.m_nBodySize + 4 > s2)
+        {
+            RTMP_Log(RTMP_LOGERROR, "%s, incomplete FLV tag", __FUNCTION__);
+            break;
+        }
+
+        if (((pkt.m_packetType == RTMP_PACKET_TYPE_AUDIO
+                || pkt.m_packetType == RTMP_PACKET_TYPE_VIDEO) &&
+                !pkt.m_nTimeStamp) || pkt.m_packetType == RTMP_PACKET_TYPE_INFO)
+        {
+            pkt.m_headerType = RTMP_PACKET_SIZE_LARGE;
+        }
+        else
+        {
+            pkt.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+        }
+
+        if (!QueuePacketChunks(r, &pkt, buf, &cv))
+            return -1;
+
+        buf += pkt.m_nBodySize + 4;
+        s2 -= pkt.m_nBodySize + 4;
+    }
+
+    if (s2 != 0 || !FlushChunkVec(r, &cv))
+        return -1;
+
+    return size;
+}
@@ -29,11 +29,8 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
-/* dynamic bitrate coefficients */
-#define DBR_INC_TIMER (30ULL * SEC_TO_NSEC)
-#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
-#define MIN_ESTIMATE_DURATION_MS 1000
-#define MAX_ESTIMATE_DURATION_MS 2000
+/* dynamic bitrate limits */
+#define DBR_MIN_BITRATE 50
 
 static const char *rtmp_stream_getname(void *unused)
 {
@@ -125,7 +122,7 @@ static void rtmp_stream_destroy(void *data)
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
-	circlebuf_free(&stream->dbr_frames);
+	bitrate_controller_destroy(stream->dbr);
 	pthread_mutex_destroy(&stream->dbr_mutex);
 
 	os_event_destroy(stream->buffer_space_available_event);
@@ -136,9 +133,59 @@ static void rtmp_stream_destroy(void *data)
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
+	array_output_serializer_free(&stream->send_batch);
 	bfree(stream);
 }
 
+static void get_dbr_stats(void *data, calldata_t *cd)
+{
+	struct rtmp_stream *stream = data;
+	struct bitrate_controller_stats stats;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	if (!stream->dbr) {
+		pthread_mutex_unlock(&stream->dbr_mutex);
+		return;
+	}
+
+	bitrate_controller_get_stats(stream->dbr, &stats);
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	calldata_set_int(cd, "bitrate", stats.bitrate);
+	calldata_set_int(cd, "estimate", stats.est_bitrate);
+	calldata_set_int(cd, "buffer_ms", stats.queue_usec / 1000);
+	calldata_set_float(cd, "gradient", stats.gradient);
+	calldata_set_int(cd, "increases", (long long)stats.increases);
+	calldata_set_int(cd, "decreases", (long long)stats.decreases);
+	calldata_set_int(cd, "decisions", (long long)stats.decisions);
+}
+
+static void get_dbr_decision(void *data, calldata_t *cd)
+{
+	struct rtmp_stream *stream = data;
+	struct bitrate_decision decision;
+	size_t idx = (size_t)calldata_int(cd, "index");
+	bool found = false;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	if (stream->dbr)
+		found = bitrate_controller_get_decision(stream->dbr, idx,
+							&decision);
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	if (!found)
+		return;
+
+	calldata_set_int(cd, "timestamp", (long long)decision.ts);
+	calldata_set_string(cd, "type",
+			    bitrate_decision_type_name(decision.type));
+	calldata_set_int(cd, "prev_bitrate", decision.prev_bitrate);
+	calldata_set_int(cd, "bitrate", decision.bitrate);
+	calldata_set_int(cd, "estimate", decision.est_bitrate);
+	calldata_set_int(cd, "buffer_ms", decision.queue_usec / 1000);
+	calldata_set_float(cd, "gradient", decision.gradient);
+}
+
 static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
@@ -185,6 +232,22 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 		goto fail;
 	}
 
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph,
+			 "void get_dbr_stats(out int bitrate, "
+			 "out int estimate, out int buffer_ms, "
+			 "out float gradient, "
+			 "out int increases, out int decreases, "
+			 "out int decisions)",
+			 get_dbr_stats, stream);
+	proc_handler_add(ph,
+			 "void get_dbr_decision(in int index, "
+			 "out int timestamp, out string type, "
+			 "out int prev_bitrate, out int bitrate, "
+			 "out int estimate, out int buffer_ms, "
+			 "out float gradient)",
+			 get_dbr_decision, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 
@@ -233,8 +296,10 @@ static inline void set_rtmp_dstr(AVal *val, struct dstr *str)
 	val->av_len = valid ? (int)str->len : 0;
 }
 
+/* last_dts_usec is the newest queued timestamp at the time of the pop */
 static inline bool get_next_packet(struct rtmp_stream *stream,
-				   struct encoder_packet *packet)
+				   struct encoder_packet *packet,
+				   int64_t *last_dts_usec)
 {
 	bool new_packet = false;
 
@@ -242,6 +307,7 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	if (stream->packets.size) {
 		circlebuf_pop_front(&stream->packets, packet,
 				    sizeof(struct encoder_packet));
+		*last_dts_usec = stream->last_dts_usec;
 		new_packet = true;
 	}
 	pthread_mutex_unlock(&stream->packets_mutex);
@@ -249,6 +315,28 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	return new_packet;
 }
 
+/* only pops the next packet if it goes to the same RTMP stream */
+static inline bool get_next_batch_packet(struct rtmp_stream *stream,
+					 struct encoder_packet *packet,
+					 size_t idx)
+{
+	struct encoder_packet next;
+	bool new_packet = false;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	if (stream->packets.size) {
+		circlebuf_peek_front(&stream->packets, &next, sizeof(next));
+		if (next.track_idx == idx) {
+			circlebuf_pop_front(&stream->packets, packet,
+					    sizeof(struct encoder_packet));
+			new_packet = true;
+		}
+	}
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return new_packet;
+}
+
 static bool discard_recv_data(struct rtmp_stream *stream, size_t size)
 {
 	RTMP *rtmp = &stream->rtmp;
@@ -398,30 +486,39 @@ retry_send:
 	return len;
 }
 
+static bool discard_pending_recv_data(struct rtmp_stream *stream)
+{
+	int recv_size = 0;
+	int ret = 0;
+
+	if (stream->new_socket_loop)
+		return true;
+
+#ifdef _WIN32
+	ret = ioctlsocket(stream->rtmp.m_sb.sb_socket, FIONREAD,
+			  (u_long *)&recv_size);
+#else
+	ret = ioctl(stream->rtmp.m_sb.sb_socket, FIONREAD, &recv_size);
+#endif
+
+	if (ret >= 0 && recv_size > 0)
+		return discard_recv_data(stream, (size_t)recv_size);
+
+	return true;
+}
+
 static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
 	uint8_t *data;
 	size_t size;
-	int recv_size = 0;
 	int ret = 0;
 
 	assert(idx < RTMP_MAX_STREAMS);
 
-	if (!stream->new_socket_loop) {
-#ifdef _WIN32
-		ret = ioctlsocket(stream->rtmp.m_sb.sb_socket, FIONREAD,
-				  (u_long *)&recv_size);
-#else
-		ret = ioctl(stream->rtmp.m_sb.sb_socket, FIONREAD, &recv_size);
-#endif
-
-		if (ret >= 0 && recv_size > 0) {
-			if (!discard_recv_data(stream, (size_t)recv_size))
-				return -1;
-		}
-	}
+	if (!discard_pending_recv_data(stream))
+		return -1;
 
 	if (idx > 0) {
 		flv_additional_packet_mux(
@@ -448,6 +545,54 @@ static int send_packet(struct rtmp_stream *stream,
 	return ret;
 }
 
+#define MAX_BATCH_SIZE (1024 * 1024)
+
+/* Sends the packet along with every other packet that is already queued for
+ * the same RTMP stream.  The FLV tags are written to a reused buffer and
+ * RTMP_WriteTags sends all of their chunks with as few socket writes as
+ * possible, instead of one write per chunk. */
+static int send_packet_batch(struct rtmp_stream *stream,
+			     struct encoder_packet *packet, size_t *size)
+{
+	struct array_output_data *batch = &stream->send_batch;
+	size_t idx = packet->track_idx;
+	int ret;
+
+	assert(idx < RTMP_MAX_STREAMS);
+
+	if (!discard_pending_recv_data(stream)) {
+		obs_encoder_packet_release(packet);
+		return -1;
+	}
+
+	batch->bytes.num = 0;
+
+	for (;;) {
+		flv_packet_mux_append(batch, packet, stream->start_dts_offset,
+				      false, idx);
+		obs_encoder_packet_release(packet);
+
+		/* when stopping, each packet has to be checked against the
+		 * stop timestamp, so don't take any more from the queue */
+		if (stopping(stream) || batch->bytes.num >= MAX_BATCH_SIZE)
+			break;
+		if (!get_next_batch_packet(stream, packet, idx))
+			break;
+	}
+
+	*size = batch->bytes.num;
+
+#ifdef TEST_FRAMEDROPS
+	droptest_cap_data_rate(stream, batch->bytes.num);
+#endif
+
+	ret = RTMP_WriteTags(&stream->rtmp, (char *)batch->bytes.array,
+			     (int)batch->bytes.num, (int)idx);
+
+	stream->total_bytes_sent += batch->bytes.num;
+	return ret;
+}
+
 static inline bool send_headers(struct rtmp_stream *stream);
 
 static inline bool can_shutdown_stream(struct rtmp_stream *stream,
@@ -536,38 +681,7 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
-{
-	struct dbr_frame front;
-	uint64_t dur;
-
-	circlebuf_push_back(&stream->dbr_frames, back, sizeof(*back));
-	circlebuf_peek_front(&stream->dbr_frames, &front, sizeof(front));
-
-	stream->dbr_data_size += back->size;
-
-	dur = (back->send_end - front.send_beg) / 1000000;
-
-	if (dur >= MAX_ESTIMATE_DURATION_MS) {
-		stream->dbr_data_size -= front.size;
-		circlebuf_pop_front(&stream->dbr_frames, NULL, sizeof(front));
-	}
-
-	stream->dbr_est_bitrate =
-		(dur >= MIN_ESTIMATE_DURATION_MS)
-			? (long)(stream->dbr_data_size * 1000 / dur)
-			: 0;
-	stream->dbr_est_bitrate *= 8;
-	stream->dbr_est_bitrate /= 1000;
-
-	if (stream->dbr_est_bitrate) {
-		stream->dbr_est_bitrate -= stream->audio_bitrate;
-		if (stream->dbr_est_bitrate < 50)
-			stream->dbr_est_bitrate = 50;
-	}
-}
-
-static void dbr_set_bitrate(struct rtmp_stream *stream);
+static void dbr_set_bitrate(struct rtmp_stream *stream, long bitrate);
 
 static void *send_thread(void *data)
 {
@@ -577,13 +691,14 @@ static void *send_thread(void *data)
 
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
-		struct dbr_frame dbr_frame;
+		struct bitrate_sample sample;
+		int64_t last_dts_usec;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
 		}
 
-		if (!get_next_packet(stream, &packet))
+		if (!get_next_packet(stream, &packet, &last_dts_usec))
 			continue;
 
 		if (stopping(stream)) {
@@ -601,20 +716,20 @@ static void *send_thread(void *data)
 		}
 
 		if (stream->dbr_enabled) {
-			dbr_frame.send_beg = os_gettime_ns();
-			dbr_frame.size = packet.size;
+			sample.queue_usec = last_dts_usec - packet.dts_usec;
+			sample.send_beg = os_gettime_ns();
 		}
 
-		if (send_packet(stream, &packet, false, packet.track_idx) < 0) {
+		if (send_packet_batch(stream, &packet, &sample.size) < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
 
 		if (stream->dbr_enabled) {
-			dbr_frame.send_end = os_gettime_ns();
+			sample.send_end = os_gettime_ns();
 
 			pthread_mutex_lock(&stream->dbr_mutex);
-			dbr_add_frame(stream, &dbr_frame);
+			bitrate_controller_add_sample(stream->dbr, &sample);
 			pthread_mutex_unlock(&stream->dbr_mutex);
 		}
 	}
@@ -656,10 +771,14 @@ static void *send_thread(void *data)
 
 	/* reset bitrate on stop */
 	if (stream->dbr_enabled) {
-		if (stream->dbr_cur_bitrate != stream->dbr_orig_bitrate) {
-			stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-			dbr_set_bitrate(stream);
-		}
+		bool reset;
+
+		pthread_mutex_lock(&stream->dbr_mutex);
+		reset = bitrate_controller_reset(stream->dbr, os_gettime_ns());
+		pthread_mutex_unlock(&stream->dbr_mutex);
+
+		if (reset)
+			dbr_set_bitrate(stream, stream->dbr_orig_bitrate);
 	}
 
 	return NULL;
@@ -1072,14 +1191,8 @@ static bool init_connect(struct rtmp_stream *stream)
 	obs_data_t *vsettings = obs_encoder_get_settings(venc);
 	obs_data_t *asettings = obs_encoder_get_settings(aenc);
 
-	circlebuf_free(&stream->dbr_frames);
 	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
-	stream->dbr_data_size = 0;
 	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
-	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-	stream->dbr_est_bitrate = 0;
-	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
-	stream->dbr_inc_timeout = 0;
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
 
 	caps = obs_encoder_get_caps(venc);
@@ -1091,8 +1204,32 @@ static bool init_connect(struct rtmp_stream *stream)
 		stream->dbr_enabled = false;
 	}
 
+	pthread_mutex_lock(&stream->dbr_mutex);
+	bitrate_controller_destroy(stream->dbr);
+	stream->dbr = NULL;
+
 	if (stream->dbr_enabled) {
-		info("Dynamic bitrate enabled.  Dropped frames begone!");
+		struct bitrate_controller_config config = {
+			.max_bitrate = stream->dbr_orig_bitrate,
+			.min_bitrate = DBR_MIN_BITRATE,
+			.audio_bitrate = stream->audio_bitrate,
+		};
+		const char *model =
+			obs_data_get_string(settings, OPT_DYN_BITRATE_MODEL);
+
+		stream->dbr = bitrate_controller_create(model, &config);
+		if (!stream->dbr) {
+			warn("Unknown dynamic bitrate model '%s', using '%s'",
+			     model, BITRATE_MODEL_DELAY_GRADIENT);
+			stream->dbr = bitrate_controller_create(
+				BITRATE_MODEL_DELAY_GRADIENT, &config);
+		}
+	}
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	if (stream->dbr_enabled) {
+		info("Dynamic bitrate enabled (%s).  Dropped frames begone!",
+		     bitrate_controller_model_id(stream->dbr));
 	}
 
 	obs_data_release(vsettings);
@@ -1232,94 +1369,43 @@ static bool find_first_video_packet(struct rtmp_stream *stream,
 	return false;
 }
 
-static bool dbr_bitrate_lowered(struct rtmp_stream *stream)
-{
-	long prev_bitrate = stream->dbr_prev_bitrate;
-	long est_bitrate = 0;
-	long new_bitrate;
-
-	if (stream->dbr_est_bitrate &&
-	    stream->dbr_est_bitrate < stream->dbr_cur_bitrate) {
-		stream->dbr_data_size = 0;
-		circlebuf_pop_front(&stream->dbr_frames, NULL,
-				    stream->dbr_frames.size);
-		est_bitrate = stream->dbr_est_bitrate / 100 * 100;
-		if (est_bitrate < 50) {
-			est_bitrate = 50;
-		}
-	}
-
-#if 0
-	if (prev_bitrate && est_bitrate) {
-		if (prev_bitrate < est_bitrate) {
-			blog(LOG_INFO, "going back to prev bitrate: "
-					"prev_bitrate (%d) < est_bitrate (%d)",
-					prev_bitrate,
-					est_bitrate);
-			new_bitrate = prev_bitrate;
-		} else {
-			new_bitrate = est_bitrate;
-		}
-		new_bitrate = est_bitrate;
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else {
-		return false;
-	}
-#else
-	if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else {
-		return false;
-	}
-
-	if (new_bitrate == stream->dbr_cur_bitrate) {
-		return false;
-	}
-#endif
-
-	stream->dbr_prev_bitrate = 0;
-	stream->dbr_cur_bitrate = new_bitrate;
-	stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-	info("bitrate decreased to: %ld", stream->dbr_cur_bitrate);
-	return true;
-}
-
-static void dbr_set_bitrate(struct rtmp_stream *stream)
+static void dbr_set_bitrate(struct rtmp_stream *stream, long bitrate)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
 	obs_data_t *settings = obs_encoder_get_settings(vencoder);
 
-	obs_data_set_int(settings, "bitrate", stream->dbr_cur_bitrate);
+	obs_data_set_int(settings, "bitrate", bitrate);
 	obs_encoder_update(vencoder, settings);
 
 	obs_data_release(settings);
 }
 
-static void dbr_inc_bitrate(struct rtmp_stream *stream)
+static void dbr_update(struct rtmp_stream *stream, int64_t buffer_usec)
 {
-	stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
-	stream->dbr_cur_bitrate += stream->dbr_inc_bitrate;
-
-	if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate) {
-		stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-		info("bitrate increased to: %ld, done",
-		     stream->dbr_cur_bitrate);
-	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate) {
-		stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-		info("bitrate increased to: %ld, waiting",
-		     stream->dbr_cur_bitrate);
+	struct bitrate_decision decision;
+	struct bitrate_controller_stats stats;
+	bool changed;
+	long bitrate;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	changed = bitrate_controller_update(stream->dbr, os_gettime_ns(),
+					    buffer_usec, &bitrate);
+	if (changed) {
+		bitrate_controller_get_stats(stream->dbr, &stats);
+		bitrate_controller_get_decision(stream->dbr,
+						stats.decisions - 1, &decision);
 	}
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	if (!changed)
+		return;
+
+	info("bitrate %s from %ld to %ld (estimate: %ld, "
+	     "buffer: %" PRId64 " ms, gradient: %.1f ms/s)",
+	     bitrate_decision_type_name(decision.type), decision.prev_bitrate,
+	     decision.bitrate, decision.est_bitrate,
+	     decision.queue_usec / 1000, decision.gradient);
+	dbr_set_bitrate(stream, bitrate);
 }
 
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
@@ -1333,26 +1419,20 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
 					 : stream->drop_threshold_usec;
 
-	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
-			uint64_t t = os_gettime_ns();
-
-			if (t >= stream->dbr_inc_timeout) {
-				stream->dbr_inc_timeout = 0;
-				dbr_inc_bitrate(stream);
-				dbr_set_bitrate(stream);
-			}
-		}
-	}
-
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			if (stream->dbr_enabled)
+				dbr_update(stream, 0);
+		}
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
+	if (!find_first_video_packet(stream, &first)) {
+		if (!pframes && stream->dbr_enabled)
+			dbr_update(stream, 0);
 		return;
+	}
 
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
@@ -1368,23 +1448,8 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	 * but let's test without dropping frames
 	 * at all first */
 	if (stream->dbr_enabled) {
-		bool bitrate_changed = false;
-
-		if (pframes) {
-			return;
-		}
-
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
-			pthread_mutex_lock(&stream->dbr_mutex);
-			bitrate_changed = dbr_bitrate_lowered(stream);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
-
-		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64,
-			      buffer_duration_usec / 1000);
-			dbr_set_bitrate(stream);
-		}
+		if (!pframes)
+			dbr_update(stream, buffer_duration_usec);
 		return;
 	}
 
@@ -1465,6 +1530,8 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
+	obs_data_set_default_string(defaults, OPT_DYN_BITRATE_MODEL,
+				    BITRATE_MODEL_DELAY_GRADIENT);
 }
 
 static obs_properties_t *rtmp_stream_properties(void *unused)
@@ -9,6 +9,7 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "bitrate-controller.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -25,6 +26,7 @@
 #define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
 
 #define OPT_DYN_BITRATE "dyn_bitrate"
+#define OPT_DYN_BITRATE_MODEL "dyn_bitrate_model"
 #define OPT_DROP_THRESHOLD "drop_threshold_ms"
 #define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
 #define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
@@ -47,12 +49,6 @@ struct droptest_info {
 };
 #endif
 
-struct dbr_frame {
-	uint64_t send_beg;
-	uint64_t send_end;
-	size_t size;
-};
-
 struct rtmp_stream {
 	obs_output_t *output;
 
@@ -94,6 +90,9 @@ struct rtmp_stream {
 	uint64_t total_bytes_sent;
 	int dropped_frames;
 
+	/* reused between sends, holds the FLV tags of one batch of packets */
+	struct array_output_data send_batch;
+
 #ifdef TEST_FRAMEDROPS
 	struct circlebuf droptest_info;
 	uint64_t droptest_last_key_check;
@@ -102,15 +101,9 @@ struct rtmp_stream {
 #endif
 
 	pthread_mutex_t dbr_mutex;
-	struct circlebuf dbr_frames;
-	size_t dbr_data_size;
-	uint64_t dbr_inc_timeout;
+	bitrate_controller_t *dbr;
 	long audio_bitrate;
-	long dbr_est_bitrate;
 	long dbr_orig_bitrate;
-	long dbr_prev_bitrate;
-	long dbr_cur_bitrate;
-	long dbr_inc_bitrate;
 	bool dbr_enabled;
 
 	RTMP rtmp;
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-io.h>
+#include <media-io/audio-mix.h>
+
+/*
+ * Times one audio tick of mixing, the way obs-audio.c adds every source's
+ * output to a mix, with an increasing number of sources and channels.  The
+ * kernel audio_get_mix_func picks is compared against the plain loop it
+ * replaced.
+ */
+
+#define MIN_RUN_TIME_NS 250000000ULL
+
+static const size_t source_counts[] = {1, 4, 16, 64};
+static const size_t channel_counts[] = {1, 2, 6, 8};
+
+#define SOURCE_COUNTS (sizeof(source_counts) / sizeof(source_counts[0]))
+#define CHANNEL_COUNTS (sizeof(channel_counts) / sizeof(channel_counts[0]))
+#define MAX_SOURCES 64
+
+static void mix_floats_scalar(float *dst, const float *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+struct buffers {
+	float *mix[MAX_AUDIO_CHANNELS];
+	float *sources[MAX_SOURCES][MAX_AUDIO_CHANNELS];
+};
+
+static void buffers_init(struct buffers *buf)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		buf->mix[c] = bzalloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
+
+		for (size_t s = 0; s < MAX_SOURCES; s++) {
+			float *data = bmalloc(AUDIO_OUTPUT_FRAMES *
+					      sizeof(float));
+
+			/* quiet noise, the exact values don't matter */
+			for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++)
+				data[i] = (float)(rand() % 2000 - 1000) /
+					  1000000.0f;
+			buf->sources[s][c] = data;
+		}
+	}
+}
+
+static void buffers_free(struct buffers *buf)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		bfree(buf->mix[c]);
+		for (size_t s = 0; s < MAX_SOURCES; s++)
+			bfree(buf->sources[s][c]);
+	}
+}
+
+/* returns nanoseconds per tick */
+static double run(struct buffers *buf, audio_mix_func_t mix_floats,
+		  size_t sources, size_t channels)
+{
+	uint64_t start, elapsed;
+	uint64_t ticks = 0;
+
+	start = os_gettime_ns();
+
+	do {
+		for (int i = 0; i < 100; i++) {
+			for (size_t c = 0; c < channels; c++)
+				memset(buf->mix[c], 0,
+				       AUDIO_OUTPUT_FRAMES * sizeof(float));
+
+			for (size_t s = 0; s < sources; s++) {
+				for (size_t c = 0; c < channels; c++)
+					mix_floats(buf->mix[c],
+						   buf->sources[s][c],
+						   AUDIO_OUTPUT_FRAMES);
+			}
+		}
+
+		ticks += 100;
+		elapsed = os_gettime_ns() - start;
+	} while (elapsed < MIN_RUN_TIME_NS);
+
+	return (double)elapsed / (double)ticks;
+}
+
+int main(void)
+{
+	audio_mix_func_t mix_floats = audio_get_mix_func();
+	struct buffers buf = {0};
+
+	buffers_init(&buf);
+
+	printf("%8s %9s %12s %12s %8s\n", "sources", "channels",
+	       "kernel (us)", "scalar (us)", "speedup");
+
+	for (size_t i = 0; i < SOURCE_COUNTS; i++) {
+		for (size_t j = 0; j < CHANNEL_COUNTS; j++) {
+			size_t sources = source_counts[i];
+			size_t channels = channel_counts[j];
+			double kernel = run(&buf, mix_floats, sources,
+					    channels);
+			double scalar = run(&buf, mix_floats_scalar, sources,
+					    channels);
+
+			printf("%8zu %9zu %12.2f %12.2f %7.2fx\n",
+			       sources, channels, kernel / 1000.0,
+			       scalar / 1000.0, scalar / kernel);
+		}
+	}
+
+	buffers_free(&buf);
+	return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-resampler.h>
+
+/*
+ * Times the conversions the audio pipeline does most often, once with the
+ * built-in conversions and once through libswresample, in blocks of 1024
+ * frames like the output mixes them.
+ */
+
+#define MIN_RUN_TIME_NS 250000000ULL
+#define BLOCK_FRAMES 1024
+
+struct conversion {
+	const char *name;
+	struct resample_info src;
+	struct resample_info dst;
+};
+
+static const struct conversion conversions[] = {
+	{"s16 -> fltp, 48k",
+	 {48000, AUDIO_FORMAT_16BIT, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"s32 -> fltp, 48k",
+	 {48000, AUDIO_FORMAT_32BIT, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"fltp -> s16, 48k",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_16BIT, SPEAKERS_STEREO}},
+	{"fltp -> flt, 48k",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT, SPEAKERS_STEREO}},
+	{"mono -> stereo, 48k",
+	 {48000, AUDIO_FORMAT_16BIT, SPEAKERS_MONO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"stereo -> mono, 48k",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_MONO}},
+	{"fltp, 44.1k -> 48k",
+	 {44100, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"s16, 44.1k -> fltp, 48k",
+	 {44100, AUDIO_FORMAT_16BIT, SPEAKERS_STEREO},
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+	{"fltp, 48k -> 44.1k",
+	 {48000, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO},
+	 {44100, AUDIO_FORMAT_FLOAT_PLANAR, SPEAKERS_STEREO}},
+};
+
+#define CONVERSION_COUNT (sizeof(conversions) / sizeof(conversions[0]))
+
+/* returns input frames per second, 0 if the resampler couldn't be made */
+static double run(const struct conversion *conv, bool native, uint8_t *data)
+{
+	const struct resample_info *src = &conv->src;
+	size_t plane_size = BLOCK_FRAMES *
+			    get_audio_bytes_per_channel(src->format);
+	const uint8_t *input[MAX_AV_PLANES] = {0};
+	audio_resampler_t *rs;
+	uint64_t start, elapsed;
+	uint64_t frames = 0;
+
+	audio_resampler_set_native(native);
+	rs = audio_resampler_create(&conv->dst, src);
+	audio_resampler_set_native(true);
+
+	if (!rs || audio_resampler_is_native(rs) != native) {
+		audio_resampler_destroy(rs);
+		return 0.0;
+	}
+
+	for (uint32_t c = 0; c < get_audio_planes(src->format, src->speakers);
+	     c++)
+		input[c] = data + c * plane_size;
+
+	start = os_gettime_ns();
+
+	do {
+		uint8_t *output[MAX_AV_PLANES];
+		uint32_t out_frames;
+		uint64_t ts_offset;
+
+		for (int i = 0; i < 100; i++) {
+			audio_resampler_resample(rs, output, &out_frames,
+						 &ts_offset, input,
+						 BLOCK_FRAMES);
+			frames += BLOCK_FRAMES;
+		}
+
+		elapsed = os_gettime_ns() - start;
+	} while (elapsed < MIN_RUN_TIME_NS);
+
+	audio_resampler_destroy(rs);
+	return (double)frames * 1000000000.0 / (double)elapsed;
+}
+
+int main(void)
+{
+	size_t size = BLOCK_FRAMES * MAX_AUDIO_CHANNELS * sizeof(float);
+	uint8_t *data = bmalloc(size);
+
+	/* quiet noise, the exact values don't matter */
+	for (size_t i = 0; i < size / sizeof(float); i++)
+		((float *)data)[i] = (float)(rand() % 2000 - 1000) / 4000.0f;
+
+	printf("%-24s %14s %14s %8s\n", "conversion", "native", "swr",
+	       "speedup");
+
+	for (size_t i = 0; i < CONVERSION_COUNT; i++) {
+		const struct conversion *conv = &conversions[i];
+		double native = run(conv, true, data);
+		double swr = run(conv, false, data);
+
+		printf("%-24s %9.1f Mf/s %9.1f Mf/s %7.2fx\n", conv->name,
+		       native / 1000000.0, swr / 1000000.0,
+		       swr > 0.0 ? native / swr : 0.0);
+	}
+
+	bfree(data);
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/circlebuf-spsc.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+/*
+ * Moves data from a producer thread to a consumer thread, once through the
+ * lock-free circlebuf_spsc and once through a circlebuf guarded by a mutex,
+ * for a few message sizes and buffer capacities.  Both sides spin for a while
+ * when the buffer is full or empty before giving up their time slice, so this
+ * mostly measures the contention between the two threads rather than any
+ * waiting.
+ */
+
+#define TOTAL_BYTES (64ULL * 1024 * 1024)
+#define MAX_SPINS 1000
+
+static const size_t message_sizes[] = {16, 256, 4096};
+static const size_t capacities[] = {4096, 65536, 1048576};
+
+#define MESSAGE_SIZES (sizeof(message_sizes) / sizeof(message_sizes[0]))
+#define CAPACITIES (sizeof(capacities) / sizeof(capacities[0]))
+#define MAX_MESSAGE 4096
+
+struct locked_buf {
+	pthread_mutex_t mutex;
+	struct circlebuf cb;
+	size_t capacity;
+};
+
+struct run {
+	bool locked;
+	size_t message;
+	uint64_t count;
+	struct circlebuf_spsc spsc;
+	struct locked_buf lb;
+	uint64_t checksum;
+};
+
+static bool locked_push(struct locked_buf *lb, const void *data, size_t size)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&lb->mutex);
+	if (lb->capacity - lb->cb.size >= size) {
+		circlebuf_push_back(&lb->cb, data, size);
+		success = true;
+	}
+	pthread_mutex_unlock(&lb->mutex);
+	return success;
+}
+
+static bool locked_pop(struct locked_buf *lb, void *data, size_t size)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&lb->mutex);
+	if (lb->cb.size >= size) {
+		circlebuf_pop_front(&lb->cb, data, size);
+		success = true;
+	}
+	pthread_mutex_unlock(&lb->mutex);
+	return success;
+}
+
+/* lets the other thread run when there is only one core to share */
+static inline void backoff(int *spins)
+{
+	if (++*spins >= MAX_SPINS) {
+		os_sleep_ms(0);
+		*spins = 0;
+	}
+}
+
+static void *producer_thread(void *param)
+{
+	struct run *run = param;
+	uint8_t message[MAX_MESSAGE];
+	int spins = 0;
+
+	for (uint64_t i = 0; i < run->count; i++) {
+		memset(message, (int)(i & 0xFF), run->message);
+
+		if (run->locked) {
+			while (!locked_push(&run->lb, message, run->message))
+				backoff(&spins);
+		} else {
+			while (!circlebuf_spsc_push(&run->spsc, message,
+						    run->message))
+				backoff(&spins);
+		}
+	}
+
+	return NULL;
+}
+
+static void consume(struct run *run)
+{
+	uint8_t message[MAX_MESSAGE];
+	uint64_t checksum = 0;
+	int spins = 0;
+
+	for (uint64_t i = 0; i < run->count; i++) {
+		if (run->locked) {
+			while (!locked_pop(&run->lb, message, run->message))
+				backoff(&spins);
+		} else {
+			while (!circlebuf_spsc_pop(&run->spsc, message,
+						   run->message))
+				backoff(&spins);
+		}
+
+		checksum += message[0] + message[run->message - 1];
+	}
+
+	run->checksum = checksum;
+}
+
+/* returns megabytes per second, 0 if the producer couldn't be started */
+static double run_transfer(bool locked, size_t message, size_t capacity)
+{
+	struct run run = {.locked = locked, .message = message};
+	pthread_t producer;
+	uint64_t start, elapsed;
+
+	run.count = TOTAL_BYTES / message;
+
+	if (locked) {
+		pthread_mutex_init(&run.lb.mutex, NULL);
+		circlebuf_init(&run.lb.cb);
+		circlebuf_reserve(&run.lb.cb, capacity);
+		run.lb.capacity = capacity;
+	} else {
+		circlebuf_spsc_init(&run.spsc, capacity);
+	}
+
+	start = os_gettime_ns();
+
+	if (pthread_create(&producer, NULL, producer_thread, &run) != 0)
+		return 0.0;
+	consume(&run);
+	pthread_join(producer, NULL);
+
+	elapsed = os_gettime_ns() - start;
+
+	if (locked) {
+		circlebuf_free(&run.lb.cb);
+		pthread_mutex_destroy(&run.lb.mutex);
+	} else {
+		circlebuf_spsc_free(&run.spsc);
+	}
+
+	/* every byte of message i is i & 0xFF */
+	if (run.checksum != (run.count / 256) * 2 * (255 * 256 / 2) +
+				    (run.count % 256) * (run.count % 256 - 1)) {
+		printf("data was corrupted\n");
+		exit(1);
+	}
+
+	return (double)(run.count * message) * 1000.0 / (double)elapsed;
+}
+
+int main(void)
+{
+	printf("%8s %9s %14s %14s %8s\n", "message", "capacity", "spsc",
+	       "mutex", "speedup");
+
+	for (size_t i = 0; i < MESSAGE_SIZES; i++) {
+		for (size_t j = 0; j < CAPACITIES; j++) {
+			size_t message = message_sizes[i];
+			size_t capacity = capacities[j];
+			double spsc = run_transfer(false, message, capacity);
+			double mutex = run_transfer(true, message, capacity);
+
+			printf("%8zu %9zu %9.1f MB/s %9.1f MB/s %7.2fx\n",
+			       message, capacity, spsc, mutex,
+			       mutex > 0.0 ? spsc / mutex : 0.0);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+/*
+ * Times each conversion in format-conversion.c with every instruction set the
+ * CPU supports on a single thread, and then with the slice threads using
+ * whatever would be picked automatically.
+ */
+
+#define MIN_RUN_TIME_NS 250000000ULL
+#define MIN_RUNS 5
+
+struct resolution {
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+};
+
+static const struct resolution resolutions[] = {
+	{"1080p", 1920, 1080},
+	{"1440p", 2560, 1440},
+	{"2160p", 3840, 2160},
+};
+
+enum conversion {
+	CONV_I420,
+	CONV_NV12,
+	CONV_I444,
+	CONV_DECOMPRESS_NV12,
+	CONV_DECOMPRESS_420,
+	CONV_DECOMPRESS_422,
+	CONV_COUNT,
+};
+
+static const char *conversion_names[] = {
+	"uyvx -> i420", "uyvx -> nv12", "uyvx -> i444",
+	"nv12 -> uyvx", "i420 -> uyvx", "yuy2 -> uyvx",
+};
+
+struct buffers {
+	uint32_t width;
+	uint32_t height;
+
+	uint8_t *packed;
+	uint32_t packed_linesize;
+	uint8_t *planes[3];
+	uint32_t linesize[3];
+};
+
+/* decompress_422 reads and writes past the line it is given, so leave some
+ * room at the end */
+static void buffers_init(struct buffers *buf, uint32_t width, uint32_t height)
+{
+	size_t plane_size = (size_t)width * (height + 2);
+
+	buf->width = width;
+	buf->height = height;
+	buf->packed_linesize = width * 4;
+	buf->packed = bmalloc(plane_size * 4);
+
+	for (uint32_t i = 0; i < plane_size * 4; i++)
+		buf->packed[i] = (uint8_t)(i * 7 + (i >> 12));
+
+	for (size_t i = 0; i < 3; i++) {
+		buf->linesize[i] = width;
+		buf->planes[i] = bmalloc(plane_size);
+		memset(buf->planes[i], 0x80, plane_size);
+	}
+}
+
+static void buffers_free(struct buffers *buf)
+{
+	bfree(buf->packed);
+	for (size_t i = 0; i < 3; i++)
+		bfree(buf->planes[i]);
+}
+
+static void run(enum conversion conv, struct buffers *buf)
+{
+	const uint8_t *const inputs[] = {buf->planes[0], buf->planes[1],
+					 buf->planes[2]};
+	uint32_t h = buf->height;
+
+	switch (conv) {
+	case CONV_I420:
+		compress_uyvx_to_i420(buf->packed, buf->packed_linesize, 0, h,
+				      buf->planes, buf->linesize);
+		break;
+	case CONV_NV12:
+		compress_uyvx_to_nv12(buf->packed, buf->packed_linesize, 0, h,
+				      buf->planes, buf->linesize);
+		break;
+	case CONV_I444:
+		convert_uyvx_to_i444(buf->packed, buf->packed_linesize, 0, h,
+				     buf->planes, buf->linesize);
+		break;
+	case CONV_DECOMPRESS_NV12:
+		decompress_nv12(inputs, buf->linesize, 0, h, buf->packed,
+				buf->packed_linesize);
+		break;
+	case CONV_DECOMPRESS_420:
+		decompress_420(inputs, buf->linesize, 0, h, buf->packed,
+			       buf->packed_linesize);
+		break;
+	case CONV_DECOMPRESS_422:
+		decompress_422(buf->planes[0], buf->width, 0, h,
+			       buf->packed, buf->packed_linesize, true);
+		break;
+	case CONV_COUNT:
+		break;
+	}
+}
+
+/* returns the average time per frame in milliseconds */
+static double time_conversion(enum conversion conv, struct buffers *buf)
+{
+	uint64_t start, elapsed;
+	int runs = 0;
+
+	/* warm up the caches and the slice threads */
+	run(conv, buf);
+
+	start = os_gettime_ns();
+	do {
+		run(conv, buf);
+		runs++;
+		elapsed = os_gettime_ns() - start;
+	} while (runs < MIN_RUNS || elapsed < MIN_RUN_TIME_NS);
+
+	return (double)elapsed / (double)runs / 1000000.0;
+}
+
+/* keeps the slice thread messages out of the table */
+static void log_handler(int lvl, const char *msg, va_list args, void *param)
+{
+	if (lvl <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+struct path {
+	const char *name;
+	enum format_conversion_simd simd;
+	uint32_t threads;
+};
+
+int main(int argc, char *argv[])
+{
+	struct path paths[] = {
+		{"C", FORMAT_CONVERSION_SIMD_NONE, 1},
+		{"SSE2", FORMAT_CONVERSION_SIMD_SSE2, 1},
+		{"AVX2", FORMAT_CONVERSION_SIMD_AVX2, 1},
+		{"sliced", FORMAT_CONVERSION_SIMD_AUTO, 0},
+	};
+	const size_t path_count = sizeof(paths) / sizeof(paths[0]);
+
+	base_set_log_handler(log_handler, NULL);
+
+	if (argc > 1)
+		paths[path_count - 1].threads = (uint32_t)atoi(argv[1]);
+
+	format_conversion_set_threads(paths[path_count - 1].threads);
+	printf("sliced: %s, %u threads (pass a thread count to change)\n\n",
+	       format_conversion_simd_name(format_conversion_get_simd()),
+	       format_conversion_get_threads());
+
+	printf("%-6s %-13s", "", "ms per frame");
+	for (size_t i = 0; i < path_count; i++)
+		printf(" %9s", paths[i].name);
+	printf("\n");
+
+	for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]);
+	     r++) {
+		const struct resolution *res = &resolutions[r];
+		struct buffers buf;
+
+		buffers_init(&buf, res->width, res->height);
+
+		for (int conv = 0; conv < CONV_COUNT; conv++) {
+			printf("%-6s %-13s", res->name, conversion_names[conv]);
+
+			for (size_t i = 0; i < path_count; i++) {
+				const struct path *path = &paths[i];
+
+				if (!format_conversion_set_simd(path->simd)) {
+					printf(" %9s", "-");
+					continue;
+				}
+
+				format_conversion_set_threads(path->threads);
+				printf(" %9.3f", time_conversion(conv, &buf));
+				fflush(stdout);
+			}
+
+			printf("\n");
+		}
+
+		buffers_free(&buf);
+	}
+
+	format_conversion_free();
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <media-playback/media.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+/*
+ * Measures how long media-playback takes to show the frame at a random
+ * position of a paused file, like scrubbing with the media controls, first
+ * without and then with the seek index.
+ *
+ *   media-seek-benchmark [-n seeks] file...
+ */
+
+#define DEFAULT_SEEKS 100
+#define SEEK_TIMEOUT_MS 5000
+#define INDEX_TIMEOUT_MS 60000
+
+struct seek_stats {
+	double total_ms;
+	double max_ms;
+	int timeouts;
+};
+
+static os_event_t *frame_event = NULL;
+
+static void frame_shown(void *opaque, struct obs_source_frame *frame)
+{
+	os_event_signal(frame_event);
+
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(frame);
+}
+
+static uint64_t next_random(uint64_t *seed)
+{
+	*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *seed >> 33;
+}
+
+static bool run(const char *path, bool index, int seeks,
+		struct seek_stats *stats)
+{
+	struct mp_media_info info = {
+		.v_preload_cb = frame_shown,
+		.v_seek_cb = frame_shown,
+		.path = path,
+		.speed = 100,
+		.is_local_file = true,
+		.build_index = index,
+	};
+	mp_media_t media;
+	uint64_t seed = 1;
+	int64_t duration_ms;
+
+	memset(stats, 0, sizeof(*stats));
+	os_event_reset(frame_event);
+
+	if (!mp_media_init(&media, &info))
+		return false;
+
+	/* the first frame is preloaded once the file is open */
+	if (os_event_timedwait(frame_event, SEEK_TIMEOUT_MS) != 0 ||
+	    !media.has_video) {
+		mp_media_free(&media);
+		return false;
+	}
+
+	if (index) {
+		uint64_t start = os_gettime_ns();
+		int waited = 0;
+
+		while (!mp_media_index_ready(&media)) {
+			if (waited++ == INDEX_TIMEOUT_MS) {
+				mp_media_free(&media);
+				return false;
+			}
+			os_sleep_ms(1);
+		}
+
+		printf("  index ready after %.1f ms, %lld frames\n",
+		       (double)(os_gettime_ns() - start) / 1000000.0,
+		       (long long)mp_media_get_frames(&media));
+	}
+
+	duration_ms = media.fmt->duration / 1000;
+	if (duration_ms <= 0) {
+		mp_media_free(&media);
+		return false;
+	}
+
+	mp_media_play(&media, false, false);
+	mp_media_play_pause(&media, true);
+	os_sleep_ms(100);
+
+	for (int i = 0; i < seeks; i++) {
+		int64_t pos = (int64_t)(next_random(&seed) % duration_ms);
+		uint64_t start;
+		double ms;
+
+		os_event_reset(frame_event);
+		start = os_gettime_ns();
+		mp_media_seek_to(&media, pos);
+
+		if (os_event_timedwait(frame_event, SEEK_TIMEOUT_MS) != 0) {
+			stats->timeouts++;
+			continue;
+		}
+
+		ms = (double)(os_gettime_ns() - start) / 1000000.0;
+		stats->total_ms += ms;
+		if (ms > stats->max_ms)
+			stats->max_ms = ms;
+	}
+
+	mp_media_free(&media);
+	return true;
+}
+
+static void print_stats(const char *name, const struct seek_stats *stats,
+			int seeks)
+{
+	int shown = seeks - stats->timeouts;
+
+	printf("  %-10s avg %8.2f ms  max %8.2f ms", name,
+	       shown ? stats->total_ms / shown : 0.0, stats->max_ms);
+	if (stats->timeouts)
+		printf("  (%d timed out)", stats->timeouts);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int seeks = DEFAULT_SEEKS;
+	int first = 1;
+
+	if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+		seeks = atoi(argv[2]);
+		first = 3;
+	}
+
+	if (first >= argc || seeks < 1) {
+		printf("usage: %s [-n seeks] file...\n", argv[0]);
+		return 1;
+	}
+
+	os_event_init(&frame_event, OS_EVENT_TYPE_AUTO);
+
+	for (int i = first; i < argc; i++) {
+		struct seek_stats unindexed, indexed;
+
+		printf("%s\n", argv[i]);
+
+		if (!run(argv[i], false, seeks, &unindexed) ||
+		    !run(argv[i], true, seeks, &indexed)) {
+			printf("  failed to open\n");
+			continue;
+		}
+
+		print_stats("no index", &unindexed, seeks);
+		print_stats("index", &indexed, seeks);
+	}
+
+	os_event_destroy(frame_event);
+	return 0;
+}
@@ -0,0 +1,332 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <obs-data.h>
+
+/*
+ * Builds a synthetic scene collection, then times saving it to json and to
+ * the binary form, loading it back and reading every source the way
+ * obs_load_source and a source's update callback would.
+ */
+
+#define DEFAULT_SOURCES 500
+#define SETTINGS_PER_SOURCE 40
+#define FILTERS_PER_SOURCE 3
+#define ITEMS_PER_SCENE 25
+#define RUNS 5
+
+static void fill_settings(obs_data_t *settings, int idx, int count)
+{
+	struct dstr name = {0};
+
+	/* set in a scrambled order so insertion order is not sorted */
+	for (int i = 0; i < count; i++) {
+		int key = (i * 7 + idx) % count;
+
+		dstr_printf(&name, "setting_%02d", key);
+
+		switch (key % 4) {
+		case 0:
+			obs_data_set_int(settings, name.array, key * idx);
+			break;
+		case 1:
+			obs_data_set_bool(settings, name.array, key & 2);
+			break;
+		case 2:
+			obs_data_set_double(settings, name.array, key * 0.5);
+			break;
+		default:
+			obs_data_set_string(settings, name.array,
+					    "some string value");
+		}
+	}
+
+	dstr_free(&name);
+}
+
+static obs_data_t *create_source(const char *id, int idx)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *hotkeys = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	struct dstr name = {0};
+
+	dstr_printf(&name, "%s %d", id, idx);
+	obs_data_set_string(source, "name", name.array);
+	obs_data_set_string(source, "id", id);
+	obs_data_set_string(source, "versioned_id", id);
+	obs_data_set_int(source, "flags", 0);
+	obs_data_set_double(source, "volume", 1.0);
+	obs_data_set_double(source, "balance", 0.5);
+	obs_data_set_int(source, "mixers", 0x3F);
+	obs_data_set_int(source, "sync", 0);
+	obs_data_set_int(source, "monitoring_type", 0);
+	obs_data_set_bool(source, "enabled", true);
+	obs_data_set_bool(source, "muted", false);
+	obs_data_set_bool(source, "push-to-mute", false);
+	obs_data_set_int(source, "push-to-mute-delay", 0);
+	obs_data_set_bool(source, "push-to-talk", false);
+	obs_data_set_int(source, "push-to-talk-delay", 0);
+	obs_data_set_int(source, "deinterlace_mode", 0);
+	obs_data_set_int(source, "deinterlace_field_order", 0);
+
+	fill_settings(settings, idx, SETTINGS_PER_SOURCE);
+	obs_data_set_obj(source, "settings", settings);
+
+	for (int i = 0; i < FILTERS_PER_SOURCE; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *filter_settings = obs_data_create();
+
+		dstr_printf(&name, "Filter %d", i);
+		obs_data_set_string(filter, "name", name.array);
+		obs_data_set_string(filter, "id", "color_filter");
+		obs_data_set_bool(filter, "enabled", true);
+		fill_settings(filter_settings, idx + i, 12);
+		obs_data_set_obj(filter, "settings", filter_settings);
+		obs_data_array_push_back(filters, filter);
+
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_set_obj(source, "hotkeys", hotkeys);
+
+	dstr_free(&name);
+	obs_data_array_release(filters);
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+	return source;
+}
+
+static obs_data_t *create_scene(int idx, int source_count)
+{
+	obs_data_t *scene = create_source("scene", idx);
+	obs_data_t *settings = obs_data_get_obj(scene, "settings");
+	obs_data_array_t *items = obs_data_array_create();
+	struct dstr name = {0};
+
+	for (int i = 0; i < ITEMS_PER_SCENE; i++) {
+		obs_data_t *item = obs_data_create();
+
+		dstr_printf(&name, "color_source %d",
+			    (idx * ITEMS_PER_SCENE + i) % source_count);
+		obs_data_set_string(item, "name", name.array);
+		obs_data_set_int(item, "id", i + 1);
+		obs_data_set_bool(item, "visible", true);
+		obs_data_set_bool(item, "locked", false);
+		obs_data_set_double(item, "rot", 0.0);
+		obs_data_set_int(item, "align", 5);
+		obs_data_set_int(item, "bounds_type", 0);
+		obs_data_set_int(item, "bounds_align", 0);
+		obs_data_set_int(item, "crop_left", 0);
+		obs_data_set_int(item, "crop_top", 0);
+		obs_data_set_int(item, "crop_right", 0);
+		obs_data_set_int(item, "crop_bottom", 0);
+		obs_data_set_int(item, "scale_filter", 0);
+		obs_data_set_int(item, "blend_type", 0);
+		obs_data_array_push_back(items, item);
+		obs_data_release(item);
+	}
+
+	obs_data_set_array(settings, "items", items);
+
+	dstr_free(&name);
+	obs_data_array_release(items);
+	obs_data_release(settings);
+	return scene;
+}
+
+static obs_data_t *create_collection(int source_count)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	int scene_count = source_count / ITEMS_PER_SCENE;
+
+	for (int i = 0; i < source_count; i++) {
+		obs_data_t *source = create_source("color_source", i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	for (int i = 0; i < scene_count; i++) {
+		obs_data_t *scene = create_scene(i, source_count);
+		obs_data_array_push_back(sources, scene);
+		obs_data_release(scene);
+	}
+
+	obs_data_set_string(collection, "name", "Benchmark");
+	obs_data_set_string(collection, "current_scene", "scene 0");
+	obs_data_set_string(collection, "current_program_scene", "scene 0");
+	obs_data_set_array(collection, "sources", sources);
+
+	obs_data_array_release(sources);
+	return collection;
+}
+
+static int64_t read_settings(obs_data_t *settings, int count)
+{
+	struct dstr name = {0};
+	int64_t sum = 0;
+
+	for (int i = 0; i < count; i++) {
+		dstr_printf(&name, "setting_%02d", i);
+
+		/* what get_defaults and update callbacks end up doing */
+		obs_data_set_default_int(settings, name.array, 0);
+		sum += obs_data_get_int(settings, name.array);
+		sum += obs_data_has_user_value(settings, name.array);
+	}
+
+	dstr_free(&name);
+	return sum;
+}
+
+/* roughly the lookups obs_load_source does for a source */
+static int64_t read_source(obs_data_t *source)
+{
+	static const char *keys[] = {
+		"name",
+		"id",
+		"versioned_id",
+		"flags",
+		"volume",
+		"balance",
+		"mixers",
+		"sync",
+		"enabled",
+		"muted",
+		"push-to-mute",
+		"push-to-mute-delay",
+		"push-to-talk",
+		"push-to-talk-delay",
+		"deinterlace_mode",
+		"deinterlace_field_order",
+		"monitoring_type",
+	};
+	obs_data_t *settings = obs_data_get_obj(source, "settings");
+	obs_data_array_t *filters = obs_data_get_array(source, "filters");
+	int64_t sum = 0;
+
+	for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		sum += obs_data_get_int(source, keys[i]) +
+		       obs_data_has_user_value(source, keys[i]);
+
+	sum += read_settings(settings, SETTINGS_PER_SOURCE);
+
+	for (size_t i = 0; i < obs_data_array_count(filters); i++) {
+		obs_data_t *filter = obs_data_array_item(filters, i);
+		obs_data_t *filter_settings =
+			obs_data_get_obj(filter, "settings");
+
+		sum += read_settings(filter_settings, 12);
+
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_array_release(filters);
+	obs_data_release(settings);
+	return sum;
+}
+
+static double ms_since(uint64_t start)
+{
+	return (double)(os_gettime_ns() - start) / 1000000.0;
+}
+
+static int64_t read_collection(obs_data_t *collection)
+{
+	obs_data_array_t *sources = obs_data_get_array(collection, "sources");
+	int64_t sum = 0;
+
+	for (size_t i = 0; i < obs_data_array_count(sources); i++) {
+		obs_data_t *source = obs_data_array_item(sources, i);
+		sum += read_source(source);
+		obs_data_release(source);
+	}
+
+	obs_data_array_release(sources);
+	return sum;
+}
+
+struct times {
+	double save_ms;
+	double load_ms;
+	double read_ms;
+	size_t size;
+};
+
+static void print_times(const char *name, const struct times *times)
+{
+	printf("%-7s %9.1f KiB %8.2f ms %8.2f ms %8.2f ms %8.2f ms\n", name,
+	       (double)times->size / 1024.0, times->save_ms / RUNS,
+	       times->load_ms / RUNS, times->read_ms / RUNS,
+	       (times->load_ms + times->read_ms) / RUNS);
+}
+
+int main(int argc, char *argv[])
+{
+	int source_count = argc > 1 ? atoi(argv[1]) : DEFAULT_SOURCES;
+	struct times json = {0};
+	struct times binary = {0};
+	double create_ms = 0.0;
+	int64_t json_sum = 0, binary_sum = 0;
+
+	if (source_count < ITEMS_PER_SCENE)
+		source_count = ITEMS_PER_SCENE;
+
+	for (int run = 0; run < RUNS; run++) {
+		uint64_t start = os_gettime_ns();
+		obs_data_t *collection = create_collection(source_count);
+		create_ms += ms_since(start);
+
+		start = os_gettime_ns();
+		const char *text = obs_data_get_json(collection);
+		json.save_ms += ms_since(start);
+		json.size = strlen(text);
+
+		start = os_gettime_ns();
+		obs_data_t *loaded = obs_data_create_from_json(text);
+		json.load_ms += ms_since(start);
+
+		start = os_gettime_ns();
+		json_sum += read_collection(loaded);
+		json.read_ms += ms_since(start);
+		obs_data_release(loaded);
+
+		start = os_gettime_ns();
+		void *buf = obs_data_get_binary(collection, &binary.size);
+		binary.save_ms += ms_since(start);
+
+		start = os_gettime_ns();
+		loaded = obs_data_create_from_binary(buf, binary.size);
+		binary.load_ms += ms_since(start);
+
+		/* this is where the binary form decodes the objects */
+		start = os_gettime_ns();
+		binary_sum += read_collection(loaded);
+		binary.read_ms += ms_since(start);
+		obs_data_release(loaded);
+
+		bfree(buf);
+		obs_data_release(collection);
+	}
+
+	printf("%d sources, %d scenes (checksums %" PRId64 " %s %" PRId64
+	       ")\n",
+	       source_count, source_count / ITEMS_PER_SCENE, json_sum,
+	       json_sum == binary_sum ? "==" : "!=", binary_sum);
+	printf("create: %8.2f ms\n\n", create_ms / RUNS);
+	printf("%-7s %13s %11s %11s %11s %11s\n", "", "size", "save", "load",
+	       "read", "load+read");
+	print_times("json", &json);
+	print_times("binary", &binary);
+	return json_sum == binary_sum ? 0 : 1;
+}
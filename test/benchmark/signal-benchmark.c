@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <callback/signal.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+/*
+ * Times signal_handler_signal with 0, 1 and 10 connected callbacks, first
+ * from one thread and then from several threads signalling the same signal
+ * at once, the way sources emit signals from the video and audio threads.
+ */
+
+#define DEFAULT_SIGNALS 2000000
+#define THREADS 4
+
+static volatile long total_calls = 0;
+
+static void count_callback(void *data, calldata_t *cd)
+{
+	os_atomic_inc_long(&total_calls);
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(cd);
+}
+
+struct signal_thread {
+	signal_handler_t *handler;
+	int count;
+	pthread_t thread;
+};
+
+static void *signal_thread(void *param)
+{
+	struct signal_thread *thread = param;
+	struct calldata cd;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "value", 1);
+
+	for (int i = 0; i < thread->count; i++)
+		signal_handler_signal(thread->handler, "test", &cd);
+
+	return NULL;
+}
+
+static double run(signal_handler_t *handler, int threads, int count)
+{
+	struct signal_thread thread[THREADS];
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < threads; i++) {
+		thread[i].handler = handler;
+		thread[i].count = count / threads;
+		pthread_create(&thread[i].thread, NULL, signal_thread,
+			       &thread[i]);
+	}
+	for (int i = 0; i < threads; i++)
+		pthread_join(thread[i].thread, NULL);
+
+	return (double)(os_gettime_ns() - start) / 1000000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int listener_counts[] = {0, 1, 10};
+	int count = argc > 1 ? atoi(argv[1]) : DEFAULT_SIGNALS;
+	int data[10];
+
+	if (count < THREADS)
+		count = THREADS;
+
+	printf("%-10s %16s %16s\n", "listeners", "1 thread",
+	       "4 threads");
+
+	for (size_t i = 0; i < sizeof(listener_counts) / sizeof(int); i++) {
+		int listeners = listener_counts[i];
+		signal_handler_t *handler = signal_handler_create();
+		double single, multi;
+
+		signal_handler_add(handler, "void test(int value)");
+		for (int j = 0; j < listeners; j++)
+			signal_handler_connect(handler, "test", count_callback,
+					       &data[j]);
+
+		single = run(handler, 1, count);
+		multi = run(handler, THREADS, count);
+
+		printf("%-10d %12.0f/sec %12.0f/sec\n", listeners,
+		       (double)count / single, (double)count / multi);
+
+		signal_handler_destroy(handler);
+	}
+
+	printf("\n%ld callbacks\n", os_atomic_load_long(&total_calls));
+	return 0;
+}
@@ -0,0 +1,421 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <media-io/audio-resampler.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* the built-in conversions have to match what libswresample produces for the
+ * same input, blocks of different sizes are fed to both */
+
+#define BLOCKS 32
+#define MAX_BLOCK 1024
+#define MAX_OUTPUT (BLOCKS * MAX_BLOCK * 2)
+
+/* the filter starts from mirrored input, skip the first samples to not
+ * depend on exactly how */
+#define RESAMPLE_SKIP 64
+
+/* timestamp offsets have to agree to within a microsecond */
+#define TS_TOLERANCE 1000
+
+struct stream {
+	float *planes[MAX_AUDIO_CHANNELS];
+	size_t frames;
+	uint64_t ts_offsets[BLOCKS];
+};
+
+static uint32_t seed = 1;
+
+static float rand_float(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (float)((seed >> 8) & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+static size_t block_size(int block)
+{
+	return 256 + (size_t)(block * 97) % (MAX_BLOCK - 256);
+}
+
+static void write_sample(uint8_t *dst, enum audio_format format, float val)
+{
+	switch (format) {
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		*(int16_t *)dst = (int16_t)lrintf(val * 32767.0f);
+		break;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		*(int32_t *)dst = (int32_t)lrint(val * 2147483647.0);
+		break;
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		*(float *)dst = val;
+		break;
+	case AUDIO_FORMAT_UNKNOWN:
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		*dst = (uint8_t)lrintf(val * 127.0f + 128.0f);
+		break;
+	}
+}
+
+static float read_sample(const uint8_t *src, enum audio_format format)
+{
+	switch (format) {
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		return *(const int16_t *)src / 32768.0f;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		return (float)(*(const int32_t *)src / 2147483648.0);
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return *(const float *)src;
+	case AUDIO_FORMAT_UNKNOWN:
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		break;
+	}
+
+	return (*src - 128) / 128.0f;
+}
+
+/* fills a block in the given format, planes point into data */
+static void make_block(const struct resample_info *info, uint8_t *data,
+		       const uint8_t *planes[], size_t frames)
+{
+	uint32_t channels = get_audio_channels(info->speakers);
+	size_t size = get_audio_bytes_per_channel(info->format);
+	bool planar = is_audio_planar(info->format);
+
+	for (size_t i = 0; i < frames; i++) {
+		for (uint32_t c = 0; c < channels; c++) {
+			size_t pos = planar ? c * frames + i
+					    : i * channels + c;
+			write_sample(data + pos * size, info->format,
+				     rand_float() * 0.9f);
+		}
+	}
+
+	for (uint32_t c = 0; c < channels; c++)
+		planes[c] = planar ? data + c * frames * size : data;
+}
+
+static void append_output(const struct resample_info *info,
+			  struct stream *out, uint8_t *const output[],
+			  uint32_t frames)
+{
+	uint32_t channels = get_audio_channels(info->speakers);
+	size_t size = get_audio_bytes_per_channel(info->format);
+	bool planar = is_audio_planar(info->format);
+
+	assert_true(out->frames + frames <= MAX_OUTPUT);
+
+	for (uint32_t i = 0; i < frames; i++) {
+		for (uint32_t c = 0; c < channels; c++) {
+			const uint8_t *src =
+				planar ? output[c] + i * size
+				       : output[0] + (i * channels + c) * size;
+			out->planes[c][out->frames + i] =
+				read_sample(src, info->format);
+		}
+	}
+
+	out->frames += frames;
+}
+
+static void stream_init(struct stream *s)
+{
+	memset(s, 0, sizeof(*s));
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		s->planes[c] = bzalloc(MAX_OUTPUT * sizeof(float));
+}
+
+static void stream_free(struct stream *s)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		bfree(s->planes[c]);
+}
+
+static void run(const struct resample_info *dst,
+		const struct resample_info *src, bool native,
+		struct stream *out)
+{
+	uint8_t *data = bzalloc(MAX_BLOCK * MAX_AUDIO_CHANNELS * 4);
+	audio_resampler_t *rs;
+
+	audio_resampler_set_native(native);
+	rs = audio_resampler_create(dst, src);
+	audio_resampler_set_native(true);
+	assert_non_null(rs);
+
+	seed = 1;
+	stream_init(out);
+
+	for (int block = 0; block < BLOCKS; block++) {
+		const uint8_t *input[MAX_AV_PLANES] = {0};
+		uint8_t *output[MAX_AV_PLANES] = {0};
+		size_t frames = block_size(block);
+		uint32_t out_frames = 0;
+		uint64_t ts_offset = 0;
+
+		make_block(src, data, input, frames);
+		assert_true(audio_resampler_resample(rs, output, &out_frames,
+						     &ts_offset, input,
+						     (uint32_t)frames));
+		append_output(dst, out, output, out_frames);
+		out->ts_offsets[block] = ts_offset;
+	}
+
+	audio_resampler_destroy(rs);
+	bfree(data);
+}
+
+static void compare(const struct resample_info *dst,
+		    const struct resample_info *src)
+{
+	uint32_t channels = get_audio_channels(dst->speakers);
+	bool resampled = dst->samples_per_sec != src->samples_per_sec;
+	size_t skip = resampled ? RESAMPLE_SKIP : 0;
+	struct stream native, swr;
+	float tolerance;
+	size_t frames;
+
+	if (resampled)
+		tolerance = 1e-3f;
+	else if (get_audio_bytes_per_channel(dst->format) == 2)
+		tolerance = 1.5f / 32768.0f;
+	else
+		tolerance = 1e-6f;
+
+	run(dst, src, true, &native);
+	run(dst, src, false, &swr);
+
+	/* the two may split the output differently at the end of a block */
+	frames = native.frames < swr.frames ? native.frames : swr.frames;
+	assert_true(frames + MAX_BLOCK > native.frames);
+	assert_true(frames + MAX_BLOCK > swr.frames);
+	assert_true(frames > skip);
+
+	for (int block = 0; block < BLOCKS; block++) {
+		int64_t diff = (int64_t)(native.ts_offsets[block] -
+					 swr.ts_offsets[block]);
+		if (diff < -TS_TOLERANCE || diff > TS_TOLERANCE)
+			fail_msg("block %d ts_offset: %llu != %llu", block,
+				 (unsigned long long)native.ts_offsets[block],
+				 (unsigned long long)swr.ts_offsets[block]);
+	}
+
+	for (uint32_t c = 0; c < channels; c++) {
+		for (size_t i = skip; i < frames; i++) {
+			float diff = native.planes[c][i] - swr.planes[c][i];
+			if (fabsf(diff) > tolerance)
+				fail_msg("channel %u sample %zu: %f != %f", c,
+					 i, native.planes[c][i],
+					 swr.planes[c][i]);
+		}
+	}
+
+	stream_free(&native);
+	stream_free(&swr);
+}
+
+static void check_native(const struct resample_info *dst,
+			 const struct resample_info *src, bool expected)
+{
+	audio_resampler_t *rs = audio_resampler_create(dst, src);
+
+	assert_non_null(rs);
+	assert_int_equal(audio_resampler_is_native(rs), expected);
+	audio_resampler_destroy(rs);
+}
+
+static const enum audio_format formats[] = {
+	AUDIO_FORMAT_16BIT, AUDIO_FORMAT_16BIT_PLANAR,
+	AUDIO_FORMAT_32BIT, AUDIO_FORMAT_32BIT_PLANAR,
+	AUDIO_FORMAT_FLOAT, AUDIO_FORMAT_FLOAT_PLANAR,
+};
+
+#define FORMAT_COUNT (sizeof(formats) / sizeof(formats[0]))
+
+static inline bool is_float(enum audio_format format)
+{
+	return format == AUDIO_FORMAT_FLOAT ||
+	       format == AUDIO_FORMAT_FLOAT_PLANAR;
+}
+
+static void format_test(void **state)
+{
+	for (size_t i = 0; i < FORMAT_COUNT; i++) {
+		for (size_t j = 0; j < FORMAT_COUNT; j++) {
+			struct resample_info src = {48000, formats[i],
+						    SPEAKERS_STEREO};
+			struct resample_info dst = {48000, formats[j],
+						    SPEAKERS_STEREO};
+
+			if (!is_float(src.format) && !is_float(dst.format))
+				continue;
+
+			check_native(&dst, &src, true);
+			compare(&dst, &src);
+		}
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void layout_test(void **state)
+{
+	for (size_t i = 0; i < FORMAT_COUNT; i++) {
+		struct resample_info mono = {48000, formats[i], SPEAKERS_MONO};
+		struct resample_info stereo = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+					       SPEAKERS_STEREO};
+
+		check_native(&stereo, &mono, true);
+		compare(&stereo, &mono);
+		check_native(&mono, &stereo, true);
+		compare(&mono, &stereo);
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+static void resample_test(void **state)
+{
+	static const uint32_t rates[][2] = {
+		{44100, 48000},
+		{48000, 44100},
+		{32000, 48000},
+		{48000, 16000},
+	};
+
+	for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+		struct resample_info src = {rates[i][0],
+					    AUDIO_FORMAT_FLOAT_PLANAR,
+					    SPEAKERS_STEREO};
+		struct resample_info dst = {rates[i][1],
+					    AUDIO_FORMAT_FLOAT_PLANAR,
+					    SPEAKERS_STEREO};
+
+		check_native(&dst, &src, true);
+		compare(&dst, &src);
+
+		src.format = AUDIO_FORMAT_16BIT;
+		dst.speakers = SPEAKERS_MONO;
+		compare(&dst, &src);
+
+		src.format = AUDIO_FORMAT_FLOAT;
+		src.speakers = SPEAKERS_MONO;
+		dst.format = AUDIO_FORMAT_16BIT;
+		dst.speakers = SPEAKERS_STEREO;
+		compare(&dst, &src);
+	}
+
+	UNUSED_PARAMETER(state);
+}
+
+/* a tone resampled from 44.1 kHz has to come out as the same tone */
+static void sine_test(void **state)
+{
+	struct resample_info src = {44100, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_MONO};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_MONO};
+	audio_resampler_t *rs = audio_resampler_create(&dst, &src);
+	float *input = bzalloc(MAX_BLOCK * sizeof(float));
+	size_t in_pos = 0;
+	size_t out_pos = 0;
+
+	assert_true(audio_resampler_is_native(rs));
+
+	for (int block = 0; block < BLOCKS; block++) {
+		const uint8_t *in[MAX_AV_PLANES] = {(uint8_t *)input};
+		uint8_t *out[MAX_AV_PLANES] = {0};
+		size_t frames = block_size(block);
+		uint32_t out_frames = 0;
+		uint64_t ts_offset = 0;
+
+		for (size_t i = 0; i < frames; i++, in_pos++)
+			input[i] = 0.5f * (float)sin(2.0 * M_PI * 1000.0 *
+						     in_pos / 44100.0);
+
+		assert_true(audio_resampler_resample(rs, out, &out_frames,
+						     &ts_offset, in,
+						     (uint32_t)frames));
+
+		for (uint32_t i = 0; i < out_frames; i++, out_pos++) {
+			const float *val = (const float *)out[0];
+			double expected = 0.5 * sin(2.0 * M_PI * 1000.0 *
+						    out_pos / 48000.0);
+
+			if (out_pos >= RESAMPLE_SKIP)
+				assert_true(fabs(val[i] - expected) < 1e-3);
+		}
+	}
+
+	/* everything but what is still in the filter comes out */
+	assert_true(out_pos * 44100 / 48000 + 64 > in_pos);
+
+	audio_resampler_destroy(rs);
+	bfree(input);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void fallback_test(void **state)
+{
+	struct resample_info src = {48000, AUDIO_FORMAT_16BIT,
+				    SPEAKERS_5POINT1};
+	struct resample_info dst = {48000, AUDIO_FORMAT_FLOAT_PLANAR,
+				    SPEAKERS_STEREO};
+
+	/* downmixing anything but stereo */
+	check_native(&dst, &src, false);
+
+	/* integer to integer */
+	src.speakers = SPEAKERS_STEREO;
+	dst.format = AUDIO_FORMAT_32BIT;
+	check_native(&dst, &src, false);
+
+	/* 8 bit samples */
+	src.format = AUDIO_FORMAT_U8BIT;
+	dst.format = AUDIO_FORMAT_FLOAT;
+	check_native(&dst, &src, false);
+
+	/* rates without a small ratio */
+	src.format = AUDIO_FORMAT_FLOAT;
+	src.samples_per_sec = 44101;
+	check_native(&dst, &src, false);
+
+	/* and the switch to turn it off */
+	src.samples_per_sec = 48000;
+	check_native(&dst, &src, true);
+	audio_resampler_set_native(false);
+	check_native(&dst, &src, false);
+	audio_resampler_set_native(true);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(format_test),
+		cmocka_unit_test(layout_test),
+		cmocka_unit_test(resample_test),
+		cmocka_unit_test(sine_test),
+		cmocka_unit_test(fallback_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,83 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <obs-avc.h>
+
+/* an IDR slice followed by a regular slice, both with annex-b start codes */
+static const uint8_t annexb[] = {
+	0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33,
+	0x00, 0x00, 0x01, 0x41, 0x9a, 0x02, 0x0c,
+};
+
+static const uint8_t avcc[] = {
+	0x00, 0x00, 0x00, 0x05, 0x65, 0x88, 0x84, 0x00, 0x33,
+	0x00, 0x00, 0x00, 0x04, 0x41, 0x9a, 0x02, 0x0c,
+};
+
+static void parse_avc_packet_test(void **state)
+{
+	struct encoder_packet src = {
+		.data = (uint8_t *)annexb,
+		.size = sizeof(annexb),
+		.type = OBS_ENCODER_VIDEO,
+		.pts = 3,
+		.dts = 1,
+	};
+	struct encoder_packet parsed;
+	struct encoder_packet ref;
+
+	obs_parse_avc_packet(&parsed, &src);
+
+	assert_non_null(parsed.data);
+	assert_int_equal(parsed.size, sizeof(avcc));
+	assert_memory_equal(parsed.data, avcc, sizeof(avcc));
+	assert_int_equal(parsed.pts, 3);
+	assert_int_equal(parsed.dts, 1);
+	assert_false(parsed.keyframe);
+	assert_int_equal(parsed.priority, OBS_NAL_PRIORITY_HIGH);
+
+	/* the parsed packet has to survive the same reference counting as
+	 * any other encoder packet */
+	obs_encoder_packet_ref(&ref, &parsed);
+	obs_encoder_packet_release(&parsed);
+	assert_null(parsed.data);
+	assert_memory_equal(ref.data, avcc, sizeof(avcc));
+	obs_encoder_packet_release(&ref);
+	assert_null(ref.data);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void parse_avc_keyframe_test(void **state)
+{
+	struct encoder_packet src = {
+		.data = (uint8_t *)annexb,
+		.size = 9,
+		.type = OBS_ENCODER_VIDEO,
+	};
+	struct encoder_packet parsed;
+
+	obs_parse_avc_packet(&parsed, &src);
+
+	assert_int_equal(parsed.size, 9);
+	assert_memory_equal(parsed.data, avcc, 9);
+	assert_true(parsed.keyframe);
+	assert_int_equal(parsed.priority, OBS_NAL_PRIORITY_HIGHEST);
+
+	obs_encoder_packet_release(&parsed);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(parse_avc_packet_test),
+		cmocka_unit_test(parse_avc_keyframe_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,535 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/circlebuf.h>
+
+#include "bitrate-controller.h"
+
+/*
+ * Deterministic simulation of a stream going through a fake socket.  The
+ * socket has a fixed size send buffer that drains at the bandwidth of the
+ * current trace point, and lost transmissions are modeled as ticks where
+ * nothing drains (the retransmit).  Everything runs on a virtual clock, so
+ * the same trace always produces the same decisions.
+ */
+
+#define TICK_NS 1000000ULL
+#define SEC_NS 1000000000ULL
+#define FPS 30
+#define KEYFRAME_INTERVAL (FPS * 2)
+#define SNDBUF_SIZE (64 * 1024)
+#define AUDIO_BITRATE 160
+#define MAX_SECONDS 120
+
+struct trace_point {
+	int start_sec;
+	long kbps;
+	double loss;
+};
+
+struct sim_frame {
+	int64_t dts_usec;
+	size_t size;
+};
+
+struct sim_result {
+	long bitrate[MAX_SECONDS];
+	int64_t max_queue_usec[MAX_SECONDS];
+	struct bitrate_controller_stats stats;
+	struct bitrate_decision decisions[256];
+	size_t num_decisions;
+};
+
+struct sim {
+	const struct trace_point *trace;
+	size_t trace_count;
+	uint64_t now;
+	uint32_t rng;
+
+	/* fake socket */
+	size_t sndbuf;
+
+	/* sender */
+	struct circlebuf queue;
+	int64_t last_dts_usec;
+	bool sending;
+	struct sim_frame cur;
+	size_t cur_left;
+	uint64_t send_beg;
+	int64_t send_queue_usec;
+
+	/* encoder */
+	long bitrate;
+	uint64_t next_frame;
+	uint64_t frame_count;
+
+	bitrate_controller_t *bc;
+};
+
+static const struct trace_point *trace_at(struct sim *sim)
+{
+	const struct trace_point *point = &sim->trace[0];
+	int sec = (int)(sim->now / SEC_NS);
+
+	for (size_t i = 1; i < sim->trace_count; i++) {
+		if (sim->trace[i].start_sec <= sec)
+			point = &sim->trace[i];
+	}
+	return point;
+}
+
+static double sim_random(struct sim *sim)
+{
+	sim->rng = sim->rng * 1664525u + 1013904223u;
+	return (double)(sim->rng >> 8) / (double)(1 << 24);
+}
+
+static void socket_drain(struct sim *sim)
+{
+	const struct trace_point *point = trace_at(sim);
+	size_t bytes = (size_t)(point->kbps * 1000 / 8 / 1000);
+
+	if (point->loss > 0.0 && sim_random(sim) < point->loss)
+		return;
+
+	sim->sndbuf = sim->sndbuf > bytes ? sim->sndbuf - bytes : 0;
+}
+
+static int64_t queue_duration(struct sim *sim)
+{
+	struct sim_frame front;
+
+	if (!sim->queue.size)
+		return 0;
+
+	circlebuf_peek_front(&sim->queue, &front, sizeof(front));
+	return sim->last_dts_usec - front.dts_usec;
+}
+
+static void encode_frame(struct sim *sim, struct sim_result *result)
+{
+	struct sim_frame frame;
+	size_t avg = (size_t)(sim->bitrate + AUDIO_BITRATE) * 1000 / 8 / FPS;
+	int64_t queue_usec;
+	long bitrate;
+
+	/* keyframes are three times the size of the other frames */
+	frame.size = avg * KEYFRAME_INTERVAL / (KEYFRAME_INTERVAL + 2);
+	if (sim->frame_count % KEYFRAME_INTERVAL == 0)
+		frame.size *= 3;
+	frame.dts_usec = (int64_t)(sim->frame_count * 1000000 / FPS);
+
+	circlebuf_push_back(&sim->queue, &frame, sizeof(frame));
+	sim->last_dts_usec = frame.dts_usec;
+
+	queue_usec = queue_duration(sim);
+	if (bitrate_controller_update(sim->bc, sim->now, queue_usec, &bitrate))
+		sim->bitrate = bitrate;
+
+	int sec = (int)(sim->now / SEC_NS);
+	if (queue_usec > result->max_queue_usec[sec])
+		result->max_queue_usec[sec] = queue_usec;
+	result->bitrate[sec] = sim->bitrate;
+
+	sim->frame_count++;
+	sim->next_frame = sim->frame_count * SEC_NS / FPS;
+}
+
+static void socket_send(struct sim *sim)
+{
+	for (;;) {
+		size_t space, size;
+
+		if (!sim->sending) {
+			if (!sim->queue.size)
+				return;
+
+			sim->send_queue_usec = queue_duration(sim);
+			circlebuf_pop_front(&sim->queue, &sim->cur,
+					    sizeof(sim->cur));
+			sim->cur_left = sim->cur.size;
+			sim->send_beg = sim->now;
+			sim->sending = true;
+		}
+
+		/* blocks until everything is in the send buffer */
+		space = SNDBUF_SIZE - sim->sndbuf;
+		size = sim->cur_left < space ? sim->cur_left : space;
+		sim->sndbuf += size;
+		sim->cur_left -= size;
+
+		if (sim->cur_left)
+			return;
+
+		struct bitrate_sample sample = {
+			.send_beg = sim->send_beg,
+			.send_end = sim->now,
+			.size = sim->cur.size,
+			.queue_usec = sim->send_queue_usec,
+		};
+		bitrate_controller_add_sample(sim->bc, &sample);
+		sim->sending = false;
+	}
+}
+
+static void run_sim(bitrate_controller_t *bc, const struct trace_point *trace,
+		    size_t trace_count, int seconds, struct sim_result *result)
+{
+	struct sim sim = {0};
+
+	assert_true(seconds <= MAX_SECONDS);
+	memset(result, 0, sizeof(*result));
+
+	sim.trace = trace;
+	sim.trace_count = trace_count;
+	sim.rng = 12345;
+	sim.bc = bc;
+	sim.bitrate = bitrate_controller_get_bitrate(bc);
+
+	while (sim.now < (uint64_t)seconds * SEC_NS) {
+		socket_drain(&sim);
+		if (sim.now >= sim.next_frame)
+			encode_frame(&sim, result);
+		socket_send(&sim);
+		sim.now += TICK_NS;
+	}
+
+	bitrate_controller_get_stats(bc, &result->stats);
+	for (size_t i = 0; i < 256; i++) {
+		if (!bitrate_controller_get_decision(bc, i,
+						     &result->decisions[i]))
+			break;
+		result->num_decisions++;
+	}
+
+	circlebuf_free(&sim.queue);
+}
+
+static void run_model(const char *model, long max_bitrate,
+		      const struct trace_point *trace, size_t trace_count,
+		      int seconds, struct sim_result *result)
+{
+	struct bitrate_controller_config config = {
+		.max_bitrate = max_bitrate,
+		.min_bitrate = 200,
+		.audio_bitrate = AUDIO_BITRATE,
+	};
+	bitrate_controller_t *bc = bitrate_controller_create(model, &config);
+
+	assert_non_null(bc);
+	run_sim(bc, trace, trace_count, seconds, result);
+	bitrate_controller_destroy(bc);
+}
+
+static void print_result(const char *name, struct sim_result *result,
+			 int seconds)
+{
+	print_message("%s: %zu decisions, %llu decreases, %llu increases\n",
+		      name, result->num_decisions,
+		      (unsigned long long)result->stats.decreases,
+		      (unsigned long long)result->stats.increases);
+
+	for (int i = 0; i < seconds; i += 5)
+		print_message("  %3ds: %5ld kbps, queue %4lld ms\n", i,
+			      result->bitrate[i],
+			      (long long)result->max_queue_usec[i] / 1000);
+}
+
+static long min_bitrate_in(struct sim_result *result, int from, int to)
+{
+	long val = result->bitrate[from];
+	for (int i = from; i < to; i++) {
+		if (result->bitrate[i] < val)
+			val = result->bitrate[i];
+	}
+	return val;
+}
+
+static long max_bitrate_in(struct sim_result *result, int from, int to)
+{
+	long val = result->bitrate[from];
+	for (int i = from; i < to; i++) {
+		if (result->bitrate[i] > val)
+			val = result->bitrate[i];
+	}
+	return val;
+}
+
+static long avg_bitrate_in(struct sim_result *result, int from, int to)
+{
+	long total = 0;
+	for (int i = from; i < to; i++)
+		total += result->bitrate[i];
+	return total / (to - from);
+}
+
+static int64_t max_queue_in(struct sim_result *result, int from, int to)
+{
+	int64_t val = 0;
+	for (int i = from; i < to; i++) {
+		if (result->max_queue_usec[i] > val)
+			val = result->max_queue_usec[i];
+	}
+	return val;
+}
+
+#define COUNT(x) (sizeof(x) / sizeof(x[0]))
+
+/* ------------------------------------------------------------------------- */
+
+static void steady_link_test(void **state)
+{
+	const struct trace_point trace[] = {{0, 10000, 0.0}};
+	struct sim_result result;
+
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 60,
+		  &result);
+
+	assert_int_equal(result.stats.decreases, 0);
+	assert_int_equal(min_bitrate_in(&result, 0, 60), 6000);
+	assert_true(max_queue_in(&result, 0, 60) < 100000);
+}
+
+static void bandwidth_drop_test(void **state)
+{
+	const struct trace_point trace[] = {{0, 8000, 0.0}, {20, 3000, 0.0}};
+	struct sim_result result;
+
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 80,
+		  &result);
+	print_result("bandwidth drop", &result, 80);
+
+	/* reacts within a couple of seconds */
+	assert_int_equal(result.bitrate[19], 6000);
+	assert_true(result.bitrate[22] < 6000);
+
+	/* settles around the link rate without giving most of it away,
+	 * probing above it only briefly */
+	assert_true(avg_bitrate_in(&result, 40, 80) + AUDIO_BITRATE <= 3000);
+	assert_true(max_bitrate_in(&result, 40, 80) + AUDIO_BITRATE <= 3300);
+	assert_true(min_bitrate_in(&result, 40, 80) >= 3000 * 6 / 10);
+
+	/* queue is kept short once settled */
+	assert_true(max_queue_in(&result, 40, 80) < 500000);
+
+	/* and the encoder isn't reconfigured constantly */
+	assert_true(result.num_decisions < 40);
+}
+
+static void recovery_test(void **state)
+{
+	const struct trace_point trace[] = {
+		{0, 2500, 0.0}, {30, 8000, 0.0}};
+	struct sim_result result;
+
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 90,
+		  &result);
+	print_result("recovery", &result, 90);
+
+	assert_true(avg_bitrate_in(&result, 20, 30) + AUDIO_BITRATE <= 2500);
+	assert_int_equal(result.bitrate[80], 6000);
+
+	/* ramping back up happens gradually */
+	for (size_t i = 0; i < result.num_decisions; i++) {
+		struct bitrate_decision *d = &result.decisions[i];
+		if (d->type == BITRATE_DECISION_INCREASE && d->bitrate != 6000)
+			assert_true(d->bitrate <= d->prev_bitrate * 115 / 100);
+	}
+}
+
+static void loss_test(void **state)
+{
+	/* ~4800 kbps of goodput */
+	const struct trace_point trace[] = {{0, 8000, 0.0}, {10, 8000, 0.4}};
+	struct sim_result result;
+
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 60,
+		  &result);
+	print_result("loss", &result, 60);
+
+	assert_true(result.stats.decreases > 0);
+	assert_true(avg_bitrate_in(&result, 30, 60) + AUDIO_BITRATE <= 4800);
+	assert_true(max_bitrate_in(&result, 30, 60) + AUDIO_BITRATE <= 5300);
+	assert_true(min_bitrate_in(&result, 30, 60) >= 4800 * 6 / 10);
+	assert_true(max_queue_in(&result, 30, 60) < 500000);
+}
+
+static void legacy_model_test(void **state)
+{
+	const struct trace_point trace[] = {{0, 8000, 0.0}, {10, 3000, 0.0}};
+	struct sim_result result;
+
+	run_model(BITRATE_MODEL_LEGACY, 6000, trace, COUNT(trace), 40,
+		  &result);
+
+	assert_true(result.stats.decreases > 0);
+	assert_true(result.bitrate[39] < 3000);
+}
+
+static void deterministic_test(void **state)
+{
+	const struct trace_point trace[] = {
+		{0, 8000, 0.0}, {10, 3000, 0.1}, {30, 5000, 0.05}};
+	struct sim_result *a = malloc(sizeof(*a));
+	struct sim_result *b = malloc(sizeof(*b));
+
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 60,
+		  a);
+	run_model(BITRATE_MODEL_DELAY_GRADIENT, 6000, trace, COUNT(trace), 60,
+		  b);
+
+	assert_true(a->num_decisions > 0);
+	assert_int_equal(a->num_decisions, b->num_decisions);
+	for (size_t i = 0; i < a->num_decisions; i++) {
+		struct bitrate_decision *da = &a->decisions[i];
+		struct bitrate_decision *db = &b->decisions[i];
+
+		assert_int_equal(da->ts, db->ts);
+		assert_int_equal(da->type, db->type);
+		assert_int_equal(da->bitrate, db->bitrate);
+		assert_int_equal(da->est_bitrate, db->est_bitrate);
+		assert_int_equal(da->queue_usec, db->queue_usec);
+	}
+	assert_memory_equal(a->bitrate, b->bitrate, sizeof(a->bitrate));
+
+	free(a);
+	free(b);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct fixed_model {
+	long target;
+	size_t samples;
+	size_t updates;
+	size_t changes;
+};
+
+static struct fixed_model *fixed_model = NULL;
+
+static void *fixed_create(const struct bitrate_controller_config *config)
+{
+	struct fixed_model *model = calloc(1, sizeof(*model));
+	model->target = config->max_bitrate;
+	fixed_model = model;
+	return model;
+}
+
+static void fixed_destroy(void *data)
+{
+	free(data);
+}
+
+static void fixed_add_sample(void *data, const struct bitrate_sample *sample)
+{
+	struct fixed_model *model = data;
+	model->samples++;
+}
+
+static void fixed_update(void *data, uint64_t ts, int64_t queue_usec,
+			 long cur_bitrate, struct bitrate_model_state *state)
+{
+	struct fixed_model *model = data;
+	model->updates++;
+	state->target = model->target;
+}
+
+static void fixed_changed(void *data, uint64_t ts, long bitrate)
+{
+	struct fixed_model *model = data;
+	model->changes++;
+}
+
+static const struct bitrate_model_info fixed_model_info = {
+	.id = "fixed",
+	.create = fixed_create,
+	.destroy = fixed_destroy,
+	.add_sample = fixed_add_sample,
+	.update = fixed_update,
+	.bitrate_changed = fixed_changed,
+};
+
+static void custom_model_test(void **state)
+{
+	struct bitrate_controller_config config = {
+		.max_bitrate = 4000,
+		.min_bitrate = 500,
+		.audio_bitrate = 128,
+	};
+	struct bitrate_sample sample = {0, 1, 1000, 0};
+	struct bitrate_controller_stats stats;
+	struct bitrate_decision decision;
+	bitrate_controller_t *bc;
+	struct fixed_model *model;
+	long bitrate = 0;
+
+	assert_null(bitrate_controller_create("unknown", &config));
+
+	bc = bitrate_controller_create_custom(&fixed_model_info, &config);
+	assert_non_null(bc);
+	assert_string_equal(bitrate_controller_model_id(bc), "fixed");
+	model = fixed_model;
+
+	bitrate_controller_add_sample(bc, &sample);
+	assert_int_equal(model->samples, 1);
+
+	/* no change */
+	assert_false(bitrate_controller_update(bc, 1, 0, &bitrate));
+
+	/* clamped to the minimum */
+	model->target = 100;
+	assert_true(bitrate_controller_update(bc, 2, 0, &bitrate));
+	assert_int_equal(bitrate, 500);
+
+	/* increases that are too small to bother with are skipped */
+	model->target = 510;
+	assert_false(bitrate_controller_update(bc, 3, 0, &bitrate));
+
+	/* clamped to the maximum */
+	model->target = 10000;
+	assert_true(bitrate_controller_update(bc, 4, 0, &bitrate));
+	assert_int_equal(bitrate, 4000);
+
+	model->target = 1000;
+	assert_true(bitrate_controller_update(bc, 5, 250000, &bitrate));
+	assert_true(bitrate_controller_reset(bc, 6));
+	assert_false(bitrate_controller_reset(bc, 7));
+	assert_int_equal(bitrate_controller_get_bitrate(bc), 4000);
+
+	assert_int_equal(model->updates, 5);
+	assert_int_equal(model->changes, 4);
+
+	bitrate_controller_get_stats(bc, &stats);
+	assert_int_equal(stats.samples, 1);
+	assert_int_equal(stats.decreases, 2);
+	assert_int_equal(stats.increases, 1);
+	assert_int_equal(stats.decisions, 4);
+
+	assert_true(bitrate_controller_get_decision(bc, 2, &decision));
+	assert_int_equal(decision.type, BITRATE_DECISION_DECREASE);
+	assert_int_equal(decision.prev_bitrate, 4000);
+	assert_int_equal(decision.bitrate, 1000);
+	assert_int_equal(decision.queue_usec, 250000);
+	assert_string_equal(bitrate_decision_type_name(decision.type),
+			    "decrease");
+	assert_false(bitrate_controller_get_decision(bc, 4, &decision));
+
+	bitrate_controller_destroy(bc);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(steady_link_test),
+		cmocka_unit_test(bandwidth_drop_test),
+		cmocka_unit_test(recovery_test),
+		cmocka_unit_test(loss_test),
+		cmocka_unit_test(legacy_model_test),
+		cmocka_unit_test(deterministic_test),
+		cmocka_unit_test(custom_model_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
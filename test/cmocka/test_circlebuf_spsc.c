@@ -0,0 +1,142 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/circlebuf-spsc.h>
+#include <util/platform.h>
+
+static void spsc_basic_test(void **state)
+{
+	struct circlebuf_spsc cb;
+	uint8_t in[5] = {1, 2, 3, 4, 5};
+	uint8_t out[5] = {0};
+
+	assert_true(circlebuf_spsc_init(&cb, 6));
+	assert_int_equal(cb.capacity, 8);
+	assert_int_equal(circlebuf_spsc_size(&cb), 0);
+	assert_int_equal(circlebuf_spsc_avail(&cb), 8);
+
+	assert_true(circlebuf_spsc_push(&cb, in, sizeof(in)));
+	assert_int_equal(circlebuf_spsc_size(&cb), 5);
+
+	/* not enough room, nothing should be written */
+	assert_false(circlebuf_spsc_push(&cb, in, sizeof(in)));
+	assert_int_equal(circlebuf_spsc_size(&cb), 5);
+
+	assert_true(circlebuf_spsc_peek(&cb, out, sizeof(out)));
+	assert_memory_equal(in, out, sizeof(in));
+	assert_int_equal(circlebuf_spsc_size(&cb), 5);
+
+	assert_true(circlebuf_spsc_pop(&cb, out, 2));
+	assert_int_equal(circlebuf_spsc_size(&cb), 3);
+	assert_false(circlebuf_spsc_pop(&cb, out, 4));
+
+	circlebuf_spsc_free(&cb);
+}
+
+static void spsc_wrap_test(void **state)
+{
+	struct circlebuf_spsc cb;
+	uint8_t in[6] = {1, 2, 3, 4, 5, 6};
+	uint8_t out[6] = {0};
+
+	circlebuf_spsc_init(&cb, 8);
+
+	for (int i = 0; i < 100; i++) {
+		assert_true(circlebuf_spsc_push(&cb, in, sizeof(in)));
+		assert_true(circlebuf_spsc_pop(&cb, out, sizeof(out)));
+		assert_memory_equal(in, out, sizeof(in));
+		in[i % 6]++;
+	}
+
+	circlebuf_spsc_free(&cb);
+}
+
+static void spsc_regions_test(void **state)
+{
+	struct circlebuf_spsc cb;
+	uint8_t in[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	const void *rptr1, *rptr2;
+	void *wptr1, *wptr2;
+	size_t size1, size2;
+
+	circlebuf_spsc_init(&cb, 8);
+
+	circlebuf_spsc_push(&cb, in, 6);
+	circlebuf_spsc_pop(&cb, NULL, 6);
+
+	/* writable space now wraps around the end of the buffer */
+	assert_int_equal(circlebuf_spsc_write_regions(&cb, &wptr1, &size1,
+						      &wptr2, &size2),
+			 8);
+	assert_int_equal(size1, 2);
+	assert_int_equal(size2, 6);
+
+	memcpy(wptr1, in, size1);
+	memcpy(wptr2, in + size1, 3);
+	circlebuf_spsc_commit_write(&cb, size1 + 3);
+
+	assert_int_equal(circlebuf_spsc_read_regions(&cb, &rptr1, &size1,
+						     &rptr2, &size2),
+			 5);
+	assert_int_equal(size1, 2);
+	assert_int_equal(size2, 3);
+	assert_memory_equal(rptr1, in, 2);
+	assert_memory_equal(rptr2, in + 2, 3);
+
+	circlebuf_spsc_commit_read(&cb, 5);
+	assert_int_equal(circlebuf_spsc_size(&cb), 0);
+
+	circlebuf_spsc_free(&cb);
+}
+
+#define THREAD_TEST_COUNT 100000
+
+static void *spsc_producer(void *param)
+{
+	struct circlebuf_spsc *cb = param;
+
+	for (uint32_t i = 0; i < THREAD_TEST_COUNT; i++) {
+		while (!circlebuf_spsc_push(cb, &i, sizeof(i)))
+			os_sleep_ms(0);
+	}
+
+	return NULL;
+}
+
+static void spsc_thread_test(void **state)
+{
+	struct circlebuf_spsc cb;
+	pthread_t thread;
+
+	circlebuf_spsc_init(&cb, 4096);
+	assert_int_equal(pthread_create(&thread, NULL, spsc_producer, &cb), 0);
+
+	for (uint32_t i = 0; i < THREAD_TEST_COUNT; i++) {
+		uint32_t val;
+
+		while (!circlebuf_spsc_pop(&cb, &val, sizeof(val)))
+			os_sleep_ms(0);
+
+		if (val != i)
+			fail_msg("expected %u, got %u", i, val);
+	}
+
+	pthread_join(thread, NULL);
+	assert_int_equal(circlebuf_spsc_size(&cb), 0);
+
+	circlebuf_spsc_free(&cb);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(spsc_basic_test),
+		cmocka_unit_test(spsc_wrap_test),
+		cmocka_unit_test(spsc_regions_test),
+		cmocka_unit_test(spsc_thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,228 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <util/bmem.h>
+#include <media-io/format-conversion.h>
+
+/* every path has to produce exactly what the plain C one does, with and
+ * without slice threads */
+
+struct frame {
+	uint32_t width;
+	uint32_t height;
+
+	uint8_t *packed;
+	uint32_t packed_linesize;
+
+	uint8_t *planes[3];
+	uint32_t linesize[3];
+	size_t plane_size[3];
+};
+
+static uint32_t seed = 1;
+
+static uint8_t rand_u8(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (uint8_t)(seed >> 16);
+}
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = rand_u8();
+}
+
+/* decompress_422 reads and writes past the end of the line it is given, so
+ * leave some room at the end of every buffer */
+static void frame_init(struct frame *frame, uint32_t width, uint32_t height)
+{
+	memset(frame, 0, sizeof(*frame));
+	frame->width = width;
+	frame->height = height;
+	frame->packed_linesize = width * 4;
+	frame->packed = bzalloc(frame->packed_linesize * (height + 2));
+
+	for (size_t i = 0; i < 3; i++) {
+		frame->linesize[i] = width;
+		frame->plane_size[i] = (size_t)width * (height + 2);
+		frame->planes[i] = bzalloc(frame->plane_size[i]);
+	}
+}
+
+static void frame_free(struct frame *frame)
+{
+	bfree(frame->packed);
+	for (size_t i = 0; i < 3; i++)
+		bfree(frame->planes[i]);
+}
+
+static void frame_clear(struct frame *frame)
+{
+	memset(frame->packed, 0, frame->packed_linesize * (frame->height + 2));
+	for (size_t i = 0; i < 3; i++)
+		memset(frame->planes[i], 0, frame->plane_size[i]);
+}
+
+static void frame_compare(const struct frame *a, const struct frame *b)
+{
+	assert_memory_equal(a->packed, b->packed,
+			    a->packed_linesize * (a->height + 2));
+	for (size_t i = 0; i < 3; i++)
+		assert_memory_equal(a->planes[i], b->planes[i],
+				    a->plane_size[i]);
+}
+
+enum conversion {
+	CONV_I420,
+	CONV_NV12,
+	CONV_I444,
+	CONV_DECOMPRESS_NV12,
+	CONV_DECOMPRESS_420,
+	CONV_DECOMPRESS_YUY2,
+	CONV_DECOMPRESS_UYVY,
+	CONV_COUNT,
+};
+
+static void run(enum conversion conv, const struct frame *src,
+		struct frame *dst)
+{
+	const uint8_t *const inputs[] = {src->planes[0], src->planes[1],
+					 src->planes[2]};
+	uint32_t h = src->height;
+
+	switch (conv) {
+	case CONV_I420:
+		compress_uyvx_to_i420(src->packed, src->packed_linesize, 0, h,
+				      dst->planes, dst->linesize);
+		break;
+	case CONV_NV12:
+		compress_uyvx_to_nv12(src->packed, src->packed_linesize, 0, h,
+				      dst->planes, dst->linesize);
+		break;
+	case CONV_I444:
+		convert_uyvx_to_i444(src->packed, src->packed_linesize, 0, h,
+				     dst->planes, dst->linesize);
+		break;
+	case CONV_DECOMPRESS_NV12:
+		decompress_nv12(inputs, src->linesize, 0, h, dst->packed,
+				dst->packed_linesize);
+		break;
+	case CONV_DECOMPRESS_420:
+		decompress_420(inputs, src->linesize, 0, h, dst->packed,
+			       dst->packed_linesize);
+		break;
+	case CONV_DECOMPRESS_YUY2:
+	case CONV_DECOMPRESS_UYVY:
+		decompress_422(src->packed, src->width * 2, 0, h, dst->packed,
+			       dst->packed_linesize,
+			       conv == CONV_DECOMPRESS_YUY2);
+		break;
+	case CONV_COUNT:
+		break;
+	}
+}
+
+static void compare_paths(uint32_t width, uint32_t height, uint32_t threads)
+{
+	const enum format_conversion_simd paths[] = {
+		FORMAT_CONVERSION_SIMD_SSE2,
+		FORMAT_CONVERSION_SIMD_AVX2,
+	};
+	struct frame src, expected, out;
+
+	frame_init(&src, width, height);
+	frame_init(&expected, width, height);
+	frame_init(&out, width, height);
+
+	fill_random(src.packed, src.packed_linesize * height);
+	for (size_t i = 0; i < 3; i++)
+		fill_random(src.planes[i], (size_t)width * height);
+
+	for (int conv = 0; conv < CONV_COUNT; conv++) {
+		format_conversion_set_threads(1);
+		assert_true(format_conversion_set_simd(
+			FORMAT_CONVERSION_SIMD_NONE));
+		frame_clear(&expected);
+		run(conv, &src, &expected);
+
+		format_conversion_set_threads(threads);
+
+		for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+			if (!format_conversion_set_simd(paths[i]))
+				continue;
+
+			frame_clear(&out);
+			run(conv, &src, &out);
+			frame_compare(&expected, &out);
+		}
+	}
+
+	format_conversion_set_simd(FORMAT_CONVERSION_SIMD_AUTO);
+	format_conversion_set_threads(0);
+
+	frame_free(&src);
+	frame_free(&expected);
+	frame_free(&out);
+}
+
+static void single_thread_test(void **state)
+{
+	compare_paths(1920, 1080, 1);
+	/* not a multiple of 8, leaves pixels over for the row tails */
+	compare_paths(1284, 202, 1);
+}
+
+static void sliced_test(void **state)
+{
+	compare_paths(1920, 1080, 4);
+	compare_paths(1284, 202, 3);
+	/* too small to be split */
+	compare_paths(64, 64, 4);
+}
+
+static void partial_range_test(void **state)
+{
+	const uint8_t *const inputs[3] = {0};
+	struct frame src, full, part;
+
+	frame_init(&src, 640, 480);
+	frame_init(&full, 640, 480);
+	frame_init(&part, 640, 480);
+	fill_random(src.packed, src.packed_linesize * 480);
+
+	format_conversion_set_threads(4);
+
+	compress_uyvx_to_nv12(src.packed, src.packed_linesize, 0, 480,
+			      full.planes, full.linesize);
+	compress_uyvx_to_nv12(src.packed, src.packed_linesize, 0, 160,
+			      part.planes, part.linesize);
+	compress_uyvx_to_nv12(src.packed, src.packed_linesize, 160, 480,
+			      part.planes, part.linesize);
+	frame_compare(&full, &part);
+
+	/* an empty range must not touch anything */
+	decompress_420(inputs, src.linesize, 100, 100, NULL, 0);
+
+	format_conversion_free();
+	format_conversion_set_threads(0);
+
+	frame_free(&src);
+	frame_free(&full);
+	frame_free(&part);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(single_thread_test),
+		cmocka_unit_test(sliced_test),
+		cmocka_unit_test(partial_range_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,72 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/job-pool.h>
+
+#define JOB_COUNT 1000
+
+struct batch {
+	volatile long calls[JOB_COUNT];
+	volatile long total;
+};
+
+static void count_job(void *param, size_t idx)
+{
+	struct batch *batch = param;
+
+	os_atomic_inc_long(&batch->calls[idx]);
+	os_atomic_inc_long(&batch->total);
+}
+
+static void run_batches(os_job_pool_t *pool)
+{
+	/* every job runs exactly once, whatever the batch size */
+	for (size_t count = 0; count <= JOB_COUNT; count += 37) {
+		struct batch *batch = bzalloc(sizeof(struct batch));
+
+		os_job_pool_run(pool, count_job, batch, count);
+
+		assert_int_equal(batch->total, count);
+		for (size_t i = 0; i < JOB_COUNT; i++)
+			assert_int_equal(batch->calls[i], i < count ? 1 : 0);
+
+		bfree(batch);
+	}
+}
+
+static void threads_test(void **state)
+{
+	os_job_pool_t *pool = os_job_pool_create("test job pool", 3);
+
+	assert_non_null(pool);
+	assert_int_equal(os_job_pool_get_threads(pool), 3);
+
+	run_batches(pool);
+	os_job_pool_destroy(pool);
+}
+
+static void no_threads_test(void **state)
+{
+	os_job_pool_t *pool = os_job_pool_create("test job pool", 0);
+
+	assert_int_equal(os_job_pool_get_threads(pool), 0);
+	run_batches(pool);
+	os_job_pool_destroy(pool);
+
+	/* no pool at all runs everything on the caller */
+	run_batches(NULL);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(threads_test),
+		cmocka_unit_test(no_threads_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,383 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <obs-data.h>
+
+/* enough keys for the name index to be built and grown a few times */
+#define KEY_COUNT 300
+
+static void key_name(char *name, size_t size, int key)
+{
+	snprintf(name, size, "key_%03d", key);
+}
+
+/* items have to come out sorted by name, whatever order they went in */
+static void check_items(obs_data_t *data, const bool *present)
+{
+	obs_data_item_t *item = obs_data_first(data);
+	char name[32];
+
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+
+		if (!present[key]) {
+			assert_false(obs_data_has_user_value(data, name));
+			continue;
+		}
+
+		assert_non_null(item);
+		assert_string_equal(obs_data_item_get_name(item), name);
+		assert_int_equal(obs_data_get_int(data, name), key);
+		obs_data_item_next(&item);
+	}
+
+	assert_null(item);
+}
+
+static void lookup_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	bool present[KEY_COUNT] = {0};
+	char name[32];
+
+	/* 7 is coprime with the key count, so every key is hit once */
+	for (int i = 0; i < KEY_COUNT; i++) {
+		int key = (i * 7) % KEY_COUNT;
+
+		key_name(name, sizeof(name), key);
+		obs_data_set_int(data, name, key);
+		present[key] = true;
+
+		if (i == 10 || i == KEY_COUNT - 1)
+			check_items(data, present);
+	}
+
+	/* erase every third key, then add some back */
+	for (int key = 0; key < KEY_COUNT; key += 3) {
+		key_name(name, sizeof(name), key);
+		obs_data_erase(data, name);
+		present[key] = false;
+	}
+	check_items(data, present);
+
+	for (int key = 0; key < KEY_COUNT; key += 6) {
+		key_name(name, sizeof(name), key);
+		obs_data_set_int(data, name, key);
+		present[key] = true;
+	}
+	check_items(data, present);
+
+	/* remove everything through the iterator */
+	obs_data_item_t *item = obs_data_first(data);
+	while (item) {
+		obs_data_item_t *next = item;
+		obs_data_item_next(&next);
+		obs_data_item_remove(&item);
+		item = next;
+	}
+
+	memset(present, 0, sizeof(present));
+	check_items(data, present);
+	assert_null(obs_data_first(data));
+
+	obs_data_release(data);
+}
+
+static void realloc_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	char name[32];
+	char value[256];
+
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+		obs_data_set_string(data, name, "x");
+	}
+
+	/* longer values and defaults reallocate the items */
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+		memset(value, 'a' + key % 26, sizeof(value) - 1);
+		value[sizeof(value) - 1 - key % 100] = 0;
+
+		obs_data_set_string(data, name, value);
+		obs_data_set_default_string(data, name, value);
+		obs_data_set_autoselect_string(data, name, name);
+	}
+
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+		assert_int_equal(strlen(obs_data_get_string(data, name)),
+				 sizeof(value) - 1 - key % 100);
+		assert_string_equal(obs_data_get_autoselect_string(data, name),
+				    name);
+	}
+
+	/* and the copy has to end up the same */
+	obs_data_t *copy = obs_data_create();
+	obs_data_apply(copy, data);
+	assert_string_equal(obs_data_get_json(copy), obs_data_get_json(data));
+
+	obs_data_release(copy);
+	obs_data_release(data);
+}
+
+static size_t count_items(obs_data_t *data)
+{
+	obs_data_item_t *item = obs_data_first(data);
+	size_t count = 0;
+
+	for (; item; obs_data_item_next(&item))
+		count++;
+	return count;
+}
+
+/* the index is kept once built, even after the object shrinks below the
+ * size that builds it */
+static void shrink_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	char name[32];
+
+	for (int key = 0; key < 20; key++) {
+		key_name(name, sizeof(name), key);
+		obs_data_set_int(data, name, key);
+	}
+	for (int key = 0; key < 10; key++) {
+		key_name(name, sizeof(name), key);
+		obs_data_erase(data, name);
+	}
+
+	obs_data_set_string(data, "new", "x");
+	assert_true(obs_data_has_user_value(data, "new"));
+	assert_int_equal(count_items(data), 11);
+
+	obs_data_set_string(data, "new", "y");
+	assert_int_equal(count_items(data), 11);
+
+	obs_data_item_t *item = obs_data_item_byname(data, "new");
+	assert_non_null(item);
+	obs_data_item_set_string(&item, "a much longer value than before");
+	obs_data_item_release(&item);
+
+	assert_string_equal(obs_data_get_string(data, "new"),
+			    "a much longer value than before");
+	assert_int_equal(count_items(data), 11);
+
+	for (int key = 10; key < 20; key++) {
+		key_name(name, sizeof(name), key);
+		assert_int_equal(obs_data_get_int(data, name), key);
+	}
+
+	obs_data_release(data);
+}
+
+static void json_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	char name[32];
+
+	for (int i = 0; i < KEY_COUNT; i++) {
+		int key = (i * 7) % KEY_COUNT;
+
+		key_name(name, sizeof(name), key);
+		obs_data_set_int(data, name, key);
+	}
+
+	obs_data_t *loaded = obs_data_create_from_json(obs_data_get_json(data));
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_json(loaded), obs_data_get_json(data));
+
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+		assert_int_equal(obs_data_get_int(loaded, name), key);
+	}
+	assert_false(obs_data_has_user_value(loaded, "key_999"));
+
+	obs_data_release(loaded);
+	obs_data_release(data);
+}
+
+static void item_outlives_data_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	char name[32];
+
+	for (int key = 0; key < KEY_COUNT; key++) {
+		key_name(name, sizeof(name), key);
+		obs_data_set_int(data, name, key);
+	}
+
+	obs_data_item_t *item = obs_data_item_byname(data, "key_042");
+	assert_non_null(item);
+	obs_data_release(data);
+
+	/* the item is not part of anything anymore, growing it must not touch
+	 * the released object */
+	obs_data_item_set_string(&item, "a value longer than the int it was");
+	assert_string_equal(obs_data_item_get_string(item),
+			    "a value longer than the int it was");
+	obs_data_item_release(&item);
+}
+
+static obs_data_t *create_nested(void)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *obj = obs_data_create();
+	obs_data_t *empty = obs_data_create();
+	obs_data_array_t *array = obs_data_array_create();
+	obs_data_array_t *empty_array = obs_data_array_create();
+	char name[32];
+
+	for (int i = 0; i < 40; i++) {
+		obs_data_t *item = obs_data_create();
+
+		key_name(name, sizeof(name), i);
+		obs_data_set_string(item, "name", name);
+		obs_data_set_string(item, "id", "same_string");
+		obs_data_set_int(item, "value", -i * 1000000007LL);
+		obs_data_set_obj(item, "settings", obj);
+		obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+
+	obs_data_set_string(obj, "text", "some \"text\"\nwith ütf-8");
+	obs_data_set_string(obj, "empty", "");
+	obs_data_set_double(obj, "double", -0.125);
+	obs_data_set_int(obj, "big", 0x7FFFFFFFFFFFFFFFLL);
+	obs_data_set_bool(obj, "yes", true);
+	obs_data_set_bool(obj, "no", false);
+	obs_data_set_default_int(obj, "default_only", 5);
+
+	obs_data_set_obj(data, "obj", obj);
+	obs_data_set_obj(data, "empty", empty);
+	obs_data_set_array(data, "array", array);
+	obs_data_set_array(data, "empty_array", empty_array);
+	obs_data_set_string(data, "name", "same_string");
+
+	obs_data_array_release(empty_array);
+	obs_data_array_release(array);
+	obs_data_release(empty);
+	obs_data_release(obj);
+	return data;
+}
+
+static obs_data_t *binary_round_trip(obs_data_t *data)
+{
+	size_t size;
+	void *buf = obs_data_get_binary(data, &size);
+	obs_data_t *loaded;
+
+	assert_non_null(buf);
+	loaded = obs_data_create_from_binary(buf, size);
+	bfree(buf);
+
+	assert_non_null(loaded);
+	return loaded;
+}
+
+static void binary_test(void **state)
+{
+	obs_data_t *data = create_nested();
+	obs_data_t *loaded = binary_round_trip(data);
+	obs_data_t *from_json;
+	obs_data_t *twice;
+
+	assert_string_equal(obs_data_get_json(loaded), obs_data_get_json(data));
+
+	/* and the same through the json form */
+	from_json = obs_data_create_from_json(obs_data_get_json(data));
+	twice = binary_round_trip(from_json);
+	assert_string_equal(obs_data_get_json(twice), obs_data_get_json(data));
+
+	/* defaults aren't part of it, same as with json */
+	obs_data_t *obj = obs_data_get_obj(loaded, "obj");
+	assert_false(obs_data_has_user_value(obj, "default_only"));
+	assert_int_equal(obs_data_get_int(obj, "big"), 0x7FFFFFFFFFFFFFFFLL);
+	obs_data_set_int(obj, "added", 1);
+	obs_data_release(obj);
+
+	obs_data_array_t *array = obs_data_get_array(loaded, "array");
+	assert_int_equal(obs_data_array_count(array), 40);
+	obs_data_t *item = obs_data_array_item(array, 39);
+	assert_string_equal(obs_data_get_string(item, "name"), "key_039");
+	assert_int_equal(obs_data_get_int(item, "value"), -39 * 1000000007LL);
+	obs_data_release(item);
+	obs_data_array_release(array);
+
+	obs_data_release(twice);
+	obs_data_release(from_json);
+	obs_data_release(loaded);
+	obs_data_release(data);
+}
+
+static void binary_lazy_test(void **state)
+{
+	obs_data_t *data = create_nested();
+	obs_data_t *loaded = binary_round_trip(data);
+	obs_data_array_t *array = obs_data_get_array(loaded, "array");
+	obs_data_t *item = obs_data_array_item(array, 3);
+	obs_data_t *copy = obs_data_create();
+
+	/* never used objects have to be freed as they are, and used ones
+	 * have to be usable after everything else is gone */
+	obs_data_array_release(array);
+	obs_data_release(loaded);
+
+	obs_data_apply(copy, item);
+	assert_string_equal(obs_data_get_json(copy), obs_data_get_json(item));
+	assert_string_equal(obs_data_get_string(copy, "name"), "key_003");
+
+	obs_data_release(copy);
+	obs_data_release(item);
+	obs_data_release(data);
+}
+
+static void binary_corrupt_test(void **state)
+{
+	obs_data_t *data = create_nested();
+	size_t size;
+	uint8_t *buf = obs_data_get_binary(data, &size);
+	uint8_t *bad = bmalloc(size);
+
+	assert_null(obs_data_create_from_binary(buf, size - 1));
+	assert_null(obs_data_create_from_binary(buf, 4));
+
+	/* damaged data must never be read past the end of the buffer */
+	for (size_t i = 0; i < size; i++) {
+		memcpy(bad, buf, size);
+		bad[i] ^= 0x5A;
+
+		obs_data_t *loaded = obs_data_create_from_binary(bad, size);
+		if (loaded) {
+			assert_non_null(obs_data_get_json(loaded));
+			obs_data_release(loaded);
+		}
+	}
+
+	bfree(bad);
+	bfree(buf);
+	obs_data_release(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lookup_test),
+		cmocka_unit_test(realloc_test),
+		cmocka_unit_test(shrink_test),
+		cmocka_unit_test(json_test),
+		cmocka_unit_test(item_outlives_data_test),
+		cmocka_unit_test(binary_test),
+		cmocka_unit_test(binary_lazy_test),
+		cmocka_unit_test(binary_corrupt_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,161 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define TRACE_FILE "test_profiler_trace.json"
+
+static const char *outer_name = "outer";
+static const char *inner_name = "inner";
+static const char *worker_name = "worker";
+
+static size_t count_str(const char *str, const char *find)
+{
+	size_t count = 0;
+
+	while ((str = strstr(str, find)) != NULL) {
+		count++;
+		str++;
+	}
+
+	return count;
+}
+
+static char *dump_trace(void)
+{
+	assert_true(profiler_trace_dump_json(TRACE_FILE));
+
+	char *json = os_quick_read_utf8_file(TRACE_FILE);
+	assert_non_null(json);
+
+	os_unlink(TRACE_FILE);
+	return json;
+}
+
+static void *worker_thread(void *param)
+{
+	profile_start(worker_name);
+	profile_end(worker_name);
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+static void nested_test(void **state)
+{
+	pthread_t thread;
+
+	profiler_trace_start(64);
+
+	profile_start(outer_name);
+	profile_start(inner_name);
+	profile_end(inner_name);
+	profile_end(outer_name);
+
+	assert_int_equal(pthread_create(&thread, NULL, worker_thread, NULL),
+			 0);
+	pthread_join(thread, NULL);
+
+	char *json = dump_trace();
+
+	/* a ring per thread, named after the first call of the thread */
+	assert_int_equal(count_str(json, "\"thread_name\""), 2);
+	assert_int_equal(count_str(json, "\"args\":{\"name\":\"outer\"}"), 1);
+	assert_int_equal(count_str(json, "\"args\":{\"name\":\"worker\"}"), 1);
+
+	assert_int_equal(count_str(json, "\"ph\":\"B\""), 3);
+	assert_int_equal(count_str(json, "\"ph\":\"E\""), 3);
+	assert_true(strstr(json, "{\"name\":\"outer\",\"ph\":\"B\"") <
+		    strstr(json, "{\"name\":\"inner\",\"ph\":\"B\""));
+
+	bfree(json);
+	profiler_free();
+
+	UNUSED_PARAMETER(state);
+}
+
+static void thread_exit_test(void **state)
+{
+	pthread_t thread;
+
+	profiler_trace_start(64);
+
+	/* the ring of a thread that exited is reused by the next thread */
+	for (int i = 0; i < 10; i++) {
+		assert_int_equal(
+			pthread_create(&thread, NULL, worker_thread, NULL), 0);
+		pthread_join(thread, NULL);
+	}
+
+	char *json = dump_trace();
+
+	assert_int_equal(count_str(json, "\"thread_name\""), 1);
+	assert_int_equal(count_str(json, "\"ph\":\"B\""), 1);
+	assert_int_equal(count_str(json, "\"ph\":\"E\""), 1);
+
+	bfree(json);
+	profiler_free();
+
+	UNUSED_PARAMETER(state);
+}
+
+static void wrap_test(void **state)
+{
+	profiler_trace_start(64);
+
+	profile_start(outer_name);
+	for (int i = 0; i < 100; i++) {
+		profile_start(inner_name);
+		profile_end(inner_name);
+	}
+	profile_end(outer_name);
+
+	char *json = dump_trace();
+
+	/* only the last 64 of the 202 events are kept, the end events whose
+	 * begin events were overwritten are left out */
+	assert_int_equal(count_str(json, "\"ph\":\"B\""), 31);
+	assert_int_equal(count_str(json, "\"ph\":\"E\""), 31);
+	assert_null(strstr(json, "{\"name\":\"outer\",\"ph\""));
+
+	bfree(json);
+	profiler_free();
+
+	UNUSED_PARAMETER(state);
+}
+
+static void stopped_test(void **state)
+{
+	profiler_trace_start(64);
+	profiler_trace_stop();
+
+	profile_start(outer_name);
+	profile_end(outer_name);
+
+	char *json = dump_trace();
+	assert_int_equal(count_str(json, "\"ph\":"), 0);
+
+	bfree(json);
+	profiler_free();
+
+	UNUSED_PARAMETER(state);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(nested_test),
+		cmocka_unit_test(thread_exit_test),
+		cmocka_unit_test(wrap_test),
+		cmocka_unit_test(stopped_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
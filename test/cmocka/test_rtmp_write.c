@@ -0,0 +1,306 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "librtmp/rtmp.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* counts the socket writes done by librtmp, this executable's definitions
+ * take precedence over the libc ones */
+static volatile long send_calls = 0;
+
+ssize_t send(int fd, const void *buf, size_t len, int flags)
+{
+	os_atomic_inc_long(&send_calls);
+	return syscall(SYS_sendto, fd, buf, len, flags, NULL, 0);
+}
+
+ssize_t sendmsg(int fd, const struct msghdr *msg, int flags)
+{
+	os_atomic_inc_long(&send_calls);
+	return syscall(SYS_sendmsg, fd, msg, flags);
+}
+#define SEND_CALLS() os_atomic_load_long(&send_calls)
+#else
+#define SEND_CALLS() 0L
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* local sink that reads everything sent through the socket pair */
+
+struct sink {
+	int fd;
+	bool keep;
+	DARRAY(uint8_t) data;
+	size_t total;
+	pthread_t thread;
+};
+
+static void *sink_thread(void *param)
+{
+	struct sink *sink = param;
+	uint8_t buf[65536];
+	ssize_t ret;
+
+	while ((ret = recv(sink->fd, buf, sizeof(buf), 0)) > 0) {
+		if (sink->keep)
+			da_push_back_array(sink->data, buf, (size_t)ret);
+		sink->total += (size_t)ret;
+	}
+
+	return NULL;
+}
+
+static void open_connection(RTMP *r, struct sink *sink, bool keep)
+{
+	int fds[2];
+
+	assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+	RTMP_Init(r);
+	r->m_sb.sb_socket = fds[0];
+	r->m_outChunkSize = 4096;
+	r->Link.streams[0].id = 1;
+	r->Link.nStreams = 1;
+
+	memset(sink, 0, sizeof(*sink));
+	sink->fd = fds[1];
+	sink->keep = keep;
+	assert_int_equal(pthread_create(&sink->thread, NULL, sink_thread, sink),
+			 0);
+}
+
+static void close_connection(RTMP *r, struct sink *sink)
+{
+	shutdown(r->m_sb.sb_socket, SHUT_WR);
+	pthread_join(sink->thread, NULL);
+	close(r->m_sb.sb_socket);
+	close(sink->fd);
+	r->m_sb.sb_socket = -1;
+	for (int i = 0; i < r->m_channelsAllocatedOut; i++)
+		free(r->m_vecChannelsOut[i]);
+	free(r->m_vecChannelsOut);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void put_be24(uint8_t *p, uint32_t val)
+{
+	p[0] = (uint8_t)(val >> 16);
+	p[1] = (uint8_t)(val >> 8);
+	p[2] = (uint8_t)val;
+}
+
+static size_t add_tag(struct darray *tags, uint8_t type, uint32_t ts,
+		      uint32_t size)
+{
+	DARRAY(uint8_t) out;
+	uint8_t header[11] = {type};
+	uint8_t tag_size[4];
+	size_t start;
+
+	out.da = *tags;
+	start = out.num;
+
+	put_be24(header + 1, size);
+	put_be24(header + 4, ts & 0xFFFFFF);
+	header[7] = (uint8_t)(ts >> 24);
+
+	da_push_back_array(out, header, sizeof(header));
+	for (uint32_t i = 0; i < size; i++) {
+		uint8_t val = (uint8_t)(ts + i);
+		da_push_back(out, &val);
+	}
+
+	put_be24(tag_size + 1, size + 11);
+	tag_size[0] = 0;
+	da_push_back_array(out, tag_size, sizeof(tag_size));
+
+	*tags = out.da;
+	return out.num - start;
+}
+
+/* roughly what a stream looks like: a keyframe, then smaller frames with
+ * audio packets in between */
+static void make_tags(struct darray *tags, struct darray *sizes_da, int frames)
+{
+	DARRAY(size_t) sizes;
+	sizes.da = *sizes_da;
+
+	for (int i = 0; i < frames; i++) {
+		uint32_t ts = (uint32_t)i * 33;
+		uint32_t video = (i % 60) == 0 ? 120000 : 9000 + (i % 7) * 1500;
+		size_t size;
+
+		size = add_tag(tags, RTMP_PACKET_TYPE_VIDEO, ts, video);
+		da_push_back(sizes, &size);
+		size = add_tag(tags, RTMP_PACKET_TYPE_AUDIO, ts + 10, 370);
+		da_push_back(sizes, &size);
+	}
+
+	*sizes_da = sizes.da;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void write_tags_matches_write_test(void **state)
+{
+	DARRAY(uint8_t) tags = {0};
+	DARRAY(size_t) sizes = {0};
+	struct sink sink_a, sink_b;
+	RTMP a, b;
+	size_t offset = 0;
+
+	make_tags(&tags.da, &sizes.da, 90);
+
+	open_connection(&a, &sink_a, true);
+	for (size_t i = 0; i < sizes.num; i++) {
+		int size = (int)sizes.array[i];
+		assert_int_equal(RTMP_Write(&a, (char *)tags.array + offset,
+					    size, 0),
+				 size);
+		offset += sizes.array[i];
+	}
+	close_connection(&a, &sink_a);
+
+	/* send in uneven batches to also cover state carried between calls */
+	open_connection(&b, &sink_b, true);
+	offset = 0;
+	for (size_t i = 0; i < sizes.num;) {
+		size_t count = 1 + i % 5;
+		size_t size = 0;
+
+		for (size_t j = 0; j < count && i < sizes.num; j++)
+			size += sizes.array[i++];
+
+		assert_int_equal(RTMP_WriteTags(&b, (char *)tags.array + offset,
+						(int)size, 0),
+				 (int)size);
+		offset += size;
+	}
+	close_connection(&b, &sink_b);
+
+	assert_true(sink_a.data.num > tags.num / 2);
+	assert_int_equal(sink_a.data.num, sink_b.data.num);
+	assert_memory_equal(sink_a.data.array, sink_b.data.array,
+			    sink_a.data.num);
+
+	da_free(sink_a.data);
+	da_free(sink_b.data);
+	da_free(sizes);
+	da_free(tags);
+}
+
+static void write_tags_incomplete_test(void **state)
+{
+	DARRAY(uint8_t) tags = {0};
+	DARRAY(size_t) sizes = {0};
+	struct sink sink;
+	RTMP r;
+
+	make_tags(&tags.da, &sizes.da, 1);
+
+	open_connection(&r, &sink, false);
+	assert_int_equal(RTMP_WriteTags(&r, (char *)tags.array,
+					(int)sizes.array[0] - 1, 0),
+			 -1);
+	close_connection(&r, &sink);
+
+	da_free(sizes);
+	da_free(tags);
+}
+
+/* ------------------------------------------------------------------------- */
+/* loopback benchmark, prints numbers for both write paths */
+
+static double thread_cpu_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static void bench(const char *name, bool batched, struct darray *tags_da,
+		  struct darray *sizes_da)
+{
+	DARRAY(uint8_t) tags;
+	DARRAY(size_t) sizes;
+	struct sink sink;
+	RTMP r;
+	size_t offset = 0;
+	long calls = SEND_CALLS();
+	uint64_t start = os_gettime_ns();
+	double cpu = thread_cpu_sec();
+
+	tags.da = *tags_da;
+	sizes.da = *sizes_da;
+	open_connection(&r, &sink, false);
+
+	/* one video frame and its audio per send, like the send thread */
+	for (size_t i = 0; i < sizes.num; i += 2) {
+		size_t size = sizes.array[i] + sizes.array[i + 1];
+		char *data = (char *)tags.array + offset;
+
+		if (batched) {
+			assert_int_equal(RTMP_WriteTags(&r, data, (int)size, 0),
+					 (int)size);
+		} else {
+			assert_int_equal(RTMP_Write(&r, data,
+						    (int)sizes.array[i], 0),
+					 (int)sizes.array[i]);
+			assert_int_equal(
+				RTMP_Write(&r, data + sizes.array[i],
+					   (int)sizes.array[i + 1], 0),
+				(int)sizes.array[i + 1]);
+		}
+		offset += size;
+	}
+
+	cpu = thread_cpu_sec() - cpu;
+	calls = SEND_CALLS() - calls;
+	double sec = (double)(os_gettime_ns() - start) / 1000000000.0;
+	close_connection(&r, &sink);
+
+	double mbit = (double)sink.total * 8.0 / 1000000.0;
+	print_message("%-14s %8.1f Mbps, %9.0f syscalls/sec, "
+		      "%6.3f ms CPU per Mbit\n",
+		      name, mbit / sec, (double)calls / sec,
+		      cpu * 1000.0 / mbit);
+}
+
+static void write_benchmark(void **state)
+{
+	DARRAY(uint8_t) tags = {0};
+	DARRAY(size_t) sizes = {0};
+
+	make_tags(&tags.da, &sizes.da, 1200);
+
+	bench("RTMP_Write", false, &tags.da, &sizes.da);
+	bench("RTMP_WriteTags", true, &tags.da, &sizes.da);
+
+	da_free(sizes);
+	da_free(tags);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(write_tags_matches_write_test),
+		cmocka_unit_test(write_tags_incomplete_test),
+		cmocka_unit_test(write_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,196 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+struct counter {
+	signal_handler_t *handler;
+	volatile long calls;
+	volatile bool in_call;
+	bool disconnect_self;
+	bool remove_self;
+};
+
+static void count_callback(void *param, calldata_t *cd)
+{
+	struct counter *counter = param;
+
+	os_atomic_set_bool(&counter->in_call, true);
+	os_atomic_inc_long(&counter->calls);
+
+	if (counter->disconnect_self)
+		signal_handler_disconnect(counter->handler, "test",
+					  count_callback, counter);
+	if (counter->remove_self)
+		signal_handler_remove_current();
+
+	os_atomic_set_bool(&counter->in_call, false);
+
+	UNUSED_PARAMETER(cd);
+}
+
+static signal_handler_t *create_handler(void)
+{
+	signal_handler_t *handler = signal_handler_create();
+
+	assert_non_null(handler);
+	assert_true(signal_handler_add(handler, "void test(int value)"));
+	return handler;
+}
+
+static void signal_test(signal_handler_t *handler)
+{
+	struct calldata cd;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "value", 1);
+	signal_handler_signal(handler, "test", &cd);
+}
+
+static void connect_test(void **state)
+{
+	signal_handler_t *handler = create_handler();
+	struct counter a = {handler};
+	struct counter b = {handler};
+
+	signal_handler_connect(handler, "test", count_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &b);
+
+	/* connecting twice only connects once */
+	signal_test(handler);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 1);
+
+	signal_handler_disconnect(handler, "test", count_callback, &a);
+	signal_test(handler);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 2);
+
+	signal_handler_disconnect(handler, "test", count_callback, &b);
+	signal_test(handler);
+	assert_int_equal(b.calls, 2);
+
+	signal_handler_destroy(handler);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void remove_in_callback_test(void **state)
+{
+	signal_handler_t *handler = create_handler();
+	struct counter a = {handler, .disconnect_self = true};
+	struct counter b = {handler, .remove_self = true};
+	struct counter c = {handler};
+
+	signal_handler_connect(handler, "test", count_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &b);
+	signal_handler_connect(handler, "test", count_callback, &c);
+
+	signal_test(handler);
+	signal_test(handler);
+
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 1);
+	assert_int_equal(c.calls, 2);
+
+	signal_handler_destroy(handler);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void keep_ref_test(void **state)
+{
+	signal_handler_t *handler = create_handler();
+	struct counter a = {handler, .remove_self = true};
+
+	/* the connection keeps the handler alive after it is destroyed */
+	signal_handler_connect_ref(handler, "test", count_callback, &a);
+	signal_handler_destroy(handler);
+
+	signal_test(handler);
+	assert_int_equal(a.calls, 1);
+
+	/* removing the connection released the last reference */
+
+	UNUSED_PARAMETER(state);
+}
+
+struct signal_thread {
+	signal_handler_t *handler;
+	volatile bool stop;
+};
+
+static void *signal_thread(void *param)
+{
+	struct signal_thread *thread = param;
+
+	while (!os_atomic_load_bool(&thread->stop))
+		signal_test(thread->handler);
+
+	return NULL;
+}
+
+static void concurrent_test(void **state)
+{
+	signal_handler_t *handler = create_handler();
+	struct signal_thread thread = {handler};
+	struct counter counters[8];
+	pthread_t threads[2];
+
+	for (size_t i = 0; i < 2; i++)
+		assert_int_equal(pthread_create(&threads[i], NULL,
+						signal_thread, &thread),
+				 0);
+
+	for (int round = 0; round < 200; round++) {
+		for (size_t i = 0; i < 8; i++) {
+			counters[i] = (struct counter){handler};
+			signal_handler_connect(handler, "test", count_callback,
+					       &counters[i]);
+		}
+
+		os_sleep_ms(0);
+
+		/* once disconnected, a callback is neither running nor called
+		 * again */
+		for (size_t i = 0; i < 8; i++) {
+			struct counter *counter = &counters[i];
+			long calls;
+
+			signal_handler_disconnect(handler, "test",
+						  count_callback, counter);
+			assert_false(os_atomic_load_bool(&counter->in_call));
+
+			calls = os_atomic_load_long(&counter->calls);
+			os_sleep_ms(0);
+			assert_int_equal(os_atomic_load_long(&counter->calls),
+					 calls);
+		}
+	}
+
+	os_atomic_set_bool(&thread.stop, true);
+	for (size_t i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	signal_handler_destroy(handler);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(connect_test),
+		cmocka_unit_test(remove_in_callback_test),
+		cmocka_unit_test(keep_ref_test),
+		cmocka_unit_test(concurrent_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,270 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+
+/* the input callback is held up until the test lets it go, so which frames
+ * a queued input gets and skips is deterministic */
+
+struct slow_input {
+	os_event_t *entered;
+	os_event_t *release;
+	uint64_t timestamps[16];
+	volatile long count;
+};
+
+static void slow_callback(void *param, struct video_data *frame)
+{
+	struct slow_input *input = param;
+
+	long count = os_atomic_load_long(&input->count);
+
+	if (count < 16)
+		input->timestamps[count] = frame->timestamp;
+	os_atomic_inc_long(&input->count);
+
+	os_event_signal(input->entered);
+	os_event_wait(input->release);
+}
+
+static video_t *open_video(size_t cache_size)
+{
+	struct video_output_info info = {
+		.name = "test",
+		.format = VIDEO_FORMAT_I420,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = 16,
+		.height = 16,
+		.cache_size = cache_size,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	video_t *video = NULL;
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+static void output_frame(video_t *video, uint64_t timestamp)
+{
+	struct video_frame frame;
+
+	assert_true(video_output_lock_frame(video, &frame, 1, timestamp));
+	video_output_unlock_frame(video);
+}
+
+static void run_policy(enum video_input_drop_policy policy,
+		       struct slow_input *input,
+		       struct video_input_stats *stats)
+{
+	struct video_input_queue_info queue = {2, policy};
+	video_t *video = open_video(6);
+
+	os_event_init(&input->entered, OS_EVENT_TYPE_AUTO);
+	os_event_init(&input->release, OS_EVENT_TYPE_MANUAL);
+
+	assert_true(video_output_connect_queued(video, NULL, &queue,
+						slow_callback, input));
+
+	/* frame 1 gets stuck in the callback, 2 and 3 fill the queue, 4 is
+	 * over the depth */
+	output_frame(video, 1);
+	os_event_wait(input->entered);
+	output_frame(video, 2);
+	output_frame(video, 3);
+	if (policy != VIDEO_INPUT_BLOCK)
+		output_frame(video, 4);
+	os_sleep_ms(50);
+
+	os_event_signal(input->release);
+
+	for (int i = 0; i < 1000 && os_atomic_load_long(&input->count) < 3; i++)
+		os_sleep_ms(1);
+	os_sleep_ms(50);
+
+	assert_true(video_output_get_input_stats(video, slow_callback, input,
+						 stats));
+	video_output_disconnect(video, slow_callback, input);
+	video_output_close(video);
+
+	os_event_destroy(input->entered);
+	os_event_destroy(input->release);
+}
+
+static void drop_newest_test(void **state)
+{
+	struct slow_input input = {0};
+	struct video_input_stats stats;
+
+	run_policy(VIDEO_INPUT_DROP_NEWEST, &input, &stats);
+
+	assert_int_equal(input.count, 2);
+	assert_int_equal(input.timestamps[0], 1);
+	assert_int_equal(input.timestamps[1], 2);
+	assert_int_equal(stats.skipped_frames, 2);
+	assert_int_equal(stats.queue_depth, 2);
+	assert_int_equal(stats.max_queued_frames, 2);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void drop_oldest_test(void **state)
+{
+	struct slow_input input = {0};
+	struct video_input_stats stats;
+
+	run_policy(VIDEO_INPUT_DROP_OLDEST, &input, &stats);
+
+	/* 2 is the oldest frame over the depth once 1 is done */
+	assert_int_equal(input.count, 3);
+	assert_int_equal(input.timestamps[0], 1);
+	assert_int_equal(input.timestamps[1], 3);
+	assert_int_equal(input.timestamps[2], 4);
+	assert_int_equal(stats.skipped_frames, 1);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void block_test(void **state)
+{
+	struct slow_input input = {0};
+	struct video_input_stats stats;
+	uint32_t frames = 0;
+
+	run_policy(VIDEO_INPUT_BLOCK, &input, &stats);
+
+	assert_int_equal(input.count, 3);
+	assert_int_equal(input.timestamps[2], 3);
+	assert_int_equal(stats.skipped_frames, 0);
+
+	for (size_t i = 0; i < VIDEO_INPUT_LATENCY_BUCKETS; i++)
+		frames += stats.latency[i];
+	assert_int_equal(frames, 3);
+
+	/* the first frame was held up for at least 50ms */
+	assert_true(stats.latency[VIDEO_INPUT_LATENCY_BUCKETS - 1] +
+			    stats.latency[VIDEO_INPUT_LATENCY_BUCKETS - 2] >=
+		    1);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void discard_callback(void *param, struct video_data *frame)
+{
+	os_atomic_inc_long(param);
+	UNUSED_PARAMETER(frame);
+}
+
+/* a queued input that is stuck must only skip its own frames, even when it
+ * would have held on to more frames than the cache has */
+static void blocked_input_test(void **state)
+{
+	struct video_input_queue_info queue = {4, VIDEO_INPUT_DROP_OLDEST};
+	struct slow_input input = {0};
+	volatile long direct = 0;
+	video_t *video = open_video(6);
+	int locked = 0;
+
+	os_event_init(&input.entered, OS_EVENT_TYPE_AUTO);
+	os_event_init(&input.release, OS_EVENT_TYPE_MANUAL);
+
+	assert_true(video_output_connect_queued(video, NULL, &queue,
+						slow_callback, &input));
+	assert_true(video_output_connect(video, NULL, discard_callback,
+					 (void *)&direct));
+
+	output_frame(video, 1);
+	os_event_wait(input.entered);
+
+	/* give the video thread time to hand out each frame, so the cache
+	 * never runs full on its own */
+	for (uint64_t ts = 2; ts <= 30; ts++) {
+		struct video_frame frame;
+
+		if (video_output_lock_frame(video, &frame, 1, ts)) {
+			video_output_unlock_frame(video);
+			locked++;
+		}
+		os_sleep_ms(5);
+	}
+
+	assert_int_equal(locked, 29);
+	assert_int_equal(video_output_get_skipped_frames(video), 0);
+	assert_int_equal(os_atomic_load_long(&direct), 30);
+	assert_true(video_output_get_input_skipped_frames(
+			    video, slow_callback, &input) > 0);
+
+	os_event_signal(input.release);
+	video_output_disconnect(video, slow_callback, &input);
+	video_output_disconnect(video, discard_callback, (void *)&direct);
+	video_output_close(video);
+
+	os_event_destroy(input.entered);
+	os_event_destroy(input.release);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* with threaded inputs turned on, a plain input gets its own thread too and a
+ * stuck one only skips its own frames */
+static void threaded_inputs_test(void **state)
+{
+	struct slow_input input = {0};
+	volatile long direct = 0;
+	video_t *video = open_video(6);
+
+	os_event_init(&input.entered, OS_EVENT_TYPE_AUTO);
+	os_event_init(&input.release, OS_EVENT_TYPE_MANUAL);
+
+	assert_false(video_output_threaded_inputs(video));
+	video_output_set_threaded_inputs(video, true);
+	assert_true(video_output_threaded_inputs(video));
+
+	assert_true(video_output_connect(video, NULL, slow_callback, &input));
+	assert_true(video_output_connect(video, NULL, discard_callback,
+					 (void *)&direct));
+
+	output_frame(video, 1);
+	os_event_wait(input.entered);
+
+	for (uint64_t ts = 2; ts <= 10; ts++) {
+		output_frame(video, ts);
+		os_sleep_ms(5);
+	}
+
+	assert_int_equal(video_output_get_skipped_frames(video), 0);
+	assert_int_equal(os_atomic_load_long(&direct), 10);
+	assert_int_equal(os_atomic_load_long(&input.count), 1);
+	assert_true(video_output_get_input_skipped_frames(
+			    video, slow_callback, &input) > 0);
+
+	os_event_signal(input.release);
+	video_output_disconnect(video, slow_callback, &input);
+	video_output_disconnect(video, discard_callback, (void *)&direct);
+	video_output_close(video);
+
+	os_event_destroy(input.entered);
+	os_event_destroy(input.release);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(drop_newest_test),
+		cmocka_unit_test(drop_oldest_test),
+		cmocka_unit_test(block_test),
+		cmocka_unit_test(blocked_input_test),
+		cmocka_unit_test(threaded_inputs_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}